@@ -0,0 +1,95 @@
+#pragma once
+
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+
+// std lib headers
+#include <memory>
+#include <mutex>
+#include <unordered_set>
+#include <vector>
+
+// Where a resource lives, returned by MemoryAllocator and handed back to free it
+struct Allocation {
+  VkDeviceMemory memory = VK_NULL_HANDLE;
+  VkDeviceSize offset = 0;
+  VkDeviceSize size = 0;
+  // Persistently mapped pointer to offset, null unless the memory is host visible
+  void *mapped = nullptr;
+  // Property flags of the memory type it was placed in, which may have fewer than were asked for
+  VkMemoryPropertyFlags properties = 0;
+
+  uint32_t pool = 0;
+  uint32_t block = 0;
+  uint32_t order = 0;
+  bool dedicated = false;
+};
+
+struct AllocatorStats {
+  uint32_t blockCount = 0;
+  uint32_t dedicatedCount = 0;
+  uint64_t allocationCount = 0;
+  // Memory held from the driver, handed out to resources, and actually requested by them
+  VkDeviceSize reservedBytes = 0;
+  VkDeviceSize allocatedBytes = 0;
+  VkDeviceSize requestedBytes = 0;
+};
+
+// Buffers and linear images are kept apart from optimal images so bufferImageGranularity never applies
+enum class ResourceKind { Linear, Optimal };
+
+/*
+ * Buddy sub-allocator over large VkDeviceMemory blocks, one pool of blocks per
+ * memory type and resource kind. Sizes round up to a power of two no smaller
+ * than the alignment, so every sub-allocation is naturally aligned. Requests
+ * larger than a block get a dedicated allocation.
+ */
+class MemoryAllocator {
+ public:
+  static constexpr VkDeviceSize MIN_ALLOCATION_SIZE = 256;
+  static constexpr VkDeviceSize DEFAULT_BLOCK_SIZE = 64 * 1024 * 1024;
+
+  MemoryAllocator(VkPhysicalDevice physicalDevice, VkDevice device);
+  ~MemoryAllocator();
+
+  MemoryAllocator(const MemoryAllocator &) = delete;
+  MemoryAllocator &operator=(const MemoryAllocator &) = delete;
+
+  Allocation allocate(
+      const VkMemoryRequirements &requirements,
+      VkMemoryPropertyFlags properties,
+      ResourceKind kind);
+  void free(const Allocation &allocation);
+
+  AllocatorStats getStats();
+
+ private:
+  struct Block {
+    VkDeviceMemory memory = VK_NULL_HANDLE;
+    void *mapped = nullptr;
+    // Free offsets per order, order 0 is MIN_ALLOCATION_SIZE
+    std::vector<std::unordered_set<VkDeviceSize>> freeLists;
+    VkDeviceSize allocatedBytes = 0;
+  };
+
+  struct Pool {
+    uint32_t memoryType;
+    ResourceKind kind;
+    VkDeviceSize blockSize;
+    uint32_t maxOrder;
+    bool hostVisible;
+    std::vector<std::unique_ptr<Block>> blocks;
+  };
+
+  uint32_t findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties);
+  uint32_t getPool(uint32_t memoryType, ResourceKind kind);
+  uint32_t createBlock(Pool &pool);
+  bool allocateFromBlock(Pool &pool, uint32_t blockIndex, uint32_t order, Allocation &allocation);
+  Allocation allocateDedicated(uint32_t memoryType, VkDeviceSize size);
+
+  VkDevice device_;
+  VkPhysicalDeviceMemoryProperties memProperties;
+  std::vector<Pool> pools;
+  std::mutex mutex;
+  AllocatorStats stats;
+};
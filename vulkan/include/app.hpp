@@ -4,7 +4,16 @@
 #include "pipeline.hpp"
 #include "device.hpp"
 #include "swap_chain.hpp"
+#include "upload_ring.hpp"
+#include "transfer_manager.hpp"
+#include "pipeline_library.hpp"
+#include "shader_archive.hpp"
+#include "layout_cache.hpp"
+#include "compute_pipeline.hpp"
+#include "mesh.hpp"
+#include "mesh_loader.hpp"
 
+#include <functional>
 #include <memory>
 #include <vector>
 #include <stdexcept>
@@ -14,6 +23,8 @@ class App{
     Window window;
     Device device;
     SwapChain swapChain;
+    ShaderArchive shaders;
+    LayoutCache layouts;
     std::unique_ptr<Pipeline> pipeline; 
     VkPipelineLayout pipelineLayout;
     std::vector<VkCommandBuffer> commandBuffers;
@@ -22,13 +33,69 @@ class App{
     void createPipeline();
     void createCommandBuffers();
     void drawFrame();
+
+    // Command buffers and the vertex shader invocation query timeDraws records into, and what
+    // its last run measured; invocations stay 0 without pipeline statistics
+    struct DrawTimer {
+      std::vector<VkCommandBuffer> commandBuffers;
+      VkQueryPool statisticsPool = VK_NULL_HANDLE;
+      double frameMs = 0.0;
+      uint64_t vertexInvocationsPerDraw = 0;
+    };
+
+    // Color and depth attachments and a framebuffer for the swap chain's render pass at one extent,
+    // what a resize rebuilds
+    struct RenderTarget {
+      VkImage images[2];
+      Allocation memory[2];
+      VkImageView views[2];
+      VkFramebuffer framebuffer;
+    };
+
+    // Buffer creation and destruction through the device memory allocator
+    void benchmarkAllocator(int buffers);
+    // Per frame uploads through an UploadRing and asset uploads through the TransferManager
+    void benchmarkTransfers();
+    // New pipeline variants, resizes and extended dynamic state
+    void benchmarkPipelines();
+    // Loose shader files against the mapped archive, and layout deduplication across materials
+    void benchmarkShaderLoading();
+    // Bandwidth of a SAXPY compute dispatch against the same loop on the CPU
+    void benchmarkCompute();
+    // Grid draws with interleaved and position split vertex layouts in float and quantized formats
+    void benchmarkMeshes();
+    // A million triangle OBJ loaded on one thread and all of them, drawn in file order and optimized
+    void benchmarkMeshLoading();
+
+    DrawTimer createDrawTimer();
+    void destroyDrawTimer(DrawTimer& timer);
+    // Mesh shaders take the mesh's PositionQuantization as push constants through meshLayout
+    std::unique_ptr<Pipeline> createMeshPipeline(const VertexLayout& layout, bool depthOnly, VkPipelineLayout& meshLayout);
+    // Millions of triangles per second through the swap chain, as frames would be drawn
+    double timeDraws(DrawTimer& timer, Mesh& mesh, bool depthOnly);
+
+    // The material'th variant of the default pipeline, differing in cull mode, front face and depth compare
+    PipelineDesc materialDesc(int material, bool blend, bool extendedDynamic = false);
+    // Prints average and worst frame time while new materials arrive, pipelines fetched through lookup
+    void timeMaterials(bool blend, const std::function<VkPipeline(const PipelineDesc&)>& lookup);
+    RenderTarget createRenderTarget(VkExtent2D extent);
+    void destroyRenderTarget(RenderTarget& target);
+    // One frame into target, record draws between the render pass begin and end, waited on
+    void drawToTarget(RenderTarget& target, VkExtent2D extent, const std::function<void(VkCommandBuffer)>& record);
+    // Average ms for a resize that rebuilds the render target and draws every material once. Dynamic
+    // viewports keep their pipelines, baked in ones rebuild all of them for the new extent
+    double timeResizes(bool staticViewport);
   public:
     static constexpr int WIDTH = 800;
     static constexpr int HEIGHT = 600;
+    // Written by tools/pack_shaders in make buildShaders
+    static constexpr const char* SHADER_ARCHIVE_PATH = "build/shaders/shaders.pak";
 
     App(std::string title);
     ~App();
     void run();
+    // Runs the benchmark functions above in order, printing what each measured
+    void benchmark(int buffers);
 
     App(const App&) = delete;
     App& operator=(const App&) = delete;
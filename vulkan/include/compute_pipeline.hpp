@@ -0,0 +1,66 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <stdexcept>
+
+#include "device.hpp"
+#include "layout_cache.hpp"
+#include "shader_archive.hpp"
+#include "shader_reflection.hpp"
+#include "specialization.hpp"
+
+/*
+ * A compute shader with its layout, reflected like Pipeline's, and a pool for
+ * the descriptor sets its dispatches bind. Record into graphics command
+ * buffers: the graphics family always does compute too, so results reach
+ * rendering with a barrier instead of a queue ownership transfer.
+ */
+class ComputePipeline{
+  public:
+    // Room for maxSets of each descriptor set the shader declares
+    ComputePipeline(Device& device, const ShaderArchive& shaders, LayoutCache& layouts,
+                    const std::string& shader, const SpecializationConstants& specialization = {},
+                    uint32_t maxSets = 16);
+    ~ComputePipeline();
+
+    // Deleted
+    ComputePipeline(const ComputePipeline&) = delete;
+    ComputePipeline& operator=(const ComputePipeline&) = delete;
+
+    // Freed with the pipeline, throws once maxSets of this set number are allocated
+    VkDescriptorSet allocateDescriptorSet(uint32_t set = 0);
+    void writeStorageBuffer(VkDescriptorSet descriptorSet, uint32_t binding, VkBuffer buffer,
+                            VkDeviceSize offset = 0, VkDeviceSize range = VK_WHOLE_SIZE);
+
+    void bind(VkCommandBuffer commandBuffer);
+    void bindDescriptorSet(VkCommandBuffer commandBuffer, VkDescriptorSet descriptorSet, uint32_t set = 0);
+    // Size and layout must match the shader's push constant block
+    void pushConstants(VkCommandBuffer commandBuffer, const void* data, uint32_t size);
+    // One invocation per element along x, capped at the device's workgroup count limit, so
+    // shaders loop over elements with a stride of gl_NumWorkGroups.x * gl_WorkGroupSize.x
+    void dispatch(VkCommandBuffer commandBuffer, uint32_t elements);
+    void dispatchGroups(VkCommandBuffer commandBuffer, uint32_t x, uint32_t y = 1, uint32_t z = 1);
+
+    // Buffer writes of earlier dispatches visible to later ones
+    static void computeBarrier(VkCommandBuffer commandBuffer);
+    // Buffer writes of earlier dispatches visible to graphics, e.g. VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT
+    // at VK_PIPELINE_STAGE_VERTEX_INPUT_BIT for vertices skinned or particles simulated on the GPU
+    static void computeToGraphicsBarrier(VkCommandBuffer commandBuffer, VkAccessFlags dstAccess,
+                                         VkPipelineStageFlags dstStages);
+
+    VkPipeline getPipeline() { return computePipeline; }
+    VkPipelineLayout getPipelineLayout() { return pipelineLayout; }
+    uint32_t getWorkgroupSize() const { return reflection.localSize[0]; }
+  private:
+    void createComputePipeline(const ShaderCode& code, const SpecializationConstants& specialization);
+    void createDescriptorPool(uint32_t maxSets);
+
+    Device& device;
+    LayoutCache& layouts;
+    ShaderReflection reflection;
+    VkShaderModule shaderModule;
+    VkPipelineLayout pipelineLayout;
+    VkPipeline computePipeline;
+    VkDescriptorPool descriptorPool = VK_NULL_HANDLE;
+};
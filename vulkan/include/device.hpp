@@ -1,8 +1,11 @@
 #pragma once
 
 #include "window.hpp"
+#include "allocator.hpp"
 
 // std lib headers
+#include <memory>
+#include <mutex>
 #include <string>
 #include <vector>
 
@@ -13,11 +16,25 @@ struct SwapChainSupportDetails {
   std::vector<VkPresentModeKHR> presentModes;
 };
 
+// Entry points of VK_EXT_extended_dynamic_state, null when the device does not support it
+struct ExtendedDynamicStateFunctions {
+  PFN_vkCmdSetCullModeEXT setCullMode = nullptr;
+  PFN_vkCmdSetFrontFaceEXT setFrontFace = nullptr;
+  PFN_vkCmdSetPrimitiveTopologyEXT setPrimitiveTopology = nullptr;
+  PFN_vkCmdSetDepthTestEnableEXT setDepthTestEnable = nullptr;
+  PFN_vkCmdSetDepthWriteEnableEXT setDepthWriteEnable = nullptr;
+  PFN_vkCmdSetDepthCompareOpEXT setDepthCompareOp = nullptr;
+};
+
 struct QueueFamilyIndices {
+  // Supports compute as well, which the spec guarantees some family does on graphics devices
   uint32_t graphicsFamily;
   uint32_t presentFamily;
+  // A family without graphics support that can copy alongside rendering, if the device has one
+  uint32_t transferFamily;
   bool graphicsFamilyHasValue = false;
   bool presentFamilyHasValue = false;
+  bool transferFamilyHasValue = false;
   bool isComplete() { return graphicsFamilyHasValue && presentFamilyHasValue; }
 };
 
@@ -38,25 +55,36 @@ class Device {
   Device(Device &&) = delete;
   Device &operator=(Device &&) = delete;
 
+  // Loaded from PIPELINE_CACHE_PATH on construction and written back on destruction
+  static constexpr const char *PIPELINE_CACHE_PATH = "build/pipeline_cache.bin";
+
   VkCommandPool getCommandPool() { return commandPool; }
+  VkPipelineCache pipelineCache() { return pipelineCache_; }
   VkDevice device() { return device_; }
   VkSurfaceKHR surface() { return surface_; }
   VkQueue graphicsQueue() { return graphicsQueue_; }
   VkQueue presentQueue() { return presentQueue_; }
+  // The graphics queue when there is no dedicated transfer family
+  VkQueue transferQueue() { return transferQueue_; }
+  // Queues need external synchronization, hold this around every vkQueueSubmit, vkQueuePresentKHR
+  // and vkQueueWaitIdle. One for all queues, as they may be the same VkQueue
+  std::mutex &queueMutex() { return queueMutex_; }
 
   SwapChainSupportDetails getSwapChainSupport() { return querySwapChainSupport(physicalDevice); }
   uint32_t findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties);
+  bool hasMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties);
   QueueFamilyIndices findPhysicalQueueFamilies() { return findQueueFamilies(physicalDevice); }
   VkFormat findSupportedFormat(
       const std::vector<VkFormat> &candidates, VkImageTiling tiling, VkFormatFeatureFlags features);
 
-  // Buffer Helper Functions
+  // Buffer Helper Functions, memory is sub-allocated and must be released with the matching destroy
   void createBuffer(
       VkDeviceSize size,
       VkBufferUsageFlags usage,
       VkMemoryPropertyFlags properties,
       VkBuffer &buffer,
-      VkDeviceMemory &bufferMemory);
+      Allocation &bufferMemory);
+  void destroyBuffer(VkBuffer buffer, Allocation &bufferMemory);
   VkCommandBuffer beginSingleTimeCommands();
   void endSingleTimeCommands(VkCommandBuffer commandBuffer);
   void copyBuffer(VkBuffer srcBuffer, VkBuffer dstBuffer, VkDeviceSize size);
@@ -67,7 +95,16 @@ class Device {
       const VkImageCreateInfo &imageInfo,
       VkMemoryPropertyFlags properties,
       VkImage &image,
-      VkDeviceMemory &imageMemory);
+      Allocation &imageMemory);
+  void destroyImage(VkImage image, Allocation &imageMemory);
+
+  MemoryAllocator &allocator() { return *allocator_; }
+
+  // Cull mode, front face, topology and depth test state can be set while recording
+  bool supportsExtendedDynamicState() { return extendedDynamicState_; }
+  const ExtendedDynamicStateFunctions &extendedDynamicState() { return extendedDynamicStateFunctions; }
+  // VK_QUERY_TYPE_PIPELINE_STATISTICS query pools can be created
+  bool supportsPipelineStatistics() { return pipelineStatistics_; }
 
   VkPhysicalDeviceProperties properties;
 
@@ -78,6 +115,8 @@ class Device {
   void pickPhysicalDevice();
   void createLogicalDevice();
   void createCommandPool();
+  void createPipelineCache();
+  void savePipelineCache();
 
   // helper functions
   bool isDeviceSuitable(VkPhysicalDevice device);
@@ -87,6 +126,7 @@ class Device {
   void populateDebugMessengerCreateInfo(VkDebugUtilsMessengerCreateInfoEXT &createInfo);
   void hasGflwRequiredInstanceExtensions();
   bool checkDeviceExtensionSupport(VkPhysicalDevice device);
+  bool hasDeviceExtension(VkPhysicalDevice device, const char *extension);
   SwapChainSupportDetails querySwapChainSupport(VkPhysicalDevice device);
 
   VkInstance instance;
@@ -94,11 +134,18 @@ class Device {
   VkPhysicalDevice physicalDevice = VK_NULL_HANDLE;
   Window &window;
   VkCommandPool commandPool;
+  VkPipelineCache pipelineCache_;
 
   VkDevice device_;
   VkSurfaceKHR surface_;
   VkQueue graphicsQueue_;
   VkQueue presentQueue_;
+  VkQueue transferQueue_;
+  std::mutex queueMutex_;
+  std::unique_ptr<MemoryAllocator> allocator_;
+  bool extendedDynamicState_ = false;
+  ExtendedDynamicStateFunctions extendedDynamicStateFunctions;
+  bool pipelineStatistics_ = false;
 
   const std::vector<const char *> validationLayers = {"VK_LAYER_KHRONOS_validation"};
   const std::vector<const char *> deviceExtensions = {VK_KHR_SWAPCHAIN_EXTENSION_NAME};
@@ -0,0 +1,32 @@
+#pragma once
+
+// std lib headers
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <type_traits>
+
+// FNV-1a, stable across runs so hashes can key data on disk as well as in memory
+static constexpr uint64_t HASH_SEED = 14695981039346656037ULL;
+
+inline uint64_t hashBytes(const void *data, size_t size, uint64_t hash = HASH_SEED) {
+  const unsigned char *bytes = static_cast<const unsigned char *>(data);
+  for (size_t i = 0; i < size; i++) {
+    hash ^= bytes[i];
+    hash *= 1099511628211ULL;
+  }
+  return hash;
+}
+
+// Only for types without padding or pointers, whose bytes are their value
+template <typename T>
+void hashCombine(uint64_t &hash, const T &value) {
+  static_assert(std::is_trivially_copyable<T>::value, "hash the fields of this type instead");
+  hash = hashBytes(&value, sizeof(T), hash);
+}
+
+inline void hashCombine(uint64_t &hash, const std::string &value) {
+  hash = hashBytes(value.data(), value.size(), hash);
+  // Keeps ("ab", "c") and ("a", "bc") apart
+  hashCombine(hash, value.size());
+}
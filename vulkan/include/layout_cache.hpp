@@ -0,0 +1,39 @@
+#pragma once
+
+#include "device.hpp"
+#include "shader_reflection.hpp"
+
+// std lib headers
+#include <unordered_map>
+#include <vector>
+
+/*
+ * Descriptor set and pipeline layouts built from ShaderReflection, created
+ * once per distinct layout however many pipelines ask for it. Handles stay
+ * valid until the cache is destroyed, so pipelines share them freely.
+ *
+ * Not thread safe, layouts are expected to be requested while pipelines are set up.
+ */
+class LayoutCache {
+ public:
+  explicit LayoutCache(Device &device);
+  ~LayoutCache();
+
+  LayoutCache(const LayoutCache &) = delete;
+  LayoutCache &operator=(const LayoutCache &) = delete;
+
+  // Bindings sorted by binding number, as ShaderReflection leaves them
+  VkDescriptorSetLayout getSetLayout(const std::vector<VkDescriptorSetLayoutBinding> &bindings);
+  // Set numbers the reflection skips get an empty set layout
+  VkPipelineLayout getPipelineLayout(const ShaderReflection &reflection);
+  // Reflects and merges both stages first
+  VkPipelineLayout getPipelineLayout(const ShaderCode &vertCode, const ShaderCode &fragCode);
+
+  size_t setLayoutCount() const { return setLayouts.size(); }
+  size_t pipelineLayoutCount() const { return pipelineLayouts.size(); }
+
+ private:
+  Device &device;
+  std::unordered_map<uint64_t, VkDescriptorSetLayout> setLayouts;
+  std::unordered_map<uint64_t, VkPipelineLayout> pipelineLayouts;
+};
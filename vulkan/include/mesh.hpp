@@ -0,0 +1,82 @@
+#pragma once
+
+#include "device.hpp"
+#include "transfer_manager.hpp"
+#include "vertex_layout.hpp"
+
+// std lib headers
+#include <cstdint>
+#include <vector>
+
+// Vertex data as it is built or loaded, one array per attribute so any layout can be packed from it
+struct MeshData {
+  // componentCount floats per vertex each, empty for attributes the mesh does not have
+  std::vector<float> positions;
+  std::vector<float> normals;
+  std::vector<float> uvs;
+  std::vector<float> colors;
+  // Triangle list
+  std::vector<uint32_t> indices;
+
+  uint32_t vertexCount() const { return static_cast<uint32_t>(positions.size() / 3); }
+  const std::vector<float> &attribute(VertexAttribute attribute) const;
+};
+
+/*
+ * Vertex and index data in device local buffers, one vertex buffer per
+ * stream of its VertexLayout. Indices are 16 bit when the vertex count
+ * allows. Uploads go through the TransferManager, so the mesh may be drawn
+ * by graphics work submitted after the next flush.
+ */
+class Mesh {
+ public:
+  // Throws when layout has an attribute data does not
+  Mesh(Device &device, TransferManager &transfers, const MeshData &data, const VertexLayout &layout);
+  // Buffers sized for the counts for the caller to fill, e.g. through TransferManager::reserveBuffer
+  // with vertices packed by layout against positionQuantization and indices of getIndexType
+  Mesh(
+      Device &device,
+      const VertexLayout &layout,
+      uint32_t vertexCount,
+      uint32_t indexCount,
+      const PositionQuantization &positionQuantization = {});
+  ~Mesh();
+
+  Mesh(const Mesh &) = delete;
+  Mesh &operator=(const Mesh &) = delete;
+
+  // getIndexCount 32 bit indices, staged as getIndexType
+  void uploadIndices(TransferManager &transfers, const uint32_t *indices);
+
+  // Every stream, for pipelines built from the same layout
+  void bind(VkCommandBuffer commandBuffer);
+  // Stream 0 only, enough for position only pipelines when the layout is positionSplit
+  void bindPositions(VkCommandBuffer commandBuffer);
+  void draw(VkCommandBuffer commandBuffer, uint32_t instanceCount = 1);
+
+  const VertexLayout &getLayout() const { return layout; }
+  // Push constants of the shaders the mesh is drawn with, for their first 32 bytes
+  const PositionQuantization &getPositionQuantization() const { return positionQuantization; }
+  uint32_t getVertexCount() const { return vertexCount; }
+  uint32_t getIndexCount() const { return indexCount; }
+  VkIndexType getIndexType() const { return indexType; }
+  uint32_t indexSize() const { return indexType == VK_INDEX_TYPE_UINT16 ? 2 : 4; }
+  VkBuffer getVertexBuffer(uint32_t stream) { return vertexBuffers[stream]; }
+  VkBuffer getIndexBuffer() { return indexBuffer; }
+
+ private:
+  void createBuffers();
+  void uploadVertices(TransferManager &transfers, const MeshData &data);
+
+  Device &device;
+  VertexLayout layout;
+  uint32_t vertexCount;
+  uint32_t indexCount;
+  PositionQuantization positionQuantization;
+  VkIndexType indexType = VK_INDEX_TYPE_UINT32;
+
+  std::vector<VkBuffer> vertexBuffers;
+  std::vector<Allocation> vertexMemory;
+  VkBuffer indexBuffer = VK_NULL_HANDLE;
+  Allocation indexMemory;
+};
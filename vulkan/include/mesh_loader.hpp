@@ -0,0 +1,60 @@
+#pragma once
+
+#include "device.hpp"
+#include "mesh.hpp"
+#include "mesh_optimizer.hpp"
+#include "transfer_manager.hpp"
+#include "vertex_layout.hpp"
+
+// std lib headers
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+
+// Where a load spent its time, for comparing thread counts and files
+struct MeshLoadStats {
+  size_t fileBytes = 0;
+  uint32_t triangles = 0;
+  // After deduplication
+  uint32_t vertices = 0;
+  // Mapping the file and parsing its chunks
+  double parseMs = 0.0;
+  // Joining the chunks and deduplicating corners
+  double dedupMs = 0.0;
+  // The mesh_optimizer passes, 0 when the loader does not run them
+  double optimizeMs = 0.0;
+  // Creating the buffers and packing into staging memory
+  double packMs = 0.0;
+  // Of the indices as uploaded
+  VertexCacheStats vertexCache{};
+};
+
+/*
+ * Imports Wavefront OBJ geometry straight into a Mesh. The file is memory
+ * mapped and split at line breaks into one chunk per thread, each parsed on
+ * its own with locale independent number parsing. Corners are deduplicated
+ * through a hash table and the unique vertices packed directly into the
+ * TransferManager's staging memory, so vertex data is written once after
+ * parsing. Polygons are fanned into triangles; materials, groups and
+ * smoothing groups are ignored. Unless told not to, the triangles and
+ * vertices are reordered by the mesh_optimizer passes before packing.
+ */
+class MeshLoader {
+ public:
+  // 0 uses every hardware thread. optimize false keeps the file's order, for comparing against
+  explicit MeshLoader(unsigned threadCount = 0, bool optimize = true);
+
+  // Supports position, normal and uv attributes, throws when the file lacks one the layout has.
+  // The mesh may be drawn by graphics work submitted after the next transfers.flush()
+  std::unique_ptr<Mesh> loadObj(
+      Device &device,
+      TransferManager &transfers,
+      const std::string &path,
+      const VertexLayout &layout,
+      MeshLoadStats *stats = nullptr);
+
+ private:
+  unsigned threadCount;
+  bool optimize;
+};
@@ -0,0 +1,53 @@
+#pragma once
+
+#include "mesh.hpp"
+
+// std lib headers
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// How an index order uses a FIFO post-transform cache
+struct VertexCacheStats {
+  // Vertex shader invocations for one draw
+  uint32_t transformed = 0;
+  // Transformed per triangle, 3 with no reuse and about 0.5 at best
+  float acmr = 0.0f;
+  // Transformed per vertex, 1 when every vertex runs the shader once
+  float atvr = 0.0f;
+};
+
+/*
+ * Reordering passes for triangle lists, meant to run once when a mesh is
+ * built or loaded. Run them in the order declared: the cache pass first,
+ * the overdraw pass to reorder what it produced without undoing most of
+ * it, and the fetch pass last as it only renumbers vertices. optimizeMesh
+ * runs all three on MeshData.
+ */
+
+// Simulates a cacheSize entry FIFO over indices, the size most hardware is close to
+VertexCacheStats analyzeVertexCache(
+    const uint32_t *indices, size_t indexCount, uint32_t vertexCount, uint32_t cacheSize = 16);
+
+// Reorders triangles so vertices are reused while still in the post-transform cache, with
+// Forsyth's linear speed vertex cache optimization
+void optimizeVertexCache(uint32_t *indices, size_t indexCount, uint32_t vertexCount);
+
+// Splits a cache optimized order into clusters where the cache cost of starting over stays within
+// threshold times its own, then draws the clusters facing away from the mesh center first so early
+// depth testing rejects more of what is behind them. positions holds 3 floats per vertex
+void optimizeOverdraw(
+    uint32_t *indices,
+    size_t indexCount,
+    const float *positions,
+    uint32_t vertexCount,
+    float threshold = 1.05f);
+
+constexpr uint32_t NO_VERTEX = ~0u;
+
+// Renumbers vertices in the order the indices first use them so fetches walk the vertex buffers
+// forward. Returns the new number of each old vertex, NO_VERTEX for those no index uses
+std::vector<uint32_t> optimizeVertexFetch(uint32_t *indices, size_t indexCount, uint32_t vertexCount);
+
+// Every pass above, with the attribute arrays reordered to match and unused vertices dropped
+void optimizeMesh(MeshData &data);
@@ -8,16 +8,28 @@
 #include <cassert>
 
 #include "device.hpp"
+#include "shader_archive.hpp"
+#include "shader_reflection.hpp"
+#include "specialization.hpp"
+#include "vertex_layout.hpp"
 
 struct PipelineConfigInfo{
-  VkViewport viewport;
-  VkRect2D scissor;
   VkPipelineInputAssemblyStateCreateInfo inputAssemblyInfo;
   VkPipelineRasterizationStateCreateInfo rasterizationInfo;
   VkPipelineMultisampleStateCreateInfo multisampleInfo;
   VkPipelineColorBlendAttachmentState colorBlendAttachment;
   VkPipelineColorBlendStateCreateInfo colorBlendInfo;
   VkPipelineDepthStencilStateCreateInfo depthStencilInfo;
+  // Set while recording instead of baked in, the matching fields above are ignored
+  std::vector<VkDynamicState> dynamicStateEnables;
+  SpecializationConstants vertSpecialization;
+  SpecializationConstants fragSpecialization;
+  // Set by setVertexLayout, left empty the vertex shader's inputs are read from one interleaved binding
+  std::vector<VkVertexInputBindingDescription> bindingDescriptions;
+  std::vector<VkVertexInputAttributeDescription> attributeDescriptions;
+  // Baked in by setStaticViewport, ignored while viewport and scissor are dynamic
+  VkViewport viewport{};
+  VkRect2D scissor{};
   VkPipelineLayout pipelineLayout = nullptr;
   VkRenderPass renderPass = nullptr;
   uint32_t subpass = 0;
@@ -25,23 +37,37 @@ struct PipelineConfigInfo{
 
 class Pipeline{
   public:
-    Pipeline(Device& device, const std::string& vertFile, 
-            const std::string& fragFile, const PipelineConfigInfo& config);
+    Pipeline(Device& device, const ShaderArchive& shaders, const std::string& vertShader,
+            const std::string& fragShader, const PipelineConfigInfo& config);
     ~Pipeline();
 
     // Deleted
     Pipeline(const Pipeline&) = delete;
     Pipeline& operator=(const Pipeline&) = delete;
     
-    static PipelineConfigInfo defaultPipelineConfigInfo(uint32_t width, uint32_t height);
+    // Viewport and scissor are dynamic, so pipelines survive extent changes
+    static PipelineConfigInfo defaultPipelineConfigInfo();
+    // Also makes cull mode, front face, topology within its class and depth test state dynamic,
+    // only for devices where Device::supportsExtendedDynamicState
+    static void enableExtendedDynamicState(PipelineConfigInfo& config);
+    // Bakes viewport and scissor for extent into the pipeline, which must be rebuilt when it changes
+    static void setStaticViewport(PipelineConfigInfo& config, VkExtent2D extent);
+    // Vertex input for meshes of this layout, attributes and streams the shader does not read are left
+    // out. Quantized layouts also set the vertex shader's OCTAHEDRAL_NORMALS constant
+    static void setVertexLayout(PipelineConfigInfo& config, const VertexLayout& layout);
+    // Every pipeline needs these set before drawing
+    static void setViewport(VkCommandBuffer commandBuffer, VkExtent2D extent);
+    // Records config's values for the extended dynamic state it enables, after binding a pipeline
+    // built from a config that differs from it at most in that state
+    static void setDynamicState(VkCommandBuffer commandBuffer, const PipelineConfigInfo& config, Device& device);
+    VkPipeline getPipeline() { return graphicsPipeline; }
   private:
-    static std::vector<char> readFile(const std::string& filename);
-    void createGraphicsPipeline(const std::string& vertFile, 
-                                const std::string& fragFile, const PipelineConfigInfo& config);
-    void createShaderModule(const std::vector<char>& code, VkShaderModule* shaderModule);
+    void createGraphicsPipeline(const ShaderCode& vertCode, 
+                                const ShaderCode& fragCode, const PipelineConfigInfo& config);
+    void createShaderModule(const ShaderCode& code, VkShaderModule* shaderModule);
 
     Device& device;
     VkPipeline graphicsPipeline;
-    VkShaderModule vertShaderModule;
-    VkShaderModule frahShaderModule;
+    VkShaderModule vertShaderModule = VK_NULL_HANDLE;
+    VkShaderModule frahShaderModule = VK_NULL_HANDLE;
 };
\ No newline at end of file
@@ -0,0 +1,83 @@
+#pragma once
+
+#include "pipeline.hpp"
+
+// std lib headers
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+// Everything that decides what a pipeline compiles to
+struct PipelineDesc {
+  // Names in the library's ShaderArchive
+  std::string vertShader;
+  std::string fragShader;
+  PipelineConfigInfo config;
+  // SwapChain::getRenderPassHash of config.renderPass, which keys it instead of the handle
+  uint64_t renderPassHash = 0;
+};
+
+/*
+ * Pipelines keyed by a hash of their PipelineDesc. A variant seen for the
+ * first time is compiled on a worker thread while get() keeps returning the
+ * caller's fallback, and is returned from the first get() after it is done,
+ * so new state combinations never stall the frame that asks for them.
+ */
+class PipelineLibrary {
+ public:
+  PipelineLibrary(Device &device, const ShaderArchive &shaders, uint32_t threadCount = 2);
+  ~PipelineLibrary();
+
+  PipelineLibrary(const PipelineLibrary &) = delete;
+  PipelineLibrary &operator=(const PipelineLibrary &) = delete;
+
+  static uint64_t hashDesc(const PipelineDesc &desc);
+
+  // The compiled pipeline, or fallback while it is queued, compiling or failed to compile
+  VkPipeline get(const PipelineDesc &desc, VkPipeline fallback);
+  // Compiles on the calling thread when it is not ready yet, for pipelines that have no fallback
+  VkPipeline getBlocking(const PipelineDesc &desc);
+  // Queues compilation ahead of the first get, e.g. while a level loads
+  void request(const PipelineDesc &desc);
+
+  size_t pendingCount();
+  void waitIdle();
+
+ private:
+  enum class State { Queued, Compiling, Ready, Failed };
+
+  struct Entry {
+    State state = State::Queued;
+    std::unique_ptr<Pipeline> pipeline;
+  };
+
+  struct Job {
+    uint64_t key;
+    PipelineDesc desc;
+  };
+
+  // Returns the entry for key, queueing desc when it was not known; call with mutex held
+  Entry &findOrQueue(uint64_t key, const PipelineDesc &desc);
+  void workerLoop();
+  // Builds outside the lock, null when compilation failed
+  std::unique_ptr<Pipeline> compile(const PipelineDesc &desc);
+  // Publishes the result of a compile; call with mutex held
+  void finish(uint64_t key, std::unique_ptr<Pipeline> pipeline);
+
+  Device &device;
+  const ShaderArchive &shaders;
+  std::vector<std::thread> workers;
+
+  std::mutex mutex;
+  std::condition_variable workAvailable;
+  std::condition_variable workDone;
+  std::unordered_map<uint64_t, Entry> entries;
+  std::deque<Job> queue;
+  size_t compiling = 0;
+  bool stopping = false;
+};
@@ -0,0 +1,47 @@
+#pragma once
+
+// std lib headers
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// SPIR-V inside a mapped ShaderArchive, valid as long as the archive is
+struct ShaderCode {
+  const uint32_t *words = nullptr;
+  // In bytes, as VkShaderModuleCreateInfo::codeSize takes it
+  size_t size = 0;
+  uint64_t hash = 0;
+};
+
+/*
+ * Every shader of the app packed into one file at build time by
+ * tools/pack_shaders. The file is mapped once and shader modules are created
+ * straight from the mapped words, so startup opens a single file however
+ * many shaders there are and never copies the bytecode.
+ */
+class ShaderArchive {
+ public:
+  // verifyHashes checks every shader against its hash up front, which reads the whole archive
+  explicit ShaderArchive(const std::string &path, bool verifyHashes = false);
+  ~ShaderArchive();
+
+  ShaderArchive(const ShaderArchive &) = delete;
+  ShaderArchive &operator=(const ShaderArchive &) = delete;
+
+  // Throws when no shader was packed under name
+  ShaderCode find(const std::string &name) const;
+  bool contains(const std::string &name) const { return index.count(name) > 0; }
+  size_t shaderCount() const { return index.size(); }
+
+  // Packs each file under its name without directory and extension, "shaders/vert.spv" as "vert"
+  static void write(const std::string &path, const std::vector<std::string> &files);
+
+ private:
+  void readIndex(bool verifyHashes);
+
+  void *mapping = nullptr;
+  size_t mappingSize = 0;
+  std::unordered_map<std::string, ShaderCode> index;
+};
@@ -0,0 +1,34 @@
+#pragma once
+
+#include "shader_archive.hpp"
+
+#include <vulkan/vulkan.h>
+
+// std lib headers
+#include <cstdint>
+#include <map>
+#include <vector>
+
+/*
+ * What a pipeline's shaders expect from their layouts, read from the SPIR-V
+ * itself so layouts never have to be written by hand. Reflect each stage and
+ * merge them into one per pipeline.
+ */
+struct ShaderReflection {
+  VkShaderStageFlags stages = 0;
+  // Bindings sorted by binding number, keyed by set number
+  std::map<uint32_t, std::vector<VkDescriptorSetLayoutBinding>> descriptorSets;
+  // At most one range, covering every stage's push constant block
+  std::vector<VkPushConstantRange> pushConstantRanges;
+  // Vertex stage inputs, assumed interleaved in binding 0 in location order without padding
+  std::vector<VkVertexInputAttributeDescription> vertexAttributes;
+  uint32_t vertexStride = 0;
+  // Compute workgroup size as declared, sizes set through specialization constants are not seen
+  uint32_t localSize[3] = {1, 1, 1};
+
+  // Throws when code is not valid SPIR-V or uses a resource this cannot describe
+  static ShaderReflection reflect(const ShaderCode &code);
+
+  // Adds another stage of the same pipeline, throws when the two disagree on a binding
+  void merge(const ShaderReflection &other);
+};
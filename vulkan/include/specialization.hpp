@@ -0,0 +1,35 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+// std lib headers
+#include <cstdint>
+#include <vector>
+
+/*
+ * Values for a shader's constant_id constants. The driver folds them in when
+ * the pipeline is created, so feature toggles, loop counts and workgroup
+ * sizes cost nothing at run time. Constants stay sorted by id, the same
+ * values set in any order hash the same.
+ */
+class SpecializationConstants {
+ public:
+  // Overloads rather than a template, only the 32 bit scalars a GLSL constant can be
+  SpecializationConstants &set(uint32_t constantId, bool value);
+  SpecializationConstants &set(uint32_t constantId, int32_t value);
+  SpecializationConstants &set(uint32_t constantId, uint32_t value);
+  SpecializationConstants &set(uint32_t constantId, float value);
+
+  bool empty() const { return entries.empty(); }
+  // Points into this object, keep it alive until the pipeline is created
+  VkSpecializationInfo info() const;
+  // Part of PipelineLibrary's key
+  uint64_t hash() const;
+
+ private:
+  void setWord(uint32_t constantId, uint32_t word);
+
+  std::vector<VkSpecializationMapEntry> entries;
+  // One word per entry, in the order of entries
+  std::vector<uint32_t> data;
+};
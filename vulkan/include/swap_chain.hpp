@@ -9,18 +9,29 @@
 #include <string>
 #include <vector>
 
+// What the swap chain is tuned for when choosing present mode and image count
+enum class PresentProfile { Throughput, Latency, Power };
+
 class SwapChain {
  public:
   static constexpr int MAX_FRAMES_IN_FLIGHT = 2;
 
-  SwapChain(Device &deviceRef, VkExtent2D windowExtent);
+  SwapChain(
+      Device &deviceRef,
+      VkExtent2D windowExtent,
+      PresentProfile profile = PresentProfile::Throughput);
   ~SwapChain();
 
   SwapChain(const SwapChain &) = delete;
   void operator=(const SwapChain &) = delete;
 
-  VkFramebuffer getFrameBuffer(int index) { return swapChainFramebuffers[index]; }
+  // Pairs the image with the current frame's depth buffer, so it is only valid until the next submit
+  VkFramebuffer getFrameBuffer(int index) {
+    return swapChainFramebuffers[currentFrame * imageCount() + index];
+  }
   VkRenderPass getRenderPass() { return renderPass; }
+  // Equal for compatible render passes, unlike the handle it is stable across runs
+  uint64_t getRenderPassHash() { return renderPassHash; }
   VkImageView getImageView(int index) { return swapChainImageViews[index]; }
   size_t imageCount() { return swapChainImages.size(); }
   VkFormat getSwapChainImageFormat() { return swapChainImageFormat; }
@@ -32,6 +43,9 @@ class SwapChain {
     return static_cast<float>(swapChainExtent.width) / static_cast<float>(swapChainExtent.height);
   }
   VkFormat findDepthFormat();
+  PresentProfile getPresentProfile() { return presentProfile; }
+  // Frame slot whose fence acquireNextImage last waited on, safe to reuse per frame resources of
+  size_t getCurrentFrame() { return currentFrame; }
 
   VkResult acquireNextImage(uint32_t *imageIndex);
   VkResult submitCommandBuffers(const VkCommandBuffer *buffers, uint32_t *imageIndex);
@@ -50,21 +64,26 @@ class SwapChain {
   VkPresentModeKHR chooseSwapPresentMode(
       const std::vector<VkPresentModeKHR> &availablePresentModes);
   VkExtent2D chooseSwapExtent(const VkSurfaceCapabilitiesKHR &capabilities);
+  uint32_t chooseImageCount(const VkSurfaceCapabilitiesKHR &capabilities);
 
   VkFormat swapChainImageFormat;
   VkExtent2D swapChainExtent;
 
+  // One per frame in flight and swapchain image, indexed frame major
   std::vector<VkFramebuffer> swapChainFramebuffers;
   VkRenderPass renderPass;
+  uint64_t renderPassHash;
 
+  // Only frames in flight render at the same time, so depth is per frame rather than per image
   std::vector<VkImage> depthImages;
-  std::vector<VkDeviceMemory> depthImageMemorys;
+  std::vector<Allocation> depthImageMemorys;
   std::vector<VkImageView> depthImageViews;
   std::vector<VkImage> swapChainImages;
   std::vector<VkImageView> swapChainImageViews;
 
   Device &device;
   VkExtent2D windowExtent;
+  PresentProfile presentProfile;
 
   VkSwapchainKHR swapChain;
 
@@ -0,0 +1,100 @@
+#pragma once
+
+#include "device.hpp"
+
+// std lib headers
+#include <memory>
+#include <vector>
+
+// Identifies a submitted batch of copies, increasing with every flush
+using TransferToken = uint64_t;
+
+/*
+ * Batches buffer and image uploads into one submission instead of draining
+ * the queue per copy. Copies run on the dedicated transfer queue when the
+ * device has one, with queue ownership released there and acquired on the
+ * graphics queue behind a semaphore, so graphics work submitted afterwards
+ * sees the data without any CPU wait. Otherwise they run on the graphics
+ * queue. Data is staged in a per batch host visible buffer that is recycled
+ * once the batch's fence signals.
+ *
+ * Not thread safe, uploads are expected to come from a single loading thread.
+ * Submissions hold the device's queue mutex, so that thread need not be the
+ * one rendering.
+ */
+class TransferManager {
+ public:
+  static constexpr VkDeviceSize DEFAULT_STAGING_SIZE = 16 * 1024 * 1024;
+
+  TransferManager(Device &device, VkDeviceSize stagingSize = DEFAULT_STAGING_SIZE);
+  ~TransferManager();
+
+  TransferManager(const TransferManager &) = delete;
+  TransferManager &operator=(const TransferManager &) = delete;
+
+  // dst must have been created with VK_BUFFER_USAGE_TRANSFER_DST_BIT, regions written in one batch must not overlap
+  void uploadBuffer(VkBuffer dst, VkDeviceSize dstOffset, const void *data, VkDeviceSize size);
+  // uploadBuffer without the copy in, returns staging memory for the caller to write the data to.
+  // Any further upload may submit the batch, so fill it before calling into the manager again
+  void *reserveBuffer(VkBuffer dst, VkDeviceSize dstOffset, VkDeviceSize size);
+  // Replaces the whole first mip level, the image ends in finalLayout
+  void uploadImage(
+      VkImage dst,
+      uint32_t width,
+      uint32_t height,
+      uint32_t layerCount,
+      const void *data,
+      VkDeviceSize size,
+      VkImageLayout finalLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+
+  // Submits everything recorded so far, returns the token of the last submission if nothing was
+  TransferToken flush();
+  bool isComplete(TransferToken token);
+  void wait(TransferToken token);
+
+  bool usesDedicatedQueue() { return dedicated; }
+
+ private:
+  struct Batch {
+    VkCommandBuffer transferCommands = VK_NULL_HANDLE;
+    VkCommandBuffer acquireCommands = VK_NULL_HANDLE;
+    VkSemaphore released = VK_NULL_HANDLE;
+    VkFence fence = VK_NULL_HANDLE;
+
+    VkBuffer staging = VK_NULL_HANDLE;
+    Allocation stagingMemory;
+    VkDeviceSize stagingHead = 0;
+    // Uploads larger than the staging buffer get their own, freed with the batch
+    std::vector<std::pair<VkBuffer, Allocation>> oversized;
+
+    // Emitted together at flush, the acquires only with a dedicated queue
+    std::vector<VkBufferMemoryBarrier> bufferReleases;
+    std::vector<VkImageMemoryBarrier> imageReleases;
+    std::vector<VkBufferMemoryBarrier> bufferAcquires;
+    std::vector<VkImageMemoryBarrier> imageAcquires;
+
+    TransferToken token = 0;
+    bool inFlight = false;
+  };
+
+  Batch &recordingBatch();
+  std::unique_ptr<Batch> createBatch();
+  void destroyBatch(Batch &batch);
+  void retire();
+  // Takes size bytes of staging memory in the recording batch
+  void *stage(VkDeviceSize size, VkBuffer &buffer, VkDeviceSize &offset);
+  void releaseBuffer(Batch &batch, VkBuffer buffer, VkDeviceSize offset, VkDeviceSize size);
+  void releaseImage(Batch &batch, VkImage image, uint32_t layerCount, VkImageLayout finalLayout);
+
+  Device &device;
+  VkDeviceSize stagingSize;
+  bool dedicated;
+  uint32_t transferFamily;
+  uint32_t graphicsFamily;
+  VkCommandPool transferPool = VK_NULL_HANDLE;
+  VkCommandPool acquirePool = VK_NULL_HANDLE;
+
+  std::vector<std::unique_ptr<Batch>> batches;
+  Batch *recording = nullptr;
+  TransferToken lastToken = 0;
+};
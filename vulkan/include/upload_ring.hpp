@@ -0,0 +1,65 @@
+#pragma once
+
+#include "device.hpp"
+
+// std lib headers
+#include <cstring>
+#include <vector>
+
+// Space handed out by UploadRing, valid until the same frame slot comes around again
+struct UploadRange {
+  void *data;
+  VkBuffer buffer;
+  VkDeviceSize offset;
+};
+
+/*
+ * Linear allocator over one persistently mapped, host coherent buffer, split
+ * into a partition per frame in flight. Allocation bumps an offset inside the
+ * current partition; the whole partition is reclaimed by beginFrame once the
+ * frame's fence has been waited on, so per frame uploads never allocate
+ * memory or wait on the device. Offsets are suitable as dynamic offsets.
+ */
+class UploadRing {
+ public:
+  UploadRing(
+      Device &device,
+      VkDeviceSize frameSize,
+      uint32_t frameCount,
+      VkBufferUsageFlags usage = VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT |
+                                 VK_BUFFER_USAGE_STORAGE_BUFFER_BIT |
+                                 VK_BUFFER_USAGE_VERTEX_BUFFER_BIT |
+                                 VK_BUFFER_USAGE_INDEX_BUFFER_BIT);
+  ~UploadRing();
+
+  UploadRing(const UploadRing &) = delete;
+  UploadRing &operator=(const UploadRing &) = delete;
+
+  // Only call after the fence of the frame previously using frameIndex has signaled
+  void beginFrame(uint32_t frameIndex);
+  // Alignment of zero uses the device's uniform and storage dynamic offset alignment
+  UploadRange allocate(VkDeviceSize size, VkDeviceSize alignment = 0);
+
+  template <typename T>
+  UploadRange push(const T &value) {
+    UploadRange range = allocate(sizeof(T));
+    std::memcpy(range.data, &value, sizeof(T));
+    return range;
+  }
+
+  VkBuffer getBuffer() { return buffer; }
+  VkDeviceSize getFrameSize() { return frameSize; }
+  // Bytes handed out in the current frame, including alignment padding
+  VkDeviceSize frameUsage() { return head - frameIndex * frameSize; }
+
+ private:
+  Device &device;
+  VkBuffer buffer;
+  Allocation memory;
+  VkDeviceSize frameSize;
+  uint32_t frameCount;
+  VkDeviceSize minAlignment;
+
+  uint32_t frameIndex = 0;
+  VkDeviceSize head = 0;
+};
@@ -0,0 +1,96 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+// std lib headers
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// What a mesh can carry per vertex, each value is the shader location it is read at
+enum class VertexAttribute : uint32_t { POSITION = 0, NORMAL = 1, UV = 2, COLOR = 3 };
+
+/*
+ * FLOAT stores every component as a 32 bit float. QUANTIZED stores positions
+ * as 16 bit snorm within the mesh's bounds, normals as 16 bit snorm
+ * octahedral pairs, uvs as half floats and colors as 8 bit unorm, which
+ * halves an interleaved position, normal and uv vertex to 16 bytes.
+ */
+enum class VertexEncoding { FLOAT, QUANTIZED };
+
+// Vertex shaders reading normals declare layout(constant_id = 0) const bool OCTAHEDRAL_NORMALS,
+// Pipeline::setVertexLayout sets it when the layout's normals need decoding
+constexpr uint32_t OCTAHEDRAL_NORMALS_CONSTANT_ID = 0;
+
+// Maps stored positions back to model space as stored * scale + offset, the push constants of
+// vertex shaders reading positions. Two vec4s to match their std430 layout
+struct PositionQuantization {
+  float scale[4] = {1.0f, 1.0f, 1.0f, 0.0f};
+  float offset[4] = {0.0f, 0.0f, 0.0f, 0.0f};
+};
+
+// Floats per vertex in MeshData
+uint32_t componentCount(VertexAttribute attribute);
+// Bytes one vertex's attribute takes in format
+uint32_t formatSize(VkFormat format);
+
+struct VertexElement {
+  VertexAttribute attribute;
+  VkFormat format;
+  // Vertex buffer binding the attribute is read from
+  uint32_t stream;
+  // Within a vertex of its stream
+  uint32_t offset;
+};
+
+// Writes one vertex's floats of an element's attribute to destination, encoded for its format.
+// positions says where they fall in the snorm range when stored quantized
+void packAttribute(
+    const VertexElement &element,
+    const float *components,
+    const PositionQuantization &positions,
+    void *destination);
+// packAttribute over count vertices whose floats follow one another, destination advancing by
+// stride a vertex. Quantized positions, normals and UVs are encoded several vertices at a time
+// with SSE2, UVs with F16C where the CPU has it
+void packAttributes(
+    const VertexElement &element,
+    const float *components,
+    size_t count,
+    uint32_t stride,
+    const PositionQuantization &positions,
+    void *destination);
+
+/*
+ * How a mesh's attributes are spread over vertex buffers. Pipelines take
+ * their vertex input from it and Mesh packs its buffers by it, so the two
+ * always agree. Streams are numbered from 0 without gaps.
+ */
+class VertexLayout {
+ public:
+  // Every attribute in one buffer, the usual choice when all of them are read together
+  static VertexLayout interleaved(
+      const std::vector<VertexAttribute> &attributes, VertexEncoding encoding = VertexEncoding::FLOAT);
+  // Positions alone in stream 0 and everything else interleaved in stream 1, so depth and shadow
+  // passes bind and fetch only the positions
+  static VertexLayout positionSplit(
+      const std::vector<VertexAttribute> &attributes, VertexEncoding encoding = VertexEncoding::FLOAT);
+
+  const std::vector<VertexElement> &getElements() const { return elements; }
+  uint32_t streamCount() const { return static_cast<uint32_t>(strides.size()); }
+  uint32_t stride(uint32_t stream) const { return strides[stream]; }
+  VertexEncoding getEncoding() const { return encoding; }
+
+  // Bounds of count positions when they are stored quantized, identity otherwise
+  PositionQuantization quantizePositions(const float *positions, size_t count) const;
+
+  std::vector<VkVertexInputBindingDescription> bindingDescriptions() const;
+  std::vector<VkVertexInputAttributeDescription> attributeDescriptions() const;
+
+ private:
+  void add(VertexAttribute attribute, VkFormat format, uint32_t stream);
+
+  std::vector<VertexElement> elements;
+  std::vector<uint32_t> strides;
+  VertexEncoding encoding = VertexEncoding::FLOAT;
+};
@@ -1,8 +1,13 @@
 #include "app.hpp"
 #include <iostream>
+#include <string>
 
-int main() {
+int main(int argc, char** argv) {
   App app{"Vulkan App"};
+  if (argc > 1 && std::string(argv[1]) == "--benchmark") {
+    app.benchmark(100000);
+    return EXIT_SUCCESS;
+  }
   app.run();
   return EXIT_SUCCESS;
 }
\ No newline at end of file
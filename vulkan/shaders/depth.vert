@@ -0,0 +1,14 @@
+#version 450
+
+// Depth and shadow passes need nothing but positions
+layout(location = 0) in vec3 position;
+
+// The mesh's PositionQuantization, identity for float positions
+layout(push_constant) uniform Push {
+  vec4 positionScale;
+  vec4 positionOffset;
+} push;
+
+void main() {
+  gl_Position = vec4(position * push.positionScale.xyz + push.positionOffset.xyz, 1.0);
+}
@@ -0,0 +1,13 @@
+#version 450
+
+layout(location = 0) in vec3 fragNormal;
+layout(location = 1) in vec2 fragUv;
+
+layout(location = 0) out vec4 outColor;
+
+const vec3 lightDirection = vec3(0.3, -0.5, -0.8);
+
+void main() {
+  float light = max(dot(normalize(fragNormal), normalize(-lightDirection)), 0.1);
+  outColor = vec4(vec3(fragUv, 1.0) * light, 1.0);
+}
@@ -0,0 +1,30 @@
+#version 450
+
+// Set for quantized vertex layouts, normals arrive as an octahedral pair in xy
+layout(constant_id = 0) const bool OCTAHEDRAL_NORMALS = false;
+
+layout(location = 0) in vec3 position;
+layout(location = 1) in vec3 normal;
+layout(location = 2) in vec2 uv;
+
+layout(location = 0) out vec3 fragNormal;
+layout(location = 1) out vec2 fragUv;
+
+// The mesh's PositionQuantization, identity for float positions
+layout(push_constant) uniform Push {
+  vec4 positionScale;
+  vec4 positionOffset;
+} push;
+
+vec3 octahedralDecode(vec2 encoded) {
+  vec3 n = vec3(encoded, 1.0 - abs(encoded.x) - abs(encoded.y));
+  float folded = max(-n.z, 0.0);
+  n.xy += vec2(n.x >= 0.0 ? -folded : folded, n.y >= 0.0 ? -folded : folded);
+  return normalize(n);
+}
+
+void main() {
+  gl_Position = vec4(position * push.positionScale.xyz + push.positionOffset.xyz, 1.0);
+  fragNormal = OCTAHEDRAL_NORMALS ? octahedralDecode(normal.xy) : normal;
+  fragUv = uv;
+}
@@ -0,0 +1,234 @@
+#include "allocator.hpp"
+
+// std
+#include <algorithm>
+#include <stdexcept>
+
+MemoryAllocator::MemoryAllocator(VkPhysicalDevice physicalDevice, VkDevice device) : device_{device} {
+  vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memProperties);
+}
+
+MemoryAllocator::~MemoryAllocator() {
+  for (auto &pool : pools) {
+    for (auto &block : pool.blocks) {
+      if (block) {
+        vkFreeMemory(device_, block->memory, nullptr);
+      }
+    }
+  }
+}
+
+uint32_t MemoryAllocator::findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties) {
+  for (uint32_t i = 0; i < memProperties.memoryTypeCount; i++) {
+    if ((typeFilter & (1 << i)) &&
+        (memProperties.memoryTypes[i].propertyFlags & properties) == properties) {
+      return i;
+    }
+  }
+
+  throw std::runtime_error("failed to find suitable memory type!");
+}
+
+uint32_t MemoryAllocator::getPool(uint32_t memoryType, ResourceKind kind) {
+  for (uint32_t i = 0; i < pools.size(); i++) {
+    if (pools[i].memoryType == memoryType && pools[i].kind == kind) {
+      return i;
+    }
+  }
+
+  // Small heaps, such as the host visible device local window, get blocks of at most an eighth of the heap
+  VkDeviceSize heapSize = memProperties.memoryHeaps[memProperties.memoryTypes[memoryType].heapIndex].size;
+  VkDeviceSize blockSize = DEFAULT_BLOCK_SIZE;
+  while (blockSize > MIN_ALLOCATION_SIZE && blockSize > heapSize / 8) {
+    blockSize /= 2;
+  }
+
+  Pool pool{};
+  pool.memoryType = memoryType;
+  pool.kind = kind;
+  pool.blockSize = blockSize;
+  pool.maxOrder = 0;
+  while ((MIN_ALLOCATION_SIZE << pool.maxOrder) < blockSize) {
+    pool.maxOrder++;
+  }
+  pool.hostVisible =
+      memProperties.memoryTypes[memoryType].propertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT;
+  pools.push_back(std::move(pool));
+  return static_cast<uint32_t>(pools.size() - 1);
+}
+
+uint32_t MemoryAllocator::createBlock(Pool &pool) {
+  auto block = std::make_unique<Block>();
+
+  VkMemoryAllocateInfo allocInfo{};
+  allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+  allocInfo.allocationSize = pool.blockSize;
+  allocInfo.memoryTypeIndex = pool.memoryType;
+  if (vkAllocateMemory(device_, &allocInfo, nullptr, &block->memory) != VK_SUCCESS) {
+    throw std::runtime_error("failed to allocate memory block!");
+  }
+  // A memory object can only be mapped once, so host visible blocks stay mapped for their lifetime
+  if (pool.hostVisible &&
+      vkMapMemory(device_, block->memory, 0, VK_WHOLE_SIZE, 0, &block->mapped) != VK_SUCCESS) {
+    throw std::runtime_error("failed to map memory block!");
+  }
+  block->freeLists.resize(pool.maxOrder + 1);
+  block->freeLists[pool.maxOrder].insert(0);
+
+  stats.blockCount++;
+  stats.reservedBytes += pool.blockSize;
+
+  // Reuse the slot of a block released earlier so allocation indices stay stable
+  for (uint32_t i = 0; i < pool.blocks.size(); i++) {
+    if (!pool.blocks[i]) {
+      pool.blocks[i] = std::move(block);
+      return i;
+    }
+  }
+  pool.blocks.push_back(std::move(block));
+  return static_cast<uint32_t>(pool.blocks.size() - 1);
+}
+
+bool MemoryAllocator::allocateFromBlock(
+    Pool &pool, uint32_t blockIndex, uint32_t order, Allocation &allocation) {
+  Block &block = *pool.blocks[blockIndex];
+  uint32_t available = order;
+  while (available <= pool.maxOrder && block.freeLists[available].empty()) {
+    available++;
+  }
+  if (available > pool.maxOrder) {
+    return false;
+  }
+
+  VkDeviceSize offset = *block.freeLists[available].begin();
+  block.freeLists[available].erase(block.freeLists[available].begin());
+  // Split down to the requested order, the upper halves become free buddies
+  while (available > order) {
+    available--;
+    block.freeLists[available].insert(offset + (MIN_ALLOCATION_SIZE << available));
+  }
+  block.allocatedBytes += MIN_ALLOCATION_SIZE << order;
+
+  allocation.memory = block.memory;
+  allocation.offset = offset;
+  allocation.block = blockIndex;
+  allocation.order = order;
+  allocation.mapped = block.mapped ? static_cast<char *>(block.mapped) + offset : nullptr;
+  return true;
+}
+
+Allocation MemoryAllocator::allocateDedicated(uint32_t memoryType, VkDeviceSize size) {
+  Allocation allocation{};
+  VkMemoryAllocateInfo allocInfo{};
+  allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+  allocInfo.allocationSize = size;
+  allocInfo.memoryTypeIndex = memoryType;
+  if (vkAllocateMemory(device_, &allocInfo, nullptr, &allocation.memory) != VK_SUCCESS) {
+    throw std::runtime_error("failed to allocate dedicated memory!");
+  }
+  if ((memProperties.memoryTypes[memoryType].propertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) &&
+      vkMapMemory(device_, allocation.memory, 0, VK_WHOLE_SIZE, 0, &allocation.mapped) != VK_SUCCESS) {
+    throw std::runtime_error("failed to map dedicated memory!");
+  }
+  allocation.size = size;
+  allocation.dedicated = true;
+
+  stats.dedicatedCount++;
+  stats.reservedBytes += size;
+  stats.allocatedBytes += size;
+  return allocation;
+}
+
+Allocation MemoryAllocator::allocate(
+    const VkMemoryRequirements &requirements,
+    VkMemoryPropertyFlags properties,
+    ResourceKind kind) {
+  std::lock_guard<std::mutex> lock{mutex};
+  uint32_t memoryType = findMemoryType(requirements.memoryTypeBits, properties);
+  uint32_t poolIndex = getPool(memoryType, kind);
+  Pool &pool = pools[poolIndex];
+
+  Allocation allocation{};
+  VkDeviceSize needed = std::max({requirements.size, requirements.alignment, MIN_ALLOCATION_SIZE});
+  if (needed > pool.blockSize) {
+    allocation = allocateDedicated(memoryType, requirements.size);
+  } else {
+    uint32_t order = 0;
+    while ((MIN_ALLOCATION_SIZE << order) < needed) {
+      order++;
+    }
+
+    bool found = false;
+    for (uint32_t i = 0; i < pool.blocks.size() && !found; i++) {
+      found = pool.blocks[i] && allocateFromBlock(pool, i, order, allocation);
+    }
+    if (!found) {
+      allocateFromBlock(pool, createBlock(pool), order, allocation);
+    }
+    stats.allocatedBytes += MIN_ALLOCATION_SIZE << order;
+  }
+
+  allocation.pool = poolIndex;
+  allocation.size = requirements.size;
+  allocation.properties = memProperties.memoryTypes[memoryType].propertyFlags;
+  stats.allocationCount++;
+  stats.requestedBytes += requirements.size;
+  return allocation;
+}
+
+void MemoryAllocator::free(const Allocation &allocation) {
+  if (allocation.memory == VK_NULL_HANDLE) {
+    return;
+  }
+  std::lock_guard<std::mutex> lock{mutex};
+  stats.allocationCount--;
+  stats.requestedBytes -= allocation.size;
+
+  if (allocation.dedicated) {
+    VkDeviceSize size = allocation.size;
+    vkFreeMemory(device_, allocation.memory, nullptr);
+    stats.dedicatedCount--;
+    stats.reservedBytes -= size;
+    stats.allocatedBytes -= size;
+    return;
+  }
+
+  Pool &pool = pools[allocation.pool];
+  Block &block = *pool.blocks[allocation.block];
+  VkDeviceSize offset = allocation.offset;
+  uint32_t order = allocation.order;
+  block.allocatedBytes -= MIN_ALLOCATION_SIZE << order;
+  stats.allocatedBytes -= MIN_ALLOCATION_SIZE << order;
+
+  // Merge with the buddy for as long as it is free too
+  while (order < pool.maxOrder) {
+    VkDeviceSize buddy = offset ^ (MIN_ALLOCATION_SIZE << order);
+    auto found = block.freeLists[order].find(buddy);
+    if (found == block.freeLists[order].end()) {
+      break;
+    }
+    block.freeLists[order].erase(found);
+    offset = std::min(offset, buddy);
+    order++;
+  }
+  block.freeLists[order].insert(offset);
+
+  // Give empty blocks back to the driver, but keep one around so churn does not reallocate
+  if (block.allocatedBytes == 0) {
+    uint32_t liveBlocks = 0;
+    for (auto &other : pool.blocks) {
+      liveBlocks += other ? 1 : 0;
+    }
+    if (liveBlocks > 1) {
+      vkFreeMemory(device_, block.memory, nullptr);
+      pool.blocks[allocation.block].reset();
+      stats.blockCount--;
+      stats.reservedBytes -= pool.blockSize;
+    }
+  }
+}
+
+AllocatorStats MemoryAllocator::getStats() {
+  std::lock_guard<std::mutex> lock{mutex};
+  return stats;
+}
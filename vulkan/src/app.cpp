@@ -1,29 +1,748 @@
 #include "app.hpp"
 
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <unordered_map>
+#include <unordered_set>
+
 void App::run(){
   while(!window.shouldClose()){
     glfwPollEvents();
   }
 }
 
-void App::createPipelineLayout(){
-  VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
-  pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
-  pipelineLayoutInfo.setLayoutCount = 0;
-  pipelineLayoutInfo.pSetLayouts = nullptr;
-  pipelineLayoutInfo.pushConstantRangeCount = 0;
-  pipelineLayoutInfo.pPushConstantRanges = nullptr;
+namespace {
+
+// Frames timeDraws draws and times, and how often each draws the mesh
+constexpr int DRAW_FRAMES = 200;
+constexpr int DRAWS_PER_FRAME = 8;
+
+// A new material every few frames for timeMaterials, each draw looks up its pipeline as a renderer would
+constexpr int MATERIAL_FRAMES = 320;
+constexpr int MATERIAL_DRAWS_PER_FRAME = 200;
+constexpr int FRAMES_PER_MATERIAL = 10;
+constexpr int MATERIALS = MATERIAL_FRAMES / FRAMES_PER_MATERIAL;
+constexpr VkCullModeFlags CULL_MODES[] = {
+    VK_CULL_MODE_NONE, VK_CULL_MODE_FRONT_BIT, VK_CULL_MODE_BACK_BIT, VK_CULL_MODE_FRONT_AND_BACK};
+constexpr VkCompareOp COMPARE_OPS[] = {
+    VK_COMPARE_OP_LESS, VK_COMPARE_OP_LESS_OR_EQUAL, VK_COMPARE_OP_GREATER, VK_COMPARE_OP_ALWAYS};
+
+// Extents timeResizes alternates between
+constexpr int RESIZES = 8;
+constexpr VkExtent2D RESIZE_EXTENTS[] = {{1280, 720}, {1024, 768}};
+
+}  // namespace
+
+void App::benchmark(int buffers){
+  benchmarkAllocator(buffers);
+  benchmarkTransfers();
+  benchmarkPipelines();
+  benchmarkShaderLoading();
+  benchmarkCompute();
+  benchmarkMeshes();
+  benchmarkMeshLoading();
+}
+
+void App::benchmarkAllocator(int buffers){
+  std::vector<VkBuffer> handles(buffers);
+  std::vector<Allocation> allocations(buffers);
+
+  auto start = std::chrono::high_resolution_clock::now();
+  for(int i = 0; i < buffers; i++){
+    // Small uniform sized buffers, the case that exhausts maxMemoryAllocationCount without sub-allocation
+    VkDeviceSize size = 64 + (i % 16) * 64;
+    device.createBuffer(size, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
+        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+        handles[i], allocations[i]);
+  }
+  auto created = std::chrono::high_resolution_clock::now();
+  AllocatorStats stats = device.allocator().getStats();
+
+  for(int i = 0; i < buffers; i++){
+    device.destroyBuffer(handles[i], allocations[i]);
+  }
+  auto destroyed = std::chrono::high_resolution_clock::now();
+
+  std::chrono::duration<double, std::milli> createTime = created - start;
+  std::chrono::duration<double, std::milli> destroyTime = destroyed - created;
+  std::cout << "Created " << buffers << " buffers in " << createTime.count() << " ms, destroyed in "
+            << destroyTime.count() << " ms\n";
+  std::cout << "  device memory allocations: " << stats.blockCount + stats.dedicatedCount
+            << " (limit " << device.properties.limits.maxMemoryAllocationCount << ")\n";
+  std::cout << "  reserved " << stats.reservedBytes / 1024 << " KiB, allocated "
+            << stats.allocatedBytes / 1024 << " KiB, requested " << stats.requestedBytes / 1024 << " KiB\n";
+}
+
+void App::benchmarkTransfers(){
+  // Per object uniform data for a frame's worth of draws, nothing is submitted so every slot is free
+  constexpr int frames = 1000;
+  constexpr int objects = 1000;
+  struct ObjectData {
+    float transform[16];
+    float color[4];
+  };
+  UploadRing ring{device, objects * 256, SwapChain::MAX_FRAMES_IN_FLIGHT};
+  ObjectData data{};
+  auto start = std::chrono::high_resolution_clock::now();
+  for(int frame = 0; frame < frames; frame++){
+    ring.beginFrame(frame % SwapChain::MAX_FRAMES_IN_FLIGHT);
+    for(int i = 0; i < objects; i++){
+      data.color[0] = static_cast<float>(i);
+      ring.push(data);
+    }
+  }
+  std::chrono::duration<double, std::milli> uploadTime = std::chrono::high_resolution_clock::now() - start;
+  std::cout << "Uploaded " << objects << " objects per frame for " << frames << " frames in "
+            << uploadTime.count() << " ms (" << uploadTime.count() * 1000000.0 / (frames * objects)
+            << " ns per upload, " << ring.frameUsage() / 1024 << " KiB per frame)\n";
+
+  // Asset loads, one staging copy and queue drain each against batched transfers
+  constexpr int assets = 256;
+  constexpr VkDeviceSize assetSize = 256 * 1024;
+  std::vector<char> assetData(assetSize, 1);
+  std::vector<VkBuffer> assetBuffers(assets);
+  std::vector<Allocation> assetMemory(assets);
+  for(int i = 0; i < assets; i++){
+    device.createBuffer(assetSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
+        VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, assetBuffers[i], assetMemory[i]);
+  }
+  double megabytes = static_cast<double>(assets * assetSize) / (1024.0 * 1024.0);
+
+  start = std::chrono::high_resolution_clock::now();
+  for(int i = 0; i < assets; i++){
+    VkBuffer staging;
+    Allocation stagingMemory;
+    device.createBuffer(assetSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, staging, stagingMemory);
+    std::memcpy(stagingMemory.mapped, assetData.data(), assetSize);
+    device.copyBuffer(staging, assetBuffers[i], assetSize);
+    device.destroyBuffer(staging, stagingMemory);
+  }
+  std::chrono::duration<double> singleTime = std::chrono::high_resolution_clock::now() - start;
+
+  TransferManager transfers{device};
+  start = std::chrono::high_resolution_clock::now();
+  for(int i = 0; i < assets; i++){
+    transfers.uploadBuffer(assetBuffers[i], 0, assetData.data(), assetSize);
+  }
+  transfers.wait(transfers.flush());
+  std::chrono::duration<double> batchedTime = std::chrono::high_resolution_clock::now() - start;
+
+  std::cout << "Uploaded " << megabytes << " MiB in " << assets << " assets: single time commands "
+            << megabytes / singleTime.count() << " MiB/s, batched " << megabytes / batchedTime.count()
+            << " MiB/s (" << (transfers.usesDedicatedQueue() ? "dedicated transfer queue" : "graphics queue")
+            << ")\n";
+  for(int i = 0; i < assets; i++){
+    device.destroyBuffer(assetBuffers[i], assetMemory[i]);
+  }
+}
+
+void App::benchmarkPipelines(){
+  std::cout << "Frame times with " << MATERIALS << " new materials over " << MATERIAL_FRAMES << " frames\n";
+  std::cout << " built inline:";
+  std::unordered_map<uint64_t, std::unique_ptr<Pipeline>> inlinePipelines;
+  timeMaterials(false, [&](const PipelineDesc& desc){
+    auto& built = inlinePipelines[PipelineLibrary::hashDesc(desc)];
+    if(!built){
+      built = std::make_unique<Pipeline>(device, shaders, desc.vertShader, desc.fragShader, desc.config);
+    }
+    return built->getPipeline();
+  });
+  std::cout << " pipeline library:";
+  PipelineLibrary library{device, shaders};
+  timeMaterials(true, [&](const PipelineDesc& desc){
+    return library.get(desc, pipeline->getPipeline());
+  });
+  library.waitIdle();
+
+  std::cout << "Resizes drawing " << MATERIALS << " materials, average with dynamic viewport " << timeResizes(false)
+            << " ms, with baked in viewport " << timeResizes(true) << " ms (warm pipeline cache)\n";
+
+  auto distinctPipelines = [&](bool extendedDynamic){
+    std::unordered_set<uint64_t> keys;
+    for(int material = 0; material < MATERIALS; material++){
+      keys.insert(PipelineLibrary::hashDesc(materialDesc(material, false, extendedDynamic)));
+    }
+    return keys.size();
+  };
+  std::cout << "Pipelines for " << MATERIALS << " materials: " << distinctPipelines(false) << " static, ";
+  if(device.supportsExtendedDynamicState()){
+    std::cout << distinctPipelines(true) << " with extended dynamic state\n";
+
+    // Every material drawn through the one pipeline they collapse into, its state set while recording
+    PipelineDesc sharedDesc = materialDesc(0, false, true);
+    Pipeline shared{device, shaders, sharedDesc.vertShader, sharedDesc.fragShader, sharedDesc.config};
+    VkExtent2D extent = swapChain.getSwapChainExtent();
+    RenderTarget target = createRenderTarget(extent);
+    auto start = std::chrono::high_resolution_clock::now();
+    drawToTarget(target, extent, [&](VkCommandBuffer commandBuffer){
+      Pipeline::setViewport(commandBuffer, extent);
+      vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, shared.getPipeline());
+      for(int material = 0; material < MATERIALS; material++){
+        Pipeline::setDynamicState(commandBuffer, materialDesc(material, false, true).config, device);
+        vkCmdDraw(commandBuffer, 3, 1, 0, 0);
+      }
+    });
+    std::chrono::duration<double, std::milli> sharedTime = std::chrono::high_resolution_clock::now() - start;
+    destroyRenderTarget(target);
+    std::cout << "  drew all " << MATERIALS << " materials with one pipeline in " << sharedTime.count() << " ms\n";
+  } else {
+    std::cout << "extended dynamic state not supported\n";
+  }
+}
+
+void App::benchmarkShaderLoading(){
+  // Startup shader loading as hundreds of shaders would see it, one open per file against one per archive
+  constexpr int shaderLoads = 512;
+  const char* looseShaders[] = {"build/shaders/vert.spv", "build/shaders/frag.spv"};
+  size_t looseBytes = 0;
+  auto start = std::chrono::high_resolution_clock::now();
+  for(int i = 0; i < shaderLoads; i++){
+    std::ifstream file(looseShaders[i % 2], std::ios::ate | std::ios::binary);
+    std::vector<char> code(static_cast<size_t>(file.tellg()));
+    file.seekg(0);
+    file.read(code.data(), code.size());
+    looseBytes += code.size();
+  }
+  std::chrono::duration<double, std::milli> looseTime = std::chrono::high_resolution_clock::now() - start;
+  size_t archiveBytes = 0;
+  start = std::chrono::high_resolution_clock::now();
+  {
+    ShaderArchive archive{SHADER_ARCHIVE_PATH};
+    for(int i = 0; i < shaderLoads; i++){
+      archiveBytes += archive.find(i % 2 ? "frag" : "vert").size;
+    }
+  }
+  std::chrono::duration<double, std::milli> archiveTime = std::chrono::high_resolution_clock::now() - start;
+  std::cout << "Loading " << shaderLoads << " shaders: loose files " << looseTime.count() << " ms for "
+            << looseBytes << " bytes copied, mapped archive " << archiveTime.count() << " ms for "
+            << archiveBytes << " bytes in place\n";
+
+  // Every material asks for its layout as if it were the only one, equal layouts share one handle
+  start = std::chrono::high_resolution_clock::now();
+  for(int material = 0; material < MATERIALS; material++){
+    layouts.getPipelineLayout(shaders.find("vert"), shaders.find("frag"));
+  }
+  std::chrono::duration<double, std::milli> layoutTime = std::chrono::high_resolution_clock::now() - start;
+  std::cout << "Pipeline layouts for " << MATERIALS << " materials: " << layouts.pipelineLayoutCount()
+            << " instead of " << MATERIALS << ", " << layoutTime.count() << " ms reflecting and looking up\n";
+}
+
+void App::benchmarkCompute(){
+  // SAXPY over 16M floats, each pass reads x and y and writes y, so moves three floats per element
+  constexpr uint32_t saxpyElements = 16 * 1024 * 1024;
+  constexpr int saxpyPasses = 20;
+  constexpr float saxpyA = 2.0f;
+  constexpr VkDeviceSize saxpyBytes = VkDeviceSize{saxpyElements} * sizeof(float);
+  double saxpyGigabytes = 3.0 * saxpyBytes * saxpyPasses / 1e9;
+  ComputePipeline saxpy{device, shaders, layouts, "saxpy"};
+  VkBuffer saxpyBuffers[2];
+  Allocation saxpyMemory[2];
+  for(int i = 0; i < 2; i++){
+    device.createBuffer(saxpyBytes,
+        VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+        VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, saxpyBuffers[i], saxpyMemory[i]);
+  }
+  VkDescriptorSet saxpySet = saxpy.allocateDescriptorSet();
+  saxpy.writeStorageBuffer(saxpySet, 0, saxpyBuffers[0]);
+  saxpy.writeStorageBuffer(saxpySet, 1, saxpyBuffers[1]);
+  struct SaxpyPushConstants {
+    float a;
+    uint32_t count;
+  } saxpyPush{saxpyA, saxpyElements};
+  auto recordSaxpy = [&](VkCommandBuffer commandBuffer, int passes){
+    saxpy.bind(commandBuffer);
+    saxpy.bindDescriptorSet(commandBuffer, saxpySet);
+    saxpy.pushConstants(commandBuffer, &saxpyPush, sizeof(saxpyPush));
+    for(int pass = 0; pass < passes; pass++){
+      saxpy.dispatch(commandBuffer, saxpyElements);
+      ComputePipeline::computeBarrier(commandBuffer);
+    }
+  };
+
+  // x = 1 and y = 0 filled on the GPU, then one untimed pass to warm up clocks and caches
+  VkCommandBuffer commandBuffer = device.beginSingleTimeCommands();
+  float one = 1.0f;
+  uint32_t oneBits;
+  std::memcpy(&oneBits, &one, sizeof(oneBits));
+  vkCmdFillBuffer(commandBuffer, saxpyBuffers[0], 0, VK_WHOLE_SIZE, oneBits);
+  vkCmdFillBuffer(commandBuffer, saxpyBuffers[1], 0, VK_WHOLE_SIZE, 0);
+  VkMemoryBarrier filled{};
+  filled.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+  filled.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+  filled.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+  vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                       0, 1, &filled, 0, nullptr, 0, nullptr);
+  recordSaxpy(commandBuffer, 1);
+  device.endSingleTimeCommands(commandBuffer);
+
+  auto start = std::chrono::high_resolution_clock::now();
+  commandBuffer = device.beginSingleTimeCommands();
+  recordSaxpy(commandBuffer, saxpyPasses);
+  device.endSingleTimeCommands(commandBuffer);
+  std::chrono::duration<double> gpuTime = std::chrono::high_resolution_clock::now() - start;
+
+  // Every element of y is now (1 + saxpyPasses) * a, check the first one made it
+  VkBuffer resultBuffer;
+  Allocation resultMemory;
+  device.createBuffer(sizeof(float), VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+      VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, resultBuffer, resultMemory);
+  commandBuffer = device.beginSingleTimeCommands();
+  VkMemoryBarrier computed{};
+  computed.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+  computed.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+  computed.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+  vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                       0, 1, &computed, 0, nullptr, 0, nullptr);
+  VkBufferCopy resultRegion{0, 0, sizeof(float)};
+  vkCmdCopyBuffer(commandBuffer, saxpyBuffers[1], resultBuffer, 1, &resultRegion);
+  device.endSingleTimeCommands(commandBuffer);
+  float result;
+  std::memcpy(&result, resultMemory.mapped, sizeof(result));
+  device.destroyBuffer(resultBuffer, resultMemory);
+  for(int i = 0; i < 2; i++){
+    device.destroyBuffer(saxpyBuffers[i], saxpyMemory[i]);
+  }
+
+  std::vector<float> x(saxpyElements, 1.0f), y(saxpyElements, 0.0f);
+  start = std::chrono::high_resolution_clock::now();
+  for(int pass = 0; pass < saxpyPasses; pass++){
+    for(uint32_t i = 0; i < saxpyElements; i++){
+      y[i] = saxpyA * x[i] + y[i];
+    }
+  }
+  std::chrono::duration<double> cpuTime = std::chrono::high_resolution_clock::now() - start;
+
+  std::cout << "SAXPY over " << saxpyElements << " floats, " << saxpyPasses << " passes: compute "
+            << saxpyGigabytes / gpuTime.count() << " GB/s (" << gpuTime.count() * 1000.0 / saxpyPasses
+            << " ms per pass, " << saxpy.getWorkgroupSize() << " invocations per workgroup), CPU "
+            << saxpyGigabytes / cpuTime.count() << " GB/s, "
+            << (result == (1 + saxpyPasses) * saxpyA && y[0] == saxpyPasses * saxpyA ? "results match" : "results differ")
+            << "\n";
+}
+
+void App::benchmarkMeshes(){
+  // A dense grid drawn several times a frame, small triangles keep it bound by vertex work. Color
+  // passes read every attribute, depth passes only positions
+  constexpr uint32_t gridQuads = 512;
+  MeshData grid{};
+  for(uint32_t row = 0; row <= gridQuads; row++){
+    for(uint32_t column = 0; column <= gridQuads; column++){
+      float u = static_cast<float>(column) / gridQuads;
+      float v = static_cast<float>(row) / gridQuads;
+      grid.positions.insert(grid.positions.end(), {u * 1.8f - 0.9f, v * 1.8f - 0.9f, 0.5f});
+      grid.normals.insert(grid.normals.end(), {0.0f, 0.0f, -1.0f});
+      grid.uvs.insert(grid.uvs.end(), {u, v});
+    }
+  }
+  for(uint32_t row = 0; row < gridQuads; row++){
+    for(uint32_t column = 0; column < gridQuads; column++){
+      uint32_t corner = row * (gridQuads + 1) + column;
+      uint32_t below = corner + gridQuads + 1;
+      grid.indices.insert(grid.indices.end(), {corner, corner + 1, below, corner + 1, below + 1, below});
+    }
+  }
+  std::vector<VertexAttribute> gridAttributes = {VertexAttribute::POSITION, VertexAttribute::NORMAL, VertexAttribute::UV};
+  VertexLayout interleavedLayout = VertexLayout::interleaved(gridAttributes);
+  VertexLayout splitLayout = VertexLayout::positionSplit(gridAttributes);
+  TransferManager transfers{device};
+  Mesh interleavedGrid{device, transfers, grid, interleavedLayout};
+  Mesh splitGrid{device, transfers, grid, splitLayout};
+  VertexLayout quantizedLayout = VertexLayout::interleaved(gridAttributes, VertexEncoding::QUANTIZED);
+  VertexLayout quantizedSplitLayout = VertexLayout::positionSplit(gridAttributes, VertexEncoding::QUANTIZED);
+  Mesh quantizedGrid{device, transfers, grid, quantizedLayout};
+  Mesh quantizedSplitGrid{device, transfers, grid, quantizedSplitLayout};
+  transfers.flush();
+
+  DrawTimer timer = createDrawTimer();
+
+  std::cout << "Drawing " << grid.indices.size() / 3 << " triangles " << DRAWS_PER_FRAME << " times a frame for "
+            << DRAW_FRAMES << " frames, millions of triangles per second\n";
+  std::cout << "  color pass: interleaved " << timeDraws(timer, interleavedGrid, false) << ", position split "
+            << timeDraws(timer, splitGrid, false) << "\n";
+  std::cout << "  depth pass: interleaved " << timeDraws(timer, interleavedGrid, true) << " (" << interleavedLayout.stride(0)
+            << " byte vertices), position split " << timeDraws(timer, splitGrid, true) << " (" << splitLayout.stride(0)
+            << " byte positions)\n";
 
-if(vkCreatePipelineLayout(device.device(), &pipelineLayoutInfo, nullptr, &pipelineLayout) != VK_SUCCESS){
-  throw std::runtime_error("failed to create pipeline layout!");
+  // Vertex buffer bytes the draws of the last timeDraws read at least once, the streams it bound
+  auto vertexGigabytesPerSecond = [&](const Mesh& mesh, bool depthOnly){
+    const VertexLayout& layout = mesh.getLayout();
+    double bytes = 0.0;
+    for(uint32_t stream = 0; stream < (depthOnly ? 1 : layout.streamCount()); stream++){
+      bytes += static_cast<double>(layout.stride(stream)) * mesh.getVertexCount();
+    }
+    return bytes * DRAWS_PER_FRAME / (timer.frameMs / 1000.0) / 1e9;
+  };
+  std::cout << "Quantized vertex formats, " << interleavedLayout.stride(0) << " against " << quantizedLayout.stride(0)
+            << " byte interleaved vertices, " << splitLayout.stride(0) << " against " << quantizedSplitLayout.stride(0)
+            << " byte split positions\n";
+  for(bool depthOnly : {false, true}){
+    Mesh& floatMesh = depthOnly ? splitGrid : interleavedGrid;
+    Mesh& quantizedMesh = depthOnly ? quantizedSplitGrid : quantizedGrid;
+    double floatRate = timeDraws(timer, floatMesh, depthOnly);
+    double floatFrameMs = timer.frameMs;
+    double floatBandwidth = vertexGigabytesPerSecond(floatMesh, depthOnly);
+    double quantizedRate = timeDraws(timer, quantizedMesh, depthOnly);
+    std::cout << (depthOnly ? "  depth pass, position split: float " : "  color pass, interleaved: float ") << floatRate
+              << " million triangles per second, " << floatFrameMs << " ms a frame, " << floatBandwidth
+              << " GB/s of vertices; quantized " << quantizedRate << ", " << timer.frameMs << " ms, "
+              << vertexGigabytesPerSecond(quantizedMesh, depthOnly) << " GB/s\n";
+  }
+  destroyDrawTimer(timer);
 }
+
+void App::benchmarkMeshLoading(){
+  // A million triangle OBJ, written once and kept beside the shaders, loaded in file order on one
+  // thread and on every thread, then optimized and drawn like the grid against the file order
+  constexpr uint32_t objQuads = 708;
+  const std::string objPath = "build/benchmark_grid.obj";
+  if(!std::ifstream{objPath}){
+    std::ofstream obj{objPath};
+    if(!obj){
+      throw std::runtime_error("failed to write " + objPath);
+    }
+    for(uint32_t row = 0; row <= objQuads; row++){
+      for(uint32_t column = 0; column <= objQuads; column++){
+        float u = static_cast<float>(column) / objQuads;
+        float v = static_cast<float>(row) / objQuads;
+        obj << "v " << u * 1.8f - 0.9f << ' ' << v * 1.8f - 0.9f << " 0.5\nvt " << u << ' ' << v << '\n';
+      }
+    }
+    obj << "vn 0 0 -1\n";
+    for(uint32_t row = 0; row < objQuads; row++){
+      for(uint32_t column = 0; column < objQuads; column++){
+        uint32_t corner = row * (objQuads + 1) + column + 1;
+        uint32_t below = corner + objQuads + 1;
+        obj << "f " << corner << '/' << corner << "/1 " << corner + 1 << '/' << corner + 1 << "/1 " << below + 1 << '/'
+            << below + 1 << "/1 " << below << '/' << below << "/1\n";
+      }
+    }
+  }
+  std::vector<VertexAttribute> attributes = {VertexAttribute::POSITION, VertexAttribute::NORMAL, VertexAttribute::UV};
+  VertexLayout interleavedLayout = VertexLayout::interleaved(attributes);
+  VertexLayout quantizedLayout = VertexLayout::interleaved(attributes, VertexEncoding::QUANTIZED);
+  TransferManager transfers{device};
+  DrawTimer timer = createDrawTimer();
+  std::unique_ptr<Mesh> loaded;
+  MeshLoadStats loadStats{};
+  for(unsigned threads : {1u, 0u}){
+    auto start = std::chrono::high_resolution_clock::now();
+    loaded = MeshLoader{threads, false}.loadObj(device, transfers, objPath, interleavedLayout, &loadStats);
+    std::chrono::duration<double, std::milli> loadTime = std::chrono::high_resolution_clock::now() - start;
+    std::cout << "Loaded " << loadStats.fileBytes / (1024.0 * 1024.0) << " MiB OBJ, " << loadStats.triangles
+              << " triangles and " << loadStats.vertices << " vertices, on "
+              << (threads == 1 ? "one thread" : "every thread") << " in " << loadTime.count() << " ms (parse "
+              << loadStats.parseMs << ", deduplicate " << loadStats.dedupMs << ", pack " << loadStats.packMs << ")\n";
+    // The next load replaces this mesh, its copies must be done first
+    transfers.wait(transfers.flush());
+  }
+  MeshLoadStats optimizedStats{};
+  std::unique_ptr<Mesh> optimized = MeshLoader{}.loadObj(device, transfers, objPath, interleavedLayout, &optimizedStats);
+  MeshLoadStats quantizedStats{};
+  std::unique_ptr<Mesh> quantized = MeshLoader{}.loadObj(device, transfers, objPath, quantizedLayout, &quantizedStats);
+  transfers.flush();
+  std::cout << "Optimized for the vertex cache, overdraw and vertex fetch at load in " << optimizedStats.optimizeMs
+            << " ms, simulated vertex shader invocations per triangle " << loadStats.vertexCache.acmr << " in file order, "
+            << optimizedStats.vertexCache.acmr << " optimized, packed in " << optimizedStats.packMs << " ms as floats and "
+            << quantizedStats.packMs << " ms quantized\n";
+  for(Mesh* mesh : {loaded.get(), optimized.get(), quantized.get()}){
+    double trianglesPerSecond = timeDraws(timer, *mesh, false);
+    std::cout << "  "
+              << (mesh == loaded.get() ? "file order: " : mesh == optimized.get() ? "optimized: " : "optimized and quantized: ")
+              << trianglesPerSecond
+              << " million triangles per second, " << timer.frameMs << " ms a frame";
+    if(timer.statisticsPool != VK_NULL_HANDLE){
+      std::cout << ", " << timer.vertexInvocationsPerDraw << " vertex shader invocations a draw";
+    }
+    std::cout << "\n";
+  }
+  destroyDrawTimer(timer);
+}
+
+App::DrawTimer App::createDrawTimer(){
+  DrawTimer timer{};
+  timer.commandBuffers.resize(SwapChain::MAX_FRAMES_IN_FLIGHT);
+  VkCommandBufferAllocateInfo allocInfo{};
+  allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+  allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+  allocInfo.commandPool = device.getCommandPool();
+  allocInfo.commandBufferCount = static_cast<uint32_t>(timer.commandBuffers.size());
+  if(vkAllocateCommandBuffers(device.device(), &allocInfo, timer.commandBuffers.data()) != VK_SUCCESS){
+    throw std::runtime_error("failed to allocate command buffers!");
+  }
+
+  // Counts the first frame's vertex shader invocations where the device can
+  if(device.supportsPipelineStatistics()){
+    VkQueryPoolCreateInfo queryPoolInfo{};
+    queryPoolInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+    queryPoolInfo.queryType = VK_QUERY_TYPE_PIPELINE_STATISTICS;
+    queryPoolInfo.queryCount = 1;
+    queryPoolInfo.pipelineStatistics = VK_QUERY_PIPELINE_STATISTIC_VERTEX_SHADER_INVOCATIONS_BIT;
+    if(vkCreateQueryPool(device.device(), &queryPoolInfo, nullptr, &timer.statisticsPool) != VK_SUCCESS){
+      throw std::runtime_error("failed to create query pool!");
+    }
+  }
+  return timer;
+}
+
+void App::destroyDrawTimer(DrawTimer& timer){
+  if(timer.statisticsPool != VK_NULL_HANDLE){
+    vkDestroyQueryPool(device.device(), timer.statisticsPool, nullptr);
+  }
+  vkFreeCommandBuffers(device.device(), device.getCommandPool(),
+                       static_cast<uint32_t>(timer.commandBuffers.size()), timer.commandBuffers.data());
+}
+
+std::unique_ptr<Pipeline> App::createMeshPipeline(const VertexLayout& layout, bool depthOnly, VkPipelineLayout& meshLayout){
+  const char* vertShader = depthOnly ? "depth_vert" : "mesh_vert";
+  const char* fragShader = depthOnly ? "frag" : "mesh_frag";
+  PipelineConfigInfo config = Pipeline::defaultPipelineConfigInfo();
+  config.renderPass = swapChain.getRenderPass();
+  meshLayout = layouts.getPipelineLayout(shaders.find(vertShader), shaders.find(fragShader));
+  config.pipelineLayout = meshLayout;
+  Pipeline::setVertexLayout(config, layout);
+  if(depthOnly){
+    config.colorBlendAttachment.colorWriteMask = 0;
+  }
+  return std::make_unique<Pipeline>(device, shaders, vertShader, fragShader, config);
+}
+
+double App::timeDraws(DrawTimer& timer, Mesh& mesh, bool depthOnly){
+  VkPipelineLayout drawLayout = VK_NULL_HANDLE;
+  std::unique_ptr<Pipeline> drawPipeline = createMeshPipeline(mesh.getLayout(), depthOnly, drawLayout);
+  auto start = std::chrono::high_resolution_clock::now();
+  for(int frame = 0; frame < DRAW_FRAMES; frame++){
+    bool counted = frame == 0 && timer.statisticsPool != VK_NULL_HANDLE;
+    uint32_t imageIndex;
+    VkResult acquired = swapChain.acquireNextImage(&imageIndex);
+    if(acquired != VK_SUCCESS && acquired != VK_SUBOPTIMAL_KHR){
+      throw std::runtime_error("failed to acquire swap chain image!");
+    }
+    VkCommandBuffer commandBuffer = timer.commandBuffers[swapChain.getCurrentFrame()];
+    VkCommandBufferBeginInfo beginInfo{};
+    beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    if(vkBeginCommandBuffer(commandBuffer, &beginInfo) != VK_SUCCESS){
+      throw std::runtime_error("failed to begin recording command buffer!");
+    }
+    if(counted){
+      vkCmdResetQueryPool(commandBuffer, timer.statisticsPool, 0, 1);
+    }
+
+    std::array<VkClearValue, 2> clearValues{};
+    clearValues[1].depthStencil = {1.0f, 0};
+    VkRenderPassBeginInfo renderPassInfo{};
+    renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+    renderPassInfo.renderPass = swapChain.getRenderPass();
+    renderPassInfo.framebuffer = swapChain.getFrameBuffer(imageIndex);
+    renderPassInfo.renderArea = {{0, 0}, swapChain.getSwapChainExtent()};
+    renderPassInfo.clearValueCount = static_cast<uint32_t>(clearValues.size());
+    renderPassInfo.pClearValues = clearValues.data();
+    vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
+    Pipeline::setViewport(commandBuffer, swapChain.getSwapChainExtent());
+    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, drawPipeline->getPipeline());
+    vkCmdPushConstants(commandBuffer, drawLayout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(PositionQuantization),
+                       &mesh.getPositionQuantization());
+    if(depthOnly){
+      mesh.bindPositions(commandBuffer);
+    } else {
+      mesh.bind(commandBuffer);
+    }
+    if(counted){
+      vkCmdBeginQuery(commandBuffer, timer.statisticsPool, 0, 0);
+    }
+    for(int i = 0; i < DRAWS_PER_FRAME; i++){
+      mesh.draw(commandBuffer);
+    }
+    if(counted){
+      vkCmdEndQuery(commandBuffer, timer.statisticsPool, 0);
+    }
+    vkCmdEndRenderPass(commandBuffer);
+    if(vkEndCommandBuffer(commandBuffer) != VK_SUCCESS){
+      throw std::runtime_error("failed to record command buffer!");
+    }
+
+    VkResult submitted = swapChain.submitCommandBuffers(&commandBuffer, &imageIndex);
+    if(submitted != VK_SUCCESS && submitted != VK_SUBOPTIMAL_KHR){
+      throw std::runtime_error("failed to present swap chain image!");
+    }
+  }
+  vkDeviceWaitIdle(device.device());
+  std::chrono::duration<double> drawTime = std::chrono::high_resolution_clock::now() - start;
+  timer.frameMs = drawTime.count() * 1000.0 / DRAW_FRAMES;
+  if(timer.statisticsPool != VK_NULL_HANDLE){
+    uint64_t invocations = 0;
+    if(vkGetQueryPoolResults(device.device(), timer.statisticsPool, 0, 1, sizeof(invocations), &invocations,
+                             sizeof(invocations), VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WAIT_BIT) != VK_SUCCESS){
+      throw std::runtime_error("failed to get query pool results!");
+    }
+    timer.vertexInvocationsPerDraw = invocations / DRAWS_PER_FRAME;
+  }
+  double triangles = static_cast<double>(mesh.getIndexCount() / 3) * DRAWS_PER_FRAME * DRAW_FRAMES;
+  return triangles / drawTime.count() / 1e6;
+}
+
+PipelineDesc App::materialDesc(int material, bool blend, bool extendedDynamic){
+  PipelineDesc desc{};
+  desc.vertShader = "vert";
+  desc.fragShader = "frag";
+  desc.config = Pipeline::defaultPipelineConfigInfo();
+  if(extendedDynamic){
+    Pipeline::enableExtendedDynamicState(desc.config);
+  }
+  desc.config.renderPass = swapChain.getRenderPass();
+  desc.config.pipelineLayout = pipelineLayout;
+  desc.config.rasterizationInfo.cullMode = CULL_MODES[material % 4];
+  desc.config.rasterizationInfo.frontFace = (material / 4) % 2 ? VK_FRONT_FACE_COUNTER_CLOCKWISE : VK_FRONT_FACE_CLOCKWISE;
+  desc.config.depthStencilInfo.depthCompareOp = COMPARE_OPS[(material / 8) % 4];
+  desc.config.colorBlendAttachment.blendEnable = blend ? VK_TRUE : VK_FALSE;
+  desc.renderPassHash = swapChain.getRenderPassHash();
+  return desc;
+}
+
+void App::timeMaterials(bool blend, const std::function<VkPipeline(const PipelineDesc&)>& lookup){
+  // Each run gets its own variants, otherwise the second would hit the first one's pipeline cache entries
+  std::vector<PipelineDesc> descs;
+  double total = 0.0, worst = 0.0;
+  for(int frame = 0; frame < MATERIAL_FRAMES; frame++){
+    if(frame % FRAMES_PER_MATERIAL == 0){
+      descs.push_back(materialDesc(frame / FRAMES_PER_MATERIAL, blend));
+    }
+    auto frameStart = std::chrono::high_resolution_clock::now();
+    for(int draw = 0; draw < MATERIAL_DRAWS_PER_FRAME; draw++){
+      lookup(descs[draw % descs.size()]);
+    }
+    std::chrono::duration<double, std::milli> frameTime = std::chrono::high_resolution_clock::now() - frameStart;
+    total += frameTime.count();
+    worst = std::max(worst, frameTime.count());
+  }
+  std::cout << "  average " << total / MATERIAL_FRAMES << " ms, worst " << worst << " ms\n";
+}
+
+App::RenderTarget App::createRenderTarget(VkExtent2D extent){
+  RenderTarget target{};
+  VkFormat formats[] = {swapChain.getSwapChainImageFormat(), swapChain.findDepthFormat()};
+  VkImageUsageFlags usages[] = {VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT, VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT};
+  VkImageAspectFlags aspects[] = {VK_IMAGE_ASPECT_COLOR_BIT, VK_IMAGE_ASPECT_DEPTH_BIT};
+  for(int i = 0; i < 2; i++){
+    VkImageCreateInfo imageInfo{};
+    imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+    imageInfo.imageType = VK_IMAGE_TYPE_2D;
+    imageInfo.extent = {extent.width, extent.height, 1};
+    imageInfo.mipLevels = 1;
+    imageInfo.arrayLayers = 1;
+    imageInfo.format = formats[i];
+    imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+    imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    imageInfo.usage = usages[i];
+    imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+    imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    device.createImageWithInfo(imageInfo, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, target.images[i], target.memory[i]);
+
+    VkImageViewCreateInfo viewInfo{};
+    viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+    viewInfo.image = target.images[i];
+    viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+    viewInfo.format = formats[i];
+    viewInfo.subresourceRange = {aspects[i], 0, 1, 0, 1};
+    if(vkCreateImageView(device.device(), &viewInfo, nullptr, &target.views[i]) != VK_SUCCESS){
+      throw std::runtime_error("failed to create image view!");
+    }
+  }
+  VkFramebufferCreateInfo framebufferInfo{};
+  framebufferInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+  framebufferInfo.renderPass = swapChain.getRenderPass();
+  framebufferInfo.attachmentCount = 2;
+  framebufferInfo.pAttachments = target.views;
+  framebufferInfo.width = extent.width;
+  framebufferInfo.height = extent.height;
+  framebufferInfo.layers = 1;
+  if(vkCreateFramebuffer(device.device(), &framebufferInfo, nullptr, &target.framebuffer) != VK_SUCCESS){
+    throw std::runtime_error("failed to create framebuffer!");
+  }
+  return target;
+}
+
+void App::destroyRenderTarget(RenderTarget& target){
+  vkDestroyFramebuffer(device.device(), target.framebuffer, nullptr);
+  for(int i = 0; i < 2; i++){
+    vkDestroyImageView(device.device(), target.views[i], nullptr);
+    device.destroyImage(target.images[i], target.memory[i]);
+  }
+}
+
+void App::drawToTarget(RenderTarget& target, VkExtent2D extent, const std::function<void(VkCommandBuffer)>& record){
+  VkCommandBuffer commandBuffer = device.beginSingleTimeCommands();
+  std::array<VkClearValue, 2> clearValues{};
+  clearValues[1].depthStencil = {1.0f, 0};
+  VkRenderPassBeginInfo renderPassInfo{};
+  renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+  renderPassInfo.renderPass = swapChain.getRenderPass();
+  renderPassInfo.framebuffer = target.framebuffer;
+  renderPassInfo.renderArea = {{0, 0}, extent};
+  renderPassInfo.clearValueCount = static_cast<uint32_t>(clearValues.size());
+  renderPassInfo.pClearValues = clearValues.data();
+  vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
+  record(commandBuffer);
+  vkCmdEndRenderPass(commandBuffer);
+  device.endSingleTimeCommands(commandBuffer);
+}
+
+double App::timeResizes(bool staticViewport){
+  std::vector<std::unique_ptr<Pipeline>> pipelines;
+  if(!staticViewport){
+    for(int material = 0; material < MATERIALS; material++){
+      PipelineDesc desc = materialDesc(material, false);
+      pipelines.push_back(std::make_unique<Pipeline>(device, shaders, desc.vertShader, desc.fragShader, desc.config));
+    }
+  }
+  double total = 0.0;
+  for(int resize = 0; resize < RESIZES; resize++){
+    VkExtent2D extent = RESIZE_EXTENTS[resize % 2];
+    auto resizeStart = std::chrono::high_resolution_clock::now();
+    RenderTarget target = createRenderTarget(extent);
+    if(staticViewport){
+      pipelines.clear();
+      for(int material = 0; material < MATERIALS; material++){
+        PipelineDesc desc = materialDesc(material, false);
+        Pipeline::setStaticViewport(desc.config, extent);
+        pipelines.push_back(std::make_unique<Pipeline>(device, shaders, desc.vertShader, desc.fragShader, desc.config));
+      }
+    }
+    drawToTarget(target, extent, [&](VkCommandBuffer commandBuffer){
+      if(!staticViewport){
+        Pipeline::setViewport(commandBuffer, extent);
+      }
+      for(auto& drawn : pipelines){
+        vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, drawn->getPipeline());
+        vkCmdDraw(commandBuffer, 3, 1, 0, 0);
+      }
+    });
+    std::chrono::duration<double, std::milli> resizeTime = std::chrono::high_resolution_clock::now() - resizeStart;
+    total += resizeTime.count();
+    destroyRenderTarget(target);
+  }
+  return total / RESIZES;
+}
+
+void App::createPipelineLayout(){
+  // Reflected from the shaders, resources added to them need no layout code; owned by layouts
+  pipelineLayout = layouts.getPipelineLayout(shaders.find("vert"), shaders.find("frag"));
 }
 
 void App::createPipeline(){
-  auto pipelineConfig = Pipeline::defaultPipelineConfigInfo(swapChain.width(), swapChain.height());
+  auto pipelineConfig = Pipeline::defaultPipelineConfigInfo();
   pipelineConfig.renderPass = swapChain.getRenderPass();
   pipelineConfig.pipelineLayout = pipelineLayout;
-  pipeline = std::make_unique<Pipeline>(device, "build/shaders/vert.spv", "build/shaders/frag.spv", pipelineConfig);    
+  // Compare across launches to see what the on disk pipeline cache saves
+  auto start = std::chrono::high_resolution_clock::now();
+  pipeline = std::make_unique<Pipeline>(device, shaders, "vert", "frag", pipelineConfig);    
+  std::chrono::duration<double, std::milli> elapsed = std::chrono::high_resolution_clock::now() - start;
+  std::cout << "Pipeline created in " << elapsed.count() << " ms" << std::endl;
 }
 
 void App::createCommandBuffers(){
@@ -35,12 +754,12 @@ void App::drawFrame(){
 }
 
 App::App(std::string title) : window{WIDTH, HEIGHT, title}, device{window},
-                            swapChain{device, window.getExtent()} {
+                            swapChain{device, window.getExtent()}, shaders{SHADER_ARCHIVE_PATH, device.enableValidationLayers},
+                            layouts{device} {
   createPipelineLayout();
   createPipeline();
   createCommandBuffers();
 };
 
 App::~App(){
-  vkDestroyPipelineLayout(device.device(), pipelineLayout, nullptr);
 }
\ No newline at end of file
@@ -0,0 +1,165 @@
+#include "compute_pipeline.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <map>
+
+void ComputePipeline::createComputePipeline(const ShaderCode& code,
+                                            const SpecializationConstants& specialization){
+  if(!(reflection.stages & VK_SHADER_STAGE_COMPUTE_BIT)){
+    throw std::runtime_error("failed to create compute pipeline, shader is not a compute shader");
+  }
+  pipelineLayout = layouts.getPipelineLayout(reflection);
+
+  VkShaderModuleCreateInfo moduleInfo{};
+  moduleInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+  moduleInfo.codeSize = code.size;
+  moduleInfo.pCode = code.words;
+  if(vkCreateShaderModule(device.device(), &moduleInfo, nullptr, &shaderModule) != VK_SUCCESS){
+    throw std::runtime_error("failed to create shader module");
+  }
+
+  VkSpecializationInfo specializationInfo = specialization.info();
+  VkComputePipelineCreateInfo pipelineInfo{};
+  pipelineInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+  pipelineInfo.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+  pipelineInfo.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+  pipelineInfo.stage.module = shaderModule;
+  pipelineInfo.stage.pName = "main";
+  pipelineInfo.stage.pSpecializationInfo = specialization.empty() ? nullptr : &specializationInfo;
+  pipelineInfo.layout = pipelineLayout;
+  pipelineInfo.basePipelineIndex = -1;
+  pipelineInfo.basePipelineHandle = VK_NULL_HANDLE;
+
+  if(vkCreateComputePipelines(device.device(), device.pipelineCache(), 1, &pipelineInfo,
+                nullptr, &computePipeline) != VK_SUCCESS){
+    throw std::runtime_error("failed to create compute pipeline");
+  }
+}
+
+void ComputePipeline::createDescriptorPool(uint32_t maxSets){
+  std::map<VkDescriptorType, uint32_t> descriptorCounts;
+  for(const auto& set : reflection.descriptorSets){
+    for(const auto& binding : set.second){
+      descriptorCounts[binding.descriptorType] += binding.descriptorCount * maxSets;
+    }
+  }
+  if(descriptorCounts.empty()){
+    return;
+  }
+
+  std::vector<VkDescriptorPoolSize> poolSizes;
+  for(const auto& count : descriptorCounts){
+    poolSizes.push_back({count.first, count.second});
+  }
+  VkDescriptorPoolCreateInfo poolInfo{};
+  poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+  poolInfo.maxSets = maxSets * static_cast<uint32_t>(reflection.descriptorSets.size());
+  poolInfo.poolSizeCount = static_cast<uint32_t>(poolSizes.size());
+  poolInfo.pPoolSizes = poolSizes.data();
+  if(vkCreateDescriptorPool(device.device(), &poolInfo, nullptr, &descriptorPool) != VK_SUCCESS){
+    throw std::runtime_error("failed to create descriptor pool");
+  }
+}
+
+VkDescriptorSet ComputePipeline::allocateDescriptorSet(uint32_t set){
+  auto bindings = reflection.descriptorSets.find(set);
+  if(bindings == reflection.descriptorSets.end()){
+    throw std::runtime_error("failed to allocate descriptor set, the shader declares no set " + std::to_string(set));
+  }
+  // The same handle the pipeline layout was built from
+  VkDescriptorSetLayout setLayout = layouts.getSetLayout(bindings->second);
+
+  VkDescriptorSetAllocateInfo allocInfo{};
+  allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+  allocInfo.descriptorPool = descriptorPool;
+  allocInfo.descriptorSetCount = 1;
+  allocInfo.pSetLayouts = &setLayout;
+
+  VkDescriptorSet descriptorSet;
+  if(vkAllocateDescriptorSets(device.device(), &allocInfo, &descriptorSet) != VK_SUCCESS){
+    throw std::runtime_error("failed to allocate descriptor set");
+  }
+  return descriptorSet;
+}
+
+void ComputePipeline::writeStorageBuffer(VkDescriptorSet descriptorSet, uint32_t binding, VkBuffer buffer,
+                                         VkDeviceSize offset, VkDeviceSize range){
+  VkDescriptorBufferInfo bufferInfo{};
+  bufferInfo.buffer = buffer;
+  bufferInfo.offset = offset;
+  bufferInfo.range = range;
+
+  VkWriteDescriptorSet write{};
+  write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+  write.dstSet = descriptorSet;
+  write.dstBinding = binding;
+  write.descriptorCount = 1;
+  write.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+  write.pBufferInfo = &bufferInfo;
+  vkUpdateDescriptorSets(device.device(), 1, &write, 0, nullptr);
+}
+
+void ComputePipeline::bind(VkCommandBuffer commandBuffer){
+  vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, computePipeline);
+}
+
+void ComputePipeline::bindDescriptorSet(VkCommandBuffer commandBuffer, VkDescriptorSet descriptorSet, uint32_t set){
+  vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipelineLayout, set, 1,
+                          &descriptorSet, 0, nullptr);
+}
+
+void ComputePipeline::pushConstants(VkCommandBuffer commandBuffer, const void* data, uint32_t size){
+  assert(!reflection.pushConstantRanges.empty() &&
+        "Cannot push constants:: the shader declares no push constant block");
+  vkCmdPushConstants(commandBuffer, pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT,
+                     reflection.pushConstantRanges[0].offset, size, data);
+}
+
+void ComputePipeline::dispatch(VkCommandBuffer commandBuffer, uint32_t elements){
+  uint32_t workgroupSize = reflection.localSize[0];
+  uint32_t groups = elements / workgroupSize + (elements % workgroupSize != 0);
+  dispatchGroups(commandBuffer, std::min(groups, device.properties.limits.maxComputeWorkGroupCount[0]));
+}
+
+void ComputePipeline::dispatchGroups(VkCommandBuffer commandBuffer, uint32_t x, uint32_t y, uint32_t z){
+  vkCmdDispatch(commandBuffer, x, y, z);
+}
+
+void ComputePipeline::computeBarrier(VkCommandBuffer commandBuffer){
+  VkMemoryBarrier barrier{};
+  barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+  barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+  barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+  vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                       0, 1, &barrier, 0, nullptr, 0, nullptr);
+}
+
+void ComputePipeline::computeToGraphicsBarrier(VkCommandBuffer commandBuffer, VkAccessFlags dstAccess,
+                                               VkPipelineStageFlags dstStages){
+  // Recorded outside render passes, before the one that reads the results
+  VkMemoryBarrier barrier{};
+  barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+  barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+  barrier.dstAccessMask = dstAccess;
+  vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, dstStages,
+                       0, 1, &barrier, 0, nullptr, 0, nullptr);
+}
+
+ComputePipeline::ComputePipeline(Device& device, const ShaderArchive& shaders, LayoutCache& layouts,
+                                 const std::string& shader, const SpecializationConstants& specialization,
+                                 uint32_t maxSets)
+:device(device), layouts(layouts){
+  ShaderCode code = shaders.find(shader);
+  reflection = ShaderReflection::reflect(code);
+  createComputePipeline(code, specialization);
+  createDescriptorPool(maxSets);
+}
+
+ComputePipeline::~ComputePipeline(){
+  if(descriptorPool != VK_NULL_HANDLE){
+    vkDestroyDescriptorPool(device.device(), descriptorPool, nullptr);
+  }
+  vkDestroyShaderModule(device.device(), shaderModule, nullptr);
+  vkDestroyPipeline(device.device(), computePipeline, nullptr);
+}
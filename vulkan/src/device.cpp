@@ -1,7 +1,10 @@
 #include "device.hpp"
+#include "hash.hpp"
 
 // std headers
 #include <cstring>
+#include <filesystem>
+#include <fstream>
 #include <iostream>
 #include <set>
 #include <unordered_set>
@@ -52,11 +55,16 @@ Device::Device(Window &window) : window{window} {
   createSurface();
   pickPhysicalDevice();
   createLogicalDevice();
+  allocator_ = std::make_unique<MemoryAllocator>(physicalDevice, device_);
   createCommandPool();
+  createPipelineCache();
 }
 
 Device::~Device() {
+  savePipelineCache();
+  vkDestroyPipelineCache(device_, pipelineCache_, nullptr);
   vkDestroyCommandPool(device_, commandPool, nullptr);
+  allocator_.reset();
   vkDestroyDevice(device_, nullptr);
 
   if (enableValidationLayers) {
@@ -78,7 +86,8 @@ void Device::createInstance() {
   appInfo.applicationVersion = VK_MAKE_VERSION(1, 0, 0);
   appInfo.pEngineName = "No Engine";
   appInfo.engineVersion = VK_MAKE_VERSION(1, 0, 0);
-  appInfo.apiVersion = VK_API_VERSION_1_0;
+  // 1.1 for vkGetPhysicalDeviceFeatures2, which reports extension features
+  appInfo.apiVersion = VK_API_VERSION_1_1;
 
   VkInstanceCreateInfo createInfo = {};
   createInfo.sType = VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO;
@@ -137,6 +146,9 @@ void Device::createLogicalDevice() {
 
   std::vector<VkDeviceQueueCreateInfo> queueCreateInfos;
   std::set<uint32_t> uniqueQueueFamilies = {indices.graphicsFamily, indices.presentFamily};
+  if (indices.transferFamilyHasValue) {
+    uniqueQueueFamilies.insert(indices.transferFamily);
+  }
 
   float queuePriority = 1.0f;
   for (uint32_t queueFamily : uniqueQueueFamilies) {
@@ -148,8 +160,13 @@ void Device::createLogicalDevice() {
     queueCreateInfos.push_back(queueCreateInfo);
   }
 
+  VkPhysicalDeviceFeatures supportedFeatures;
+  vkGetPhysicalDeviceFeatures(physicalDevice, &supportedFeatures);
   VkPhysicalDeviceFeatures deviceFeatures = {};
   deviceFeatures.samplerAnisotropy = VK_TRUE;
+  // Optional, lets benchmarks count shader invocations
+  deviceFeatures.pipelineStatisticsQuery = supportedFeatures.pipelineStatisticsQuery;
+  pipelineStatistics_ = supportedFeatures.pipelineStatisticsQuery == VK_TRUE;
 
   VkDeviceCreateInfo createInfo = {};
   createInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
@@ -158,8 +175,25 @@ void Device::createLogicalDevice() {
   createInfo.pQueueCreateInfos = queueCreateInfos.data();
 
   createInfo.pEnabledFeatures = &deviceFeatures;
-  createInfo.enabledExtensionCount = static_cast<uint32_t>(deviceExtensions.size());
-  createInfo.ppEnabledExtensionNames = deviceExtensions.data();
+
+  // Optional, lets pipelines differing only in cull, depth or topology state collapse into one
+  std::vector<const char *> enabledExtensions = deviceExtensions;
+  VkPhysicalDeviceExtendedDynamicStateFeaturesEXT extendedDynamicStateFeatures = {};
+  extendedDynamicStateFeatures.sType =
+      VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_EXTENDED_DYNAMIC_STATE_FEATURES_EXT;
+  if (hasDeviceExtension(physicalDevice, VK_EXT_EXTENDED_DYNAMIC_STATE_EXTENSION_NAME)) {
+    VkPhysicalDeviceFeatures2 features = {};
+    features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+    features.pNext = &extendedDynamicStateFeatures;
+    vkGetPhysicalDeviceFeatures2(physicalDevice, &features);
+    extendedDynamicState_ = extendedDynamicStateFeatures.extendedDynamicState == VK_TRUE;
+  }
+  if (extendedDynamicState_) {
+    enabledExtensions.push_back(VK_EXT_EXTENDED_DYNAMIC_STATE_EXTENSION_NAME);
+    createInfo.pNext = &extendedDynamicStateFeatures;
+  }
+  createInfo.enabledExtensionCount = static_cast<uint32_t>(enabledExtensions.size());
+  createInfo.ppEnabledExtensionNames = enabledExtensions.data();
 
   // might not really be necessary anymore because device specific validation layers
   // have been deprecated
@@ -176,6 +210,29 @@ void Device::createLogicalDevice() {
 
   vkGetDeviceQueue(device_, indices.graphicsFamily, 0, &graphicsQueue_);
   vkGetDeviceQueue(device_, indices.presentFamily, 0, &presentQueue_);
+  if (extendedDynamicState_) {
+    auto &functions = extendedDynamicStateFunctions;
+    functions.setCullMode =
+        (PFN_vkCmdSetCullModeEXT)vkGetDeviceProcAddr(device_, "vkCmdSetCullModeEXT");
+    functions.setFrontFace =
+        (PFN_vkCmdSetFrontFaceEXT)vkGetDeviceProcAddr(device_, "vkCmdSetFrontFaceEXT");
+    functions.setPrimitiveTopology = (PFN_vkCmdSetPrimitiveTopologyEXT)vkGetDeviceProcAddr(
+        device_,
+        "vkCmdSetPrimitiveTopologyEXT");
+    functions.setDepthTestEnable = (PFN_vkCmdSetDepthTestEnableEXT)vkGetDeviceProcAddr(
+        device_,
+        "vkCmdSetDepthTestEnableEXT");
+    functions.setDepthWriteEnable = (PFN_vkCmdSetDepthWriteEnableEXT)vkGetDeviceProcAddr(
+        device_,
+        "vkCmdSetDepthWriteEnableEXT");
+    functions.setDepthCompareOp =
+        (PFN_vkCmdSetDepthCompareOpEXT)vkGetDeviceProcAddr(device_, "vkCmdSetDepthCompareOpEXT");
+  }
+  if (indices.transferFamilyHasValue) {
+    vkGetDeviceQueue(device_, indices.transferFamily, 0, &transferQueue_);
+  } else {
+    transferQueue_ = graphicsQueue_;
+  }
 }
 
 void Device::createCommandPool() {
@@ -192,6 +249,111 @@ void Device::createCommandPool() {
   }
 }
 
+// Wraps the driver's cache data on disk, "VKPC" and a layout version followed by an FNV-1a checksum of the data
+struct PipelineCacheFileHeader {
+  uint32_t magic;
+  uint32_t version;
+  // Some drivers keep the cache UUID across updates that change the binary format
+  uint32_t driverVersion;
+  uint32_t reserved;
+  uint64_t dataSize;
+  uint64_t checksum;
+};
+
+static constexpr uint32_t PIPELINE_CACHE_MAGIC = 0x43504B56;
+static constexpr uint32_t PIPELINE_CACHE_VERSION = 1;
+
+// Whether file holds cache data this device's driver wrote, handing anything else to the driver risks a crash
+static bool isPipelineCacheValid(
+    const std::vector<char> &file, const VkPhysicalDeviceProperties &properties) {
+  PipelineCacheFileHeader header;
+  VkPipelineCacheHeaderVersionOne driverHeader;
+  if (file.size() < sizeof(header) + sizeof(driverHeader)) {
+    return false;
+  }
+  std::memcpy(&header, file.data(), sizeof(header));
+  std::memcpy(&driverHeader, file.data() + sizeof(header), sizeof(driverHeader));
+
+  return header.magic == PIPELINE_CACHE_MAGIC && header.version == PIPELINE_CACHE_VERSION &&
+         header.dataSize == file.size() - sizeof(header) &&
+         header.checksum == hashBytes(file.data() + sizeof(header), header.dataSize) &&
+         header.driverVersion == properties.driverVersion &&
+         driverHeader.headerSize >= sizeof(driverHeader) &&
+         driverHeader.headerVersion == VK_PIPELINE_CACHE_HEADER_VERSION_ONE &&
+         driverHeader.vendorID == properties.vendorID &&
+         driverHeader.deviceID == properties.deviceID &&
+         std::memcmp(driverHeader.pipelineCacheUUID, properties.pipelineCacheUUID, VK_UUID_SIZE) == 0;
+}
+
+void Device::createPipelineCache() {
+  std::vector<char> file;
+  std::ifstream stream{PIPELINE_CACHE_PATH, std::ios::binary | std::ios::ate};
+  if (stream.is_open()) {
+    file.resize(static_cast<size_t>(stream.tellg()));
+    stream.seekg(0);
+    stream.read(file.data(), file.size());
+  }
+
+  VkPipelineCacheCreateInfo cacheInfo = {};
+  cacheInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+  if (stream && isPipelineCacheValid(file, properties)) {
+    cacheInfo.initialDataSize = file.size() - sizeof(PipelineCacheFileHeader);
+    cacheInfo.pInitialData = file.data() + sizeof(PipelineCacheFileHeader);
+  }
+
+  // A driver may still refuse data that passed every check, so fall back to an empty cache
+  if (cacheInfo.initialDataSize > 0 &&
+      vkCreatePipelineCache(device_, &cacheInfo, nullptr, &pipelineCache_) == VK_SUCCESS) {
+    std::cout << "pipeline cache: " << cacheInfo.initialDataSize << " bytes loaded" << std::endl;
+    return;
+  }
+  cacheInfo.initialDataSize = 0;
+  cacheInfo.pInitialData = nullptr;
+  if (vkCreatePipelineCache(device_, &cacheInfo, nullptr, &pipelineCache_) != VK_SUCCESS) {
+    throw std::runtime_error("failed to create pipeline cache!");
+  }
+  std::cout << "pipeline cache: cold" << std::endl;
+}
+
+void Device::savePipelineCache() {
+  size_t dataSize = 0;
+  if (vkGetPipelineCacheData(device_, pipelineCache_, &dataSize, nullptr) != VK_SUCCESS ||
+      dataSize == 0) {
+    return;
+  }
+  std::vector<char> data(dataSize);
+  if (vkGetPipelineCacheData(device_, pipelineCache_, &dataSize, data.data()) != VK_SUCCESS) {
+    return;
+  }
+
+  PipelineCacheFileHeader header = {};
+  header.magic = PIPELINE_CACHE_MAGIC;
+  header.version = PIPELINE_CACHE_VERSION;
+  header.driverVersion = properties.driverVersion;
+  header.dataSize = dataSize;
+  header.checksum = hashBytes(data.data(), dataSize);
+
+  // Written beside the real file and renamed over it, so a crash mid save leaves the old cache intact
+  std::string temporaryPath = std::string(PIPELINE_CACHE_PATH) + ".tmp";
+  std::error_code error;
+  {
+    std::ofstream stream{temporaryPath, std::ios::binary | std::ios::trunc};
+    stream.write(reinterpret_cast<const char *>(&header), sizeof(header));
+    stream.write(data.data(), dataSize);
+    stream.flush();
+    if (!stream) {
+      std::cerr << "failed to write pipeline cache!" << std::endl;
+      std::filesystem::remove(temporaryPath, error);
+      return;
+    }
+  }
+  std::filesystem::rename(temporaryPath, PIPELINE_CACHE_PATH, error);
+  if (error) {
+    std::cerr << "failed to replace pipeline cache: " << error.message() << std::endl;
+    std::filesystem::remove(temporaryPath, error);
+  }
+}
+
 void Device::createSurface() { window.createWindowSurface(instance, &surface_); }
 
 bool Device::isDeviceSuitable(VkPhysicalDevice device) {
@@ -296,6 +458,25 @@ void Device::hasGflwRequiredInstanceExtensions() {
   }
 }
 
+bool Device::hasDeviceExtension(VkPhysicalDevice device, const char *extension) {
+  uint32_t extensionCount;
+  vkEnumerateDeviceExtensionProperties(device, nullptr, &extensionCount, nullptr);
+
+  std::vector<VkExtensionProperties> availableExtensions(extensionCount);
+  vkEnumerateDeviceExtensionProperties(
+      device,
+      nullptr,
+      &extensionCount,
+      availableExtensions.data());
+
+  for (const auto &available : availableExtensions) {
+    if (strcmp(available.extensionName, extension) == 0) {
+      return true;
+    }
+  }
+  return false;
+}
+
 bool Device::checkDeviceExtensionSupport(VkPhysicalDevice device) {
   uint32_t extensionCount;
   vkEnumerateDeviceExtensionProperties(device, nullptr, &extensionCount, nullptr);
@@ -327,7 +508,9 @@ QueueFamilyIndices Device::findQueueFamilies(VkPhysicalDevice device) {
 
   int i = 0;
   for (const auto &queueFamily : queueFamilies) {
-    if (queueFamily.queueCount > 0 && queueFamily.queueFlags & VK_QUEUE_GRAPHICS_BIT) {
+    // Compute that feeds rendering is recorded with it, ComputePipeline relies on one family doing both
+    VkQueueFlags graphicsAndCompute = VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT;
+    if (queueFamily.queueCount > 0 && (queueFamily.queueFlags & graphicsAndCompute) == graphicsAndCompute) {
       indices.graphicsFamily = i;
       indices.graphicsFamilyHasValue = true;
     }
@@ -344,6 +527,20 @@ QueueFamilyIndices Device::findQueueFamilies(VkPhysicalDevice device) {
     i++;
   }
 
+  // Prefer a transfer only family, usually backed by a copy engine, over an async compute one
+  i = 0;
+  for (const auto &queueFamily : queueFamilies) {
+    VkQueueFlags flags = queueFamily.queueFlags;
+    if (queueFamily.queueCount > 0 && (flags & VK_QUEUE_TRANSFER_BIT) &&
+        !(flags & VK_QUEUE_GRAPHICS_BIT)) {
+      if (!indices.transferFamilyHasValue || !(flags & VK_QUEUE_COMPUTE_BIT)) {
+        indices.transferFamily = i;
+        indices.transferFamilyHasValue = true;
+      }
+    }
+    i++;
+  }
+
   return indices;
 }
 
@@ -402,12 +599,24 @@ uint32_t Device::findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags prope
   throw std::runtime_error("failed to find suitable memory type!");
 }
 
+bool Device::hasMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties) {
+  VkPhysicalDeviceMemoryProperties memProperties;
+  vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memProperties);
+  for (uint32_t i = 0; i < memProperties.memoryTypeCount; i++) {
+    if ((typeFilter & (1 << i)) &&
+        (memProperties.memoryTypes[i].propertyFlags & properties) == properties) {
+      return true;
+    }
+  }
+  return false;
+}
+
 void Device::createBuffer(
     VkDeviceSize size,
     VkBufferUsageFlags usage,
     VkMemoryPropertyFlags properties,
     VkBuffer &buffer,
-    VkDeviceMemory &bufferMemory) {
+    Allocation &bufferMemory) {
   VkBufferCreateInfo bufferInfo{};
   bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
   bufferInfo.size = size;
@@ -421,16 +630,16 @@ void Device::createBuffer(
   VkMemoryRequirements memRequirements;
   vkGetBufferMemoryRequirements(device_, buffer, &memRequirements);
 
-  VkMemoryAllocateInfo allocInfo{};
-  allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-  allocInfo.allocationSize = memRequirements.size;
-  allocInfo.memoryTypeIndex = findMemoryType(memRequirements.memoryTypeBits, properties);
-
-  if (vkAllocateMemory(device_, &allocInfo, nullptr, &bufferMemory) != VK_SUCCESS) {
-    throw std::runtime_error("failed to allocate vertex buffer memory!");
+  bufferMemory = allocator_->allocate(memRequirements, properties, ResourceKind::Linear);
+  if (vkBindBufferMemory(device_, buffer, bufferMemory.memory, bufferMemory.offset) != VK_SUCCESS) {
+    throw std::runtime_error("failed to bind buffer memory!");
   }
+}
 
-  vkBindBufferMemory(device_, buffer, bufferMemory, 0);
+void Device::destroyBuffer(VkBuffer buffer, Allocation &bufferMemory) {
+  vkDestroyBuffer(device_, buffer, nullptr);
+  allocator_->free(bufferMemory);
+  bufferMemory = Allocation{};
 }
 
 VkCommandBuffer Device::beginSingleTimeCommands() {
@@ -459,8 +668,11 @@ void Device::endSingleTimeCommands(VkCommandBuffer commandBuffer) {
   submitInfo.commandBufferCount = 1;
   submitInfo.pCommandBuffers = &commandBuffer;
 
-  vkQueueSubmit(graphicsQueue_, 1, &submitInfo, VK_NULL_HANDLE);
-  vkQueueWaitIdle(graphicsQueue_);
+  {
+    std::lock_guard<std::mutex> lock{queueMutex_};
+    vkQueueSubmit(graphicsQueue_, 1, &submitInfo, VK_NULL_HANDLE);
+    vkQueueWaitIdle(graphicsQueue_);
+  }
 
   vkFreeCommandBuffers(device_, commandPool, 1, &commandBuffer);
 }
@@ -508,7 +720,7 @@ void Device::createImageWithInfo(
     const VkImageCreateInfo &imageInfo,
     VkMemoryPropertyFlags properties,
     VkImage &image,
-    VkDeviceMemory &imageMemory) {
+    Allocation &imageMemory) {
   if (vkCreateImage(device_, &imageInfo, nullptr, &image) != VK_SUCCESS) {
     throw std::runtime_error("failed to create image!");
   }
@@ -516,16 +728,21 @@ void Device::createImageWithInfo(
   VkMemoryRequirements memRequirements;
   vkGetImageMemoryRequirements(device_, image, &memRequirements);
 
-  VkMemoryAllocateInfo allocInfo{};
-  allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-  allocInfo.allocationSize = memRequirements.size;
-  allocInfo.memoryTypeIndex = findMemoryType(memRequirements.memoryTypeBits, properties);
-
-  if (vkAllocateMemory(device_, &allocInfo, nullptr, &imageMemory) != VK_SUCCESS) {
-    throw std::runtime_error("failed to allocate image memory!");
+  // Lazily allocated memory only exists on tiled GPUs, elsewhere transient attachments get ordinary memory
+  if ((properties & VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT) &&
+      !hasMemoryType(memRequirements.memoryTypeBits, properties)) {
+    properties &= ~VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT;
   }
-
-  if (vkBindImageMemory(device_, image, imageMemory, 0) != VK_SUCCESS) {
+  ResourceKind kind =
+      imageInfo.tiling == VK_IMAGE_TILING_LINEAR ? ResourceKind::Linear : ResourceKind::Optimal;
+  imageMemory = allocator_->allocate(memRequirements, properties, kind);
+  if (vkBindImageMemory(device_, image, imageMemory.memory, imageMemory.offset) != VK_SUCCESS) {
     throw std::runtime_error("failed to bind image memory!");
   }
 }
+
+void Device::destroyImage(VkImage image, Allocation &imageMemory) {
+  vkDestroyImage(device_, image, nullptr);
+  allocator_->free(imageMemory);
+  imageMemory = Allocation{};
+}
@@ -0,0 +1,91 @@
+#include "layout_cache.hpp"
+#include "hash.hpp"
+
+// std
+#include <stdexcept>
+
+LayoutCache::LayoutCache(Device &device) : device{device} {}
+
+LayoutCache::~LayoutCache() {
+  for (auto &layout : pipelineLayouts) {
+    vkDestroyPipelineLayout(device.device(), layout.second, nullptr);
+  }
+  for (auto &layout : setLayouts) {
+    vkDestroyDescriptorSetLayout(device.device(), layout.second, nullptr);
+  }
+}
+
+VkDescriptorSetLayout LayoutCache::getSetLayout(const std::vector<VkDescriptorSetLayoutBinding> &bindings) {
+  uint64_t key = HASH_SEED;
+  for (const auto &binding : bindings) {
+    hashCombine(key, binding.binding);
+    hashCombine(key, binding.descriptorType);
+    hashCombine(key, binding.descriptorCount);
+    hashCombine(key, binding.stageFlags);
+  }
+  hashCombine(key, bindings.size());
+
+  auto found = setLayouts.find(key);
+  if (found != setLayouts.end()) {
+    return found->second;
+  }
+
+  VkDescriptorSetLayoutCreateInfo layoutInfo{};
+  layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+  layoutInfo.bindingCount = static_cast<uint32_t>(bindings.size());
+  layoutInfo.pBindings = bindings.data();
+
+  VkDescriptorSetLayout setLayout;
+  if (vkCreateDescriptorSetLayout(device.device(), &layoutInfo, nullptr, &setLayout) != VK_SUCCESS) {
+    throw std::runtime_error("failed to create descriptor set layout!");
+  }
+  setLayouts[key] = setLayout;
+  return setLayout;
+}
+
+VkPipelineLayout LayoutCache::getPipelineLayout(const ShaderReflection &reflection) {
+  // Set layouts are deduplicated first, so equal handles mean equal sets
+  std::vector<VkDescriptorSetLayout> sets;
+  if (!reflection.descriptorSets.empty()) {
+    sets.resize(reflection.descriptorSets.rbegin()->first + 1, VK_NULL_HANDLE);
+    for (uint32_t set = 0; set < sets.size(); set++) {
+      auto found = reflection.descriptorSets.find(set);
+      sets[set] = getSetLayout(found != reflection.descriptorSets.end() ? found->second
+                                                                        : std::vector<VkDescriptorSetLayoutBinding>{});
+    }
+  }
+
+  uint64_t key = HASH_SEED;
+  for (VkDescriptorSetLayout set : sets) {
+    hashCombine(key, set);
+  }
+  hashCombine(key, sets.size());
+  for (const auto &range : reflection.pushConstantRanges) {
+    hashCombine(key, range);
+  }
+
+  auto found = pipelineLayouts.find(key);
+  if (found != pipelineLayouts.end()) {
+    return found->second;
+  }
+
+  VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+  pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+  pipelineLayoutInfo.setLayoutCount = static_cast<uint32_t>(sets.size());
+  pipelineLayoutInfo.pSetLayouts = sets.data();
+  pipelineLayoutInfo.pushConstantRangeCount = static_cast<uint32_t>(reflection.pushConstantRanges.size());
+  pipelineLayoutInfo.pPushConstantRanges = reflection.pushConstantRanges.data();
+
+  VkPipelineLayout pipelineLayout;
+  if (vkCreatePipelineLayout(device.device(), &pipelineLayoutInfo, nullptr, &pipelineLayout) != VK_SUCCESS) {
+    throw std::runtime_error("failed to create pipeline layout!");
+  }
+  pipelineLayouts[key] = pipelineLayout;
+  return pipelineLayout;
+}
+
+VkPipelineLayout LayoutCache::getPipelineLayout(const ShaderCode &vertCode, const ShaderCode &fragCode) {
+  ShaderReflection reflection = ShaderReflection::reflect(vertCode);
+  reflection.merge(ShaderReflection::reflect(fragCode));
+  return getPipelineLayout(reflection);
+}
@@ -0,0 +1,144 @@
+#include "mesh.hpp"
+
+// std
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+
+const std::vector<float> &MeshData::attribute(VertexAttribute attribute) const {
+  switch (attribute) {
+    case VertexAttribute::POSITION:
+      return positions;
+    case VertexAttribute::NORMAL:
+      return normals;
+    case VertexAttribute::UV:
+      return uvs;
+    case VertexAttribute::COLOR:
+      return colors;
+  }
+  throw std::runtime_error("unknown vertex attribute");
+}
+
+Mesh::Mesh(
+    Device &device,
+    const VertexLayout &layout,
+    uint32_t vertexCount,
+    uint32_t indexCount,
+    const PositionQuantization &positionQuantization)
+    : device{device},
+      layout{layout},
+      vertexCount{vertexCount},
+      indexCount{indexCount},
+      positionQuantization{positionQuantization} {
+  createBuffers();
+}
+
+Mesh::Mesh(Device &device, TransferManager &transfers, const MeshData &data, const VertexLayout &layout)
+    : Mesh{device,
+           layout,
+           data.vertexCount(),
+           static_cast<uint32_t>(data.indices.size()),
+           layout.quantizePositions(data.positions.data(), data.vertexCount())} {
+  uploadVertices(transfers, data);
+  uploadIndices(transfers, data.indices.data());
+}
+
+Mesh::~Mesh() {
+  for (size_t i = 0; i < vertexBuffers.size(); i++) {
+    device.destroyBuffer(vertexBuffers[i], vertexMemory[i]);
+  }
+  if (indexBuffer != VK_NULL_HANDLE) {
+    device.destroyBuffer(indexBuffer, indexMemory);
+  }
+}
+
+void Mesh::createBuffers() {
+  if (vertexCount == 0) {
+    throw std::runtime_error("mesh has no vertices");
+  }
+  vertexBuffers.resize(layout.streamCount());
+  vertexMemory.resize(layout.streamCount());
+  for (uint32_t stream = 0; stream < layout.streamCount(); stream++) {
+    device.createBuffer(
+        static_cast<VkDeviceSize>(layout.stride(stream)) * vertexCount,
+        VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+        VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+        vertexBuffers[stream],
+        vertexMemory[stream]);
+  }
+
+  if (indexCount == 0) {
+    return;
+  }
+  // Halves index fetch for most meshes, 0xFFFF is left out as it restarts strips
+  indexType = vertexCount <= std::numeric_limits<uint16_t>::max() ? VK_INDEX_TYPE_UINT16 : VK_INDEX_TYPE_UINT32;
+  device.createBuffer(
+      static_cast<VkDeviceSize>(indexCount) * indexSize(),
+      VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+      VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+      indexBuffer,
+      indexMemory);
+}
+
+void Mesh::uploadVertices(TransferManager &transfers, const MeshData &data) {
+  for (const VertexElement &element : layout.getElements()) {
+    if (data.attribute(element.attribute).size() != vertexCount * componentCount(element.attribute)) {
+      throw std::runtime_error("mesh data does not match its vertex layout");
+    }
+  }
+
+  // Packed straight into staging memory, one stream at a time
+  for (uint32_t stream = 0; stream < layout.streamCount(); stream++) {
+    uint32_t stride = layout.stride(stream);
+    char *packed = static_cast<char *>(
+        transfers.reserveBuffer(vertexBuffers[stream], 0, static_cast<VkDeviceSize>(stride) * vertexCount));
+    for (const VertexElement &element : layout.getElements()) {
+      if (element.stream != stream) {
+        continue;
+      }
+      packAttributes(
+          element, data.attribute(element.attribute).data(), vertexCount, stride, positionQuantization,
+          packed + element.offset);
+    }
+  }
+}
+
+void Mesh::uploadIndices(TransferManager &transfers, const uint32_t *indices) {
+  if (indexCount == 0) {
+    return;
+  }
+  void *staged = transfers.reserveBuffer(indexBuffer, 0, static_cast<VkDeviceSize>(indexCount) * indexSize());
+  if (indexType == VK_INDEX_TYPE_UINT32) {
+    std::memcpy(staged, indices, indexCount * sizeof(uint32_t));
+    return;
+  }
+  uint16_t *shortIndices = static_cast<uint16_t *>(staged);
+  for (uint32_t i = 0; i < indexCount; i++) {
+    shortIndices[i] = static_cast<uint16_t>(indices[i]);
+  }
+}
+
+void Mesh::bind(VkCommandBuffer commandBuffer) {
+  std::vector<VkDeviceSize> offsets(vertexBuffers.size(), 0);
+  vkCmdBindVertexBuffers(
+      commandBuffer, 0, static_cast<uint32_t>(vertexBuffers.size()), vertexBuffers.data(), offsets.data());
+  if (indexBuffer != VK_NULL_HANDLE) {
+    vkCmdBindIndexBuffer(commandBuffer, indexBuffer, 0, indexType);
+  }
+}
+
+void Mesh::bindPositions(VkCommandBuffer commandBuffer) {
+  VkDeviceSize offset = 0;
+  vkCmdBindVertexBuffers(commandBuffer, 0, 1, vertexBuffers.data(), &offset);
+  if (indexBuffer != VK_NULL_HANDLE) {
+    vkCmdBindIndexBuffer(commandBuffer, indexBuffer, 0, indexType);
+  }
+}
+
+void Mesh::draw(VkCommandBuffer commandBuffer, uint32_t instanceCount) {
+  if (indexBuffer != VK_NULL_HANDLE) {
+    vkCmdDrawIndexed(commandBuffer, indexCount, instanceCount, 0, 0, 0);
+  } else {
+    vkCmdDraw(commandBuffer, vertexCount, instanceCount, 0, 0);
+  }
+}
@@ -0,0 +1,387 @@
+#include "mesh_loader.hpp"
+
+// std
+#include <algorithm>
+#include <charconv>
+#include <chrono>
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+#include <thread>
+#include <utility>
+#include <vector>
+
+// posix
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+
+// Files smaller than this per thread are not worth splitting further
+constexpr size_t MIN_CHUNK_BYTES = 1024 * 1024;
+constexpr int32_t MISSING = std::numeric_limits<int32_t>::min();
+constexpr uint32_t EMPTY_SLOT = std::numeric_limits<uint32_t>::max();
+// Vertices gathered per packAttributes call, small enough to stay in L1
+constexpr size_t PACK_CHUNK = 256;
+
+enum CornerField : uint8_t { POSITION_FIELD = 1, UV_FIELD = 2, NORMAL_FIELD = 4 };
+
+// 0 based indices into the whole file's positions, uvs and normals, MISSING when the face has none
+struct Corner {
+  int32_t position;
+  int32_t uv;
+  int32_t normal;
+
+  bool operator==(const Corner &other) const {
+    return position == other.position && uv == other.uv && normal == other.normal;
+  }
+};
+
+// A corner with negative OBJ indices, which count back from the vertices before it in the file
+struct RelativeCorner {
+  uint32_t corner;
+  uint8_t fields;
+};
+
+struct Chunk {
+  std::vector<float> positions;
+  std::vector<float> uvs;
+  std::vector<float> normals;
+  // Three per triangle, relative indices are resolved within the chunk until its offsets are known
+  std::vector<Corner> corners;
+  std::vector<RelativeCorner> relative;
+  std::string error;
+};
+
+class MappedFile {
+ public:
+  explicit MappedFile(const std::string &path) {
+    int file = open(path.c_str(), O_RDONLY);
+    if (file < 0) {
+      throw std::runtime_error("failed to open mesh: " + path);
+    }
+    struct stat info;
+    if (fstat(file, &info) != 0 || info.st_size == 0) {
+      close(file);
+      throw std::runtime_error("mesh file is empty: " + path);
+    }
+    size_ = static_cast<size_t>(info.st_size);
+    mapping = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, file, 0);
+    close(file);
+    if (mapping == MAP_FAILED) {
+      throw std::runtime_error("failed to map mesh: " + path);
+    }
+    // Chunks are read in parallel from different offsets, ask for the whole file up front
+    madvise(mapping, size_, MADV_WILLNEED);
+  }
+  ~MappedFile() { munmap(mapping, size_); }
+
+  MappedFile(const MappedFile &) = delete;
+  MappedFile &operator=(const MappedFile &) = delete;
+
+  const char *data() const { return static_cast<const char *>(mapping); }
+  size_t size() const { return size_; }
+
+ private:
+  void *mapping;
+  size_t size_;
+};
+
+bool isSpace(char c) { return c == ' ' || c == '\t' || c == '\r'; }
+
+const char *skipSpaces(const char *p, const char *end) {
+  while (p < end && isSpace(*p)) {
+    p++;
+  }
+  return p;
+}
+
+// from_chars never looks at the locale, unlike strtof and streams
+void readFloats(const char *p, const char *end, int count, std::vector<float> &out) {
+  for (int i = 0; i < count; i++) {
+    p = skipSpaces(p, end);
+    if (p < end && *p == '+') {
+      p++;
+    }
+    float value;
+    auto result = std::from_chars(p, end, value);
+    if (result.ec != std::errc{}) {
+      throw std::runtime_error("malformed number in OBJ vertex data");
+    }
+    out.push_back(value);
+    p = result.ptr;
+  }
+}
+
+// An OBJ index made 0 based, counting back from count when negative
+bool readIndex(const char *&p, const char *end, uint32_t count, int32_t &index, uint8_t field, uint8_t &relative) {
+  int32_t value;
+  auto result = std::from_chars(p, end, value);
+  if (result.ec != std::errc{} || value == 0) {
+    return false;
+  }
+  p = result.ptr;
+  if (value > 0) {
+    index = value - 1;
+  } else {
+    index = static_cast<int32_t>(count) + value;
+    relative |= field;
+  }
+  return true;
+}
+
+void parseChunk(const char *begin, const char *end, Chunk &chunk) {
+  std::vector<std::pair<Corner, uint8_t>> polygon;
+  for (const char *line = begin; line < end;) {
+    const char *lineEnd = static_cast<const char *>(std::memchr(line, '\n', end - line));
+    if (lineEnd == nullptr) {
+      lineEnd = end;
+    }
+    const char *p = skipSpaces(line, lineEnd);
+    line = lineEnd + 1;
+    if (lineEnd - p < 2) {
+      continue;
+    }
+
+    if (p[0] == 'v' && isSpace(p[1])) {
+      readFloats(p + 1, lineEnd, 3, chunk.positions);
+    } else if (p[0] == 'v' && p[1] == 't') {
+      readFloats(p + 2, lineEnd, 2, chunk.uvs);
+      // OBJ puts v = 0 at the bottom of the image, Vulkan at the top
+      chunk.uvs.back() = 1.0f - chunk.uvs.back();
+    } else if (p[0] == 'v' && p[1] == 'n') {
+      readFloats(p + 2, lineEnd, 3, chunk.normals);
+    } else if (p[0] == 'f' && isSpace(p[1])) {
+      uint32_t positionCount = static_cast<uint32_t>(chunk.positions.size() / 3);
+      uint32_t uvCount = static_cast<uint32_t>(chunk.uvs.size() / 2);
+      uint32_t normalCount = static_cast<uint32_t>(chunk.normals.size() / 3);
+      polygon.clear();
+      for (p = skipSpaces(p + 1, lineEnd); p < lineEnd; p = skipSpaces(p, lineEnd)) {
+        // p, p/t, p//n or p/t/n
+        Corner corner{MISSING, MISSING, MISSING};
+        uint8_t relative = 0;
+        bool valid = readIndex(p, lineEnd, positionCount, corner.position, POSITION_FIELD, relative);
+        if (valid && p < lineEnd && *p == '/') {
+          p++;
+          if (p < lineEnd && *p != '/') {
+            valid = readIndex(p, lineEnd, uvCount, corner.uv, UV_FIELD, relative);
+          }
+          if (valid && p < lineEnd && *p == '/') {
+            p++;
+            valid = readIndex(p, lineEnd, normalCount, corner.normal, NORMAL_FIELD, relative);
+          }
+        }
+        if (!valid || (p < lineEnd && !isSpace(*p))) {
+          throw std::runtime_error("malformed OBJ face");
+        }
+        polygon.emplace_back(corner, relative);
+      }
+      if (polygon.size() < 3) {
+        throw std::runtime_error("OBJ face with fewer than three corners");
+      }
+      for (size_t i = 2; i < polygon.size(); i++) {
+        for (size_t index : {size_t{0}, i - 1, i}) {
+          if (polygon[index].second != 0) {
+            chunk.relative.push_back({static_cast<uint32_t>(chunk.corners.size()), polygon[index].second});
+          }
+          chunk.corners.push_back(polygon[index].first);
+        }
+      }
+    }
+  }
+}
+
+uint64_t hashCorner(const Corner &corner) {
+  uint64_t hash = static_cast<uint32_t>(corner.position);
+  hash = hash * 0x9E3779B97F4A7C15ULL ^ static_cast<uint32_t>(corner.uv);
+  hash = hash * 0x9E3779B97F4A7C15ULL ^ static_cast<uint32_t>(corner.normal);
+  return hash * 0x9E3779B97F4A7C15ULL;
+}
+
+double millisecondsSince(std::chrono::high_resolution_clock::time_point start) {
+  return std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+}
+
+}  // namespace
+
+MeshLoader::MeshLoader(unsigned threadCount, bool optimize)
+    : threadCount{threadCount != 0 ? threadCount : std::max(1u, std::thread::hardware_concurrency())},
+      optimize{optimize} {}
+
+std::unique_ptr<Mesh> MeshLoader::loadObj(
+    Device &device,
+    TransferManager &transfers,
+    const std::string &path,
+    const VertexLayout &layout,
+    MeshLoadStats *stats) {
+  bool needsUv = false;
+  bool needsNormal = false;
+  for (const VertexElement &element : layout.getElements()) {
+    needsUv |= element.attribute == VertexAttribute::UV;
+    needsNormal |= element.attribute == VertexAttribute::NORMAL;
+    if (element.attribute == VertexAttribute::COLOR) {
+      throw std::runtime_error("OBJ meshes have no vertex colors: " + path);
+    }
+  }
+
+  auto start = std::chrono::high_resolution_clock::now();
+  MappedFile file{path};
+  const char *data = file.data();
+  const char *end = data + file.size();
+
+  // Chunks start after a line break, so no line is split between two of them
+  size_t chunkCount = std::max<size_t>(1, std::min<size_t>(threadCount, file.size() / MIN_CHUNK_BYTES));
+  std::vector<Chunk> chunks(chunkCount);
+  std::vector<const char *> bounds{data};
+  for (size_t i = 1; i < chunkCount; i++) {
+    const char *bound = std::max(bounds.back(), data + file.size() * i / chunkCount);
+    const char *lineEnd = static_cast<const char *>(std::memchr(bound, '\n', end - bound));
+    bounds.push_back(lineEnd != nullptr ? lineEnd + 1 : end);
+  }
+  bounds.push_back(end);
+
+  auto parse = [&](size_t i) {
+    try {
+      parseChunk(bounds[i], bounds[i + 1], chunks[i]);
+    } catch (const std::exception &e) {
+      chunks[i].error = e.what();
+    }
+  };
+  std::vector<std::thread> workers;
+  for (size_t i = 1; i < chunkCount; i++) {
+    workers.emplace_back(parse, i);
+  }
+  parse(0);
+  for (auto &worker : workers) {
+    worker.join();
+  }
+  for (const Chunk &chunk : chunks) {
+    if (!chunk.error.empty()) {
+      throw std::runtime_error(chunk.error + ": " + path);
+    }
+  }
+  double parseMs = millisecondsSince(start);
+
+  // Join the chunks' vertex data, offsetting relative indices by what came before each chunk
+  start = std::chrono::high_resolution_clock::now();
+  std::vector<float> positions;
+  std::vector<float> uvs;
+  std::vector<float> normals;
+  size_t cornerCount = 0;
+  for (Chunk &chunk : chunks) {
+    int32_t positionOffset = static_cast<int32_t>(positions.size() / 3);
+    int32_t uvOffset = static_cast<int32_t>(uvs.size() / 2);
+    int32_t normalOffset = static_cast<int32_t>(normals.size() / 3);
+    for (const RelativeCorner &relative : chunk.relative) {
+      Corner &corner = chunk.corners[relative.corner];
+      corner.position += relative.fields & POSITION_FIELD ? positionOffset : 0;
+      corner.uv += relative.fields & UV_FIELD ? uvOffset : 0;
+      corner.normal += relative.fields & NORMAL_FIELD ? normalOffset : 0;
+    }
+    positions.insert(positions.end(), chunk.positions.begin(), chunk.positions.end());
+    uvs.insert(uvs.end(), chunk.uvs.begin(), chunk.uvs.end());
+    normals.insert(normals.end(), chunk.normals.begin(), chunk.normals.end());
+    cornerCount += chunk.corners.size();
+  }
+  if (cornerCount == 0 || cornerCount > std::numeric_limits<uint32_t>::max()) {
+    throw std::runtime_error("OBJ file has no faces or too many: " + path);
+  }
+
+  // Corners equal in everything the layout reads become one vertex. Open addressing over a power of
+  // two table at most half full, slots hold indices into uniqueCorners
+  auto inRange = [](int32_t index, size_t count) { return index >= 0 && static_cast<size_t>(index) < count; };
+  size_t tableSize = 1;
+  while (tableSize < cornerCount * 2) {
+    tableSize *= 2;
+  }
+  std::vector<uint32_t> table(tableSize, EMPTY_SLOT);
+  std::vector<Corner> uniqueCorners;
+  std::vector<uint32_t> indices;
+  indices.reserve(cornerCount);
+  for (const Chunk &chunk : chunks) {
+    for (Corner corner : chunk.corners) {
+      corner.uv = needsUv ? corner.uv : MISSING;
+      corner.normal = needsNormal ? corner.normal : MISSING;
+      if (!inRange(corner.position, positions.size() / 3) || (needsUv && !inRange(corner.uv, uvs.size() / 2)) ||
+          (needsNormal && !inRange(corner.normal, normals.size() / 3))) {
+        throw std::runtime_error("OBJ face refers to a vertex attribute the file does not have: " + path);
+      }
+      size_t slot = hashCorner(corner) & (tableSize - 1);
+      while (table[slot] != EMPTY_SLOT && !(uniqueCorners[table[slot]] == corner)) {
+        slot = (slot + 1) & (tableSize - 1);
+      }
+      if (table[slot] == EMPTY_SLOT) {
+        table[slot] = static_cast<uint32_t>(uniqueCorners.size());
+        uniqueCorners.push_back(corner);
+      }
+      indices.push_back(table[slot]);
+    }
+  }
+  double dedupMs = millisecondsSince(start);
+
+  // Renumbering the vertices reorders uniqueCorners, which packing walks in order
+  start = std::chrono::high_resolution_clock::now();
+  uint32_t vertexCount = static_cast<uint32_t>(uniqueCorners.size());
+  if (optimize) {
+    std::vector<float> cornerPositions(uniqueCorners.size() * 3);
+    for (size_t vertex = 0; vertex < uniqueCorners.size(); vertex++) {
+      std::copy_n(&positions[uniqueCorners[vertex].position * 3], 3, &cornerPositions[vertex * 3]);
+    }
+    optimizeVertexCache(indices.data(), indices.size(), vertexCount);
+    optimizeOverdraw(indices.data(), indices.size(), cornerPositions.data(), vertexCount);
+    std::vector<uint32_t> remap = optimizeVertexFetch(indices.data(), indices.size(), vertexCount);
+    std::vector<Corner> reordered(uniqueCorners.size());
+    for (uint32_t vertex = 0; vertex < vertexCount; vertex++) {
+      reordered[remap[vertex]] = uniqueCorners[vertex];
+    }
+    uniqueCorners = std::move(reordered);
+  }
+  double optimizeMs = optimize ? millisecondsSince(start) : 0.0;
+
+  // Unique vertices packed by the layout straight into the mesh's staging memory, quantized within
+  // the bounds of every position in the file when the layout says so
+  start = std::chrono::high_resolution_clock::now();
+  PositionQuantization quantization = layout.quantizePositions(positions.data(), positions.size() / 3);
+  auto mesh = std::make_unique<Mesh>(
+      device, layout, vertexCount, static_cast<uint32_t>(indices.size()), quantization);
+  // Corners only point at their attributes, so each is gathered a chunk at a time for packAttributes
+  std::vector<float> gathered(PACK_CHUNK * 3);
+  for (uint32_t stream = 0; stream < layout.streamCount(); stream++) {
+    uint32_t stride = layout.stride(stream);
+    char *packed = static_cast<char *>(transfers.reserveBuffer(
+        mesh->getVertexBuffer(stream), 0, static_cast<VkDeviceSize>(stride) * uniqueCorners.size()));
+    for (const VertexElement &element : layout.getElements()) {
+      if (element.stream != stream) {
+        continue;
+      }
+      uint32_t components = componentCount(element.attribute);
+      for (size_t first = 0; first < uniqueCorners.size(); first += PACK_CHUNK) {
+        size_t chunk = std::min(PACK_CHUNK, uniqueCorners.size() - first);
+        for (size_t i = 0; i < chunk; i++) {
+          const Corner &corner = uniqueCorners[first + i];
+          const float *source = element.attribute == VertexAttribute::POSITION ? &positions[corner.position * 3]
+                                : element.attribute == VertexAttribute::UV     ? &uvs[corner.uv * 2]
+                                                                                : &normals[corner.normal * 3];
+          std::copy(source, source + components, gathered.begin() + i * components);
+        }
+        packAttributes(element, gathered.data(), chunk, stride, quantization, packed + first * stride + element.offset);
+      }
+    }
+  }
+  mesh->uploadIndices(transfers, indices.data());
+  double packMs = millisecondsSince(start);
+
+  if (stats != nullptr) {
+    stats->fileBytes = file.size();
+    stats->triangles = static_cast<uint32_t>(indices.size() / 3);
+    stats->vertices = vertexCount;
+    stats->parseMs = parseMs;
+    stats->dedupMs = dedupMs;
+    stats->optimizeMs = optimizeMs;
+    stats->packMs = packMs;
+    stats->vertexCache = analyzeVertexCache(indices.data(), indices.size(), vertexCount);
+  }
+  return mesh;
+}
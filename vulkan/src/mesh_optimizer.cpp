@@ -0,0 +1,331 @@
+#include "mesh_optimizer.hpp"
+
+// std
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+#include <utility>
+
+namespace {
+
+// Cache the vertex scores model, larger than the hardware's so the order does not depend on its size
+constexpr uint32_t SCORE_CACHE_SIZE = 32;
+// Vertices in the last triangle score lower than the rest of the cache, its edges are already used
+constexpr float LAST_TRIANGLE_SCORE = 0.75f;
+constexpr float CACHE_DECAY_POWER = 1.5f;
+// Vertices with few triangles left are finished first so they leave the cache for good
+constexpr float VALENCE_BOOST_SCALE = 2.0f;
+constexpr float VALENCE_BOOST_POWER = 0.5f;
+constexpr uint32_t NO_TRIANGLE = ~0u;
+// Used by the overdraw pass to find where the cache order starts over
+constexpr uint32_t OVERDRAW_CACHE_SIZE = 16;
+
+float vertexScore(int cachePosition, uint32_t liveTriangles) {
+  if (liveTriangles == 0) {
+    return -1.0f;
+  }
+  float score = 0.0f;
+  if (cachePosition >= 0 && cachePosition < 3) {
+    score = LAST_TRIANGLE_SCORE;
+  } else if (cachePosition >= 3) {
+    float scale = 1.0f / (SCORE_CACHE_SIZE - 3);
+    score = std::pow(1.0f - (cachePosition - 3) * scale, CACHE_DECAY_POWER);
+  }
+  return score + VALENCE_BOOST_SCALE * std::pow(static_cast<float>(liveTriangles), -VALENCE_BOOST_POWER);
+}
+
+// A FIFO cache kept as the time each vertex last went in, so flushing it is a jump in time
+class CacheSimulation {
+ public:
+  CacheSimulation(uint32_t vertexCount, uint32_t cacheSize)
+      : timestamps(vertexCount, 0), time{cacheSize + 1}, cacheSize{cacheSize} {}
+
+  uint32_t misses(const uint32_t *triangle) {
+    uint32_t missed = 0;
+    for (int corner = 0; corner < 3; corner++) {
+      uint32_t vertex = triangle[corner];
+      if (time - timestamps[vertex] > cacheSize) {
+        timestamps[vertex] = time++;
+        missed++;
+      }
+    }
+    return missed;
+  }
+
+  void flush() { time += cacheSize + 1; }
+
+ private:
+  std::vector<uint32_t> timestamps;
+  uint32_t time;
+  uint32_t cacheSize;
+};
+
+}  // namespace
+
+VertexCacheStats analyzeVertexCache(
+    const uint32_t *indices, size_t indexCount, uint32_t vertexCount, uint32_t cacheSize) {
+  VertexCacheStats stats{};
+  CacheSimulation cache{vertexCount, cacheSize};
+  std::vector<bool> used(vertexCount, false);
+  uint32_t usedVertices = 0;
+  for (size_t i = 0; i + 2 < indexCount; i += 3) {
+    stats.transformed += cache.misses(indices + i);
+    for (int corner = 0; corner < 3; corner++) {
+      if (!used[indices[i + corner]]) {
+        used[indices[i + corner]] = true;
+        usedVertices++;
+      }
+    }
+  }
+  if (indexCount >= 3) {
+    stats.acmr = static_cast<float>(stats.transformed) / (indexCount / 3);
+    stats.atvr = static_cast<float>(stats.transformed) / usedVertices;
+  }
+  return stats;
+}
+
+void optimizeVertexCache(uint32_t *indices, size_t indexCount, uint32_t vertexCount) {
+  size_t triangleCount = indexCount / 3;
+  if (triangleCount == 0) {
+    return;
+  }
+
+  // Triangles of each vertex, the first liveTriangles of its range not yet emitted
+  std::vector<uint32_t> liveTriangles(vertexCount, 0);
+  for (size_t i = 0; i < triangleCount * 3; i++) {
+    liveTriangles[indices[i]]++;
+  }
+  std::vector<uint32_t> adjacencyOffsets(vertexCount + 1, 0);
+  for (uint32_t vertex = 0; vertex < vertexCount; vertex++) {
+    adjacencyOffsets[vertex + 1] = adjacencyOffsets[vertex] + liveTriangles[vertex];
+  }
+  std::vector<uint32_t> adjacency(triangleCount * 3);
+  std::vector<uint32_t> filled(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+  for (size_t i = 0; i < triangleCount * 3; i++) {
+    adjacency[filled[indices[i]]++] = static_cast<uint32_t>(i / 3);
+  }
+
+  std::vector<float> vertexScores(vertexCount);
+  for (uint32_t vertex = 0; vertex < vertexCount; vertex++) {
+    vertexScores[vertex] = vertexScore(-1, liveTriangles[vertex]);
+  }
+  uint32_t best = 0;
+  float bestScore = -1.0f;
+  for (size_t triangle = 0; triangle < triangleCount; triangle++) {
+    const uint32_t *corners = indices + triangle * 3;
+    float score = vertexScores[corners[0]] + vertexScores[corners[1]] + vertexScores[corners[2]];
+    if (score > bestScore) {
+      bestScore = score;
+      best = static_cast<uint32_t>(triangle);
+    }
+  }
+
+  std::vector<uint32_t> source(indices, indices + triangleCount * 3);
+  std::vector<bool> emitted(triangleCount, false);
+  // Three more entries than the cache so the vertices pushed out get their scores lowered
+  std::vector<uint32_t> cache;
+  std::vector<uint32_t> nextCache;
+  cache.reserve(SCORE_CACHE_SIZE + 3);
+  nextCache.reserve(SCORE_CACHE_SIZE + 3);
+  size_t nextUnemitted = 0;
+  for (size_t output = 0; output < triangleCount; output++) {
+    if (best == NO_TRIANGLE) {
+      // Nothing in the cache has triangles left, start over at the first one not drawn
+      while (emitted[nextUnemitted]) {
+        nextUnemitted++;
+      }
+      best = static_cast<uint32_t>(nextUnemitted);
+    }
+    const uint32_t *corners = &source[best * 3];
+    std::copy(corners, corners + 3, indices + output * 3);
+    emitted[best] = true;
+
+    nextCache.clear();
+    for (int corner = 0; corner < 3; corner++) {
+      uint32_t vertex = corners[corner];
+      uint32_t *begin = &adjacency[adjacencyOffsets[vertex]];
+      uint32_t *live = std::find(begin, begin + liveTriangles[vertex], best);
+      std::swap(*live, begin[--liveTriangles[vertex]]);
+      if (std::find(nextCache.begin(), nextCache.end(), vertex) == nextCache.end()) {
+        nextCache.push_back(vertex);
+      }
+    }
+    size_t triangleVertices = nextCache.size();
+    for (uint32_t vertex : cache) {
+      if (nextCache.size() == SCORE_CACHE_SIZE + 3) {
+        break;
+      }
+      if (std::find(nextCache.begin(), nextCache.begin() + triangleVertices, vertex) ==
+          nextCache.begin() + triangleVertices) {
+        nextCache.push_back(vertex);
+      }
+    }
+
+    for (size_t position = 0; position < nextCache.size(); position++) {
+      uint32_t vertex = nextCache[position];
+      int cachePosition = position < SCORE_CACHE_SIZE ? static_cast<int>(position) : -1;
+      vertexScores[vertex] = vertexScore(cachePosition, liveTriangles[vertex]);
+    }
+    // Only triangles touching the cache changed score, the best of them goes next
+    best = NO_TRIANGLE;
+    bestScore = -1.0f;
+    for (uint32_t vertex : nextCache) {
+      const uint32_t *begin = &adjacency[adjacencyOffsets[vertex]];
+      for (const uint32_t *triangle = begin; triangle < begin + liveTriangles[vertex]; triangle++) {
+        const uint32_t *triangleCorners = &source[*triangle * 3];
+        float score = vertexScores[triangleCorners[0]] + vertexScores[triangleCorners[1]] +
+                      vertexScores[triangleCorners[2]];
+        if (score > bestScore) {
+          bestScore = score;
+          best = *triangle;
+        }
+      }
+    }
+
+    nextCache.resize(std::min<size_t>(nextCache.size(), SCORE_CACHE_SIZE));
+    std::swap(cache, nextCache);
+  }
+}
+
+void optimizeOverdraw(
+    uint32_t *indices, size_t indexCount, const float *positions, uint32_t vertexCount, float threshold) {
+  size_t triangleCount = indexCount / 3;
+  if (triangleCount == 0) {
+    return;
+  }
+
+  // Hard boundaries are where the cache order starts over, a triangle with no vertex in the cache
+  std::vector<uint32_t> hardBoundaries;
+  CacheSimulation cache{vertexCount, OVERDRAW_CACHE_SIZE};
+  for (size_t triangle = 0; triangle < triangleCount; triangle++) {
+    if (cache.misses(indices + triangle * 3) == 3 || triangle == 0) {
+      hardBoundaries.push_back(static_cast<uint32_t>(triangle));
+    }
+  }
+  hardBoundaries.push_back(static_cast<uint32_t>(triangleCount));
+
+  // Soft boundaries split a run wherever starting over with a cold cache costs little more than the
+  // run as a whole, so clusters are small enough to sort without undoing the cache pass
+  std::vector<uint32_t> clusterStarts;
+  for (size_t run = 0; run + 1 < hardBoundaries.size(); run++) {
+    uint32_t start = hardBoundaries[run];
+    uint32_t end = hardBoundaries[run + 1];
+    cache.flush();
+    uint32_t runMisses = 0;
+    for (uint32_t triangle = start; triangle < end; triangle++) {
+      runMisses += cache.misses(indices + triangle * 3);
+    }
+    float limit = threshold * runMisses / (end - start);
+
+    clusterStarts.push_back(start);
+    cache.flush();
+    uint32_t clusterMisses = 0;
+    uint32_t clusterTriangles = 0;
+    for (uint32_t triangle = start; triangle + 1 < end; triangle++) {
+      clusterMisses += cache.misses(indices + triangle * 3);
+      clusterTriangles++;
+      if (clusterMisses <= limit * clusterTriangles) {
+        clusterStarts.push_back(triangle + 1);
+        cache.flush();
+        clusterMisses = 0;
+        clusterTriangles = 0;
+      }
+    }
+  }
+  clusterStarts.push_back(static_cast<uint32_t>(triangleCount));
+
+  float meshCenter[3] = {0.0f, 0.0f, 0.0f};
+  for (uint32_t vertex = 0; vertex < vertexCount; vertex++) {
+    for (int axis = 0; axis < 3; axis++) {
+      meshCenter[axis] += positions[vertex * 3 + axis] / vertexCount;
+    }
+  }
+
+  // How far a cluster faces away from the center, by its area weighted centroid and normal
+  size_t clusterCount = clusterStarts.size() - 1;
+  std::vector<float> sortKeys(clusterCount);
+  for (size_t cluster = 0; cluster < clusterCount; cluster++) {
+    float centroid[3] = {0.0f, 0.0f, 0.0f};
+    float normal[3] = {0.0f, 0.0f, 0.0f};
+    float area = 0.0f;
+    for (uint32_t triangle = clusterStarts[cluster]; triangle < clusterStarts[cluster + 1]; triangle++) {
+      const float *a = positions + indices[triangle * 3] * 3;
+      const float *b = positions + indices[triangle * 3 + 1] * 3;
+      const float *c = positions + indices[triangle * 3 + 2] * 3;
+      float ab[3] = {b[0] - a[0], b[1] - a[1], b[2] - a[2]};
+      float ac[3] = {c[0] - a[0], c[1] - a[1], c[2] - a[2]};
+      float cross[3] = {ab[1] * ac[2] - ab[2] * ac[1], ab[2] * ac[0] - ab[0] * ac[2], ab[0] * ac[1] - ab[1] * ac[0]};
+      float triangleArea = std::sqrt(cross[0] * cross[0] + cross[1] * cross[1] + cross[2] * cross[2]);
+      for (int axis = 0; axis < 3; axis++) {
+        centroid[axis] += (a[axis] + b[axis] + c[axis]) / 3.0f * triangleArea;
+        normal[axis] += cross[axis];
+      }
+      area += triangleArea;
+    }
+    float normalLength = std::sqrt(normal[0] * normal[0] + normal[1] * normal[1] + normal[2] * normal[2]);
+    if (area == 0.0f || normalLength == 0.0f) {
+      sortKeys[cluster] = 0.0f;
+      continue;
+    }
+    float key = 0.0f;
+    for (int axis = 0; axis < 3; axis++) {
+      key += (centroid[axis] / area - meshCenter[axis]) * normal[axis] / normalLength;
+    }
+    sortKeys[cluster] = key;
+  }
+
+  std::vector<uint32_t> order(clusterCount);
+  std::iota(order.begin(), order.end(), 0);
+  std::stable_sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) { return sortKeys[a] > sortKeys[b]; });
+
+  std::vector<uint32_t> source(indices, indices + triangleCount * 3);
+  uint32_t *output = indices;
+  for (uint32_t cluster : order) {
+    output = std::copy(
+        source.begin() + clusterStarts[cluster] * 3, source.begin() + clusterStarts[cluster + 1] * 3, output);
+  }
+}
+
+std::vector<uint32_t> optimizeVertexFetch(uint32_t *indices, size_t indexCount, uint32_t vertexCount) {
+  std::vector<uint32_t> remap(vertexCount, NO_VERTEX);
+  uint32_t next = 0;
+  for (size_t i = 0; i < indexCount; i++) {
+    uint32_t &vertex = remap[indices[i]];
+    if (vertex == NO_VERTEX) {
+      vertex = next++;
+    }
+    indices[i] = vertex;
+  }
+  return remap;
+}
+
+void optimizeMesh(MeshData &data) {
+  uint32_t vertexCount = data.vertexCount();
+  size_t indexCount = data.indices.size();
+  optimizeVertexCache(data.indices.data(), indexCount, vertexCount);
+  optimizeOverdraw(data.indices.data(), indexCount, data.positions.data(), vertexCount);
+  std::vector<uint32_t> remap = optimizeVertexFetch(data.indices.data(), indexCount, vertexCount);
+
+  std::pair<VertexAttribute, std::vector<float> *> attributes[] = {
+      {VertexAttribute::POSITION, &data.positions},
+      {VertexAttribute::NORMAL, &data.normals},
+      {VertexAttribute::UV, &data.uvs},
+      {VertexAttribute::COLOR, &data.colors}};
+  for (auto &[attribute, array] : attributes) {
+    std::vector<float> &values = *array;
+    if (values.empty()) {
+      continue;
+    }
+    uint32_t components = componentCount(attribute);
+    std::vector<float> reordered(values.size());
+    size_t usedVertices = 0;
+    for (uint32_t vertex = 0; vertex < vertexCount; vertex++) {
+      if (remap[vertex] != NO_VERTEX) {
+        std::copy_n(&values[vertex * components], components, &reordered[remap[vertex] * components]);
+        usedVertices++;
+      }
+    }
+    reordered.resize(usedVertices * components);
+    values = std::move(reordered);
+  }
+}
@@ -1,32 +1,43 @@
 #include "pipeline.hpp"
 
-std::vector<char> Pipeline::readFile(const std::string& filename){
-  std::ifstream file(filename, std::ios::ate | std::ios::binary);
-  if(!file.is_open()){
-    throw std::runtime_error("Failed to open file: " + filename);
-  }
-
-  size_t fileSize = static_cast<size_t>(file.tellg());
-  std::vector<char> buffer(fileSize);
+#include <algorithm>
 
-  file.seekg(0);
-  file.read(buffer.data(), fileSize);
-  file.close();
-
-  return buffer;
-};
-
-void Pipeline::createGraphicsPipeline(const std::string& vertFile, const std::string& fragFile, 
+void Pipeline::createGraphicsPipeline(const ShaderCode& vertCode, const ShaderCode& fragCode, 
                                         const PipelineConfigInfo& config) {
 
   assert(config.pipelineLayout != VK_NULL_HANDLE &&
         "Cannot create graphics pipeline:: no pipelineLayout provided in config");
   assert(config.renderPass != VK_NULL_HANDLE &&
         "Cannot create graphics pipeline:: no renderPass provided in config");        
-  std::vector<char> vertCode = readFile(vertFile);
-  std::vector<char> fragCode = readFile(fragFile);
-//   std::cout << "Vertex Shader Code Size: " << vertCode.size() << std::endl;
-//   std::cout << "Fragment Shader Code Size: " << fragCode.size() << std::endl;
+  // The vertex layout's attributes at the locations the shader reads, or whatever it declares
+  // read from one interleaved binding when there is no layout. Resolved before the shader
+  // modules exist, so a layout that does not match leaves nothing to destroy
+  ShaderReflection vertReflection = ShaderReflection::reflect(vertCode);
+  std::vector<VkVertexInputBindingDescription> bindings;
+  std::vector<VkVertexInputAttributeDescription> attributes;
+  if(config.attributeDescriptions.empty()){
+    attributes = vertReflection.vertexAttributes;
+    if(!attributes.empty()){
+      bindings.push_back({0, vertReflection.vertexStride, VK_VERTEX_INPUT_RATE_VERTEX});
+    }
+  } else {
+    for(const auto& input : vertReflection.vertexAttributes){
+      auto found = std::find_if(config.attributeDescriptions.begin(), config.attributeDescriptions.end(),
+                                [&input](const auto& attribute){ return attribute.location == input.location; });
+      if(found == config.attributeDescriptions.end()){
+        throw std::runtime_error("failed to create graphics pipeline, vertex layout has nothing for location " +
+                                 std::to_string(input.location));
+      }
+      attributes.push_back(*found);
+    }
+    for(const auto& binding : config.bindingDescriptions){
+      if(std::any_of(attributes.begin(), attributes.end(),
+                     [&binding](const auto& attribute){ return attribute.binding == binding.binding; })){
+        bindings.push_back(binding);
+      }
+    }
+  }
+
   createShaderModule(vertCode, &vertShaderModule);
   createShaderModule(fragCode, &frahShaderModule);
 
@@ -37,28 +48,43 @@ void Pipeline::createGraphicsPipeline(const std::string& vertFile, const std::st
   shaderStages[0].pName = "main";
   shaderStages[0].flags = 0;
   shaderStages[0].pNext = nullptr;
-  shaderStages[0].pSpecializationInfo = nullptr;
+  VkSpecializationInfo vertSpecializationInfo = config.vertSpecialization.info();
+  shaderStages[0].pSpecializationInfo = config.vertSpecialization.empty() ? nullptr : &vertSpecializationInfo;
   shaderStages[1].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
   shaderStages[1].stage = VK_SHADER_STAGE_FRAGMENT_BIT;
   shaderStages[1].module = frahShaderModule;
   shaderStages[1].pName = "main";
   shaderStages[1].flags = 0;
   shaderStages[1].pNext = nullptr;
-  shaderStages[1].pSpecializationInfo = nullptr;
+  VkSpecializationInfo fragSpecializationInfo = config.fragSpecialization.info();
+  shaderStages[1].pSpecializationInfo = config.fragSpecialization.empty() ? nullptr : &fragSpecializationInfo;
 
   VkPipelineVertexInputStateCreateInfo vertexInputInfo{};
   vertexInputInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
-  vertexInputInfo.vertexAttributeDescriptionCount = 0;
-  vertexInputInfo.vertexBindingDescriptionCount = 0;
-  vertexInputInfo.pVertexAttributeDescriptions = nullptr;
-  vertexInputInfo.pVertexBindingDescriptions = nullptr;
+  vertexInputInfo.vertexAttributeDescriptionCount = static_cast<uint32_t>(attributes.size());
+  vertexInputInfo.vertexBindingDescriptionCount = static_cast<uint32_t>(bindings.size());
+  vertexInputInfo.pVertexAttributeDescriptions = attributes.data();
+  vertexInputInfo.pVertexBindingDescriptions = bindings.data();
   
+  auto isDynamic = [&config](VkDynamicState state){
+    return std::find(config.dynamicStateEnables.begin(), config.dynamicStateEnables.end(), state) !=
+           config.dynamicStateEnables.end();
+  };
   VkPipelineViewportStateCreateInfo viewportInfo{};
   viewportInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
   viewportInfo.viewportCount = 1;
-  viewportInfo.pViewports = &config.viewport;
+  viewportInfo.pViewports = isDynamic(VK_DYNAMIC_STATE_VIEWPORT) ? nullptr : &config.viewport;
   viewportInfo.scissorCount = 1;
-  viewportInfo.pScissors = &config.scissor;
+  viewportInfo.pScissors = isDynamic(VK_DYNAMIC_STATE_SCISSOR) ? nullptr : &config.scissor;
+
+  VkPipelineDynamicStateCreateInfo dynamicStateInfo{};
+  dynamicStateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
+  dynamicStateInfo.dynamicStateCount = static_cast<uint32_t>(config.dynamicStateEnables.size());
+  dynamicStateInfo.pDynamicStates = config.dynamicStateEnables.data();
+
+  // Configs are copied around, so point at this one's attachment rather than wherever it was made
+  VkPipelineColorBlendStateCreateInfo colorBlendInfo = config.colorBlendInfo;
+  colorBlendInfo.pAttachments = &config.colorBlendAttachment;
 
   VkGraphicsPipelineCreateInfo pipelineInfo{};
   pipelineInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
@@ -69,9 +95,9 @@ void Pipeline::createGraphicsPipeline(const std::string& vertFile, const std::st
   pipelineInfo.pViewportState = &viewportInfo;
   pipelineInfo.pRasterizationState = &config.rasterizationInfo;
   pipelineInfo.pMultisampleState = &config.multisampleInfo;
-  pipelineInfo.pColorBlendState = &config.colorBlendInfo;
+  pipelineInfo.pColorBlendState = &colorBlendInfo;
   pipelineInfo.pDepthStencilState = &config.depthStencilInfo;
-  pipelineInfo.pDynamicState = nullptr;
+  pipelineInfo.pDynamicState = &dynamicStateInfo;
 
   pipelineInfo.layout = config.pipelineLayout;
   pipelineInfo.renderPass = config.renderPass;
@@ -80,40 +106,31 @@ void Pipeline::createGraphicsPipeline(const std::string& vertFile, const std::st
   pipelineInfo.basePipelineIndex = -1;
   pipelineInfo.basePipelineHandle = VK_NULL_HANDLE;
 
-  if(vkCreateGraphicsPipelines(device.device(), VK_NULL_HANDLE, 1, &pipelineInfo, 
+  if(vkCreateGraphicsPipelines(device.device(), device.pipelineCache(), 1, &pipelineInfo, 
                 nullptr, &graphicsPipeline) != VK_SUCCESS) {
     throw std::runtime_error("failed to create graphics pipeline");
   }
 };
 
-void Pipeline::createShaderModule(const std::vector<char>& code, VkShaderModule* shaderModule){
+void Pipeline::createShaderModule(const ShaderCode& code, VkShaderModule* shaderModule){
+  // Straight from the archive mapping, no copy on the way to the driver
   VkShaderModuleCreateInfo createInfo{};
   createInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
-  createInfo.codeSize = code.size();
-  createInfo.pCode = reinterpret_cast<const uint32_t*>(code.data());
+  createInfo.codeSize = code.size;
+  createInfo.pCode = code.words;
    
   if(vkCreateShaderModule(device.device(), &createInfo, nullptr, shaderModule) != VK_SUCCESS){
     throw std::runtime_error("failed to create shader module");
   }
 };
 
-PipelineConfigInfo Pipeline::defaultPipelineConfigInfo(uint32_t width, uint32_t height){
+PipelineConfigInfo Pipeline::defaultPipelineConfigInfo(){
   PipelineConfigInfo configInfo{};
 
   configInfo.inputAssemblyInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
   configInfo.inputAssemblyInfo.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
   configInfo.inputAssemblyInfo.primitiveRestartEnable = VK_FALSE;
  
-  configInfo.viewport.x = 0.0f;
-  configInfo.viewport.y = 0.0f;
-  configInfo.viewport.width = static_cast<float>(width);
-  configInfo.viewport.height = static_cast<float>(height);
-  configInfo.viewport.minDepth = 0.0f;
-  configInfo.viewport.maxDepth = 1.0f;
- 
-  configInfo.scissor.offset = {0, 0};
-  configInfo.scissor.extent = {width, height};
- 
   configInfo.rasterizationInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
   configInfo.rasterizationInfo.depthClampEnable = VK_FALSE;
   configInfo.rasterizationInfo.rasterizerDiscardEnable = VK_FALSE;
@@ -166,12 +183,90 @@ PipelineConfigInfo Pipeline::defaultPipelineConfigInfo(uint32_t width, uint32_t
   configInfo.depthStencilInfo.front = {};  // Optional
   configInfo.depthStencilInfo.back = {};   // Optional
 
+  configInfo.dynamicStateEnables = {VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR};
+
   return configInfo;
 }
 
-Pipeline::Pipeline(Device& device, const std::string& vertFile, const std::string& fragFile, const PipelineConfigInfo& config) 
+void Pipeline::enableExtendedDynamicState(PipelineConfigInfo& config){
+  config.dynamicStateEnables.insert(config.dynamicStateEnables.end(), {
+      VK_DYNAMIC_STATE_CULL_MODE_EXT,
+      VK_DYNAMIC_STATE_FRONT_FACE_EXT,
+      VK_DYNAMIC_STATE_PRIMITIVE_TOPOLOGY_EXT,
+      VK_DYNAMIC_STATE_DEPTH_TEST_ENABLE_EXT,
+      VK_DYNAMIC_STATE_DEPTH_WRITE_ENABLE_EXT,
+      VK_DYNAMIC_STATE_DEPTH_COMPARE_OP_EXT});
+}
+
+void Pipeline::setStaticViewport(PipelineConfigInfo& config, VkExtent2D extent){
+  auto& states = config.dynamicStateEnables;
+  states.erase(std::remove_if(states.begin(), states.end(), [](VkDynamicState state){
+      return state == VK_DYNAMIC_STATE_VIEWPORT || state == VK_DYNAMIC_STATE_SCISSOR; }), states.end());
+  config.viewport = {0.0f, 0.0f, static_cast<float>(extent.width), static_cast<float>(extent.height), 0.0f, 1.0f};
+  config.scissor = {{0, 0}, extent};
+}
+
+void Pipeline::setDynamicState(VkCommandBuffer commandBuffer, const PipelineConfigInfo& config, Device& device){
+  const ExtendedDynamicStateFunctions& functions = device.extendedDynamicState();
+  for(VkDynamicState state : config.dynamicStateEnables){
+    switch(state){
+      case VK_DYNAMIC_STATE_CULL_MODE_EXT:
+        functions.setCullMode(commandBuffer, config.rasterizationInfo.cullMode);
+        break;
+      case VK_DYNAMIC_STATE_FRONT_FACE_EXT:
+        functions.setFrontFace(commandBuffer, config.rasterizationInfo.frontFace);
+        break;
+      case VK_DYNAMIC_STATE_PRIMITIVE_TOPOLOGY_EXT:
+        functions.setPrimitiveTopology(commandBuffer, config.inputAssemblyInfo.topology);
+        break;
+      case VK_DYNAMIC_STATE_DEPTH_TEST_ENABLE_EXT:
+        functions.setDepthTestEnable(commandBuffer, config.depthStencilInfo.depthTestEnable);
+        break;
+      case VK_DYNAMIC_STATE_DEPTH_WRITE_ENABLE_EXT:
+        functions.setDepthWriteEnable(commandBuffer, config.depthStencilInfo.depthWriteEnable);
+        break;
+      case VK_DYNAMIC_STATE_DEPTH_COMPARE_OP_EXT:
+        functions.setDepthCompareOp(commandBuffer, config.depthStencilInfo.depthCompareOp);
+        break;
+      default:
+        // Viewport and scissor come from setViewport
+        break;
+    }
+  }
+}
+
+void Pipeline::setVertexLayout(PipelineConfigInfo& config, const VertexLayout& layout){
+  config.bindingDescriptions = layout.bindingDescriptions();
+  config.attributeDescriptions = layout.attributeDescriptions();
+  if(layout.getEncoding() == VertexEncoding::QUANTIZED){
+    config.vertSpecialization.set(OCTAHEDRAL_NORMALS_CONSTANT_ID, true);
+  }
+}
+
+void Pipeline::setViewport(VkCommandBuffer commandBuffer, VkExtent2D extent){
+  VkViewport viewport{};
+  viewport.x = 0.0f;
+  viewport.y = 0.0f;
+  viewport.width = static_cast<float>(extent.width);
+  viewport.height = static_cast<float>(extent.height);
+  viewport.minDepth = 0.0f;
+  viewport.maxDepth = 1.0f;
+  VkRect2D scissor{{0, 0}, extent};
+  vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+  vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+}
+
+Pipeline::Pipeline(Device& device, const ShaderArchive& shaders, const std::string& vertShader,
+                   const std::string& fragShader, const PipelineConfigInfo& config) 
 :device(device){
-  createGraphicsPipeline(vertFile, fragFile, config);
+  try {
+    createGraphicsPipeline(shaders.find(vertShader), shaders.find(fragShader), config);
+  } catch (...) {
+    // The destructor never runs for a throwing constructor, null modules are ignored
+    vkDestroyShaderModule(device.device(), vertShaderModule, nullptr);
+    vkDestroyShaderModule(device.device(), frahShaderModule, nullptr);
+    throw;
+  }
 };
 
 Pipeline::~Pipeline(){
@@ -0,0 +1,228 @@
+#include "pipeline_library.hpp"
+#include "hash.hpp"
+
+// std
+#include <algorithm>
+#include <iostream>
+#include <stdexcept>
+
+PipelineLibrary::PipelineLibrary(Device &device, const ShaderArchive &shaders, uint32_t threadCount)
+    : device{device}, shaders{shaders} {
+  for (uint32_t i = 0; i < std::max(1u, threadCount); i++) {
+    workers.emplace_back(&PipelineLibrary::workerLoop, this);
+  }
+}
+
+PipelineLibrary::~PipelineLibrary() {
+  {
+    std::lock_guard<std::mutex> lock{mutex};
+    stopping = true;
+    queue.clear();
+  }
+  workAvailable.notify_all();
+  for (auto &worker : workers) {
+    worker.join();
+  }
+}
+
+// Dynamic topology may still only vary within a class, so that stays part of the key
+static uint32_t topologyClass(VkPrimitiveTopology topology) {
+  switch (topology) {
+    case VK_PRIMITIVE_TOPOLOGY_POINT_LIST:
+      return 0;
+    case VK_PRIMITIVE_TOPOLOGY_LINE_LIST:
+    case VK_PRIMITIVE_TOPOLOGY_LINE_STRIP:
+    case VK_PRIMITIVE_TOPOLOGY_LINE_LIST_WITH_ADJACENCY:
+    case VK_PRIMITIVE_TOPOLOGY_LINE_STRIP_WITH_ADJACENCY:
+      return 1;
+    case VK_PRIMITIVE_TOPOLOGY_PATCH_LIST:
+      return 3;
+    default:
+      return 2;
+  }
+}
+
+uint64_t PipelineLibrary::hashDesc(const PipelineDesc &desc) {
+  const PipelineConfigInfo &config = desc.config;
+  auto isDynamic = [&config](VkDynamicState state) {
+    return std::find(config.dynamicStateEnables.begin(), config.dynamicStateEnables.end(), state) !=
+           config.dynamicStateEnables.end();
+  };
+  uint64_t hash = HASH_SEED;
+  hashCombine(hash, desc.vertShader);
+  hashCombine(hash, desc.fragShader);
+  hashCombine(hash, desc.renderPassHash);
+  hashCombine(hash, config.subpass);
+  // Layouts live as long as the app, the handle identifies one well enough within a run
+  hashCombine(hash, config.pipelineLayout);
+
+  for (VkDynamicState state : config.dynamicStateEnables) {
+    hashCombine(hash, state);
+  }
+  for (const auto &binding : config.bindingDescriptions) {
+    hashCombine(hash, binding);
+  }
+  hashCombine(hash, config.bindingDescriptions.size());
+  for (const auto &attribute : config.attributeDescriptions) {
+    hashCombine(hash, attribute);
+  }
+  hashCombine(hash, config.attributeDescriptions.size());
+  if (!isDynamic(VK_DYNAMIC_STATE_VIEWPORT)) {
+    hashCombine(hash, config.viewport);
+  }
+  if (!isDynamic(VK_DYNAMIC_STATE_SCISSOR)) {
+    hashCombine(hash, config.scissor);
+  }
+  hashCombine(hash, config.vertSpecialization.hash());
+  hashCombine(hash, config.fragSpecialization.hash());
+
+  // Field by field, the create info structs carry padding and pointers. State that is set while
+  // recording is left out, so variants differing only in it share one pipeline
+  hashCombine(
+      hash,
+      isDynamic(VK_DYNAMIC_STATE_PRIMITIVE_TOPOLOGY_EXT)
+          ? topologyClass(config.inputAssemblyInfo.topology)
+          : static_cast<uint32_t>(config.inputAssemblyInfo.topology));
+  hashCombine(hash, config.inputAssemblyInfo.primitiveRestartEnable);
+
+  const auto &rasterization = config.rasterizationInfo;
+  hashCombine(hash, rasterization.depthClampEnable);
+  hashCombine(hash, rasterization.rasterizerDiscardEnable);
+  hashCombine(hash, rasterization.polygonMode);
+  if (!isDynamic(VK_DYNAMIC_STATE_CULL_MODE_EXT)) {
+    hashCombine(hash, rasterization.cullMode);
+  }
+  if (!isDynamic(VK_DYNAMIC_STATE_FRONT_FACE_EXT)) {
+    hashCombine(hash, rasterization.frontFace);
+  }
+  hashCombine(hash, rasterization.depthBiasEnable);
+  hashCombine(hash, rasterization.depthBiasConstantFactor);
+  hashCombine(hash, rasterization.depthBiasClamp);
+  hashCombine(hash, rasterization.depthBiasSlopeFactor);
+  hashCombine(hash, rasterization.lineWidth);
+
+  const auto &multisample = config.multisampleInfo;
+  hashCombine(hash, multisample.rasterizationSamples);
+  hashCombine(hash, multisample.sampleShadingEnable);
+  hashCombine(hash, multisample.minSampleShading);
+  hashCombine(hash, multisample.alphaToCoverageEnable);
+  hashCombine(hash, multisample.alphaToOneEnable);
+
+  hashCombine(hash, config.colorBlendAttachment);
+  hashCombine(hash, config.colorBlendInfo.logicOpEnable);
+  hashCombine(hash, config.colorBlendInfo.logicOp);
+  hashCombine(hash, config.colorBlendInfo.blendConstants);
+
+  const auto &depthStencil = config.depthStencilInfo;
+  if (!isDynamic(VK_DYNAMIC_STATE_DEPTH_TEST_ENABLE_EXT)) {
+    hashCombine(hash, depthStencil.depthTestEnable);
+  }
+  if (!isDynamic(VK_DYNAMIC_STATE_DEPTH_WRITE_ENABLE_EXT)) {
+    hashCombine(hash, depthStencil.depthWriteEnable);
+  }
+  if (!isDynamic(VK_DYNAMIC_STATE_DEPTH_COMPARE_OP_EXT)) {
+    hashCombine(hash, depthStencil.depthCompareOp);
+  }
+  hashCombine(hash, depthStencil.depthBoundsTestEnable);
+  hashCombine(hash, depthStencil.stencilTestEnable);
+  hashCombine(hash, depthStencil.front);
+  hashCombine(hash, depthStencil.back);
+  hashCombine(hash, depthStencil.minDepthBounds);
+  hashCombine(hash, depthStencil.maxDepthBounds);
+  return hash;
+}
+
+PipelineLibrary::Entry &PipelineLibrary::findOrQueue(uint64_t key, const PipelineDesc &desc) {
+  auto found = entries.find(key);
+  if (found != entries.end()) {
+    return found->second;
+  }
+  queue.push_back({key, desc});
+  workAvailable.notify_one();
+  return entries[key];
+}
+
+VkPipeline PipelineLibrary::get(const PipelineDesc &desc, VkPipeline fallback) {
+  uint64_t key = hashDesc(desc);
+  std::lock_guard<std::mutex> lock{mutex};
+  Entry &entry = findOrQueue(key, desc);
+  return entry.state == State::Ready ? entry.pipeline->getPipeline() : fallback;
+}
+
+void PipelineLibrary::request(const PipelineDesc &desc) {
+  uint64_t key = hashDesc(desc);
+  std::lock_guard<std::mutex> lock{mutex};
+  findOrQueue(key, desc);
+}
+
+VkPipeline PipelineLibrary::getBlocking(const PipelineDesc &desc) {
+  uint64_t key = hashDesc(desc);
+  std::unique_lock<std::mutex> lock{mutex};
+  Entry &entry = entries[key];
+
+  if (entry.state == State::Queued) {
+    // Take it off the queue, or it was unknown, and compile it right here
+    queue.erase(
+        std::remove_if(queue.begin(), queue.end(), [key](const Job &job) { return job.key == key; }),
+        queue.end());
+    entry.state = State::Compiling;
+    compiling++;
+    lock.unlock();
+    std::unique_ptr<Pipeline> pipeline = compile(desc);
+    lock.lock();
+    finish(key, std::move(pipeline));
+  } else {
+    workDone.wait(lock, [&entry] { return entry.state != State::Compiling; });
+  }
+
+  if (entry.state == State::Failed) {
+    throw std::runtime_error("failed to compile pipeline variant!");
+  }
+  return entry.pipeline->getPipeline();
+}
+
+size_t PipelineLibrary::pendingCount() {
+  std::lock_guard<std::mutex> lock{mutex};
+  return queue.size() + compiling;
+}
+
+void PipelineLibrary::waitIdle() {
+  std::unique_lock<std::mutex> lock{mutex};
+  workDone.wait(lock, [this] { return queue.empty() && compiling == 0; });
+}
+
+std::unique_ptr<Pipeline> PipelineLibrary::compile(const PipelineDesc &desc) {
+  try {
+    return std::make_unique<Pipeline>(device, shaders, desc.vertShader, desc.fragShader, desc.config);
+  } catch (const std::exception &e) {
+    std::cerr << "pipeline variant failed to compile: " << e.what() << std::endl;
+    return nullptr;
+  }
+}
+
+void PipelineLibrary::finish(uint64_t key, std::unique_ptr<Pipeline> pipeline) {
+  Entry &entry = entries[key];
+  entry.state = pipeline ? State::Ready : State::Failed;
+  entry.pipeline = std::move(pipeline);
+  compiling--;
+  workDone.notify_all();
+}
+
+void PipelineLibrary::workerLoop() {
+  std::unique_lock<std::mutex> lock{mutex};
+  while (true) {
+    workAvailable.wait(lock, [this] { return stopping || !queue.empty(); });
+    if (stopping) {
+      return;
+    }
+    Job job = std::move(queue.front());
+    queue.pop_front();
+    entries[job.key].state = State::Compiling;
+    compiling++;
+
+    lock.unlock();
+    std::unique_ptr<Pipeline> pipeline = compile(job.desc);
+    lock.lock();
+    finish(job.key, std::move(pipeline));
+  }
+}
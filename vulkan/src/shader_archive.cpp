@@ -0,0 +1,179 @@
+#include "shader_archive.hpp"
+#include "hash.hpp"
+
+// std
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <stdexcept>
+#include <unordered_set>
+
+// posix
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+
+// "SPAK"
+constexpr uint32_t ARCHIVE_MAGIC = 0x4B415053;
+constexpr uint32_t ARCHIVE_VERSION = 1;
+constexpr size_t NAME_SIZE = 48;
+// Keeps every shader word aligned, the mapping itself starts on a page
+constexpr uint64_t CODE_ALIGNMENT = 16;
+
+struct ArchiveHeader {
+  uint32_t magic;
+  uint32_t version;
+  uint32_t entryCount;
+  uint32_t reserved;
+};
+
+struct ArchiveEntry {
+  char name[NAME_SIZE];
+  uint64_t offset;
+  uint64_t size;
+  uint64_t hash;
+};
+
+uint64_t alignCode(uint64_t offset) { return (offset + CODE_ALIGNMENT - 1) & ~(CODE_ALIGNMENT - 1); }
+
+}  // namespace
+
+ShaderArchive::ShaderArchive(const std::string &path, bool verifyHashes) {
+  int file = open(path.c_str(), O_RDONLY);
+  if (file < 0) {
+    throw std::runtime_error("failed to open shader archive: " + path);
+  }
+  struct stat info;
+  if (fstat(file, &info) != 0 || info.st_size < static_cast<off_t>(sizeof(ArchiveHeader))) {
+    close(file);
+    throw std::runtime_error("shader archive is truncated: " + path);
+  }
+  mappingSize = static_cast<size_t>(info.st_size);
+  mapping = mmap(nullptr, mappingSize, PROT_READ, MAP_PRIVATE, file, 0);
+  // The mapping keeps the file alive on its own
+  close(file);
+  if (mapping == MAP_FAILED) {
+    mapping = nullptr;
+    throw std::runtime_error("failed to map shader archive: " + path);
+  }
+  // Most shaders are turned into modules during startup, read them in ahead of the first fault
+  madvise(mapping, mappingSize, MADV_WILLNEED);
+
+  try {
+    readIndex(verifyHashes);
+  } catch (const std::exception &e) {
+    munmap(mapping, mappingSize);
+    throw std::runtime_error(std::string{e.what()} + ": " + path);
+  }
+}
+
+ShaderArchive::~ShaderArchive() {
+  if (mapping != nullptr) {
+    munmap(mapping, mappingSize);
+  }
+}
+
+void ShaderArchive::readIndex(bool verifyHashes) {
+  const char *base = static_cast<const char *>(mapping);
+  ArchiveHeader header;
+  std::memcpy(&header, base, sizeof(header));
+  if (header.magic != ARCHIVE_MAGIC || header.version != ARCHIVE_VERSION) {
+    throw std::runtime_error("unknown shader archive format");
+  }
+  uint64_t indexEnd = sizeof(ArchiveHeader) + uint64_t{header.entryCount} * sizeof(ArchiveEntry);
+  if (indexEnd > mappingSize) {
+    throw std::runtime_error("shader archive index is truncated");
+  }
+
+  for (uint32_t i = 0; i < header.entryCount; i++) {
+    ArchiveEntry entry;
+    std::memcpy(&entry, base + sizeof(ArchiveHeader) + i * sizeof(ArchiveEntry), sizeof(entry));
+    if (entry.offset < indexEnd || entry.offset > mappingSize || entry.size > mappingSize - entry.offset ||
+        entry.offset % sizeof(uint32_t) != 0 || entry.size % sizeof(uint32_t) != 0) {
+      throw std::runtime_error("shader archive entry out of bounds");
+    }
+    ShaderCode code{};
+    code.words = reinterpret_cast<const uint32_t *>(base + entry.offset);
+    code.size = static_cast<size_t>(entry.size);
+    code.hash = entry.hash;
+    if (verifyHashes && hashBytes(code.words, code.size) != code.hash) {
+      throw std::runtime_error("shader archive entry does not match its hash");
+    }
+    index[std::string{entry.name, strnlen(entry.name, NAME_SIZE)}] = code;
+  }
+}
+
+ShaderCode ShaderArchive::find(const std::string &name) const {
+  auto found = index.find(name);
+  if (found == index.end()) {
+    throw std::runtime_error("shader not found in archive: " + name);
+  }
+  return found->second;
+}
+
+void ShaderArchive::write(const std::string &path, const std::vector<std::string> &files) {
+  std::vector<ArchiveEntry> entries(files.size());
+  std::vector<std::vector<char>> codes(files.size());
+  std::unordered_set<std::string> names;
+  uint64_t offset = alignCode(sizeof(ArchiveHeader) + entries.size() * sizeof(ArchiveEntry));
+
+  for (size_t i = 0; i < files.size(); i++) {
+    std::ifstream file{files[i], std::ios::ate | std::ios::binary};
+    if (!file.is_open()) {
+      throw std::runtime_error("failed to open file: " + files[i]);
+    }
+    codes[i].resize(static_cast<size_t>(file.tellg()));
+    file.seekg(0);
+    file.read(codes[i].data(), codes[i].size());
+    if (!file || codes[i].empty() || codes[i].size() % sizeof(uint32_t) != 0) {
+      throw std::runtime_error("not a SPIR-V module: " + files[i]);
+    }
+
+    std::string name = std::filesystem::path{files[i]}.stem().string();
+    if (name.size() >= NAME_SIZE) {
+      throw std::runtime_error("shader name too long for the archive: " + name);
+    }
+    if (!names.insert(name).second) {
+      throw std::runtime_error("shader packed twice: " + name);
+    }
+
+    ArchiveEntry &entry = entries[i];
+    std::memset(&entry, 0, sizeof(entry));
+    std::memcpy(entry.name, name.data(), name.size());
+    entry.offset = offset;
+    entry.size = codes[i].size();
+    entry.hash = hashBytes(codes[i].data(), codes[i].size());
+    offset = alignCode(offset + entry.size);
+  }
+
+  ArchiveHeader header{};
+  header.magic = ARCHIVE_MAGIC;
+  header.version = ARCHIVE_VERSION;
+  header.entryCount = static_cast<uint32_t>(entries.size());
+
+  // Written next to the destination and renamed over it, a running app never maps half an archive
+  std::string temporaryPath = path + ".tmp";
+  {
+    std::ofstream file{temporaryPath, std::ios::binary | std::ios::trunc};
+    file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+    file.write(reinterpret_cast<const char *>(entries.data()), entries.size() * sizeof(ArchiveEntry));
+    const char padding[CODE_ALIGNMENT] = {};
+    for (size_t i = 0; i < entries.size(); i++) {
+      file.write(padding, entries[i].offset - static_cast<uint64_t>(file.tellp()));
+      file.write(codes[i].data(), codes[i].size());
+    }
+    file.flush();
+    if (!file) {
+      throw std::runtime_error("failed to write shader archive: " + temporaryPath);
+    }
+  }
+  std::error_code error;
+  std::filesystem::rename(temporaryPath, path, error);
+  if (error) {
+    std::filesystem::remove(temporaryPath, error);
+    throw std::runtime_error("failed to replace shader archive: " + path);
+  }
+}
@@ -0,0 +1,448 @@
+#include "shader_reflection.hpp"
+
+// std
+#include <algorithm>
+#include <iterator>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+
+namespace {
+
+// Values from the SPIR-V specification, only the ones reflection looks at
+constexpr uint32_t SPIRV_MAGIC = 0x07230203;
+constexpr uint32_t SPIRV_HEADER_WORDS = 5;
+
+enum Op : uint32_t {
+  OP_ENTRY_POINT = 15,
+  OP_EXECUTION_MODE = 16,
+  OP_TYPE_BOOL = 20,
+  OP_TYPE_INT = 21,
+  OP_TYPE_FLOAT = 22,
+  OP_TYPE_VECTOR = 23,
+  OP_TYPE_MATRIX = 24,
+  OP_TYPE_IMAGE = 25,
+  OP_TYPE_SAMPLER = 26,
+  OP_TYPE_SAMPLED_IMAGE = 27,
+  OP_TYPE_ARRAY = 28,
+  OP_TYPE_RUNTIME_ARRAY = 29,
+  OP_TYPE_STRUCT = 30,
+  OP_TYPE_POINTER = 32,
+  OP_CONSTANT = 43,
+  OP_SPEC_CONSTANT = 50,
+  OP_VARIABLE = 59,
+  OP_DECORATE = 71,
+  OP_MEMBER_DECORATE = 72,
+};
+
+enum Decoration : uint32_t {
+  DECORATION_BUFFER_BLOCK = 3,
+  DECORATION_ARRAY_STRIDE = 6,
+  DECORATION_MATRIX_STRIDE = 7,
+  DECORATION_BUILT_IN = 11,
+  DECORATION_LOCATION = 30,
+  DECORATION_BINDING = 33,
+  DECORATION_DESCRIPTOR_SET = 34,
+  DECORATION_OFFSET = 35,
+};
+
+enum StorageClass : uint32_t {
+  STORAGE_CLASS_UNIFORM_CONSTANT = 0,
+  STORAGE_CLASS_INPUT = 1,
+  STORAGE_CLASS_UNIFORM = 2,
+  STORAGE_CLASS_PUSH_CONSTANT = 9,
+  STORAGE_CLASS_STORAGE_BUFFER = 12,
+};
+
+constexpr uint32_t EXECUTION_MODE_LOCAL_SIZE = 17;
+
+constexpr uint32_t DIM_BUFFER = 5;
+constexpr uint32_t DIM_SUBPASS_DATA = 6;
+// OpTypeImage's Sampled operand for images read and written without a sampler
+constexpr uint32_t IMAGE_STORAGE = 2;
+
+struct Type {
+  uint32_t opcode = 0;
+  // Operands after the result id
+  std::vector<uint32_t> operands;
+};
+
+struct Variable {
+  uint32_t id;
+  uint32_t pointerType;
+  uint32_t storageClass;
+};
+
+// The parts of a module reflection needs, indexed by result id
+class SpirvModule {
+ public:
+  explicit SpirvModule(const ShaderCode &code);
+
+  VkShaderStageFlagBits stage = VK_SHADER_STAGE_ALL;
+  uint32_t localSize[3] = {1, 1, 1};
+  std::vector<Variable> variables;
+
+  const Type &type(uint32_t id) const;
+  bool hasDecoration(uint32_t id, uint32_t decoration) const;
+  uint32_t decoration(uint32_t id, uint32_t decoration) const;
+  bool hasMemberDecoration(uint32_t id, uint32_t member, uint32_t decoration) const;
+  uint32_t memberDecoration(uint32_t id, uint32_t member, uint32_t decoration) const;
+  // Specialization constants count with their default value
+  uint32_t arrayLength(const Type &array) const;
+
+  VkDescriptorType descriptorType(uint32_t typeId, uint32_t storageClass) const;
+  VkFormat vertexFormat(uint32_t typeId, uint32_t &size) const;
+  // Bytes a value of the type occupies in an explicitly laid out block
+  uint32_t sizeOf(uint32_t typeId) const;
+
+ private:
+  static uint64_t memberKey(uint32_t id, uint32_t member) { return uint64_t{id} << 32 | member; }
+
+  std::unordered_map<uint32_t, Type> types;
+  std::unordered_map<uint32_t, uint32_t> constants;
+  std::unordered_map<uint32_t, std::unordered_map<uint32_t, uint32_t>> decorations;
+  std::unordered_map<uint64_t, std::unordered_map<uint32_t, uint32_t>> memberDecorations;
+};
+
+SpirvModule::SpirvModule(const ShaderCode &code) {
+  size_t wordCount = code.size / sizeof(uint32_t);
+  if (wordCount < SPIRV_HEADER_WORDS || code.words[0] != SPIRV_MAGIC) {
+    throw std::runtime_error("not a SPIR-V module");
+  }
+
+  bool foundEntryPoint = false;
+  for (size_t i = SPIRV_HEADER_WORDS; i < wordCount;) {
+    uint32_t instructionWords = code.words[i] >> 16;
+    uint32_t opcode = code.words[i] & 0xFFFF;
+    if (instructionWords == 0 || instructionWords > wordCount - i) {
+      throw std::runtime_error("truncated SPIR-V instruction");
+    }
+    const uint32_t *operands = code.words + i + 1;
+    uint32_t operandCount = instructionWords - 1;
+    auto require = [operandCount](uint32_t count) {
+      if (operandCount < count) {
+        throw std::runtime_error("malformed SPIR-V instruction");
+      }
+    };
+
+    switch (opcode) {
+      case OP_ENTRY_POINT:
+        require(1);
+        // Modules here have one entry point, main
+        if (!foundEntryPoint) {
+          constexpr VkShaderStageFlagBits stages[] = {
+              VK_SHADER_STAGE_VERTEX_BIT,
+              VK_SHADER_STAGE_TESSELLATION_CONTROL_BIT,
+              VK_SHADER_STAGE_TESSELLATION_EVALUATION_BIT,
+              VK_SHADER_STAGE_GEOMETRY_BIT,
+              VK_SHADER_STAGE_FRAGMENT_BIT,
+              VK_SHADER_STAGE_COMPUTE_BIT};
+          if (operands[0] >= std::size(stages)) {
+            throw std::runtime_error("unsupported shader stage");
+          }
+          stage = stages[operands[0]];
+          foundEntryPoint = true;
+        }
+        break;
+      case OP_EXECUTION_MODE:
+        require(2);
+        if (operands[1] == EXECUTION_MODE_LOCAL_SIZE) {
+          require(5);
+          std::copy(operands + 2, operands + 5, localSize);
+        }
+        break;
+      case OP_DECORATE:
+        require(2);
+        decorations[operands[0]][operands[1]] = operandCount > 2 ? operands[2] : 0;
+        break;
+      case OP_MEMBER_DECORATE:
+        require(3);
+        memberDecorations[memberKey(operands[0], operands[1])][operands[2]] = operandCount > 3 ? operands[3] : 0;
+        break;
+      case OP_TYPE_BOOL:
+      case OP_TYPE_INT:
+      case OP_TYPE_FLOAT:
+      case OP_TYPE_VECTOR:
+      case OP_TYPE_MATRIX:
+      case OP_TYPE_IMAGE:
+      case OP_TYPE_SAMPLER:
+      case OP_TYPE_SAMPLED_IMAGE:
+      case OP_TYPE_ARRAY:
+      case OP_TYPE_RUNTIME_ARRAY:
+      case OP_TYPE_STRUCT:
+      case OP_TYPE_POINTER:
+        require(1);
+        types[operands[0]] = Type{opcode, {operands + 1, operands + operandCount}};
+        break;
+      case OP_CONSTANT:
+      case OP_SPEC_CONSTANT:
+        require(3);
+        constants[operands[1]] = operands[2];
+        break;
+      case OP_VARIABLE:
+        require(3);
+        variables.push_back({operands[1], operands[0], operands[2]});
+        break;
+      default:
+        break;
+    }
+    i += instructionWords;
+  }
+
+  if (!foundEntryPoint) {
+    throw std::runtime_error("SPIR-V module has no entry point");
+  }
+}
+
+const Type &SpirvModule::type(uint32_t id) const {
+  auto found = types.find(id);
+  if (found == types.end()) {
+    throw std::runtime_error("SPIR-V uses an unsupported type");
+  }
+  return found->second;
+}
+
+bool SpirvModule::hasDecoration(uint32_t id, uint32_t decoration) const {
+  auto found = decorations.find(id);
+  return found != decorations.end() && found->second.count(decoration) > 0;
+}
+
+uint32_t SpirvModule::decoration(uint32_t id, uint32_t decoration) const {
+  return hasDecoration(id, decoration) ? decorations.at(id).at(decoration) : 0;
+}
+
+bool SpirvModule::hasMemberDecoration(uint32_t id, uint32_t member, uint32_t decoration) const {
+  auto found = memberDecorations.find(memberKey(id, member));
+  return found != memberDecorations.end() && found->second.count(decoration) > 0;
+}
+
+uint32_t SpirvModule::memberDecoration(uint32_t id, uint32_t member, uint32_t decoration) const {
+  return hasMemberDecoration(id, member, decoration) ? memberDecorations.at(memberKey(id, member)).at(decoration)
+                                                      : 0;
+}
+
+uint32_t SpirvModule::arrayLength(const Type &array) const {
+  auto found = constants.find(array.operands.at(1));
+  if (found == constants.end()) {
+    throw std::runtime_error("SPIR-V array length is not a constant");
+  }
+  return found->second;
+}
+
+VkDescriptorType SpirvModule::descriptorType(uint32_t typeId, uint32_t storageClass) const {
+  if (storageClass == STORAGE_CLASS_STORAGE_BUFFER) {
+    return VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+  }
+  if (storageClass == STORAGE_CLASS_UNIFORM) {
+    // Older compilers mark storage buffers as Uniform with BufferBlock
+    return hasDecoration(typeId, DECORATION_BUFFER_BLOCK) ? VK_DESCRIPTOR_TYPE_STORAGE_BUFFER
+                                                          : VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+  }
+
+  const Type &resource = type(typeId);
+  switch (resource.opcode) {
+    case OP_TYPE_SAMPLER:
+      return VK_DESCRIPTOR_TYPE_SAMPLER;
+    case OP_TYPE_SAMPLED_IMAGE:
+      return VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    case OP_TYPE_IMAGE: {
+      uint32_t dim = resource.operands.at(1);
+      bool storage = resource.operands.at(5) == IMAGE_STORAGE;
+      if (dim == DIM_BUFFER) {
+        return storage ? VK_DESCRIPTOR_TYPE_STORAGE_TEXEL_BUFFER : VK_DESCRIPTOR_TYPE_UNIFORM_TEXEL_BUFFER;
+      }
+      if (dim == DIM_SUBPASS_DATA) {
+        return VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT;
+      }
+      return storage ? VK_DESCRIPTOR_TYPE_STORAGE_IMAGE : VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE;
+    }
+    default:
+      throw std::runtime_error("SPIR-V uses an unsupported descriptor type");
+  }
+}
+
+VkFormat SpirvModule::vertexFormat(uint32_t typeId, uint32_t &size) const {
+  const Type *scalar = &type(typeId);
+  uint32_t components = 1;
+  if (scalar->opcode == OP_TYPE_VECTOR) {
+    components = scalar->operands.at(1);
+    scalar = &type(scalar->operands.at(0));
+  }
+  if (components < 1 || components > 4 || scalar->operands.at(0) != 32) {
+    throw std::runtime_error("unsupported vertex input type");
+  }
+  size = components * sizeof(uint32_t);
+
+  constexpr VkFormat floatFormats[] = {
+      VK_FORMAT_R32_SFLOAT, VK_FORMAT_R32G32_SFLOAT, VK_FORMAT_R32G32B32_SFLOAT, VK_FORMAT_R32G32B32A32_SFLOAT};
+  constexpr VkFormat intFormats[] = {
+      VK_FORMAT_R32_SINT, VK_FORMAT_R32G32_SINT, VK_FORMAT_R32G32B32_SINT, VK_FORMAT_R32G32B32A32_SINT};
+  constexpr VkFormat uintFormats[] = {
+      VK_FORMAT_R32_UINT, VK_FORMAT_R32G32_UINT, VK_FORMAT_R32G32B32_UINT, VK_FORMAT_R32G32B32A32_UINT};
+  if (scalar->opcode == OP_TYPE_FLOAT) {
+    return floatFormats[components - 1];
+  }
+  if (scalar->opcode == OP_TYPE_INT) {
+    return scalar->operands.at(1) ? intFormats[components - 1] : uintFormats[components - 1];
+  }
+  throw std::runtime_error("unsupported vertex input type");
+}
+
+uint32_t SpirvModule::sizeOf(uint32_t typeId) const {
+  const Type &value = type(typeId);
+  switch (value.opcode) {
+    case OP_TYPE_BOOL:
+      return sizeof(uint32_t);
+    case OP_TYPE_INT:
+    case OP_TYPE_FLOAT:
+      return value.operands.at(0) / 8;
+    case OP_TYPE_VECTOR:
+      return value.operands.at(1) * sizeOf(value.operands.at(0));
+    case OP_TYPE_MATRIX:
+      // Members carry a MatrixStride that the struct case prefers over this
+      return value.operands.at(1) * sizeOf(value.operands.at(0));
+    case OP_TYPE_ARRAY: {
+      uint32_t stride = hasDecoration(typeId, DECORATION_ARRAY_STRIDE) ? decoration(typeId, DECORATION_ARRAY_STRIDE)
+                                                                       : sizeOf(value.operands.at(0));
+      return arrayLength(value) * stride;
+    }
+    case OP_TYPE_STRUCT: {
+      uint32_t size = 0;
+      for (uint32_t member = 0; member < value.operands.size(); member++) {
+        uint32_t memberType = value.operands[member];
+        uint32_t memberSize = sizeOf(memberType);
+        if (type(memberType).opcode == OP_TYPE_MATRIX &&
+            hasMemberDecoration(typeId, member, DECORATION_MATRIX_STRIDE)) {
+          memberSize = type(memberType).operands.at(1) * memberDecoration(typeId, member, DECORATION_MATRIX_STRIDE);
+        }
+        size = std::max(size, memberDecoration(typeId, member, DECORATION_OFFSET) + memberSize);
+      }
+      return size;
+    }
+    default:
+      throw std::runtime_error("SPIR-V block member has no known size");
+  }
+}
+
+}  // namespace
+
+ShaderReflection ShaderReflection::reflect(const ShaderCode &code) {
+  SpirvModule module{code};
+  ShaderReflection reflection{};
+  reflection.stages = module.stage;
+  std::copy(std::begin(module.localSize), std::end(module.localSize), reflection.localSize);
+
+  for (const Variable &variable : module.variables) {
+    const Type &pointer = module.type(variable.pointerType);
+    uint32_t typeId = pointer.operands.at(1);
+
+    switch (variable.storageClass) {
+      case STORAGE_CLASS_UNIFORM_CONSTANT:
+      case STORAGE_CLASS_UNIFORM:
+      case STORAGE_CLASS_STORAGE_BUFFER: {
+        VkDescriptorSetLayoutBinding binding{};
+        binding.binding = module.decoration(variable.id, DECORATION_BINDING);
+        binding.descriptorCount = 1;
+        binding.stageFlags = module.stage;
+        // Arrays of resources are one binding with a count, runtime sized ones count as one
+        while (module.type(typeId).opcode == OP_TYPE_ARRAY ||
+               module.type(typeId).opcode == OP_TYPE_RUNTIME_ARRAY) {
+          const Type &array = module.type(typeId);
+          if (array.opcode == OP_TYPE_ARRAY) {
+            binding.descriptorCount *= module.arrayLength(array);
+          }
+          typeId = array.operands.at(0);
+        }
+        binding.descriptorType = module.descriptorType(typeId, variable.storageClass);
+        uint32_t set = module.decoration(variable.id, DECORATION_DESCRIPTOR_SET);
+        reflection.descriptorSets[set].push_back(binding);
+        break;
+      }
+      case STORAGE_CLASS_PUSH_CONSTANT: {
+        const Type &block = module.type(typeId);
+        uint32_t offset = UINT32_MAX;
+        for (uint32_t member = 0; member < block.operands.size(); member++) {
+          offset = std::min(offset, module.memberDecoration(typeId, member, DECORATION_OFFSET));
+        }
+        uint32_t size = module.sizeOf(typeId);
+        if (offset < size) {
+          reflection.pushConstantRanges.push_back({module.stage, offset, size - offset});
+        }
+        break;
+      }
+      case STORAGE_CLASS_INPUT: {
+        // Built-ins like gl_VertexIndex have no location and take no vertex data
+        if (module.stage != VK_SHADER_STAGE_VERTEX_BIT || module.hasDecoration(variable.id, DECORATION_BUILT_IN) ||
+            !module.hasDecoration(variable.id, DECORATION_LOCATION)) {
+          break;
+        }
+        VkVertexInputAttributeDescription attribute{};
+        attribute.location = module.decoration(variable.id, DECORATION_LOCATION);
+        attribute.binding = 0;
+        attribute.format = module.vertexFormat(typeId, attribute.offset);
+        reflection.vertexAttributes.push_back(attribute);
+        break;
+      }
+      default:
+        break;
+    }
+  }
+
+  for (auto &set : reflection.descriptorSets) {
+    std::sort(set.second.begin(), set.second.end(), [](const auto &a, const auto &b) {
+      return a.binding < b.binding;
+    });
+  }
+  // vertexFormat left each attribute's size in offset, pack them in location order
+  std::sort(reflection.vertexAttributes.begin(), reflection.vertexAttributes.end(), [](const auto &a, const auto &b) {
+    return a.location < b.location;
+  });
+  for (auto &attribute : reflection.vertexAttributes) {
+    uint32_t size = attribute.offset;
+    attribute.offset = reflection.vertexStride;
+    reflection.vertexStride += size;
+  }
+  return reflection;
+}
+
+void ShaderReflection::merge(const ShaderReflection &other) {
+  stages |= other.stages;
+
+  for (const auto &set : other.descriptorSets) {
+    auto &merged = descriptorSets[set.first];
+    for (const auto &binding : set.second) {
+      auto found = std::find_if(merged.begin(), merged.end(), [&binding](const auto &existing) {
+        return existing.binding == binding.binding;
+      });
+      if (found == merged.end()) {
+        merged.push_back(binding);
+        continue;
+      }
+      if (found->descriptorType != binding.descriptorType || found->descriptorCount != binding.descriptorCount) {
+        throw std::runtime_error(
+            "shader stages disagree on descriptor set " + std::to_string(set.first) + " binding " +
+            std::to_string(binding.binding));
+      }
+      found->stageFlags |= binding.stageFlags;
+    }
+    std::sort(merged.begin(), merged.end(), [](const auto &a, const auto &b) { return a.binding < b.binding; });
+  }
+
+  // One range over everything keeps vkCmdPushConstants simple, the blocks are tiny anyway
+  for (const auto &range : other.pushConstantRanges) {
+    if (pushConstantRanges.empty()) {
+      pushConstantRanges.push_back(range);
+      continue;
+    }
+    VkPushConstantRange &merged = pushConstantRanges[0];
+    uint32_t end = std::max(merged.offset + merged.size, range.offset + range.size);
+    merged.offset = std::min(merged.offset, range.offset);
+    merged.size = end - merged.offset;
+    merged.stageFlags |= range.stageFlags;
+  }
+
+  if (other.stages & VK_SHADER_STAGE_VERTEX_BIT) {
+    vertexAttributes = other.vertexAttributes;
+    vertexStride = other.vertexStride;
+  }
+}
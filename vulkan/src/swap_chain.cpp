@@ -1,4 +1,5 @@
 #include "swap_chain.hpp"
+#include "hash.hpp"
 
 // std
 #include <array>
@@ -8,9 +9,10 @@
 #include <limits>
 #include <set>
 #include <stdexcept>
+#include <utility>
 
-SwapChain::SwapChain(Device &deviceRef, VkExtent2D extent)
-    : device{deviceRef}, windowExtent{extent} {
+SwapChain::SwapChain(Device &deviceRef, VkExtent2D extent, PresentProfile profile)
+    : device{deviceRef}, windowExtent{extent}, presentProfile{profile} {
   createSwapChain();
   createImageViews();
   createRenderPass();
@@ -32,8 +34,7 @@ SwapChain::~SwapChain() {
 
   for (int i = 0; i < depthImages.size(); i++) {
     vkDestroyImageView(device.device(), depthImageViews[i], nullptr);
-    vkDestroyImage(device.device(), depthImages[i], nullptr);
-    vkFreeMemory(device.device(), depthImageMemorys[i], nullptr);
+    device.destroyImage(depthImages[i], depthImageMemorys[i]);
   }
 
   for (auto framebuffer : swapChainFramebuffers) {
@@ -93,6 +94,7 @@ VkResult SwapChain::submitCommandBuffers(
   submitInfo.pSignalSemaphores = signalSemaphores;
 
   vkResetFences(device.device(), 1, &inFlightFences[currentFrame]);
+  std::lock_guard<std::mutex> lock{device.queueMutex()};
   if (vkQueueSubmit(device.graphicsQueue(), 1, &submitInfo, inFlightFences[currentFrame]) !=
       VK_SUCCESS) {
     throw std::runtime_error("failed to submit draw command buffer!");
@@ -124,11 +126,7 @@ void SwapChain::createSwapChain() {
   VkPresentModeKHR presentMode = chooseSwapPresentMode(swapChainSupport.presentModes);
   VkExtent2D extent = chooseSwapExtent(swapChainSupport.capabilities);
 
-  uint32_t imageCount = swapChainSupport.capabilities.minImageCount + 1;
-  if (swapChainSupport.capabilities.maxImageCount > 0 &&
-      imageCount > swapChainSupport.capabilities.maxImageCount) {
-    imageCount = swapChainSupport.capabilities.maxImageCount;
-  }
+  uint32_t imageCount = chooseImageCount(swapChainSupport.capabilities);
 
   VkSwapchainCreateInfoKHR createInfo = {};
   createInfo.sType = VK_STRUCTURE_TYPE_SWAPCHAIN_CREATE_INFO_KHR;
@@ -258,12 +256,23 @@ void SwapChain::createRenderPass() {
   if (vkCreateRenderPass(device.device(), &renderPassInfo, nullptr, &renderPass) != VK_SUCCESS) {
     throw std::runtime_error("failed to create render pass!");
   }
+
+  // Compatibility only depends on attachment formats and sample counts for a single subpass
+  renderPassHash = HASH_SEED;
+  for (const auto &attachment : attachments) {
+    hashCombine(renderPassHash, attachment.format);
+    hashCombine(renderPassHash, attachment.samples);
+  }
+  hashCombine(renderPassHash, subpass.colorAttachmentCount);
+  hashCombine(renderPassHash, depthAttachmentRef.attachment);
 }
 
 void SwapChain::createFramebuffers() {
-  swapChainFramebuffers.resize(imageCount());
-  for (size_t i = 0; i < imageCount(); i++) {
-    std::array<VkImageView, 2> attachments = {swapChainImageViews[i], depthImageViews[i]};
+  swapChainFramebuffers.resize(MAX_FRAMES_IN_FLIGHT * imageCount());
+  for (size_t i = 0; i < swapChainFramebuffers.size(); i++) {
+    std::array<VkImageView, 2> attachments = {
+        swapChainImageViews[i % imageCount()],
+        depthImageViews[i / imageCount()]};
 
     VkExtent2D swapChainExtent = getSwapChainExtent();
     VkFramebufferCreateInfo framebufferInfo = {};
@@ -289,9 +298,9 @@ void SwapChain::createDepthResources() {
   VkFormat depthFormat = findDepthFormat();
   VkExtent2D swapChainExtent = getSwapChainExtent();
 
-  depthImages.resize(imageCount());
-  depthImageMemorys.resize(imageCount());
-  depthImageViews.resize(imageCount());
+  depthImages.resize(MAX_FRAMES_IN_FLIGHT);
+  depthImageMemorys.resize(MAX_FRAMES_IN_FLIGHT);
+  depthImageViews.resize(MAX_FRAMES_IN_FLIGHT);
 
   for (int i = 0; i < depthImages.size(); i++) {
     VkImageCreateInfo imageInfo{};
@@ -305,14 +314,16 @@ void SwapChain::createDepthResources() {
     imageInfo.format = depthFormat;
     imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
     imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-    imageInfo.usage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT;
+    // Depth is cleared on load and never stored, so tilers can keep it in on-chip memory
+    imageInfo.usage =
+        VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT;
     imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
     imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
     imageInfo.flags = 0;
 
     device.createImageWithInfo(
         imageInfo,
-        VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+        VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT | VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT,
         depthImages[i],
         depthImageMemorys[i]);
 
@@ -331,6 +342,14 @@ void SwapChain::createDepthResources() {
       throw std::runtime_error("failed to create texture image view!");
     }
   }
+
+  VkDeviceSize depthSize = depthImageMemorys[0].size;
+  size_t spared = imageCount() > depthImages.size() ? imageCount() - depthImages.size() : 0;
+  // What the images got, desktop GPUs fall back to plain device local memory
+  bool lazy = depthImageMemorys[0].properties & VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT;
+  std::cout << "Depth buffers: " << depthImages.size() << " x " << depthSize / 1024 << " KiB for "
+            << imageCount() << " images, " << spared * depthSize / 1024
+            << " KiB saved" << (lazy ? ", lazily allocated" : "") << std::endl;
 }
 
 void SwapChain::createSyncObjects() {
@@ -371,24 +390,50 @@ VkSurfaceFormatKHR SwapChain::chooseSwapSurfaceFormat(
 
 VkPresentModeKHR SwapChain::chooseSwapPresentMode(
     const std::vector<VkPresentModeKHR> &availablePresentModes) {
-  for (const auto &availablePresentMode : availablePresentModes) {
-    if (availablePresentMode == VK_PRESENT_MODE_MAILBOX_KHR) {
-      std::cout << "Present mode: Mailbox" << std::endl;
-      return availablePresentMode;
-    }
+  // FIFO is always available, so every profile falls back to it
+  std::vector<std::pair<VkPresentModeKHR, const char *>> preferred;
+  switch (presentProfile) {
+    case PresentProfile::Throughput:
+      preferred = {{VK_PRESENT_MODE_MAILBOX_KHR, "Mailbox"}, {VK_PRESENT_MODE_IMMEDIATE_KHR, "Immediate"}};
+      break;
+    case PresentProfile::Latency:
+      preferred = {
+          {VK_PRESENT_MODE_IMMEDIATE_KHR, "Immediate"},
+          {VK_PRESENT_MODE_MAILBOX_KHR, "Mailbox"},
+          {VK_PRESENT_MODE_FIFO_RELAXED_KHR, "Relaxed V-Sync"}};
+      break;
+    case PresentProfile::Power:
+      break;
   }
 
-  // for (const auto &availablePresentMode : availablePresentModes) {
-  //   if (availablePresentMode == VK_PRESENT_MODE_IMMEDIATE_KHR) {
-  //     std::cout << "Present mode: Immediate" << std::endl;
-  //     return availablePresentMode;
-  //   }
-  // }
+  for (const auto &mode : preferred) {
+    for (const auto &availablePresentMode : availablePresentModes) {
+      if (availablePresentMode == mode.first) {
+        std::cout << "Present mode: " << mode.second << std::endl;
+        return availablePresentMode;
+      }
+    }
+  }
 
   std::cout << "Present mode: V-Sync" << std::endl;
   return VK_PRESENT_MODE_FIFO_KHR;
 }
 
+uint32_t SwapChain::chooseImageCount(const VkSurfaceCapabilitiesKHR &capabilities) {
+  // a spare image keeps the CPU from waiting on presentation, latency and power profiles
+  // keep the present queue as short as the surface allows
+  uint32_t imageCount = capabilities.minImageCount;
+  if (presentProfile == PresentProfile::Throughput) {
+    imageCount++;
+  }
+
+  // maxImageCount of 0 means there is no limit
+  if (capabilities.maxImageCount > 0 && imageCount > capabilities.maxImageCount) {
+    imageCount = capabilities.maxImageCount;
+  }
+  return imageCount;
+}
+
 VkExtent2D SwapChain::chooseSwapExtent(const VkSurfaceCapabilitiesKHR &capabilities) {
   if (capabilities.currentExtent.width != std::numeric_limits<uint32_t>::max()) {
     return capabilities.currentExtent;
@@ -0,0 +1,404 @@
+#include "transfer_manager.hpp"
+
+// std
+#include <cstring>
+#include <stdexcept>
+
+// Satisfies bufferOffset rules of buffer to image copies for every format
+static constexpr VkDeviceSize STAGING_ALIGNMENT = 16;
+
+TransferManager::TransferManager(Device &device, VkDeviceSize stagingSize)
+    : device{device}, stagingSize{stagingSize} {
+  QueueFamilyIndices indices = device.findPhysicalQueueFamilies();
+  graphicsFamily = indices.graphicsFamily;
+  dedicated = indices.transferFamilyHasValue;
+  transferFamily = dedicated ? indices.transferFamily : indices.graphicsFamily;
+
+  VkCommandPoolCreateInfo poolInfo = {};
+  poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+  poolInfo.queueFamilyIndex = transferFamily;
+  poolInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+  if (vkCreateCommandPool(device.device(), &poolInfo, nullptr, &transferPool) != VK_SUCCESS) {
+    throw std::runtime_error("failed to create transfer command pool!");
+  }
+  if (dedicated) {
+    poolInfo.queueFamilyIndex = graphicsFamily;
+    if (vkCreateCommandPool(device.device(), &poolInfo, nullptr, &acquirePool) != VK_SUCCESS) {
+      throw std::runtime_error("failed to create transfer acquire command pool!");
+    }
+  }
+}
+
+TransferManager::~TransferManager() {
+  for (auto &batch : batches) {
+    if (batch->inFlight) {
+      vkWaitForFences(device.device(), 1, &batch->fence, VK_TRUE, UINT64_MAX);
+    }
+    destroyBatch(*batch);
+  }
+  if (acquirePool != VK_NULL_HANDLE) {
+    vkDestroyCommandPool(device.device(), acquirePool, nullptr);
+  }
+  vkDestroyCommandPool(device.device(), transferPool, nullptr);
+}
+
+std::unique_ptr<TransferManager::Batch> TransferManager::createBatch() {
+  auto batch = std::make_unique<Batch>();
+
+  VkCommandBufferAllocateInfo allocInfo{};
+  allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+  allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+  allocInfo.commandPool = transferPool;
+  allocInfo.commandBufferCount = 1;
+  if (vkAllocateCommandBuffers(device.device(), &allocInfo, &batch->transferCommands) !=
+      VK_SUCCESS) {
+    throw std::runtime_error("failed to allocate transfer command buffer!");
+  }
+
+  if (dedicated) {
+    allocInfo.commandPool = acquirePool;
+    if (vkAllocateCommandBuffers(device.device(), &allocInfo, &batch->acquireCommands) !=
+        VK_SUCCESS) {
+      throw std::runtime_error("failed to allocate transfer acquire command buffer!");
+    }
+
+    VkSemaphoreCreateInfo semaphoreInfo = {};
+    semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+    if (vkCreateSemaphore(device.device(), &semaphoreInfo, nullptr, &batch->released) !=
+        VK_SUCCESS) {
+      throw std::runtime_error("failed to create transfer semaphore!");
+    }
+  }
+
+  VkFenceCreateInfo fenceInfo = {};
+  fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+  if (vkCreateFence(device.device(), &fenceInfo, nullptr, &batch->fence) != VK_SUCCESS) {
+    throw std::runtime_error("failed to create transfer fence!");
+  }
+
+  device.createBuffer(
+      stagingSize,
+      VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+      VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+      batch->staging,
+      batch->stagingMemory);
+  return batch;
+}
+
+void TransferManager::destroyBatch(Batch &batch) {
+  for (auto &buffer : batch.oversized) {
+    device.destroyBuffer(buffer.first, buffer.second);
+  }
+  device.destroyBuffer(batch.staging, batch.stagingMemory);
+  vkDestroyFence(device.device(), batch.fence, nullptr);
+  if (dedicated) {
+    vkDestroySemaphore(device.device(), batch.released, nullptr);
+    vkFreeCommandBuffers(device.device(), acquirePool, 1, &batch.acquireCommands);
+  }
+  vkFreeCommandBuffers(device.device(), transferPool, 1, &batch.transferCommands);
+}
+
+void TransferManager::retire() {
+  for (auto &batch : batches) {
+    if (batch->inFlight && vkGetFenceStatus(device.device(), batch->fence) == VK_SUCCESS) {
+      batch->inFlight = false;
+      for (auto &buffer : batch->oversized) {
+        device.destroyBuffer(buffer.first, buffer.second);
+      }
+      batch->oversized.clear();
+    }
+  }
+}
+
+TransferManager::Batch &TransferManager::recordingBatch() {
+  if (recording != nullptr) {
+    return *recording;
+  }
+
+  retire();
+  for (auto &batch : batches) {
+    if (!batch->inFlight) {
+      recording = batch.get();
+      break;
+    }
+  }
+  if (recording == nullptr) {
+    batches.push_back(createBatch());
+    recording = batches.back().get();
+  }
+
+  recording->stagingHead = 0;
+  vkResetCommandBuffer(recording->transferCommands, 0);
+  VkCommandBufferBeginInfo beginInfo{};
+  beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+  beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+  if (vkBeginCommandBuffer(recording->transferCommands, &beginInfo) != VK_SUCCESS) {
+    throw std::runtime_error("failed to begin recording transfer command buffer!");
+  }
+  return *recording;
+}
+
+void *TransferManager::stage(VkDeviceSize size, VkBuffer &buffer, VkDeviceSize &offset) {
+  if (size > stagingSize) {
+    Batch &batch = recordingBatch();
+    Allocation memory;
+    device.createBuffer(
+        size,
+        VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+        buffer,
+        memory);
+    batch.oversized.emplace_back(buffer, memory);
+    offset = 0;
+    return memory.mapped;
+  }
+
+  // A full staging buffer submits what it holds and continues in a fresh batch
+  VkDeviceSize aligned =
+      (recordingBatch().stagingHead + STAGING_ALIGNMENT - 1) & ~(STAGING_ALIGNMENT - 1);
+  if (aligned + size > stagingSize) {
+    flush();
+    aligned = 0;
+  }
+  Batch &batch = recordingBatch();
+  batch.stagingHead = aligned + size;
+  buffer = batch.staging;
+  offset = aligned;
+  return static_cast<char *>(batch.stagingMemory.mapped) + aligned;
+}
+
+void TransferManager::releaseBuffer(
+    Batch &batch, VkBuffer buffer, VkDeviceSize offset, VkDeviceSize size) {
+  VkBufferMemoryBarrier barrier{};
+  barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+  barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+  barrier.dstAccessMask = dedicated ? 0 : VK_ACCESS_MEMORY_READ_BIT;
+  barrier.srcQueueFamilyIndex = dedicated ? transferFamily : VK_QUEUE_FAMILY_IGNORED;
+  barrier.dstQueueFamilyIndex = dedicated ? graphicsFamily : VK_QUEUE_FAMILY_IGNORED;
+  barrier.buffer = buffer;
+  barrier.offset = offset;
+  barrier.size = size;
+  batch.bufferReleases.push_back(barrier);
+
+  if (dedicated) {
+    barrier.srcAccessMask = 0;
+    barrier.dstAccessMask = VK_ACCESS_MEMORY_READ_BIT;
+    batch.bufferAcquires.push_back(barrier);
+  }
+}
+
+void TransferManager::releaseImage(
+    Batch &batch, VkImage image, uint32_t layerCount, VkImageLayout finalLayout) {
+  VkImageMemoryBarrier barrier{};
+  barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+  barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+  barrier.dstAccessMask = dedicated ? 0 : VK_ACCESS_MEMORY_READ_BIT;
+  // The layout transition happens once, between the release and the matching acquire
+  barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+  barrier.newLayout = finalLayout;
+  barrier.srcQueueFamilyIndex = dedicated ? transferFamily : VK_QUEUE_FAMILY_IGNORED;
+  barrier.dstQueueFamilyIndex = dedicated ? graphicsFamily : VK_QUEUE_FAMILY_IGNORED;
+  barrier.image = image;
+  barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+  barrier.subresourceRange.baseMipLevel = 0;
+  barrier.subresourceRange.levelCount = 1;
+  barrier.subresourceRange.baseArrayLayer = 0;
+  barrier.subresourceRange.layerCount = layerCount;
+  batch.imageReleases.push_back(barrier);
+
+  if (dedicated) {
+    barrier.srcAccessMask = 0;
+    barrier.dstAccessMask = VK_ACCESS_MEMORY_READ_BIT;
+    batch.imageAcquires.push_back(barrier);
+  }
+}
+
+void TransferManager::uploadBuffer(
+    VkBuffer dst, VkDeviceSize dstOffset, const void *data, VkDeviceSize size) {
+  std::memcpy(reserveBuffer(dst, dstOffset, size), data, size);
+}
+
+void *TransferManager::reserveBuffer(VkBuffer dst, VkDeviceSize dstOffset, VkDeviceSize size) {
+  VkBuffer src;
+  VkDeviceSize srcOffset;
+  void *staged = stage(size, src, srcOffset);
+  Batch &batch = recordingBatch();
+
+  VkBufferCopy copyRegion{};
+  copyRegion.srcOffset = srcOffset;
+  copyRegion.dstOffset = dstOffset;
+  copyRegion.size = size;
+  vkCmdCopyBuffer(batch.transferCommands, src, dst, 1, &copyRegion);
+  releaseBuffer(batch, dst, dstOffset, size);
+  return staged;
+}
+
+void TransferManager::uploadImage(
+    VkImage dst,
+    uint32_t width,
+    uint32_t height,
+    uint32_t layerCount,
+    const void *data,
+    VkDeviceSize size,
+    VkImageLayout finalLayout) {
+  VkBuffer src;
+  VkDeviceSize srcOffset;
+  std::memcpy(stage(size, src, srcOffset), data, size);
+  Batch &batch = recordingBatch();
+
+  // Previous contents are discarded, so no ownership is needed to make it a copy destination
+  VkImageMemoryBarrier barrier{};
+  barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+  barrier.srcAccessMask = 0;
+  barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+  barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+  barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+  barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  barrier.image = dst;
+  barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+  barrier.subresourceRange.baseMipLevel = 0;
+  barrier.subresourceRange.levelCount = 1;
+  barrier.subresourceRange.baseArrayLayer = 0;
+  barrier.subresourceRange.layerCount = layerCount;
+  vkCmdPipelineBarrier(
+      batch.transferCommands,
+      VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+      VK_PIPELINE_STAGE_TRANSFER_BIT,
+      0,
+      0,
+      nullptr,
+      0,
+      nullptr,
+      1,
+      &barrier);
+
+  VkBufferImageCopy region{};
+  region.bufferOffset = srcOffset;
+  region.bufferRowLength = 0;
+  region.bufferImageHeight = 0;
+
+  region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+  region.imageSubresource.mipLevel = 0;
+  region.imageSubresource.baseArrayLayer = 0;
+  region.imageSubresource.layerCount = layerCount;
+
+  region.imageOffset = {0, 0, 0};
+  region.imageExtent = {width, height, 1};
+
+  vkCmdCopyBufferToImage(
+      batch.transferCommands,
+      src,
+      dst,
+      VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+      1,
+      &region);
+  releaseImage(batch, dst, layerCount, finalLayout);
+}
+
+TransferToken TransferManager::flush() {
+  if (recording == nullptr) {
+    return lastToken;
+  }
+  Batch &batch = *recording;
+  recording = nullptr;
+
+  // Transfer only queues cannot name later stages, the acquire makes the data visible to them instead
+  vkCmdPipelineBarrier(
+      batch.transferCommands,
+      VK_PIPELINE_STAGE_TRANSFER_BIT,
+      dedicated ? VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT : VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,
+      0,
+      0,
+      nullptr,
+      static_cast<uint32_t>(batch.bufferReleases.size()),
+      batch.bufferReleases.data(),
+      static_cast<uint32_t>(batch.imageReleases.size()),
+      batch.imageReleases.data());
+  batch.bufferReleases.clear();
+  batch.imageReleases.clear();
+  if (vkEndCommandBuffer(batch.transferCommands) != VK_SUCCESS) {
+    throw std::runtime_error("failed to record transfer command buffer!");
+  }
+
+  VkSubmitInfo submitInfo = {};
+  submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+  submitInfo.commandBufferCount = 1;
+  submitInfo.pCommandBuffers = &batch.transferCommands;
+  vkResetFences(device.device(), 1, &batch.fence);
+
+  // Render threads submit to the graphics queue too
+  std::lock_guard<std::mutex> lock{device.queueMutex()};
+  if (!dedicated) {
+    if (vkQueueSubmit(device.graphicsQueue(), 1, &submitInfo, batch.fence) != VK_SUCCESS) {
+      throw std::runtime_error("failed to submit transfer command buffer!");
+    }
+  } else {
+    submitInfo.signalSemaphoreCount = 1;
+    submitInfo.pSignalSemaphores = &batch.released;
+    if (vkQueueSubmit(device.transferQueue(), 1, &submitInfo, VK_NULL_HANDLE) != VK_SUCCESS) {
+      throw std::runtime_error("failed to submit transfer command buffer!");
+    }
+
+    vkResetCommandBuffer(batch.acquireCommands, 0);
+    VkCommandBufferBeginInfo beginInfo{};
+    beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+    vkBeginCommandBuffer(batch.acquireCommands, &beginInfo);
+    vkCmdPipelineBarrier(
+        batch.acquireCommands,
+        VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+        VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,
+        0,
+        0,
+        nullptr,
+        static_cast<uint32_t>(batch.bufferAcquires.size()),
+        batch.bufferAcquires.data(),
+        static_cast<uint32_t>(batch.imageAcquires.size()),
+        batch.imageAcquires.data());
+    batch.bufferAcquires.clear();
+    batch.imageAcquires.clear();
+    if (vkEndCommandBuffer(batch.acquireCommands) != VK_SUCCESS) {
+      throw std::runtime_error("failed to record transfer acquire command buffer!");
+    }
+
+    // Graphics work submitted after this is ordered behind the acquire
+    VkPipelineStageFlags waitStage = VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
+    VkSubmitInfo acquireInfo = {};
+    acquireInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    acquireInfo.waitSemaphoreCount = 1;
+    acquireInfo.pWaitSemaphores = &batch.released;
+    acquireInfo.pWaitDstStageMask = &waitStage;
+    acquireInfo.commandBufferCount = 1;
+    acquireInfo.pCommandBuffers = &batch.acquireCommands;
+    if (vkQueueSubmit(device.graphicsQueue(), 1, &acquireInfo, batch.fence) != VK_SUCCESS) {
+      throw std::runtime_error("failed to submit transfer acquire command buffer!");
+    }
+  }
+
+  batch.inFlight = true;
+  batch.token = ++lastToken;
+  return batch.token;
+}
+
+bool TransferManager::isComplete(TransferToken token) {
+  if (token > lastToken) {
+    return false;
+  }
+  retire();
+  for (auto &batch : batches) {
+    if (batch->inFlight && batch->token == token) {
+      return false;
+    }
+  }
+  return true;
+}
+
+void TransferManager::wait(TransferToken token) {
+  for (auto &batch : batches) {
+    if (batch->inFlight && batch->token == token) {
+      vkWaitForFences(device.device(), 1, &batch->fence, VK_TRUE, UINT64_MAX);
+    }
+  }
+  retire();
+}
@@ -0,0 +1,48 @@
+#include "upload_ring.hpp"
+
+// std
+#include <algorithm>
+#include <stdexcept>
+
+UploadRing::UploadRing(
+    Device &device,
+    VkDeviceSize frameSize,
+    uint32_t frameCount,
+    VkBufferUsageFlags usage)
+    : device{device}, frameCount{frameCount} {
+  auto &limits = device.properties.limits;
+  minAlignment = std::max(
+      limits.minUniformBufferOffsetAlignment,
+      limits.minStorageBufferOffsetAlignment);
+  // Round partitions up so every frame starts on an aligned offset
+  this->frameSize = (frameSize + minAlignment - 1) / minAlignment * minAlignment;
+
+  device.createBuffer(
+      this->frameSize * frameCount,
+      usage,
+      VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+      buffer,
+      memory);
+  if (memory.mapped == nullptr) {
+    throw std::runtime_error("upload ring memory is not mapped!");
+  }
+}
+
+UploadRing::~UploadRing() { device.destroyBuffer(buffer, memory); }
+
+void UploadRing::beginFrame(uint32_t frameIndex) {
+  this->frameIndex = frameIndex % frameCount;
+  head = this->frameIndex * frameSize;
+}
+
+UploadRange UploadRing::allocate(VkDeviceSize size, VkDeviceSize alignment) {
+  // Alignments are powers of two, so the larger one satisfies both
+  alignment = std::max(alignment, minAlignment);
+  VkDeviceSize offset = (head + alignment - 1) & ~(alignment - 1);
+  if (offset + size > (frameIndex + 1) * frameSize) {
+    throw std::runtime_error("upload ring frame partition exhausted!");
+  }
+  head = offset + size;
+
+  return {static_cast<char *>(memory.mapped) + offset, buffer, offset};
+}
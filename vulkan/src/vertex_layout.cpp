@@ -0,0 +1,391 @@
+#include "vertex_layout.hpp"
+
+// std
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+
+// Encoders use SSE2 where the compiler targets it, which every x86-64 build does, and scalar code
+// elsewhere. F16C is newer than the baseline the Makefile builds for, so it is picked at runtime
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define VERTEX_ENCODE_SSE2
+#endif
+#if defined(VERTEX_ENCODE_SSE2) && defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define VERTEX_ENCODE_F16C
+#endif
+
+namespace {
+
+VkFormat attributeFormat(VertexAttribute attribute, VertexEncoding encoding) {
+  if (encoding == VertexEncoding::QUANTIZED) {
+    switch (attribute) {
+      case VertexAttribute::POSITION:
+        // Three component 16 bit formats are rarely supported for vertex input, w is left 0
+        return VK_FORMAT_R16G16B16A16_SNORM;
+      case VertexAttribute::NORMAL:
+        return VK_FORMAT_R16G16_SNORM;
+      case VertexAttribute::UV:
+        return VK_FORMAT_R16G16_SFLOAT;
+      case VertexAttribute::COLOR:
+        return VK_FORMAT_R8G8B8A8_UNORM;
+    }
+  }
+  switch (componentCount(attribute)) {
+    case 2:
+      return VK_FORMAT_R32G32_SFLOAT;
+    case 3:
+      return VK_FORMAT_R32G32B32_SFLOAT;
+    default:
+      return VK_FORMAT_R32G32B32A32_SFLOAT;
+  }
+}
+
+#ifdef VERTEX_ENCODE_SSE2
+// Four values clamped to [-1, 1] and rounded to the nearest snorm16 step, still 32 bits wide
+__m128i snorm16Lanes(__m128 values) {
+  __m128 clamped = _mm_min_ps(_mm_max_ps(values, _mm_set1_ps(-1.0f)), _mm_set1_ps(1.0f));
+  return _mm_cvtps_epi32(_mm_mul_ps(clamped, _mm_set1_ps(32767.0f)));
+}
+
+// The 32 bit lanes of words to four vertices stride bytes apart
+void storeLanes32(__m128i words, char *destination, uint32_t stride) {
+  int32_t lanes[4] = {
+      _mm_cvtsi128_si32(words),
+      _mm_cvtsi128_si32(_mm_srli_si128(words, 4)),
+      _mm_cvtsi128_si32(_mm_srli_si128(words, 8)),
+      _mm_cvtsi128_si32(_mm_srli_si128(words, 12))};
+  for (int lane = 0; lane < 4; lane++) {
+    std::memcpy(destination + lane * stride, &lanes[lane], sizeof(int32_t));
+  }
+}
+#endif
+
+// count of 2 or 4 values, clamped to [-1, 1] and rounded to the nearest step
+void storeSnorm16(const float values[4], int count, void *destination) {
+#ifdef VERTEX_ENCODE_SSE2
+  __m128i words = _mm_packs_epi32(snorm16Lanes(_mm_loadu_ps(values)), _mm_setzero_si128());
+  if (count == 4) {
+    _mm_storel_epi64(static_cast<__m128i *>(destination), words);
+  } else {
+    int32_t low = _mm_cvtsi128_si32(words);
+    std::memcpy(destination, &low, sizeof(low));
+  }
+#else
+  int16_t words[4];
+  for (int i = 0; i < count; i++) {
+    words[i] = static_cast<int16_t>(std::lrint(std::clamp(values[i], -1.0f, 1.0f) * 32767.0f));
+  }
+  std::memcpy(destination, words, count * sizeof(int16_t));
+#endif
+}
+
+// Rounds to the nearest half, ties to even, as the F16C conversion does
+uint16_t floatToHalf(float value) {
+  uint32_t bits;
+  std::memcpy(&bits, &value, sizeof(bits));
+  uint16_t sign = static_cast<uint16_t>((bits >> 16) & 0x8000);
+  uint32_t magnitude = bits & 0x7FFFFFFF;
+  if (magnitude >= 0x7F800000) {
+    // Infinity stays infinity, NaN stays a quiet NaN
+    return sign | 0x7C00 | (magnitude > 0x7F800000 ? 0x200 : 0);
+  }
+  if (magnitude >= 0x477FF000) {
+    // Rounds past 65504, the largest half
+    return sign | 0x7C00;
+  }
+  if (magnitude < 0x38800000) {
+    // Below 2^-14 halves are denormal, steps of 2^-24
+    return sign | static_cast<uint16_t>(std::nearbyint(std::fabs(value) * 16777216.0f));
+  }
+  uint32_t rounded = magnitude + 0xFFF + ((magnitude >> 13) & 1);
+  return sign | static_cast<uint16_t>((rounded - 0x38000000) >> 13);
+}
+
+void storeHalf2(const float values[2], void *destination) {
+  uint16_t halves[2] = {floatToHalf(values[0]), floatToHalf(values[1])};
+  std::memcpy(destination, halves, sizeof(halves));
+}
+
+// Folds the unit sphere onto the [-1, 1] square, error is spread evenly over all directions
+void octahedralEncode(const float normal[3], float encoded[2]) {
+  float length = std::fabs(normal[0]) + std::fabs(normal[1]) + std::fabs(normal[2]);
+  if (length == 0.0f) {
+    encoded[0] = encoded[1] = 0.0f;
+    return;
+  }
+  float x = normal[0] / length;
+  float y = normal[1] / length;
+  if (normal[2] < 0.0f) {
+    float foldedX = (1.0f - std::fabs(y)) * (x >= 0.0f ? 1.0f : -1.0f);
+    float foldedY = (1.0f - std::fabs(x)) * (y >= 0.0f ? 1.0f : -1.0f);
+    x = foldedX;
+    y = foldedY;
+  }
+  encoded[0] = x;
+  encoded[1] = y;
+}
+
+/*
+ * Batch encoders for packAttributes. Each takes whole batches from the start
+ * of count vertices and returns how many it wrote, leaving the rest to
+ * packAttribute. Results match packAttribute bit for bit.
+ */
+
+// Two positions a pack, w reads 0 and stays 0
+size_t packPositionsSnorm16(
+    const float *positions, size_t count, uint32_t stride, const PositionQuantization &quantization, char *destination) {
+  size_t vertex = 0;
+#ifdef VERTEX_ENCODE_SSE2
+  __m128 offset = _mm_setr_ps(quantization.offset[0], quantization.offset[1], quantization.offset[2], 0.0f);
+  __m128 scale = _mm_setr_ps(quantization.scale[0], quantization.scale[1], quantization.scale[2], 1.0f);
+  for (; vertex + 2 <= count; vertex += 2) {
+    const float *first = positions + vertex * 3;
+    const float *second = first + 3;
+    __m128 firstNormalized = _mm_div_ps(_mm_sub_ps(_mm_setr_ps(first[0], first[1], first[2], 0.0f), offset), scale);
+    __m128 secondNormalized = _mm_div_ps(_mm_sub_ps(_mm_setr_ps(second[0], second[1], second[2], 0.0f), offset), scale);
+    __m128i words = _mm_packs_epi32(snorm16Lanes(firstNormalized), snorm16Lanes(secondNormalized));
+    _mm_storel_epi64(reinterpret_cast<__m128i *>(destination + vertex * stride), words);
+    _mm_storel_epi64(reinterpret_cast<__m128i *>(destination + (vertex + 1) * stride), _mm_unpackhi_epi64(words, words));
+  }
+#endif
+  return vertex;
+}
+
+// Four normals at a time, one component per register
+size_t packNormalsOctahedral(const float *normals, size_t count, uint32_t stride, char *destination) {
+  size_t vertex = 0;
+#ifdef VERTEX_ENCODE_SSE2
+  const __m128 zero = _mm_setzero_ps();
+  const __m128 one = _mm_set1_ps(1.0f);
+  const __m128 signBit = _mm_set1_ps(-0.0f);
+  auto select = [](__m128 mask, __m128 ifSet, __m128 ifClear) {
+    return _mm_or_ps(_mm_and_ps(mask, ifSet), _mm_andnot_ps(mask, ifClear));
+  };
+  for (; vertex + 4 <= count; vertex += 4) {
+    const float *n = normals + vertex * 3;
+    __m128 x = _mm_setr_ps(n[0], n[3], n[6], n[9]);
+    __m128 y = _mm_setr_ps(n[1], n[4], n[7], n[10]);
+    __m128 z = _mm_setr_ps(n[2], n[5], n[8], n[11]);
+    __m128 length = _mm_add_ps(_mm_add_ps(_mm_andnot_ps(signBit, x), _mm_andnot_ps(signBit, y)), _mm_andnot_ps(signBit, z));
+    // Zero length normals encode as 0, their 0 / 0 is masked away
+    __m128 nonzero = _mm_cmpneq_ps(length, zero);
+    x = _mm_and_ps(_mm_div_ps(x, length), nonzero);
+    y = _mm_and_ps(_mm_div_ps(y, length), nonzero);
+    // Signs as the scalar encoder takes them, where -0 counts as positive
+    __m128 signX = select(_mm_cmpge_ps(x, zero), one, _mm_sub_ps(zero, one));
+    __m128 signY = select(_mm_cmpge_ps(y, zero), one, _mm_sub_ps(zero, one));
+    __m128 foldedX = _mm_mul_ps(_mm_sub_ps(one, _mm_andnot_ps(signBit, y)), signX);
+    __m128 foldedY = _mm_mul_ps(_mm_sub_ps(one, _mm_andnot_ps(signBit, x)), signY);
+    __m128 lower = _mm_cmplt_ps(z, zero);
+    __m128i encodedX = snorm16Lanes(select(lower, foldedX, x));
+    __m128i encodedY = snorm16Lanes(select(lower, foldedY, y));
+    __m128i words = _mm_packs_epi32(_mm_unpacklo_epi32(encodedX, encodedY), _mm_unpackhi_epi32(encodedX, encodedY));
+    storeLanes32(words, destination + vertex * stride, stride);
+  }
+#endif
+  return vertex;
+}
+
+#ifdef VERTEX_ENCODE_F16C
+bool hasF16C() {
+  static const bool supported = __builtin_cpu_supports("f16c");
+  return supported;
+}
+
+// Four UVs, eight floats, a conversion
+__attribute__((target("avx,f16c"))) size_t packHalf2F16C(
+    const float *values, size_t count, uint32_t stride, char *destination) {
+  size_t vertex = 0;
+  for (; vertex + 4 <= count; vertex += 4) {
+    __m128i halves = _mm256_cvtps_ph(_mm256_loadu_ps(values + vertex * 2), _MM_FROUND_TO_NEAREST_INT);
+    storeLanes32(halves, destination + vertex * stride, stride);
+  }
+  return vertex;
+}
+#endif
+
+size_t packHalf2(const float *values, size_t count, uint32_t stride, char *destination) {
+#ifdef VERTEX_ENCODE_F16C
+  if (hasF16C()) {
+    return packHalf2F16C(values, count, stride, destination);
+  }
+#endif
+  return 0;
+}
+
+}  // namespace
+
+uint32_t formatSize(VkFormat format) {
+  switch (format) {
+    case VK_FORMAT_R16G16_SNORM:
+    case VK_FORMAT_R16G16_SFLOAT:
+    case VK_FORMAT_R8G8B8A8_UNORM:
+      return 4;
+    case VK_FORMAT_R32G32_SFLOAT:
+    case VK_FORMAT_R16G16B16A16_SNORM:
+      return 8;
+    case VK_FORMAT_R32G32B32_SFLOAT:
+      return 12;
+    case VK_FORMAT_R32G32B32A32_SFLOAT:
+      return 16;
+    default:
+      throw std::runtime_error("unsupported vertex format");
+  }
+}
+
+void packAttribute(
+    const VertexElement &element,
+    const float *components,
+    const PositionQuantization &positions,
+    void *destination) {
+  switch (element.format) {
+    case VK_FORMAT_R16G16B16A16_SNORM: {
+      float normalized[4] = {0.0f, 0.0f, 0.0f, 0.0f};
+      for (int axis = 0; axis < 3; axis++) {
+        normalized[axis] = (components[axis] - positions.offset[axis]) / positions.scale[axis];
+      }
+      storeSnorm16(normalized, 4, destination);
+      break;
+    }
+    case VK_FORMAT_R16G16_SNORM: {
+      float encoded[4] = {0.0f, 0.0f, 0.0f, 0.0f};
+      octahedralEncode(components, encoded);
+      storeSnorm16(encoded, 2, destination);
+      break;
+    }
+    case VK_FORMAT_R16G16_SFLOAT:
+      storeHalf2(components, destination);
+      break;
+    case VK_FORMAT_R8G8B8A8_UNORM: {
+      uint8_t bytes[4] = {0, 0, 0, 255};
+      for (int channel = 0; channel < 3; channel++) {
+        bytes[channel] = static_cast<uint8_t>(std::lrint(std::clamp(components[channel], 0.0f, 1.0f) * 255.0f));
+      }
+      std::memcpy(destination, bytes, sizeof(bytes));
+      break;
+    }
+    default:
+      // Float formats hold the components as they are
+      std::memcpy(destination, components, formatSize(element.format));
+  }
+}
+
+void packAttributes(
+    const VertexElement &element,
+    const float *components,
+    size_t count,
+    uint32_t stride,
+    const PositionQuantization &positions,
+    void *destination) {
+  char *packed = static_cast<char *>(destination);
+  size_t done = 0;
+  switch (element.format) {
+    case VK_FORMAT_R16G16B16A16_SNORM:
+      done = packPositionsSnorm16(components, count, stride, positions, packed);
+      break;
+    case VK_FORMAT_R16G16_SNORM:
+      done = packNormalsOctahedral(components, count, stride, packed);
+      break;
+    case VK_FORMAT_R16G16_SFLOAT:
+      done = packHalf2(components, count, stride, packed);
+      break;
+    default:
+      break;
+  }
+  uint32_t floats = componentCount(element.attribute);
+  for (size_t vertex = done; vertex < count; vertex++) {
+    packAttribute(element, components + vertex * floats, positions, packed + vertex * stride);
+  }
+}
+
+uint32_t componentCount(VertexAttribute attribute) {
+  switch (attribute) {
+    case VertexAttribute::UV:
+      return 2;
+    case VertexAttribute::POSITION:
+    case VertexAttribute::NORMAL:
+    case VertexAttribute::COLOR:
+      return 3;
+  }
+  throw std::runtime_error("unknown vertex attribute");
+}
+
+VertexLayout VertexLayout::interleaved(const std::vector<VertexAttribute> &attributes, VertexEncoding encoding) {
+  VertexLayout layout{};
+  layout.encoding = encoding;
+  for (VertexAttribute attribute : attributes) {
+    layout.add(attribute, attributeFormat(attribute, encoding), 0);
+  }
+  return layout;
+}
+
+VertexLayout VertexLayout::positionSplit(const std::vector<VertexAttribute> &attributes, VertexEncoding encoding) {
+  VertexLayout layout{};
+  layout.encoding = encoding;
+  for (VertexAttribute attribute : attributes) {
+    layout.add(attribute, attributeFormat(attribute, encoding), attribute == VertexAttribute::POSITION ? 0 : 1);
+  }
+  if (layout.strides.empty() || layout.strides[0] == 0) {
+    throw std::runtime_error("position split vertex layout without positions");
+  }
+  return layout;
+}
+
+PositionQuantization VertexLayout::quantizePositions(const float *positions, size_t count) const {
+  PositionQuantization quantization{};
+  if (encoding != VertexEncoding::QUANTIZED || count == 0) {
+    return quantization;
+  }
+  for (int axis = 0; axis < 3; axis++) {
+    float low = std::numeric_limits<float>::max();
+    float high = std::numeric_limits<float>::lowest();
+    for (size_t vertex = 0; vertex < count; vertex++) {
+      low = std::min(low, positions[vertex * 3 + axis]);
+      high = std::max(high, positions[vertex * 3 + axis]);
+    }
+    // Flat along an axis, any scale keeps the single value exact
+    quantization.scale[axis] = high > low ? (high - low) * 0.5f : 1.0f;
+    quantization.offset[axis] = (high + low) * 0.5f;
+  }
+  return quantization;
+}
+
+void VertexLayout::add(VertexAttribute attribute, VkFormat format, uint32_t stream) {
+  for (const VertexElement &element : elements) {
+    if (element.attribute == attribute) {
+      throw std::runtime_error("vertex attribute added to a layout twice");
+    }
+  }
+  if (strides.size() <= stream) {
+    strides.resize(stream + 1, 0);
+  }
+  elements.push_back({attribute, format, stream, strides[stream]});
+  strides[stream] += formatSize(format);
+}
+
+std::vector<VkVertexInputBindingDescription> VertexLayout::bindingDescriptions() const {
+  std::vector<VkVertexInputBindingDescription> bindings(strides.size());
+  for (uint32_t stream = 0; stream < strides.size(); stream++) {
+    bindings[stream].binding = stream;
+    bindings[stream].stride = strides[stream];
+    bindings[stream].inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+  }
+  return bindings;
+}
+
+std::vector<VkVertexInputAttributeDescription> VertexLayout::attributeDescriptions() const {
+  std::vector<VkVertexInputAttributeDescription> attributes;
+  for (const VertexElement &element : elements) {
+    VkVertexInputAttributeDescription description{};
+    description.location = static_cast<uint32_t>(element.attribute);
+    description.binding = element.stream;
+    description.format = element.format;
+    description.offset = element.offset;
+    attributes.push_back(description);
+  }
+  return attributes;
+}
@@ -0,0 +1,21 @@
+#include "shader_archive.hpp"
+
+#include <cstdlib>
+#include <iostream>
+
+// Packs compiled shaders into the archive the app maps at startup:
+//   pack_shaders <archive> <shader.spv>...
+int main(int argc, char** argv) {
+  if (argc < 3) {
+    std::cerr << "usage: " << argv[0] << " <archive> <shader.spv>..." << std::endl;
+    return EXIT_FAILURE;
+  }
+  try {
+    ShaderArchive::write(argv[1], {argv + 2, argv + argc});
+  } catch (const std::exception& e) {
+    std::cerr << e.what() << std::endl;
+    return EXIT_FAILURE;
+  }
+  std::cout << "Packed " << argc - 2 << " shaders into " << argv[1] << std::endl;
+  return EXIT_SUCCESS;
+}
@@ -5,25 +5,49 @@
 #include <iostream>
 #include <stdexcept>
 #include <memory>
+#include <sstream>
+#include <chrono>
 
 #include "engine.hpp"
 
+struct FrameTimings
+{
+  double elapsed;
+  double recordTime;
+};
+
 class App
 {
   public:
-    App(int width, int height, const char* title, bool debug);
+    App(int width, int height, const char* title, bool headless, bool debug);
     ~App();
   
     void run();
+    void benchmark(int frames);
+    void runHeadless(int frames);
 
   private:
     std::unique_ptr<Engine> graphicsEngine;
-    GLFWwindow* window;
+    GLFWwindow* window{nullptr};
 
-    double lastTime, currentTime;
-    int numFrames;
-    float frameTime;
+    double lastTime{0.0}, currentTime{0.0};
+    int numFrames{0};
+    float frameTime{0.0f};
 
     void buildGLFWWindow(int width, int height, const char* title, bool debug);
     void calculateFrameRate();
+    FrameTimings timeFrames(int frames);
+
+    // One per subsystem, run in order by benchmark
+    void benchmarkFramesInFlight(int frames);
+    void benchmarkCommandCache(int frames);
+    void benchmarkParallelRecording(int frames);
+    void benchmarkJobSystem();
+    void benchmarkRenderGraph();
+    void benchmarkPipelineCache();
+    void benchmarkSpecialization(int frames);
+    void benchmarkReadback(int frames);
+
+    static void keyCallback(GLFWwindow* window, int key, int scancode, int action, int mods);
+    static void framebufferResizeCallback(GLFWwindow* window, int width, int height);
 };
@@ -9,7 +9,7 @@ struct commandBufferIn
 {
   vk::Device device;
   vk::CommandPool commandPool;
-  std::vector<SwapChainFrame>& frames;
+  vk::CommandBufferLevel level{vk::CommandBufferLevel::ePrimary};
 };
 
 vk::CommandPool createCommandPool(vk::Device device, vk::PhysicalDevice physicalDevice, vk::SurfaceKHR surface, const bool& debug);
@@ -14,6 +14,9 @@
 
 void logDeviceProperties(const vk::PhysicalDevice& device);
 bool checkDeviceExtensionSupport(const vk::PhysicalDevice& device, const std::vector<const char*>& requiredExtensions, const bool& debug);
-bool isSuitable(const vk::PhysicalDevice& device, bool debug);
-vk::PhysicalDevice choosePhysicalDevice(vk::Instance& instance,bool debug);
-std::pair<vk::Device,std::pair<vk::Queue,vk::Queue>> createLogicalDevice(const vk::PhysicalDevice& physicalDevice, const vk::SurfaceKHR& surface, const bool& debug);
+bool isSuitable(const vk::PhysicalDevice& device, bool headless, bool debug);
+int deviceTypeRank(const vk::PhysicalDeviceType& type);
+vk::PhysicalDevice choosePhysicalDevice(vk::Instance& instance, bool headless, bool debug);
+uint32_t findMemoryType(const vk::PhysicalDevice& device, uint32_t typeFilter, vk::MemoryPropertyFlags properties);
+bool supportsTimelineSemaphores(const vk::PhysicalDevice& device, const bool& debug);
+std::pair<vk::Device,std::pair<vk::Queue,vk::Queue>> createLogicalDevice(const vk::PhysicalDevice& physicalDevice, const vk::SurfaceKHR& surface, const bool& timelineSemaphores, const bool& debug);
@@ -0,0 +1,12 @@
+#pragma once
+
+#include <cstdint>
+
+// One non-indexed draw recorded into the main render pass
+struct DrawCommand
+{
+  uint32_t vertexCount;
+  uint32_t instanceCount;
+  uint32_t firstVertex;
+  uint32_t firstInstance;
+};
@@ -7,24 +7,103 @@
 #include <vector>
 #include <iostream>
 #include <stdexcept>
+#include <algorithm>
+#include <chrono>
 
 #include "logging.hpp"
 #include "device.hpp"
 #include "frame.hpp"
-#include "framebuffer.hpp"
 #include "commands.hpp"
+#include "draw.hpp"
 #include "sync.hpp"
 #include "swapchain.hpp"
 #include "pipeline.hpp"
-#include "commands.hpp"
+#include "pipelinecache.hpp"
+#include "shaderarchive.hpp"
+#include "rendergraph.hpp"
+#include "limiter.hpp"
+#include "offscreen.hpp"
+#include "readback.hpp"
+#include "jobs.hpp"
+
+struct EngineIn
+{
+  int width;
+  int height;
+  const char* title;
+  // nullptr renders headless into engine-owned images, without surface or present
+  GLFWwindow* window;
+  int framesInFlight;
+  // Pace frames with a Vulkan 1.2 timeline semaphore, falls back to fences when unsupported
+  bool timelineSemaphores;
+  PresentPolicy presentPolicy;
+  // Pipeline cache loaded at startup and saved on shutdown, nullptr keeps it in memory only
+  const char* pipelineCachePath;
+  // Packed by tools/packshaders, every shader module is created from it
+  const char* shaderArchivePath;
+  bool debug;
+};
+
+// How the main pipeline shades, see shaders/shader.frag
+struct ShadingParameters
+{
+  // Bake the values below in as specialization constants instead of branching on push constants
+  bool specialized;
+  int32_t iterations;
+  bool tint;
+};
+
+struct PipelineCacheTimings
+{
+  // Milliseconds to build every variant with an empty cache and with one reloaded from disk
+  double cold;
+  double warm;
+  size_t bytes;
+};
 
 class Engine
 {
   public:
-    Engine(int width, int height, const char* title, GLFWwindow* window, bool debug);
+    static constexpr int maxFramesInFlight{4};
+
+    Engine(const EngineIn& in);
     ~Engine();
   
     void render();
+    void notifyResized() { framebufferResized = true; }
+    double getResizeTime() const { return resizeTime; }
+    // Time between the starts of the last two frames, the budget a resize has to fit in
+    double getFrameTime() const { return frameTime; }
+    void setPresentPolicy(const PresentPolicy& policy);
+    const PresentPolicy& getPresentPolicy() const { return presentPolicy; }
+    void setFramesInFlight(int count);
+    int getFramesInFlight() const { return framesInFlight; }
+    bool isHeadless() const { return headless; }
+    void setDrawList(const std::vector<DrawCommand>& draws);
+    void setCommandCaching(bool enabled);
+    void invalidateCommands() { ++renderStateVersion; }
+    double getRecordTime() const { return recordTime; }
+    // Split the draw list across this many threads, each recording its own secondary command buffer
+    void setRecordingThreads(int count);
+    int getRecordingThreads() const { return recordingThreads; }
+    // Shared with the application, frame work is scheduled on it as well
+    JobSystem& getJobSystem() { return jobSystem; }
+    // Empty graph on the engine's device at the current extent, the caller destroys it
+    RenderGraph createRenderGraph();
+    // Builds this many fixed function variants of the main pipeline cold, saves the cache to path, reloads it and builds them again
+    PipelineCacheTimings benchmarkPipelineCache(int variants, const std::string& path);
+    // Rebuilds the main pipeline when specialized values change, push constant values only re-record
+    void setShading(const ShadingParameters& parameters);
+    const ShadingParameters& getShading() const { return shading; }
+    size_t getPipelineLayoutCount() const { return layoutCache.pipelineLayoutCount(); }
+    // Capture every frame, each is handed to the callback once it retires; an empty callback stops capture
+    void setReadbackCallback(const ReadbackCallback& callback);
+    bool isCapturing() const { return readback.isCreated(); }
+
+    bool usesTimelineSemaphores() const { return timelineSemaphores; }
+    uint64_t lastSubmittedFrame() const { return submittedFrames; }
+    uint64_t retiredFrame();
+    void waitForFrame(uint64_t frame);
 
   private:
     bool debugMode{true};
@@ -33,6 +112,7 @@ class Engine
     int height;
     const char* title;
     GLFWwindow* window{nullptr};
+    bool headless{false};
 
     // Instance
     vk::Instance instance{VK_NULL_HANDLE};
@@ -49,28 +129,76 @@ class Engine
     std::vector<SwapChainFrame> swapchainFrames;
     vk::Format swapchainImageFormat;
     vk::Extent2D swapchainExtent;
+    vk::ImageUsageFlags swapchainUsage;
+    bool framebufferResized{false};
+    double resizeTime{0.0};
+    double frameTime{0.0};
+    std::chrono::steady_clock::time_point frameStart{};
+    PresentPolicy presentPolicy{PresentProfile::eThroughput, 0.0};
+    FrameLimiter frameLimiter;
 
     // Pipeline
+    std::string pipelineCachePath;
+    vk::PipelineCache pipelineCache{VK_NULL_HANDLE};
+    ShaderArchive shaderArchive;
+    // Owns pipelineLayout and those of every other pipeline the engine builds
+    LayoutCache layoutCache;
     vk::PipelineLayout pipelineLayout{VK_NULL_HANDLE};
-    vk::RenderPass renderPass{VK_NULL_HANDLE};
     vk::Pipeline pipeline{VK_NULL_HANDLE};
+    ShadingParameters shading{true, 0, false};
+
+    // Frame graph, the main pass draws the draw list into the acquired image
+    RenderGraph renderGraph;
+    RenderGraphResource backbuffer{0};
+    RenderGraphPass mainPass{0};
+    // Secondary buffers the main pass executes while it is being recorded
+    SecondaryCommands* mainPassSecondary{nullptr};
 
     // Commands
     vk::CommandPool commandPool{VK_NULL_HANDLE};
-    vk::CommandBuffer mainCommandBuffer{VK_NULL_HANDLE};
+    std::vector<DrawCommand> drawList;
+    bool commandCaching{true};
+    // Bumped whenever anything recorded into the cached command buffers changes
+    uint64_t renderStateVersion{1};
+    double recordTime{0.0};
+    int recordingThreads{1};
+    JobSystem jobSystem;
+    // Rebuilt every frame from what the frame needs to do
+    TaskGraph frameGraph;
+
+    // Frames in flight
+    int framesInFlight{2};
+    int currentFrame{0};
+    std::vector<FrameInFlight> inFlightFrames;
+
+    // Frame retirement, tracked by the graphics timeline when available and by fences otherwise
+    bool timelineSemaphores{false};
+    Timeline graphicsTimeline;
+    uint64_t submittedFrames{0};
+    uint64_t retiredFrames{0};
 
-    // Sync
-    vk::Semaphore imageAvailableSemaphore{VK_NULL_HANDLE};
-    vk::Semaphore renderFinishedSemaphore{VK_NULL_HANDLE};
-    vk::Fence inFlightFence{VK_NULL_HANDLE};
+    // Readback, one staging buffer per ring slot
+    Readback readback;
 
     bool supported(std::vector<const char*>& extensions, std::vector<const char*>& layers);
     void makeInstance();
     void enableLogging();
 
     void makeDevice();
+    void makeRenderGraph();
+    void makePipelineCache();
     void makePipeline();
     void finishSetup();
+    void recreateSwapchain();
+    void destroySwapchainFrames(std::vector<SwapChainFrame>& frames);
+    void makeFrameResources();
+    void destroyFrameResources();
 
-    void recordDrawCommands(vk::CommandBuffer commandBuffer, uint32_t imageIndex);
+    void makeSecondaryCommands(SecondaryCommands& secondary);
+    void destroySecondaryCommands(SecondaryCommands& secondary);
+    void recordDrawCommands(vk::CommandBuffer commandBuffer, uint32_t imageIndex, SecondaryCommands& secondary);
+    void recordMainPass(vk::CommandBuffer commandBuffer);
+    void recordDraws(vk::CommandBuffer commandBuffer, size_t first, size_t last);
+    void makeReadback();
+    void submitFrame(FrameInFlight& frame, SwapChainFrame& target, vk::CommandBuffer commandBuffer);
 };
\ No newline at end of file
@@ -1,10 +1,44 @@
 #pragma once
 #include <vulkan/vulkan.hpp>
+#include <cstdint>
+#include <vector>
+
+// Secondary command buffers for parallel recording, one pool per recording thread
+struct SecondaryCommands
+{
+  std::vector<vk::CommandPool> commandPools;
+  std::vector<vk::CommandBuffer> commandBuffers;
+};
 
 struct SwapChainFrame
 {
   vk::Image image;
+  // Only set for engine-owned offscreen targets, swapchain images are owned by the swapchain
+  vk::DeviceMemory imageMemory;
   vk::ImageView imageView;
-  vk::Framebuffer framebuffer;
+
+  // Cached draw commands, valid while recordedVersion matches the engine's render state
+  vk::CommandBuffer commandBuffer;
+  uint64_t recordedVersion{0};
+  SecondaryCommands secondary;
+  // Last submission that used commandBuffer
+  vk::Fence inFlightFence;
+  uint64_t frameNumber{0};
+  // Signaled by the frame rendering into the image and waited on by its present. Per image
+  // rather than per ring slot, since the image is only acquired again once that present is done
+  vk::Semaphore renderFinishedSemaphore;
+};
+
+// Resources owned by one slot of the frames-in-flight ring
+struct FrameInFlight
+{
+  vk::CommandPool commandPool;
   vk::CommandBuffer commandBuffer;
-};
\ No newline at end of file
+  // Framebuffer copy, submitted after the draw commands when capture is enabled
+  vk::CommandBuffer readbackCommandBuffer;
+  SecondaryCommands secondary;
+  vk::Semaphore imageAvailableSemaphore;
+  vk::Fence inFlightFence;
+  // Frame submitted from this slot, waited on instead of the fence on the timeline path
+  uint64_t frameNumber{0};
+};
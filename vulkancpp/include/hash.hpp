@@ -0,0 +1,20 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+/**
+    FNV-1a over raw bytes. Cheap and good enough to catch torn writes and bit
+    rot in files we wrote ourselves, not meant to resist tampering.
+*/
+inline uint64_t hashBytes(const void* data, size_t size)
+{
+  const uint8_t* bytes = static_cast<const uint8_t*>(data);
+  uint64_t hash{14695981039346656037ULL};
+  for(size_t i = 0; i < size; i++)
+  {
+    hash ^= bytes[i];
+    hash *= 1099511628211ULL;
+  }
+  return hash;
+}
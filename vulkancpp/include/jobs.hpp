@@ -0,0 +1,107 @@
+#pragma once
+
+#include <vector>
+#include <deque>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <functional>
+
+// Number of unfinished jobs spawned against it, JobSystem::wait() returns once it reaches zero
+struct JobCounter
+{
+  std::atomic<int> value{0};
+};
+
+/**
+    Tasks with dependencies between them. Nodes run once every node that
+    precedes them has finished; build it once and run it every frame.
+*/
+class TaskGraph
+{
+  public:
+    using Node = size_t;
+
+    Node add(const std::function<void()>& task);
+    void precede(Node before, Node after);
+    void clear() { nodes.clear(); }
+    size_t size() const { return nodes.size(); }
+
+  private:
+    friend class JobSystem;
+
+    struct Entry
+    {
+      std::function<void()> task;
+      std::vector<Node> successors;
+      int dependencies{0};
+      std::atomic<int> remaining{0};
+    };
+    // Entries hold atomics, so they must never move
+    std::deque<Entry> nodes;
+};
+
+/**
+    Work-stealing scheduler. Every thread owns a deque, it pushes and pops
+    its own jobs at the back and steals from the front of the others when it
+    runs dry. Threads that are not workers, such as the render thread, share
+    deque 0 and run jobs while they wait, so blocking on a job never idles
+    a core.
+*/
+class JobSystem
+{
+  public:
+    using Task = std::function<void()>;
+    using RangeTask = std::function<void(size_t begin, size_t end)>;
+
+    JobSystem();
+    ~JobSystem() { stop(); }
+
+    void start(int threadCount);
+    void stop();
+    // Worker threads, not counting the threads that only wait
+    int size() const { return workerCount; }
+    // 0 on any thread that is not a worker of this system
+    int threadIndex() const;
+
+    void spawn(const Task& task, JobCounter* counter = nullptr);
+    void wait(JobCounter& counter);
+    // Runs task over [0, count) in chunks of at most grain and returns once all of them are done
+    void parallelFor(size_t count, size_t grain, const RangeTask& task);
+    void run(TaskGraph& graph);
+
+  private:
+    struct Job
+    {
+      Task task;
+      JobCounter* counter;
+    };
+
+    struct WorkQueue
+    {
+      std::mutex mutex;
+      std::deque<Job> jobs;
+    };
+
+    // Idle spins before a worker goes to sleep, keeps wake-up latency off short gaps between jobs
+    static constexpr int idleSpins{256};
+
+    std::vector<std::thread> threads;
+    // Fixed while the workers run, threads itself is still being filled when the first ones start
+    int workerCount{0};
+    std::vector<std::unique_ptr<WorkQueue>> queues;
+    std::atomic<int> queuedJobs{0};
+    std::atomic<int> sleepingWorkers{0};
+    std::atomic<bool> stopping{false};
+    std::mutex sleepMutex;
+    std::condition_variable wake;
+
+    void workerLoop(int index);
+    bool tryRunOne(int index);
+    bool pop(int index, Job& job);
+    bool steal(int index, Job& job);
+    void execute(Job& job);
+    void spawnNode(TaskGraph& graph, TaskGraph::Node node, JobCounter* counter);
+};
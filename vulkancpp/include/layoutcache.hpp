@@ -0,0 +1,37 @@
+#pragma once
+
+#include <vulkan/vulkan.hpp>
+#include <cstdint>
+#include <map>
+#include <vector>
+#include <iostream>
+#include <stdexcept>
+
+#include "reflection.hpp"
+
+/**
+    Descriptor set and pipeline layouts built from ShaderReflection, created
+    once per distinct layout however many pipelines ask for it. Handles stay
+    valid until the cache is destroyed, so pipelines share them and never
+    destroy them themselves.
+*/
+class LayoutCache
+{
+  public:
+    void create(vk::Device device) { this->device = device; }
+    void destroy();
+
+    // Bindings sorted by binding number, as reflection leaves them
+    vk::DescriptorSetLayout getSetLayout(const std::vector<vk::DescriptorSetLayoutBinding>& bindings, const bool& debug);
+    // Set numbers the reflection skips get an empty set layout
+    vk::PipelineLayout getPipelineLayout(const ShaderReflection& reflection, const bool& debug);
+
+    size_t setLayoutCount() const { return setLayouts.size(); }
+    size_t pipelineLayoutCount() const { return pipelineLayouts.size(); }
+
+  private:
+    vk::Device device;
+    // Keyed by every field that goes into the create info, so equal keys mean equal layouts
+    std::map<std::vector<uint32_t>, vk::DescriptorSetLayout> setLayouts;
+    std::map<std::vector<uint32_t>, vk::PipelineLayout> pipelineLayouts;
+};
@@ -0,0 +1,27 @@
+#pragma once
+
+#include <chrono>
+#include <thread>
+
+/**
+    CPU-side frame pacing. Sleeps until shortly before the next frame deadline
+    and spins the rest of the way, since sleep granularity alone is too coarse
+    for stable frame times.
+*/
+class FrameLimiter
+{
+  public:
+    void setTargetFrameRate(double frameRate);
+    double getTargetFrameRate() const { return targetFrameRate; }
+    void wait();
+
+  private:
+    using Clock = std::chrono::steady_clock;
+
+    // Sleeping closer than this to the deadline risks oversleeping
+    static constexpr std::chrono::microseconds spinMargin{1500};
+
+    double targetFrameRate{0.0};
+    Clock::duration period{0};
+    Clock::time_point deadline{};
+};
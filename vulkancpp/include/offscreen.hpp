@@ -0,0 +1,26 @@
+#pragma once
+
+#include <vulkan/vulkan.hpp>
+#include <vector>
+#include <iostream>
+#include <stdexcept>
+
+#include "device.hpp"
+#include "swapchain.hpp"
+#include "frame.hpp"
+
+struct OffscreenIn
+{
+  vk::PhysicalDevice physicalDevice;
+  vk::Device device;
+  vk::Extent2D extent;
+  vk::Format format;
+  uint32_t imageCount;
+};
+
+/**
+    Create engine-owned color targets for headless rendering. The returned
+    bundle has no swapchain handle, each frame owns its image memory and can be
+    copied from once rendering has finished.
+*/
+SwapChain createOffscreenTargets(const OffscreenIn& in, const bool& debug);
@@ -2,27 +2,86 @@
 
 #include <vulkan/vulkan.hpp>
 #include <vector>
+#include <array>
+#include <algorithm>
 #include <iostream>
 #include <stdexcept>
 
 #include "shader.hpp"
+#include "specialization.hpp"
+#include "layoutcache.hpp"
+
+// Fragment push constants of the main pipeline, read by shader.frag when it is not specialized
+struct ShadingPushConstants
+{
+  int32_t iterations;
+  VkBool32 tint;
+};
 
 struct GraphicsPipelineIn
 {
   vk::Device device;
-  std::string vertexFilePath;
-  std::string fragmentFilePath;
-  vk::Extent2D extent;
-  vk::Format swapchainImageFormat;
+  // Found in the engine's ShaderArchive, only read while the pipeline is created
+  ShaderCode vertexShader;
+  ShaderCode fragmentShader;
+  SpecializationConstants vertexSpecialization;
+  SpecializationConstants fragmentSpecialization;
+  // Owns the layout derived from the shaders, pipelines with equal layouts share one
+  LayoutCache* layoutCache;
+  // Any render pass compatible with the ones the pipeline is used in
+  vk::RenderPass renderPass;
+  // Optional, compiled state is looked up in and added to it
+  vk::PipelineCache pipelineCache;
+  // Fixed function state that differs between variants of the same shaders
+  vk::PrimitiveTopology topology{vk::PrimitiveTopology::eTriangleList};
+  vk::CullModeFlags cullMode{vk::CullModeFlagBits::eBack};
+  vk::FrontFace frontFace{vk::FrontFace::eClockwise};
+  bool blend{false};
 };
 
 struct GraphicsPipelineOut
 {
+  // Owned by in.layoutCache
   vk::PipelineLayout pipelineLayout;
-  vk::RenderPass renderPass;
   vk::Pipeline pipeline;
 };
 
-vk::PipelineLayout createPipelineLayout(const vk::Device& device, const bool& debug);
-vk::RenderPass createRenderPass(const vk::Device& device, const vk::Format& swapChainImageFormat, const bool& debug);
-GraphicsPipelineOut createGraphicsPipeline(const GraphicsPipelineIn& in, const bool& debug);
\ No newline at end of file
+GraphicsPipelineOut createGraphicsPipeline(const GraphicsPipelineIn& in, const bool& debug);
+
+struct ComputePipelineIn
+{
+  vk::Device device;
+  // Found in the engine's ShaderArchive, only read while the pipeline is created
+  ShaderCode computeShader;
+  SpecializationConstants specialization;
+  // Owns the layout derived from the shader, its set layouts are the ones to allocate sets with
+  LayoutCache* layoutCache;
+  // Optional, compiled state is looked up in and added to it
+  vk::PipelineCache pipelineCache;
+};
+
+struct ComputePipelineOut
+{
+  // Owned by in.layoutCache
+  vk::PipelineLayout pipelineLayout;
+  vk::Pipeline pipeline;
+  // Invocations per workgroup along x, as the shader declares it
+  uint32_t workgroupSize;
+};
+
+ComputePipelineOut createComputePipeline(const ComputePipelineIn& in, const bool& debug);
+
+/**
+    Dispatch enough workgroups for one invocation per element, capped at
+    maxGroupCount (limits.maxComputeWorkGroupCount[0]). Shaders step through
+    elements with a stride of gl_NumWorkGroups.x * gl_WorkGroupSize.x so the
+    cap never drops any.
+*/
+void dispatchCompute(vk::CommandBuffer commandBuffer, const ComputePipelineOut& pipeline, uint32_t elements, uint32_t maxGroupCount);
+
+/**
+    Make compute shader writes visible to later graphics work reading them at
+    dstStages with dstAccess, e.g. vertex input reading skinned vertices.
+    Compute runs on the graphics queue, so no ownership transfer is needed.
+*/
+void recordComputeToGraphicsBarrier(vk::CommandBuffer commandBuffer, vk::AccessFlags dstAccess, vk::PipelineStageFlags dstStages);
@@ -0,0 +1,31 @@
+#pragma once
+
+#include <vulkan/vulkan.hpp>
+#include <vector>
+#include <string>
+#include <iostream>
+#include <stdexcept>
+
+struct PipelineCacheIn
+{
+  vk::PhysicalDevice physicalDevice;
+  vk::Device device;
+  std::string path;
+};
+
+/**
+    Create a pipeline cache seeded from the file at in.path. The file wraps
+    the driver's cache data with a checksum and the driver version, and the
+    data's own header must match this physical device's vendor, device and
+    cache UUID. Anything missing, torn or written by another driver yields an
+    empty cache instead of handing the driver data it might crash on.
+*/
+vk::PipelineCache loadPipelineCache(const PipelineCacheIn& in, const bool& debug);
+
+/**
+    Write the cache's data to in.path through a temporary file that is renamed
+    over the old one, so an interrupted save never leaves a partial cache.
+    Saving is best effort and reports failure instead of throwing, since it
+    runs during shutdown.
+*/
+bool savePipelineCache(const PipelineCacheIn& in, vk::PipelineCache cache, const bool& debug);
@@ -0,0 +1,74 @@
+#pragma once
+
+#include <vulkan/vulkan.hpp>
+#include <vector>
+#include <algorithm>
+#include <functional>
+#include <iostream>
+#include <stdexcept>
+
+#include "device.hpp"
+
+// Pixels of one finished frame, only valid for the duration of the callback
+struct ReadbackFrame
+{
+  uint64_t frameNumber;
+  vk::Extent2D extent;
+  vk::Format format;
+  const void* data;
+  // Tightly packed, 4 bytes per pixel
+  uint32_t rowPitch;
+};
+
+using ReadbackCallback = std::function<void(const ReadbackFrame&)>;
+
+struct ReadbackIn
+{
+  vk::PhysicalDevice physicalDevice;
+  vk::Device device;
+  vk::Extent2D extent;
+  vk::Format format;
+  uint32_t slotCount;
+};
+
+/**
+    Ring of persistently mapped host-visible staging buffers, one per frame in
+    flight. Copies are recorded into the frame's own command buffer and never
+    waited on here; a slot's pixels are handed to the callback only once the
+    engine has seen that slot's frame retire, so capture never stalls the queue.
+*/
+class Readback
+{
+  public:
+    void create(const ReadbackIn& in, const bool& debug);
+    void destroy();
+    bool isCreated() const { return !slots.empty(); }
+    const vk::Extent2D& getExtent() const { return extent; }
+
+    void setCallback(const ReadbackCallback& consumer) { callback = consumer; }
+
+    // Copy image into the slot's buffer, image is left in the layout it was in
+    void record(vk::CommandBuffer commandBuffer, uint32_t slot, vk::Image image, vk::ImageLayout layout, uint64_t frameNumber);
+    // Hand a captured frame to the callback, the frame must have retired
+    void deliver(uint32_t slot);
+    // Deliver every captured frame in submission order, all of them must have retired
+    void flush();
+
+  private:
+    struct Slot
+    {
+      vk::Buffer buffer;
+      vk::DeviceMemory memory;
+      void* mapped{nullptr};
+      // 0 when nothing is waiting to be delivered
+      uint64_t frameNumber{0};
+    };
+
+    vk::Device device{VK_NULL_HANDLE};
+    vk::Extent2D extent;
+    vk::Format format;
+    vk::DeviceSize size{0};
+    bool coherent{true};
+    std::vector<Slot> slots;
+    ReadbackCallback callback;
+};
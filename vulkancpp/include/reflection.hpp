@@ -0,0 +1,42 @@
+#pragma once
+
+#include <vulkan/vulkan.hpp>
+#include <array>
+#include <cstdint>
+#include <map>
+#include <vector>
+#include <stdexcept>
+
+#include "shaderarchive.hpp"
+
+/**
+    What a pipeline's shaders expect from their layouts, read from the SPIR-V
+    so layouts never have to be written by hand. Each stage is reflected on
+    its own and merged into one reflection per pipeline.
+*/
+struct ShaderReflection
+{
+  vk::ShaderStageFlags stages;
+  // Bindings sorted by binding number, keyed by set number
+  std::map<uint32_t, std::vector<vk::DescriptorSetLayoutBinding>> descriptorSets;
+  // At most one range, covering every stage's push constant block
+  std::vector<vk::PushConstantRange> pushConstantRanges;
+  // Vertex stage inputs, assumed interleaved in binding 0 in location order without padding
+  std::vector<vk::VertexInputAttributeDescription> vertexAttributes;
+  uint32_t vertexStride{0};
+  // Compute workgroup size as declared, sizes set through specialization constants are not seen
+  std::array<uint32_t, 3> localSize{1, 1, 1};
+};
+
+/**
+    Reflect one shader stage. Throws when the code is not valid SPIR-V or
+    declares a resource that has no descriptor type.
+*/
+ShaderReflection reflectShader(const ShaderCode& code);
+
+/**
+    Add another stage of the same pipeline to into. Bindings used by both get
+    both stage flags and the push constant ranges become one; throws when the
+    stages disagree on what a binding is.
+*/
+void mergeReflection(ShaderReflection& into, const ShaderReflection& other);
@@ -0,0 +1,150 @@
+#pragma once
+
+#include <vulkan/vulkan.hpp>
+#include <vector>
+#include <map>
+#include <array>
+#include <string>
+#include <functional>
+#include <algorithm>
+#include <iostream>
+#include <stdexcept>
+
+#include "device.hpp"
+
+using RenderGraphResource = uint32_t;
+using RenderGraphPass = uint32_t;
+
+struct RenderGraphStats
+{
+  uint32_t passes;
+  uint32_t culledPasses;
+  // Transient image memory with and without aliasing
+  vk::DeviceSize transientBytes;
+  vk::DeviceSize allocatedBytes;
+  // Merged dependencies actually emitted, against one barrier per hazardous resource access
+  uint32_t barriers;
+  uint32_t unmergedBarriers;
+};
+
+/**
+    Declarative frame graph. Passes declare the images they write as
+    attachments and the images they sample, and compile() derives the rest:
+    load and store ops, layout transitions folded into each render pass,
+    one merged dependency per pass, culling of passes whose results are never
+    used, and memory aliasing between transient images whose lifetimes do
+    not overlap. Everything is sized to the graph's extent.
+
+    The graph is declared and compiled once and executed every frame;
+    imported images such as swapchain images are bound before each execute.
+*/
+class RenderGraph
+{
+  public:
+    using RecordFunction = std::function<void(vk::CommandBuffer)>;
+
+    void create(const vk::PhysicalDevice& physicalDevice, const vk::Device& device, const vk::Extent2D& extent, const bool& debug);
+    // Releases compiled objects and forgets all declarations
+    void destroy();
+
+    // Owned elsewhere; initialLayout is what it is in when the graph starts, finalLayout what the graph leaves it in
+    RenderGraphResource importImage(const std::string& name, vk::Format format, vk::ImageLayout initialLayout, vk::ImageLayout finalLayout);
+    // Owned by the graph and only valid between the first and last pass that uses it
+    RenderGraphResource createImage(const std::string& name, vk::Format format);
+    // Keeps a resource, and the passes producing it, alive without an imported image
+    void markOutput(RenderGraphResource resource);
+
+    RenderGraphPass addPass(const std::string& name, const RecordFunction& record);
+    void writeColor(RenderGraphPass pass, RenderGraphResource resource, bool clear, std::array<float, 4> clearColor = {0.0f, 0.0f, 0.0f, 1.0f});
+    void writeDepth(RenderGraphPass pass, RenderGraphResource resource, bool clear);
+    void read(RenderGraphPass pass, RenderGraphResource resource);
+    void setContents(RenderGraphPass pass, vk::SubpassContents contents);
+
+    void compile();
+    // Re-creates transient images at the new extent; framebuffers are dropped either way since imported views may have changed
+    void setExtent(const vk::Extent2D& newExtent);
+
+    void bindImage(RenderGraphResource resource, vk::Image image, vk::ImageView view);
+    bool isCulled(RenderGraphPass pass) const { return !passes[pass].alive; }
+    vk::RenderPass getRenderPass(RenderGraphPass pass) const { return passes[pass].renderPass; }
+    // For the images currently bound, created on first use
+    vk::Framebuffer getFramebuffer(RenderGraphPass pass);
+    void execute(vk::CommandBuffer commandBuffer);
+
+    const RenderGraphStats& getStats() const { return stats; }
+
+  private:
+    enum class Access
+    {
+      eColor,
+      eDepth,
+      eRead
+    };
+
+    struct Use
+    {
+      RenderGraphResource resource;
+      Access access;
+      bool clear;
+      vk::ClearValue clearValue;
+    };
+
+    struct Resource
+    {
+      std::string name;
+      vk::Format format;
+      bool imported;
+      bool output{false};
+      vk::ImageLayout initialLayout{vk::ImageLayout::eUndefined};
+      vk::ImageLayout finalLayout{vk::ImageLayout::eUndefined};
+
+      vk::Image image;
+      vk::ImageView view;
+      vk::ImageUsageFlags usage;
+      // Alive passes, in execution order, that touch it
+      int firstPass{-1};
+      int lastPass{-1};
+      vk::DeviceSize size{0};
+      // Transient whose memory it reuses, -1 if none
+      int aliasOf{-1};
+      // For the first transient in its memory, the last one in it, whose use in the previous frame its first use waits for
+      int lastOccupant{-1};
+    };
+
+    struct Pass
+    {
+      std::string name;
+      RecordFunction record;
+      std::vector<Use> uses;
+      vk::SubpassContents contents{vk::SubpassContents::eInline};
+      bool alive{false};
+
+      vk::RenderPass renderPass;
+      std::vector<RenderGraphResource> attachments;
+      std::vector<vk::ClearValue> clearValues;
+      // Sampled images still in an attachment layout, transitioned before the pass begins
+      std::vector<vk::ImageMemoryBarrier> preBarriers;
+      std::vector<RenderGraphResource> preBarrierResources;
+      vk::PipelineStageFlags preSrcStages;
+      std::map<std::vector<VkImageView>, vk::Framebuffer> framebuffers;
+    };
+
+    vk::PhysicalDevice physicalDevice{VK_NULL_HANDLE};
+    vk::Device device{VK_NULL_HANDLE};
+    vk::Extent2D extent;
+    bool debugMode{false};
+    bool compiled{false};
+
+    std::vector<Resource> resources;
+    std::vector<Pass> passes;
+    std::vector<vk::DeviceMemory> memoryBlocks;
+    RenderGraphStats stats{};
+
+    void cullPasses();
+    void createTransients();
+    void destroyTransients();
+    void buildRenderPasses();
+    void destroyFramebuffers();
+    bool isDepthFormat(vk::Format format) const;
+    vk::ImageAspectFlags aspectMask(vk::Format format) const;
+};
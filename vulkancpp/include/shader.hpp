@@ -2,9 +2,13 @@
 
 #include <string>
 #include <vector>
-#include <fstream>
 #include <iostream>
 #include <vulkan/vulkan.hpp>
 
-std::vector<char> readFile(const std::string& filename, bool debug);
-vk::ShaderModule createShaderModule(std::string filename, vk::Device device, const bool& debug);
\ No newline at end of file
+#include "shaderarchive.hpp"
+
+/**
+    Create a shader module straight from code mapped by a ShaderArchive, the
+    driver reads the words in place.
+*/
+vk::ShaderModule createShaderModule(const ShaderCode& code, vk::Device device, const bool& debug);
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <iostream>
+#include <stdexcept>
+
+// SPIR-V inside an open ShaderArchive, valid until the archive is closed
+struct ShaderCode
+{
+  const uint32_t* words;
+  // In bytes, as vk::ShaderModuleCreateInfo::codeSize takes it
+  size_t size;
+  uint64_t hash;
+};
+
+/**
+    Every shader of the program packed into one file at build time by
+    tools/packshaders. The file is mapped once when opened and shader modules
+    are created straight from the mapped words, so startup opens a single
+    file however many shaders there are and never copies the bytecode.
+*/
+class ShaderArchive
+{
+  public:
+    // With debug every entry is checked against its hash once it is mapped
+    void open(const std::string& path, const bool& debug);
+    void close();
+    bool isOpen() const { return mapping != nullptr; }
+
+    // Throws when no shader was packed under name
+    ShaderCode find(const std::string& name) const;
+    size_t shaderCount() const { return index.size(); }
+
+    // Pack each file under its name without directory and extension, "build/shaders/vert.spv" as "vert"
+    static void write(const std::string& path, const std::vector<std::string>& files);
+
+  private:
+    void readIndex(const bool& debug);
+
+    void* mapping{nullptr};
+    size_t mappingSize{0};
+    std::unordered_map<std::string, ShaderCode> index;
+};
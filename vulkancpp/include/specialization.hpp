@@ -0,0 +1,32 @@
+#pragma once
+
+#include <vulkan/vulkan.hpp>
+#include <cstdint>
+#include <vector>
+
+/**
+    Values for a shader's constant_id constants, folded in by the driver when
+    the pipeline is created so toggles, loop counts and workgroup sizes cost
+    nothing at run time. Constants are kept sorted by id, so the same values
+    set in any order give the same data, which the pipeline cache keys on.
+*/
+class SpecializationConstants
+{
+  public:
+    // Overloads rather than a template, only the 32 bit scalars a GLSL constant can be
+    SpecializationConstants& set(uint32_t constantId, bool value);
+    SpecializationConstants& set(uint32_t constantId, int32_t value);
+    SpecializationConstants& set(uint32_t constantId, uint32_t value);
+    SpecializationConstants& set(uint32_t constantId, float value);
+
+    bool empty() const { return entries.empty(); }
+    // Points into this object, which has to outlive the pipeline creation it is used in
+    vk::SpecializationInfo info() const;
+
+  private:
+    void setWord(uint32_t constantId, uint32_t word);
+
+    std::vector<vk::SpecializationMapEntry> entries;
+    // One 32 bit word per entry, in the order of entries
+    std::vector<uint32_t> data;
+};
@@ -4,6 +4,8 @@
 #include <vector>
 #include <iostream>
 #include <stdexcept>
+#include <string>
+#include <algorithm>
 
 #include "queuefamilies.hpp"
 #include "logging.hpp"
@@ -16,16 +18,34 @@ struct SwapChainSupportDetails
   std::vector<vk::PresentModeKHR> presentModes;
 };
 
+// What the swapchain should be tuned for when choosing present mode and image count
+enum class PresentProfile
+{
+  eThroughput,
+  eLatency,
+  ePower
+};
+
+struct PresentPolicy
+{
+  PresentProfile profile;
+  // CPU-side frame rate cap, 0 for unlimited
+  double targetFrameRate;
+};
+
 struct SwapChain
 {
   vk::SwapchainKHR swapChain;
   std::vector<SwapChainFrame> frames;
   vk::Format format;
   vk::Extent2D extent;
+  vk::ImageUsageFlags usage;
 };
 
 SwapChainSupportDetails querySwapChainSupport(const vk::PhysicalDevice& device, const vk::SurfaceKHR& surface, const bool& debug);
 vk::SurfaceFormatKHR chooseSwapSurfaceFormat(const std::vector<vk::SurfaceFormatKHR>& availableFormats);
-vk::PresentModeKHR chooseSwapPresentMode(const std::vector<vk::PresentModeKHR>& availablePresentModes);
+vk::PresentModeKHR chooseSwapPresentMode(const std::vector<vk::PresentModeKHR>& availablePresentModes, const PresentProfile& profile);
+uint32_t chooseSwapImageCount(const vk::SurfaceCapabilitiesKHR& capabilities, const PresentProfile& profile);
+std::string presentProfileName(const PresentProfile& profile);
 vk::Extent2D chooseSwapExtent(const vk::SurfaceCapabilitiesKHR& capabilities, int width, int height);
-SwapChain crateSwapChain(const vk::PhysicalDevice& physicalDevice, const vk::Device& device, const vk::SurfaceKHR& surface, const int& width, const int& height, const bool& debug);
+SwapChain crateSwapChain(const vk::PhysicalDevice& physicalDevice, const vk::Device& device, const vk::SurfaceKHR& surface, const int& width, const int& height, const PresentProfile& profile, const vk::SwapchainKHR& oldSwapchain, const bool& debug);
@@ -2,6 +2,7 @@
 
 #include <vulkan/vulkan.hpp>
 #include <vector>
+#include <atomic>
 #include <iostream>
 #include <stdexcept>
 
@@ -9,3 +10,33 @@
 
 vk::Semaphore createSemaphore(const vk::Device& device, const bool& debug);
 vk::Fence createFence(const vk::Device& device, const bool& debug);
+vk::Semaphore createTimelineSemaphore(const vk::Device& device, uint64_t initialValue, const bool& debug);
+
+/**
+    Monotonically increasing GPU progress counter for one queue, backed by a
+    Vulkan 1.2 timeline semaphore. Every submission signals the next value, so
+    "value N retired" can be checked or waited on without any fences.
+    completed() only reads an atomic and the semaphore counter, so it may be
+    called from any thread.
+*/
+class Timeline
+{
+  public:
+    void create(const vk::Device& device, const bool& debug);
+    void destroy();
+
+    vk::Semaphore getSemaphore() const { return semaphore; }
+    uint64_t next() { return ++submittedValue; }
+    uint64_t lastSubmitted() const { return submittedValue.load(std::memory_order_acquire); }
+    uint64_t completed();
+    bool isComplete(uint64_t value);
+    void wait(uint64_t value);
+
+  private:
+    vk::Device device{VK_NULL_HANDLE};
+    vk::Semaphore semaphore{VK_NULL_HANDLE};
+    std::atomic<uint64_t> submittedValue{0};
+    std::atomic<uint64_t> completedValue{0};
+
+    void retire(uint64_t value);
+};
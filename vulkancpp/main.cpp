@@ -1,11 +1,25 @@
 #include <memory>
+#include <string>
 
 #include "app.hpp"
 
-int main()
+int main(int argc, char** argv)
 {
-  std::unique_ptr<App> app = std::make_unique<App>(800, 600, "Vulkan App", true);
-  app->run();
+  std::string mode = argc > 1 ? argv[1] : "";
+  bool headless = mode == "--headless";
+  std::unique_ptr<App> app = std::make_unique<App>(800, 600, "Vulkan App", headless, true);
+  if(mode == "--benchmark")
+  {
+    app->benchmark(2000);
+  }
+  else if(headless)
+  {
+    app->runHeadless(argc > 2 ? std::stoi(argv[2]) : 1000);
+  }
+  else
+  {
+    app->run();
+  }
   
   return 0;
 }
\ No newline at end of file
@@ -1,10 +1,34 @@
 #version 450
 
+// Specialized pipelines fold these in, the others branch on the push constants
+layout(constant_id = 0) const bool SPECIALIZED = true;
+layout(constant_id = 1) const int ITERATIONS = 0;
+layout(constant_id = 2) const bool TINT = false;
+
+layout(push_constant) uniform Shading
+{
+    int iterations;
+    bool tint;
+} shading;
+
 layout(location = 0) in vec3 fragColor;
 
 layout(location = 0) out vec4 outColor;
 
 void main()
 {
-    outColor = vec4(fragColor, 1.0);
-}
\ No newline at end of file
+    int iterations = SPECIALIZED ? ITERATIONS : shading.iterations;
+    bool tint = SPECIALIZED ? TINT : shading.tint;
+
+    // Stands in for per pixel work whose amount depends on the material
+    vec3 color = fragColor;
+    for(int i = 0; i < iterations; i++)
+    {
+        color = fract(color * 1.618034 + vec3(0.1, 0.2, 0.3));
+    }
+    if(tint)
+    {
+        color *= vec3(1.0, 0.8, 0.6);
+    }
+    outColor = vec4(color, 1.0);
+}
@@ -1,16 +1,37 @@
 #include "app.hpp"
 
-App::App(int width, int height, const char* title, bool debug)
+App::App(int width, int height, const char* title, bool headless, bool debug)
 {
-  buildGLFWWindow(width, height, title, debug);
-  graphicsEngine = std::make_unique<Engine>(width, height, title, window, debug);
+  if(!headless)
+  {
+    buildGLFWWindow(width, height, title, debug);
+  }
+  EngineIn engineIn = {};
+  engineIn.width = width;
+  engineIn.height = height;
+  engineIn.title = title;
+  engineIn.window = window;
+  engineIn.framesInFlight = 2;
+  engineIn.timelineSemaphores = true;
+  engineIn.presentPolicy = {PresentProfile::eThroughput, 0.0};
+  engineIn.pipelineCachePath = "build/pipeline_cache.bin";
+  engineIn.shaderArchivePath = "build/shaders/shaders.pak";
+  engineIn.debug = debug;
+  graphicsEngine = std::make_unique<Engine>(engineIn);
+  if(headless)
+  {
+    return;
+  }
+  glfwSetWindowUserPointer(window, this);
+  glfwSetKeyCallback(window, keyCallback);
+  glfwSetFramebufferSizeCallback(window, framebufferResizeCallback);
 }
 
 void App::buildGLFWWindow(int width, int height, const char* title, bool debug)
 {
   glfwInit();
   glfwWindowHint(GLFW_CLIENT_API, GLFW_NO_API);
-  glfwWindowHint(GLFW_RESIZABLE, GLFW_FALSE);
+  glfwWindowHint(GLFW_RESIZABLE, GLFW_TRUE);
 
   if(window = glfwCreateWindow(width, height, title, nullptr, nullptr))
   {
@@ -35,6 +56,274 @@ void App::run()
   }
 }
 
+// Number keys 1-4 change the depth of the frames-in-flight ring at runtime,
+// T/L/P switch the present profile and F toggles a 60 fps cap
+void App::keyCallback(GLFWwindow* window, int key, int scancode, int action, int mods)
+{
+  App* app = static_cast<App*>(glfwGetWindowUserPointer(window));
+  if(action != GLFW_PRESS)
+  {
+    return;
+  }
+
+  if(key >= GLFW_KEY_1 && key <= GLFW_KEY_0 + Engine::maxFramesInFlight)
+  {
+    app->graphicsEngine->setFramesInFlight(key - GLFW_KEY_0);
+    return;
+  }
+
+  PresentPolicy policy = app->graphicsEngine->getPresentPolicy();
+  switch(key)
+  {
+  case GLFW_KEY_T:
+    policy.profile = PresentProfile::eThroughput;
+    break;
+  case GLFW_KEY_L:
+    policy.profile = PresentProfile::eLatency;
+    break;
+  case GLFW_KEY_P:
+    policy.profile = PresentProfile::ePower;
+    break;
+  case GLFW_KEY_F:
+    policy.targetFrameRate = policy.targetFrameRate > 0.0 ? 0.0 : 60.0;
+    break;
+  default:
+    return;
+  }
+  app->graphicsEngine->setPresentPolicy(policy);
+}
+
+void App::framebufferResizeCallback(GLFWwindow* window, int width, int height)
+{
+  App* app = static_cast<App*>(glfwGetWindowUserPointer(window));
+  app->graphicsEngine->notifyResized();
+}
+
+FrameTimings App::timeFrames(int frames)
+{
+  FrameTimings timings = {0.0, 0.0};
+  auto start = std::chrono::steady_clock::now();
+  for(int i = 0; i < frames; i++)
+  {
+    if(window)
+    {
+      glfwPollEvents();
+    }
+    graphicsEngine->render();
+    timings.recordTime += graphicsEngine->getRecordTime();
+  }
+  // Wait for the GPU so headless runs measure finished frames, not queued ones
+  graphicsEngine->waitForFrame(graphicsEngine->lastSubmittedFrame());
+  timings.elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  return timings;
+}
+
+void App::runHeadless(int frames)
+{
+  timeFrames(std::max(1, frames / 10));
+  double elapsed = timeFrames(frames).elapsed;
+  std::cout << "Headless: rendered " << frames << " frames in " << elapsed << " s, "
+            << frames / elapsed << " frames per second\n";
+}
+
+void App::benchmark(int frames)
+{
+  benchmarkFramesInFlight(frames);
+  benchmarkCommandCache(frames);
+  benchmarkParallelRecording(frames);
+  benchmarkJobSystem();
+  benchmarkRenderGraph();
+  benchmarkPipelineCache();
+  benchmarkSpecialization(frames);
+  benchmarkReadback(frames);
+}
+
+void App::benchmarkFramesInFlight(int frames)
+{
+  std::cout << "Frames in flight benchmark, " << frames << " frames per run\n";
+  for(int depth = 1; depth <= Engine::maxFramesInFlight; depth++)
+  {
+    graphicsEngine->setFramesInFlight(depth);
+    // Warm up so pipeline creation and first presents are not measured
+    timeFrames(std::max(1, frames / 10));
+    double elapsed = timeFrames(frames).elapsed;
+    std::cout << "\tFrames in flight: " << depth
+              << ", average frame time: " << elapsed * 1000.0 / frames << " ms"
+              << ", frame rate: " << int(frames / elapsed) << "\n";
+  }
+}
+
+void App::benchmarkCommandCache(int frames)
+{
+  const int drawCount = 10000;
+  std::cout << "Command cache benchmark, " << drawCount << " draws per frame\n";
+  graphicsEngine->setFramesInFlight(2);
+  graphicsEngine->setDrawList(std::vector<DrawCommand>(drawCount, DrawCommand{3, 1, 0, 0}));
+  for(bool caching : {false, true})
+  {
+    graphicsEngine->setCommandCaching(caching);
+    timeFrames(std::max(1, frames / 10));
+    FrameTimings timings = timeFrames(frames);
+    std::cout << "\tCommand caching: " << (caching ? "on" : "off")
+              << ", average record time: " << timings.recordTime / frames << " ms"
+              << ", average frame time: " << timings.elapsed * 1000.0 / frames << " ms\n";
+  }
+}
+
+void App::benchmarkParallelRecording(int frames)
+{
+  const int parallelDrawCount = 50000;
+  std::cout << "Parallel recording benchmark, " << parallelDrawCount << " draws per frame\n";
+  graphicsEngine->setCommandCaching(false);
+  graphicsEngine->setDrawList(std::vector<DrawCommand>(parallelDrawCount, DrawCommand{3, 1, 0, 0}));
+  int maxThreads = static_cast<int>(std::max(1U, std::thread::hardware_concurrency()));
+  double singleThreaded{0.0};
+  for(int threads = 1; threads <= maxThreads; threads *= 2)
+  {
+    graphicsEngine->setRecordingThreads(threads);
+    timeFrames(std::max(1, frames / 10));
+    FrameTimings timings = timeFrames(frames);
+    double recordTime = timings.recordTime / frames;
+    singleThreaded = threads == 1 ? recordTime : singleThreaded;
+    std::cout << "\tRecording threads: " << threads
+              << ", average record time: " << recordTime << " ms"
+              << ", speedup: " << singleThreaded / recordTime << "x\n";
+  }
+  graphicsEngine->setRecordingThreads(1);
+  graphicsEngine->setCommandCaching(true);
+  graphicsEngine->setDrawList({{3, 1, 0, 0}});
+}
+
+void App::benchmarkJobSystem()
+{
+  const int taskCount = 20000;
+  const auto taskLength = std::chrono::microseconds(10);
+  JobSystem& jobs = graphicsEngine->getJobSystem();
+  std::cout << "Job system benchmark, " << taskCount << " tasks of " << taskLength.count() << " us on " << jobs.size() + 1 << " threads\n";
+  auto busyTask = [taskLength]
+  {
+    auto end = std::chrono::steady_clock::now() + taskLength;
+    while(std::chrono::steady_clock::now() < end);
+  };
+  auto start = std::chrono::steady_clock::now();
+  for(int i = 0; i < taskCount; i++)
+  {
+    busyTask();
+  }
+  double serial = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  start = std::chrono::steady_clock::now();
+  jobs.parallelFor(taskCount, 1, [&](size_t, size_t) { busyTask(); });
+  double parallel = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  // Time each thread spent beyond its share of the work, spread over the tasks it ran
+  double overhead = std::max(0.0, parallel * (jobs.size() + 1) - serial) / taskCount;
+  std::cout << "\tSerial: " << serial * 1000.0 << " ms, parallel: " << parallel * 1000.0 << " ms"
+            << ", speedup: " << serial / parallel << "x"
+            << ", overhead per task: " << overhead * 1000000.0 << " us\n";
+}
+
+void App::benchmarkRenderGraph()
+{
+  std::cout << "Render graph benchmark, deferred frame with shadows and bloom\n";
+  RenderGraph graph = graphicsEngine->createRenderGraph();
+  RenderGraphResource shadowMap = graph.createImage("shadow map", vk::Format::eD32Sfloat);
+  RenderGraphResource albedo = graph.createImage("albedo", vk::Format::eR8G8B8A8Unorm);
+  RenderGraphResource normals = graph.createImage("normals", vk::Format::eR16G16B16A16Sfloat);
+  RenderGraphResource depth = graph.createImage("depth", vk::Format::eD32Sfloat);
+  RenderGraphResource hdr = graph.createImage("hdr", vk::Format::eR16G16B16A16Sfloat);
+  RenderGraphResource bloom = graph.createImage("bloom", vk::Format::eR16G16B16A16Sfloat);
+  RenderGraphResource overlay = graph.createImage("debug overlay", vk::Format::eR8G8B8A8Unorm);
+  RenderGraphResource result = graph.createImage("result", vk::Format::eR8G8B8A8Unorm);
+  graph.markOutput(result);
+
+  RenderGraphPass shadowPass = graph.addPass("shadow", nullptr);
+  graph.writeDepth(shadowPass, shadowMap, true);
+  RenderGraphPass gbufferPass = graph.addPass("gbuffer", nullptr);
+  graph.writeColor(gbufferPass, albedo, true);
+  graph.writeColor(gbufferPass, normals, true);
+  graph.writeDepth(gbufferPass, depth, true);
+  RenderGraphPass lightingPass = graph.addPass("lighting", nullptr);
+  graph.read(lightingPass, albedo);
+  graph.read(lightingPass, normals);
+  graph.read(lightingPass, depth);
+  graph.read(lightingPass, shadowMap);
+  graph.writeColor(lightingPass, hdr, true);
+  // Nothing reads it, so the graph drops the pass
+  RenderGraphPass overlayPass = graph.addPass("debug overlay", nullptr);
+  graph.read(overlayPass, depth);
+  graph.writeColor(overlayPass, overlay, true);
+  RenderGraphPass bloomPass = graph.addPass("bloom", nullptr);
+  graph.read(bloomPass, hdr);
+  graph.writeColor(bloomPass, bloom, true);
+  RenderGraphPass compositePass = graph.addPass("composite", nullptr);
+  graph.read(compositePass, hdr);
+  graph.read(compositePass, bloom);
+  graph.writeColor(compositePass, result, true);
+  graph.compile();
+
+  const RenderGraphStats& graphStats = graph.getStats();
+  std::cout << "\tPasses: " << graphStats.passes << ", culled: " << graphStats.culledPasses
+            << ", transient memory: " << graphStats.allocatedBytes / (1024 * 1024) << " MiB instead of " << graphStats.transientBytes / (1024 * 1024) << " MiB"
+            << ", barriers: " << graphStats.barriers << " instead of " << graphStats.unmergedBarriers << "\n";
+  graph.destroy();
+}
+
+void App::benchmarkPipelineCache()
+{
+  const int variants = 64;
+  std::cout << "Pipeline cache benchmark, " << variants << " pipeline variants\n";
+  PipelineCacheTimings cacheTimings = graphicsEngine->benchmarkPipelineCache(variants, "build/pipeline_cache_benchmark.bin");
+  std::cout << "\tCold: " << cacheTimings.cold << " ms, warm: " << cacheTimings.warm << " ms"
+            << ", speedup: " << cacheTimings.cold / cacheTimings.warm << "x"
+            << ", cache size: " << cacheTimings.bytes / 1024 << " KiB"
+            << ", pipeline layouts: " << graphicsEngine->getPipelineLayoutCount() << "\n";
+}
+
+void App::benchmarkSpecialization(int frames)
+{
+  const int shadedDrawCount = 200;
+  const int shadingIterations = 64;
+  std::cout << "Specialization benchmark, " << shadedDrawCount << " draws of " << shadingIterations << " shading iterations per frame\n";
+  graphicsEngine->setDrawList(std::vector<DrawCommand>(shadedDrawCount, DrawCommand{3, 1, 0, 0}));
+  for(bool specialized : {false, true})
+  {
+    graphicsEngine->setShading({specialized, shadingIterations, true});
+    timeFrames(std::max(1, frames / 10));
+    double elapsed = timeFrames(frames).elapsed;
+    std::cout << "\t" << (specialized ? "Specialization constants" : "Push constant branches")
+              << ", average frame time: " << elapsed * 1000.0 / frames << " ms\n";
+  }
+  graphicsEngine->setShading({true, 0, false});
+}
+
+void App::benchmarkReadback(int frames)
+{
+  std::cout << "Readback benchmark\n";
+  for(bool capture : {false, true})
+  {
+    uint64_t captured{0};
+    uint64_t checksum{0};
+    if(capture)
+    {
+      // Touch one row so the consumer actually reads the mapped memory
+      graphicsEngine->setReadbackCallback([&](const ReadbackFrame& frame)
+      {
+        const uint8_t* pixels = static_cast<const uint8_t*>(frame.data);
+        for(uint32_t i = 0; i < frame.rowPitch; i++)
+        {
+          checksum += pixels[i];
+        }
+        ++captured;
+      });
+    }
+    timeFrames(std::max(1, frames / 10));
+    double elapsed = timeFrames(frames).elapsed;
+    graphicsEngine->setReadbackCallback(nullptr);
+    std::cout << "\tCapture: " << (capture ? "on" : "off")
+              << ", average frame time: " << elapsed * 1000.0 / frames << " ms"
+              << ", frames captured: " << captured << "\n";
+  }
+}
+
 void App::calculateFrameRate()
 {
   currentTime = glfwGetTime();
@@ -43,18 +332,23 @@ void App::calculateFrameRate()
   if(delta >= 1.0)
   {
     int frameRate {std::max(1, int(numFrames/delta))};
+    frameTime = float(1000.0/frameRate);
     std::stringstream title;
-    title << "Frame rate: " << frameRate;
+    title << "Frame rate: " << frameRate << " | Frames in flight: " << graphicsEngine->getFramesInFlight()
+          << " | Profile: " << presentProfileName(graphicsEngine->getPresentPolicy().profile)
+          << " | Last resize: " << graphicsEngine->getResizeTime() << " ms of a " << frameTime << " ms frame";
     glfwSetWindowTitle(window, title.str().c_str());
     lastTime = currentTime;
     numFrames = -1;
-    frameTime = float(1000.0/frameRate);
   }
   ++numFrames;
 }
 
 App::~App()
 {
-  glfwDestroyWindow(window);
+  if(window)
+  {
+    glfwDestroyWindow(window);
+  }
   glfwTerminate();
 }
\ No newline at end of file
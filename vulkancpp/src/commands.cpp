@@ -23,38 +23,21 @@ vk::CommandBuffer createCommandBuffer(const commandBufferIn& in, const bool& deb
 {
   vk::CommandBufferAllocateInfo allocInfo = {};
   allocInfo.commandPool = in.commandPool;
-  allocInfo.level = vk::CommandBufferLevel::ePrimary;
-  allocInfo.commandBufferCount = static_cast<uint32_t>(in.frames.size());
-
-  for(int i = 0; i < in.frames.size(); i++)
-  {
-    try
-    {
-      in.frames[i].commandBuffer = in.device.allocateCommandBuffers(allocInfo)[0];
-      if(debug)
-      {
-        std::cout << "Command buffer allocated " + std::to_string(i) + "\n";
-      }
-    }
-    catch(vk::SystemError& e)
-    {
-      std::cerr << e.what() << '\n';
-      throw std::runtime_error("Failed to allocate command buffer\n");
-    }
-  }
+  allocInfo.level = in.level;
+  allocInfo.commandBufferCount = 1;
 
   try
   {
     vk::CommandBuffer commandBuffer = in.device.allocateCommandBuffers(allocInfo)[0];
     if(debug)
     {
-      std::cout << "Main command buffer allocated\n";
+      std::cout << "Command buffer allocated\n";
     }
     return commandBuffer;
   }
   catch(vk::SystemError& e)
   {
     std::cerr << e.what() << '\n';
-    throw std::runtime_error("Failed to allocate main command buffer\n");
+    throw std::runtime_error("Failed to allocate command buffer\n");
   } 
 }
@@ -13,16 +13,20 @@ bool checkDeviceExtensionSupport(const vk::PhysicalDevice& device, const std::ve
   return requiredSet.empty();
 }
 
-bool isSuitable(const vk::PhysicalDevice& device, bool debug)
+bool isSuitable(const vk::PhysicalDevice& device, bool headless, bool debug)
 {
   if(debug){std::cout << "Checking device suitability\n";}
   
-  const std::vector<const char*> requiredExtensions = {VK_KHR_SWAPCHAIN_EXTENSION_NAME};
+  // Headless rendering never presents, so any device with a graphics queue will do
+  std::vector<const char*> requiredExtensions;
+  if(!headless)
+  {
+    requiredExtensions.push_back(VK_KHR_SWAPCHAIN_EXTENSION_NAME);
+  }
   
   VkPhysicalDeviceProperties properties = device.getProperties();
-  VkPhysicalDeviceFeatures features = device.getFeatures();
 
-  if((properties.deviceType == VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU) && checkDeviceExtensionSupport(device, requiredExtensions, debug))
+  if(checkDeviceExtensionSupport(device, requiredExtensions, debug))
   {
     if(debug)
     {
@@ -34,8 +38,28 @@ bool isSuitable(const vk::PhysicalDevice& device, bool debug)
   return false;
 }
 
-vk::PhysicalDevice choosePhysicalDevice(vk::Instance& instance,bool debug)
+int deviceTypeRank(const vk::PhysicalDeviceType& type)
+{
+  switch(type)
+  {
+  case vk::PhysicalDeviceType::eDiscreteGpu:
+    return 4;
+  case vk::PhysicalDeviceType::eIntegratedGpu:
+    return 3;
+  case vk::PhysicalDeviceType::eVirtualGpu:
+    return 2;
+  case vk::PhysicalDeviceType::eCpu:
+    return 1;
+  default:
+    return 0;
+  }
+}
+
+vk::PhysicalDevice choosePhysicalDevice(vk::Instance& instance, bool headless, bool debug)
 {
+  // Prefer discrete GPUs but fall back to integrated, virtual and CPU implementations such as lavapipe
+  vk::PhysicalDevice chosen{nullptr};
+  int chosenRank{-1};
   std::vector<vk::PhysicalDevice> physicalDevices = instance.enumeratePhysicalDevices();
   for(const auto& device : physicalDevices)
   {
@@ -43,17 +67,53 @@ vk::PhysicalDevice choosePhysicalDevice(vk::Instance& instance,bool debug)
     {
       logDeviceProperties(device);
     }
-    if(isSuitable(device, debug))
+    int rank = deviceTypeRank(device.getProperties().deviceType);
+    if(rank > chosenRank && isSuitable(device, headless, debug))
     {
-    if(debug){ std::cout << "Physical device chosen\n"; }
-      return device;
+      chosen = device;
+      chosenRank = rank;
     }
   }
 
-  return nullptr;
+  if(debug && chosen)
+  {
+    std::cout << "Physical device chosen: " << chosen.getProperties().deviceName << "\n";
+  }
+  return chosen;
 }
 
-std::pair<vk::Device,std::pair<vk::Queue,vk::Queue>> createLogicalDevice(const vk::PhysicalDevice& physicalDevice, const vk::SurfaceKHR& surface, const bool& debug)
+uint32_t findMemoryType(const vk::PhysicalDevice& device, uint32_t typeFilter, vk::MemoryPropertyFlags properties)
+{
+  vk::PhysicalDeviceMemoryProperties memoryProperties = device.getMemoryProperties();
+  for(uint32_t i = 0; i < memoryProperties.memoryTypeCount; i++)
+  {
+    if((typeFilter & (1 << i)) && (memoryProperties.memoryTypes[i].propertyFlags & properties) == properties)
+    {
+      return i;
+    }
+  }
+
+  throw std::runtime_error("Failed to find suitable memory type\n");
+}
+
+bool supportsTimelineSemaphores(const vk::PhysicalDevice& device, const bool& debug)
+{
+  if(device.getProperties().apiVersion < VK_API_VERSION_1_2)
+  {
+    if(debug){std::cout << "Device does not support Vulkan 1.2, timeline semaphores disabled\n";}
+    return false;
+  }
+
+  auto features = device.getFeatures2<vk::PhysicalDeviceFeatures2, vk::PhysicalDeviceVulkan12Features>();
+  bool supported = features.get<vk::PhysicalDeviceVulkan12Features>().timelineSemaphore;
+  if(debug)
+  {
+    std::cout << "Timeline semaphores " << (supported ? "supported" : "not supported") << "\n";
+  }
+  return supported;
+}
+
+std::pair<vk::Device,std::pair<vk::Queue,vk::Queue>> createLogicalDevice(const vk::PhysicalDevice& physicalDevice, const vk::SurfaceKHR& surface, const bool& timelineSemaphores, const bool& debug)
 {
   vk::Device device{nullptr};
   QueueFamilyIndices indices = findQueueFamilies(physicalDevice, surface, debug);
@@ -76,7 +136,12 @@ std::pair<vk::Device,std::pair<vk::Queue,vk::Queue>> createLogicalDevice(const v
     ));
   }
   
-  std::vector<const char*> deviceExtensions = {VK_KHR_SWAPCHAIN_EXTENSION_NAME};
+  // Without a surface the engine renders headless and never creates a swapchain
+  std::vector<const char*> deviceExtensions;
+  if(surface)
+  {
+    deviceExtensions.push_back(VK_KHR_SWAPCHAIN_EXTENSION_NAME);
+  }
 
   vk::PhysicalDeviceFeatures features = vk::PhysicalDeviceFeatures();
 
@@ -94,6 +159,13 @@ std::pair<vk::Device,std::pair<vk::Queue,vk::Queue>> createLogicalDevice(const v
     &features
   );
 
+  vk::PhysicalDeviceVulkan12Features vulkan12Features = {};
+  vulkan12Features.timelineSemaphore = VK_TRUE;
+  if(timelineSemaphores)
+  {
+    deviceCreateInfo.pNext = &vulkan12Features;
+  }
+
   try
   {
     device = physicalDevice.createDevice(deviceCreateInfo);
@@ -1,27 +1,42 @@
 #include "engine.hpp"
 
-Engine::Engine(int width, int height, const char* title, GLFWwindow* window, bool debug) : width(width), height(height), title(title), window(window), debugMode(debug)
+Engine::Engine(const EngineIn& in) : width(in.width), height(in.height), title(in.title), window(in.window), debugMode(in.debug)
 {
+  framesInFlight = std::clamp(in.framesInFlight, 1, maxFramesInFlight);
+  timelineSemaphores = in.timelineSemaphores;
+  presentPolicy = in.presentPolicy;
+  pipelineCachePath = in.pipelineCachePath != nullptr ? in.pipelineCachePath : "";
+  shaderArchive.open(in.shaderArchivePath, debugMode);
+  frameLimiter.setTargetFrameRate(presentPolicy.targetFrameRate);
+  headless = window == nullptr;
+  // The render thread takes part in every job it waits on, so it counts as one of the cores
+  jobSystem.start(static_cast<int>(std::max(1U, std::thread::hardware_concurrency())) - 1);
   makeInstance();
   if(debugMode)
   {
     enableLogging();
   }
-  VkSurfaceKHR c_surface;
-  if(glfwCreateWindowSurface(instance, window, nullptr, &c_surface) != VK_SUCCESS)
+  if(!headless)
   {
-    throw std::runtime_error("Failed to create window surface\n");
-  }
-  else
-  {
-    if(debugMode)
+    VkSurfaceKHR c_surface;
+    if(glfwCreateWindowSurface(instance, window, nullptr, &c_surface) != VK_SUCCESS)
     {
-      std::cout << "Window surface created\n";
+      throw std::runtime_error("Failed to create window surface\n");
     }
+    else
+    {
+      if(debugMode)
+      {
+        std::cout << "Window surface created\n";
+      }
+    }
+    surface = c_surface;
   }
-  surface = c_surface;
 
   makeDevice();
+  layoutCache.create(device);
+  makeRenderGraph();
+  makePipelineCache();
   makePipeline();
   finishSetup();
 }
@@ -87,8 +102,20 @@ void Engine::makeInstance()
   
   // zero out patch
   version &= ~(0xFFFU);
-  // or use api
-  version = VK_MAKE_API_VERSION(0,1,0,0);
+  // Timeline semaphores are core in 1.2, everything else only needs 1.0
+  if(timelineSemaphores && version >= VK_API_VERSION_1_2)
+  {
+    version = VK_API_VERSION_1_2;
+  }
+  else
+  {
+    if(timelineSemaphores && debugMode)
+    {
+      std::cout << "Instance does not support Vulkan 1.2, timeline semaphores disabled\n";
+    }
+    timelineSemaphores = false;
+    version = VK_MAKE_API_VERSION(0,1,0,0);
+  }
 
   vk::ApplicationInfo appInfo = vk::ApplicationInfo(
     title,
@@ -98,10 +125,15 @@ void Engine::makeInstance()
     version
   );
 
-  uint32_t glfwExtensionCount {0};
-  const char** glfwExtensions;
-  glfwExtensions = glfwGetRequiredInstanceExtensions(&glfwExtensionCount);
-  std::vector<const char*> extensions(glfwExtensions, glfwExtensions + glfwExtensionCount);
+  // Surface extensions are only needed when presenting to a window
+  std::vector<const char*> extensions;
+  if(!headless)
+  {
+    uint32_t glfwExtensionCount {0};
+    const char** glfwExtensions;
+    glfwExtensions = glfwGetRequiredInstanceExtensions(&glfwExtensionCount);
+    extensions.assign(glfwExtensions, glfwExtensions + glfwExtensionCount);
+  }
 
   if(debugMode)
   {
@@ -152,60 +184,470 @@ void Engine::enableLogging()
 
 void Engine::makeDevice()
 {
-  physicalDevice = choosePhysicalDevice(instance, debugMode);
+  physicalDevice = choosePhysicalDevice(instance, headless, debugMode);
   if(physicalDevice == VK_NULL_HANDLE)
   {
     throw std::runtime_error("Failed to find a suitable GPU\n");
   }
-  std::pair<vk::Device, std::pair<vk::Queue, vk::Queue>> result = createLogicalDevice(physicalDevice, surface, debugMode);
+  timelineSemaphores = timelineSemaphores && supportsTimelineSemaphores(physicalDevice, debugMode);
+  std::pair<vk::Device, std::pair<vk::Queue, vk::Queue>> result = createLogicalDevice(physicalDevice, surface, timelineSemaphores, debugMode);
   device = result.first;
   graphicsQueue = result.second.first;
   presentQueue = result.second.second;
   
-  SwapChain bundle = crateSwapChain(physicalDevice, device, surface, width, height, debugMode);
+  SwapChain bundle;
+  if(headless)
+  {
+    OffscreenIn offscreenIn = {};
+    offscreenIn.physicalDevice = physicalDevice;
+    offscreenIn.device = device;
+    offscreenIn.extent = vk::Extent2D(static_cast<uint32_t>(width), static_cast<uint32_t>(height));
+    offscreenIn.format = vk::Format::eB8G8R8A8Unorm;
+    // One target per possible frame in flight, indexed by the ring slot
+    offscreenIn.imageCount = maxFramesInFlight;
+    bundle = createOffscreenTargets(offscreenIn, debugMode);
+  }
+  else
+  {
+    bundle = crateSwapChain(physicalDevice, device, surface, width, height, presentPolicy.profile, nullptr, debugMode);
+  }
   swapchain = bundle.swapChain;
   swapchainFrames = bundle.frames;
   swapchainImageFormat = bundle.format;
   swapchainExtent = bundle.extent;
+  swapchainUsage = bundle.usage;
+}
+
+void Engine::makeRenderGraph()
+{
+  renderGraph.create(physicalDevice, device, swapchainExtent, debugMode);
+  vk::ImageLayout finalLayout = headless ? vk::ImageLayout::eTransferSrcOptimal : vk::ImageLayout::ePresentSrcKHR;
+  // Cleared every frame, so whatever the previous frame left behind does not matter
+  backbuffer = renderGraph.importImage("backbuffer", swapchainImageFormat, vk::ImageLayout::eUndefined, finalLayout);
+  mainPass = renderGraph.addPass("main", [this](vk::CommandBuffer commandBuffer) { recordMainPass(commandBuffer); });
+  renderGraph.writeColor(mainPass, backbuffer, true);
+  renderGraph.setContents(mainPass, recordingThreads > 1 ? vk::SubpassContents::eSecondaryCommandBuffers : vk::SubpassContents::eInline);
+  renderGraph.compile();
+}
+
+RenderGraph Engine::createRenderGraph()
+{
+  RenderGraph graph;
+  graph.create(physicalDevice, device, swapchainExtent, debugMode);
+  return graph;
+}
+
+void Engine::makePipelineCache()
+{
+  if(pipelineCachePath.empty())
+  {
+    try
+    {
+      pipelineCache = device.createPipelineCache(vk::PipelineCacheCreateInfo());
+    }
+    catch(vk::SystemError& e)
+    {
+      std::cerr << e.what() << '\n';
+      throw std::runtime_error("Failed to create pipeline cache\n");
+    }
+    return;
+  }
+  pipelineCache = loadPipelineCache({physicalDevice, device, pipelineCachePath}, debugMode);
 }
 
 void Engine::makePipeline()
 {
+  auto start = std::chrono::steady_clock::now();
   GraphicsPipelineIn in = {};
   in.device = device;
-  in.vertexFilePath = "build/shaders/vert.spv";
-  in.fragmentFilePath = "build/shaders/frag.spv";
-  in.swapchainImageFormat = swapchainImageFormat;
-  in.extent = swapchainExtent;
+  in.layoutCache = &layoutCache;
+  in.vertexShader = shaderArchive.find("vert");
+  in.fragmentShader = shaderArchive.find("frag");
+  in.fragmentSpecialization.set(0, shading.specialized);
+  if(shading.specialized)
+  {
+    in.fragmentSpecialization.set(1, shading.iterations).set(2, shading.tint);
+  }
+  in.renderPass = renderGraph.getRenderPass(mainPass);
+  in.pipelineCache = pipelineCache;
   GraphicsPipelineOut out = createGraphicsPipeline(in, debugMode);
   pipelineLayout = out.pipelineLayout;
-  renderPass = out.renderPass;
   pipeline = out.pipeline;
+  if(debugMode)
+  {
+    std::cout << "Graphics pipeline built in " << std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() << " ms\n";
+  }
+}
+
+PipelineCacheTimings Engine::benchmarkPipelineCache(int variants, const std::string& path)
+{
+  const std::array<vk::PrimitiveTopology, 4> topologies = {vk::PrimitiveTopology::eTriangleList, vk::PrimitiveTopology::eTriangleStrip, vk::PrimitiveTopology::eLineList, vk::PrimitiveTopology::eLineStrip};
+  const std::array<vk::CullModeFlags, 4> cullModes = {vk::CullModeFlagBits::eNone, vk::CullModeFlagBits::eFront, vk::CullModeFlagBits::eBack, vk::CullModeFlagBits::eFrontAndBack};
+
+  // Times building every variant against the given cache
+  auto buildVariants = [&](vk::PipelineCache cache)
+  {
+    auto start = std::chrono::steady_clock::now();
+    for(int i = 0; i < variants; i++)
+    {
+      GraphicsPipelineIn in = {};
+      in.device = device;
+      in.layoutCache = &layoutCache;
+      in.vertexShader = shaderArchive.find("vert");
+      in.fragmentShader = shaderArchive.find("frag");
+      in.renderPass = renderGraph.getRenderPass(mainPass);
+      in.pipelineCache = cache;
+      in.topology = topologies[i % topologies.size()];
+      in.cullMode = cullModes[(i / topologies.size()) % cullModes.size()];
+      in.frontFace = (i / 16) % 2 == 0 ? vk::FrontFace::eClockwise : vk::FrontFace::eCounterClockwise;
+      in.blend = (i / 32) % 2 == 1;
+      GraphicsPipelineOut out = createGraphicsPipeline(in, false);
+      device.destroyPipeline(out.pipeline);
+    }
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+  };
+
+  PipelineCacheTimings timings = {};
+  PipelineCacheIn cacheIn = {physicalDevice, device, path};
+  vk::PipelineCache cold = device.createPipelineCache(vk::PipelineCacheCreateInfo());
+  timings.cold = buildVariants(cold);
+  timings.bytes = device.getPipelineCacheData(cold).size();
+  savePipelineCache(cacheIn, cold, debugMode);
+  device.destroyPipelineCache(cold);
+
+  vk::PipelineCache warm = loadPipelineCache(cacheIn, debugMode);
+  timings.warm = buildVariants(warm);
+  device.destroyPipelineCache(warm);
+  return timings;
 }
 
 void Engine::finishSetup()
 {
-  FrameBufferIn fbIn = {};
-  fbIn.device = device;
-  fbIn.renderPass = renderPass;
-  fbIn.extent = swapchainExtent;
-  createFrameBuffers(fbIn, swapchainFrames, debugMode);
-  
   commandPool = createCommandPool(device, physicalDevice, surface, debugMode);
+  commandBufferIn cbIn = {device, commandPool};
+  for(auto& frame : swapchainFrames)
+  {
+    frame.commandBuffer = createCommandBuffer(cbIn, debugMode);
+    makeSecondaryCommands(frame.secondary);
+    // Headless frames are never presented
+    if(!headless)
+    {
+      frame.renderFinishedSemaphore = createSemaphore(device, debugMode);
+    }
+  }
+  drawList = {{3, 1, 0, 0}};
+
+  if(timelineSemaphores)
+  {
+    graphicsTimeline.create(device, debugMode);
+  }
+  makeFrameResources();
   if(debugMode)
   {
     std::cout << "Engine setup complete\n";
   }
+}
+
+void Engine::destroySwapchainFrames(std::vector<SwapChainFrame>& frames)
+{
+  for(auto& frame : frames)
+  {
+    destroySecondaryCommands(frame.secondary);
+    device.destroySemaphore(frame.renderFinishedSemaphore);
+    device.destroyImageView(frame.imageView);
+    if(frame.imageMemory)
+    {
+      device.destroyImage(frame.image);
+      device.freeMemory(frame.imageMemory);
+    }
+  }
+}
+
+// Rebuilds only what depends on the swapchain images; device, pipeline, command pools and sync objects are kept
+void Engine::recreateSwapchain()
+{
+  if(headless)
+  {
+    return;
+  }
+
+  glfwGetFramebufferSize(window, &width, &height);
+  while(width == 0 || height == 0)
+  {
+    // Minimized, nothing can be presented until the window is restored
+    glfwWaitEvents();
+    glfwGetFramebufferSize(window, &width, &height);
+  }
+
+  auto start = std::chrono::steady_clock::now();
+  // Old framebuffers are still referenced by frames in flight
+  waitForFrame(submittedFrames);
+  presentQueue.waitIdle();
+  // Captures still hold the old extent, hand them over before the buffers are resized
+  readback.flush();
+
+  SwapChain bundle = crateSwapChain(physicalDevice, device, surface, width, height, presentPolicy.profile, swapchain, debugMode);
+  destroySwapchainFrames(swapchainFrames);
+  device.destroySwapchainKHR(swapchain);
+
+  // Keep the cached command buffers, they are re-recorded on next use
+  std::vector<vk::CommandBuffer> commandBuffers;
+  for(auto& frame : swapchainFrames)
+  {
+    commandBuffers.push_back(frame.commandBuffer);
+  }
+  swapchain = bundle.swapChain;
+  swapchainFrames = bundle.frames;
+  swapchainExtent = bundle.extent;
+  swapchainUsage = bundle.usage;
+
+  if(bundle.format != swapchainImageFormat)
+  {
+    // The render passes are no longer compatible, which only happens if the surface changed formats
+    swapchainImageFormat = bundle.format;
+    device.destroyPipeline(pipeline);
+    renderGraph.destroy();
+    makeRenderGraph();
+    makePipeline();
+  }
+  else
+  {
+    // Framebuffers referenced the old image views
+    renderGraph.setExtent(swapchainExtent);
+  }
+
+  commandBufferIn cbIn = {device, commandPool};
+  for(size_t i = 0; i < swapchainFrames.size(); i++)
+  {
+    swapchainFrames[i].commandBuffer = i < commandBuffers.size() ? commandBuffers[i] : createCommandBuffer(cbIn, debugMode);
+    makeSecondaryCommands(swapchainFrames[i].secondary);
+    swapchainFrames[i].renderFinishedSemaphore = createSemaphore(device, debugMode);
+  }
+  if(commandBuffers.size() > swapchainFrames.size())
+  {
+    device.freeCommandBuffers(commandPool, static_cast<uint32_t>(commandBuffers.size() - swapchainFrames.size()), commandBuffers.data() + swapchainFrames.size());
+  }
+  if(readback.isCreated() && readback.getExtent() != swapchainExtent)
+  {
+    readback.destroy();
+    makeReadback();
+  }
+  invalidateCommands();
+  framebufferResized = false;
+
+  resizeTime = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+  if(debugMode)
+  {
+    std::cout << "Swapchain recreated at " << swapchainExtent.width << "x" << swapchainExtent.height << " in " << resizeTime << " ms, frame time " << frameTime << " ms\n";
+    // A resize should cost no more than the frame it interrupts
+    if(frameTime > 0.0 && resizeTime > frameTime)
+    {
+      std::cout << "Swapchain recreation took longer than one frame\n";
+    }
+  }
+}
+
+void Engine::setPresentPolicy(const PresentPolicy& policy)
+{
+  bool profileChanged = policy.profile != presentPolicy.profile;
+  presentPolicy = policy;
+  frameLimiter.setTargetFrameRate(presentPolicy.targetFrameRate);
+  if(profileChanged)
+  {
+    // Present mode and image count are swapchain properties, the rest of the engine is kept
+    recreateSwapchain();
+  }
+}
+
+void Engine::makeFrameResources()
+{
+  inFlightFrames.resize(framesInFlight);
+  for(auto& frame : inFlightFrames)
+  {
+    frame.commandPool = createCommandPool(device, physicalDevice, surface, debugMode);
+    commandBufferIn cbIn = {device, frame.commandPool};
+    frame.commandBuffer = createCommandBuffer(cbIn, debugMode);
+    frame.readbackCommandBuffer = createCommandBuffer(cbIn, debugMode);
+    makeSecondaryCommands(frame.secondary);
+
+    // The timeline path paces frames without fences
+    if(!timelineSemaphores)
+    {
+      frame.inFlightFence = createFence(device, debugMode);
+    }
+    frame.frameNumber = 0;
+    frame.imageAvailableSemaphore = createSemaphore(device, debugMode);
+  }
+  currentFrame = 0;
+
+  if(debugMode)
+  {
+    std::cout << "Created " << framesInFlight << " frames in flight\n";
+  }
+}
+
+void Engine::destroyFrameResources()
+{
+  for(auto& frame : swapchainFrames)
+  {
+    frame.inFlightFence = nullptr;
+  }
+  for(auto& frame : inFlightFrames)
+  {
+    device.destroyFence(frame.inFlightFence);
+    device.destroySemaphore(frame.imageAvailableSemaphore);
+    device.destroyCommandPool(frame.commandPool);
+    destroySecondaryCommands(frame.secondary);
+  }
+  inFlightFrames.clear();
+}
+
+void Engine::setShading(const ShadingParameters& parameters)
+{
+  bool rebuild = parameters.specialized != shading.specialized
+                 || (parameters.specialized && (parameters.iterations != shading.iterations || parameters.tint != shading.tint));
+  shading = parameters;
+  if(rebuild)
+  {
+    device.waitIdle();
+    device.destroyPipeline(pipeline);
+    makePipeline();
+  }
+  invalidateCommands();
+}
+
+void Engine::setFramesInFlight(int count)
+{
+  count = std::clamp(count, 1, maxFramesInFlight);
+  if(count == framesInFlight)
+  {
+    return;
+  }
+
+  device.waitIdle();
+  // Every submitted frame is done, and the rebuilt slots carry no frame number for waitForFrame to advance past
+  retiredFrames = submittedFrames;
+  // Readback slots follow the ring, which restarts at slot 0
+  readback.flush();
+  destroyFrameResources();
+  framesInFlight = count;
+  makeFrameResources();
+}
+
+void Engine::setDrawList(const std::vector<DrawCommand>& draws)
+{
+  drawList = draws;
+  invalidateCommands();
+}
+
+void Engine::setCommandCaching(bool enabled)
+{
+  commandCaching = enabled;
+  invalidateCommands();
+}
+
+void Engine::makeSecondaryCommands(SecondaryCommands& secondary)
+{
+  // Single threaded recording stays inline in the primary buffer
+  if(recordingThreads < 2)
+  {
+    return;
+  }
+  for(int i = 0; i < recordingThreads; i++)
+  {
+    vk::CommandPool pool = createCommandPool(device, physicalDevice, surface, false);
+    commandBufferIn cbIn = {device, pool, vk::CommandBufferLevel::eSecondary};
+    secondary.commandPools.push_back(pool);
+    secondary.commandBuffers.push_back(createCommandBuffer(cbIn, false));
+  }
+}
+
+void Engine::destroySecondaryCommands(SecondaryCommands& secondary)
+{
+  for(auto& pool : secondary.commandPools)
+  {
+    device.destroyCommandPool(pool);
+  }
+  secondary.commandPools.clear();
+  secondary.commandBuffers.clear();
+}
+
+void Engine::setRecordingThreads(int count)
+{
+  count = std::clamp(count, 1, jobSystem.size() + 1);
+  if(count == recordingThreads)
+  {
+    return;
+  }
+
+  // Secondary buffers of pending frames are about to be freed
+  device.waitIdle();
+  for(auto& frame : swapchainFrames)
+  {
+    destroySecondaryCommands(frame.secondary);
+  }
+  for(auto& frame : inFlightFrames)
+  {
+    destroySecondaryCommands(frame.secondary);
+  }
+
+  recordingThreads = count;
+  renderGraph.setContents(mainPass, recordingThreads > 1 ? vk::SubpassContents::eSecondaryCommandBuffers : vk::SubpassContents::eInline);
+  for(auto& frame : swapchainFrames)
+  {
+    makeSecondaryCommands(frame.secondary);
+  }
+  for(auto& frame : inFlightFrames)
+  {
+    makeSecondaryCommands(frame.secondary);
+  }
+  invalidateCommands();
+
+  if(debugMode)
+  {
+    std::cout << "Recording with " << recordingThreads << " threads\n";
+  }
+}
 
-  commandBufferIn cbIn = {device, commandPool, swapchainFrames};
-  mainCommandBuffer = createCommandBuffer(cbIn, debugMode);
+void Engine::makeReadback()
+{
+  ReadbackIn in = {};
+  in.physicalDevice = physicalDevice;
+  in.device = device;
+  in.extent = swapchainExtent;
+  in.format = swapchainImageFormat;
+  // Indexed by ring slot, sized for the deepest ring so changing frames in flight keeps the buffers
+  in.slotCount = maxFramesInFlight;
+  readback.create(in, debugMode);
+}
+
+void Engine::setReadbackCallback(const ReadbackCallback& callback)
+{
+  if(!callback)
+  {
+    if(readback.isCreated())
+    {
+      waitForFrame(submittedFrames);
+      readback.flush();
+      readback.destroy();
+    }
+    readback.setCallback(callback);
+    return;
+  }
 
-  inFlightFence = createFence(device, debugMode);
-  imageAvailableSemaphore = createSemaphore(device, debugMode);
-  renderFinishedSemaphore = createSemaphore(device, debugMode);
+  if(!(swapchainUsage & vk::ImageUsageFlagBits::eTransferSrc))
+  {
+    std::cerr << "Surface does not support copying from swapchain images, readback disabled\n";
+    return;
+  }
+  if(!readback.isCreated())
+  {
+    makeReadback();
+  }
+  readback.setCallback(callback);
 }
 
-void Engine::recordDrawCommands(vk::CommandBuffer commandBuffer, uint32_t imageIndex)
+void Engine::recordDrawCommands(vk::CommandBuffer commandBuffer, uint32_t imageIndex, SecondaryCommands& secondary)
 {
   vk::CommandBufferBeginInfo beginInfo = {};
 //   beginInfo.flags = vk::CommandBufferUsageFlagBits::eSimultaneousUse;
@@ -218,19 +660,34 @@ void Engine::recordDrawCommands(vk::CommandBuffer commandBuffer, uint32_t imageI
     std::cerr << e.what() << '\n';
   }
   
-  vk::RenderPassBeginInfo renderPassInfo = {};
-  renderPassInfo.renderPass = renderPass;
-  renderPassInfo.framebuffer = swapchainFrames[imageIndex].framebuffer;
-  renderPassInfo.renderArea.offset = vk::Offset2D(0, 0);
-  renderPassInfo.renderArea.extent = swapchainExtent;
-  vk::ClearValue clearColor = vk::ClearColorValue(std::array<float, 4>{0.0f, 0.0f, 0.0f, 1.0f});
-  renderPassInfo.clearValueCount = 1;
-  renderPassInfo.pClearValues = &clearColor;
-
-  commandBuffer.beginRenderPass(renderPassInfo, vk::SubpassContents::eInline);
-  commandBuffer.bindPipeline(vk::PipelineBindPoint::eGraphics, pipeline);
-  commandBuffer.draw(3, 1, 0, 0);
-  commandBuffer.endRenderPass();
+  renderGraph.bindImage(backbuffer, swapchainFrames[imageIndex].image, swapchainFrames[imageIndex].imageView);
+  if(!secondary.commandBuffers.empty())
+  {
+    vk::CommandBufferInheritanceInfo inheritance = {};
+    inheritance.renderPass = renderGraph.getRenderPass(mainPass);
+    inheritance.subpass = 0;
+    inheritance.framebuffer = renderGraph.getFramebuffer(mainPass);
+
+    // Contiguous slices keep draw order when the primary executes them in sequence
+    size_t sliceCount = secondary.commandBuffers.size();
+    jobSystem.parallelFor(sliceCount, 1, [&](size_t begin, size_t end)
+    {
+      for(size_t slice = begin; slice < end; slice++)
+      {
+        size_t first = drawList.size() * slice / sliceCount;
+        size_t last = drawList.size() * (slice + 1) / sliceCount;
+        // Each pool is only ever touched by the job recording its slice
+        device.resetCommandPool(secondary.commandPools[slice]);
+        vk::CommandBuffer sliceBuffer = secondary.commandBuffers[slice];
+        sliceBuffer.begin(vk::CommandBufferBeginInfo(vk::CommandBufferUsageFlagBits::eRenderPassContinue, &inheritance));
+        recordDraws(sliceBuffer, first, last);
+        sliceBuffer.end();
+      }
+    });
+  }
+  mainPassSecondary = &secondary;
+  renderGraph.execute(commandBuffer);
+  mainPassSecondary = nullptr;
 
   try
   {
@@ -243,47 +700,261 @@ void Engine::recordDrawCommands(vk::CommandBuffer commandBuffer, uint32_t imageI
 
 }
 
-void Engine::render()
+void Engine::recordMainPass(vk::CommandBuffer commandBuffer)
 {
-  device.waitForFences(1, &inFlightFence, VK_TRUE, UINT64_MAX);
-  device.resetFences(1, &inFlightFence);
+  if(mainPassSecondary->commandBuffers.empty())
+  {
+    recordDraws(commandBuffer, 0, drawList.size());
+  }
+  else
+  {
+    commandBuffer.executeCommands(mainPassSecondary->commandBuffers);
+  }
+}
 
-  uint32_t imageIndex{device.acquireNextImageKHR(swapchain, UINT64_MAX, imageAvailableSemaphore, VK_NULL_HANDLE).value};
+void Engine::recordDraws(vk::CommandBuffer commandBuffer, size_t first, size_t last)
+{
+  vk::Viewport viewport = {};
+  viewport.x = 0.0f;
+  viewport.y = 0.0f;
+  viewport.width = static_cast<float>(swapchainExtent.width);
+  viewport.height = static_cast<float>(swapchainExtent.height);
+  viewport.minDepth = 0.0f;
+  viewport.maxDepth = 1.0f;
+  vk::Rect2D scissor = {};
+  scissor.offset = vk::Offset2D(0, 0);
+  scissor.extent = swapchainExtent;
+
+  // Secondary buffers inherit none of this state, so every buffer binds its own
+  commandBuffer.bindPipeline(vk::PipelineBindPoint::eGraphics, pipeline);
+  commandBuffer.setViewport(0, 1, &viewport);
+  commandBuffer.setScissor(0, 1, &scissor);
+  // The layout declares them whether or not the pipeline reads them
+  ShadingPushConstants pushConstants = {shading.iterations, shading.tint ? VK_TRUE : VK_FALSE};
+  commandBuffer.pushConstants(pipelineLayout, vk::ShaderStageFlagBits::eFragment, 0, sizeof(pushConstants), &pushConstants);
+  for(size_t i = first; i < last; i++)
+  {
+    const DrawCommand& draw = drawList[i];
+    commandBuffer.draw(draw.vertexCount, draw.instanceCount, draw.firstVertex, draw.firstInstance);
+  }
+}
 
-  vk::CommandBuffer commandBuffer = swapchainFrames[imageIndex].commandBuffer;
-  commandBuffer.reset();
-  recordDrawCommands(commandBuffer, imageIndex);
+uint64_t Engine::retiredFrame()
+{
+  if(timelineSemaphores)
+  {
+    return graphicsTimeline.completed();
+  }
+  return retiredFrames;
+}
 
+void Engine::waitForFrame(uint64_t frame)
+{
+  if(timelineSemaphores)
+  {
+    graphicsTimeline.wait(frame);
+    return;
+  }
+
+  for(auto& slot : inFlightFrames)
+  {
+    if(slot.frameNumber > retiredFrames && slot.frameNumber <= frame)
+    {
+      device.waitForFences(1, &slot.inFlightFence, VK_TRUE, UINT64_MAX);
+      retiredFrames = std::max(retiredFrames, slot.frameNumber);
+    }
+  }
+}
+
+void Engine::submitFrame(FrameInFlight& frame, SwapChainFrame& target, vk::CommandBuffer commandBuffer)
+{
+  // Binary semaphores ignore their entry in the value arrays
+  std::array<vk::Semaphore, 1> waitSemaphores = {frame.imageAvailableSemaphore};
+  std::array<vk::PipelineStageFlags, 1> waitStages = {vk::PipelineStageFlagBits::eColorAttachmentOutput};
+  std::array<uint64_t, 1> waitValues = {0};
+  std::array<vk::Semaphore, 2> signalSemaphores;
+  std::array<uint64_t, 2> signalValues;
+  uint32_t signalCount{0};
+  if(!headless)
+  {
+    signalSemaphores[signalCount] = target.renderFinishedSemaphore;
+    signalValues[signalCount++] = 0;
+  }
+  if(timelineSemaphores)
+  {
+    signalSemaphores[signalCount] = graphicsTimeline.getSemaphore();
+    signalValues[signalCount++] = frame.frameNumber;
+  }
+
+  // Headless frames have no image to acquire, so there is nothing to wait for
+  uint32_t waitCount = headless ? 0 : 1;
   vk::SubmitInfo submitInfo = {};
-  vk::Semaphore waitSemaphores[] = {imageAvailableSemaphore};
-  vk::PipelineStageFlags waitStages[] = {vk::PipelineStageFlagBits::eColorAttachmentOutput};
-  submitInfo.waitSemaphoreCount = 1;
-  submitInfo.pWaitSemaphores = waitSemaphores;
-  submitInfo.pWaitDstStageMask = waitStages;
-  submitInfo.commandBufferCount = 1;
-  submitInfo.pCommandBuffers = &commandBuffer;
-  vk::Semaphore signalSemaphores[] = {renderFinishedSemaphore};
-  submitInfo.signalSemaphoreCount = 1;
-  submitInfo.pSignalSemaphores = signalSemaphores;
+  submitInfo.waitSemaphoreCount = waitCount;
+  submitInfo.pWaitSemaphores = waitSemaphores.data();
+  submitInfo.pWaitDstStageMask = waitStages.data();
+  std::array<vk::CommandBuffer, 2> commandBuffers = {commandBuffer, frame.readbackCommandBuffer};
+  submitInfo.commandBufferCount = readback.isCreated() ? 2 : 1;
+  submitInfo.pCommandBuffers = commandBuffers.data();
+  submitInfo.signalSemaphoreCount = signalCount;
+  submitInfo.pSignalSemaphores = signalSemaphores.data();
+
+  vk::TimelineSemaphoreSubmitInfo timelineInfo = {};
+  timelineInfo.waitSemaphoreValueCount = waitCount;
+  timelineInfo.pWaitSemaphoreValues = waitValues.data();
+  timelineInfo.signalSemaphoreValueCount = signalCount;
+  timelineInfo.pSignalSemaphoreValues = signalValues.data();
 
   try
   {
-    graphicsQueue.submit(submitInfo, inFlightFence);
+    if(timelineSemaphores)
+    {
+      submitInfo.pNext = &timelineInfo;
+      graphicsQueue.submit(submitInfo, nullptr);
+    }
+    else
+    {
+      device.resetFences(1, &frame.inFlightFence);
+      graphicsQueue.submit(submitInfo, frame.inFlightFence);
+    }
   }
-  catch(const std::exception& e)
+  catch(vk::SystemError& e)
   {
+    // The frame's timeline value was handed out and its fence reset, neither will ever signal,
+    // so carrying on would hang the next wait on this slot
     std::cerr << e.what() << '\n';
+    throw std::runtime_error("Failed to submit frame\n");
+  }
+}
+
+void Engine::render()
+{
+  frameLimiter.wait();
+  auto now = std::chrono::steady_clock::now();
+  if(frameStart != std::chrono::steady_clock::time_point{})
+  {
+    frameTime = std::chrono::duration<double, std::milli>(now - frameStart).count();
+  }
+  frameStart = now;
+
+  FrameInFlight& frame = inFlightFrames[currentFrame];
+  if(timelineSemaphores)
+  {
+    graphicsTimeline.wait(frame.frameNumber);
+  }
+  else
+  {
+    device.waitForFences(1, &frame.inFlightFence, VK_TRUE, UINT64_MAX);
+    retiredFrames = std::max(retiredFrames, frame.frameNumber);
+  }
+
+  // Headless targets are owned per ring slot, so the slot index is the image index
+  uint32_t imageIndex{static_cast<uint32_t>(currentFrame)};
+  if(!headless)
+  {
+    try
+    {
+      imageIndex = device.acquireNextImageKHR(swapchain, UINT64_MAX, frame.imageAvailableSemaphore, VK_NULL_HANDLE).value;
+    }
+    catch(vk::OutOfDateKHRError& e)
+    {
+      // Nothing was signaled, so the slot can be reused as is once the swapchain is rebuilt
+      recreateSwapchain();
+      return;
+    }
+  }
+  SwapChainFrame& target = swapchainFrames[imageIndex];
+  frame.frameNumber = timelineSemaphores ? graphicsTimeline.next() : submittedFrames + 1;
+  submittedFrames = frame.frameNumber;
+
+  // The slot's previous frame has retired, so everything allocated from its pool is free to reuse
+  device.resetCommandPool(frame.commandPool);
+
+  vk::CommandBuffer commandBuffer = frame.commandBuffer;
+  frameGraph.clear();
+  TaskGraph::Node recordNode = frameGraph.add([&]
+  {
+    auto recordStart = std::chrono::steady_clock::now();
+    if(commandCaching)
+    {
+      // The image's cached buffer may still be pending from a submission made by another slot
+      if(timelineSemaphores)
+      {
+        graphicsTimeline.wait(target.frameNumber);
+      }
+      else if(target.inFlightFence && target.inFlightFence != frame.inFlightFence)
+      {
+        device.waitForFences(1, &target.inFlightFence, VK_TRUE, UINT64_MAX);
+      }
+      commandBuffer = target.commandBuffer;
+      if(target.recordedVersion != renderStateVersion)
+      {
+        commandBuffer.reset();
+        recordDrawCommands(commandBuffer, imageIndex, target.secondary);
+        target.recordedVersion = renderStateVersion;
+      }
+      target.inFlightFence = frame.inFlightFence;
+      target.frameNumber = frame.frameNumber;
+    }
+    else
+    {
+      recordDrawCommands(commandBuffer, imageIndex, frame.secondary);
+    }
+    recordTime = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - recordStart).count();
+  });
+
+  if(readback.isCreated())
+  {
+    // The slot's last frame retired above, framesInFlight frames after it was submitted
+    TaskGraph::Node deliverNode = frameGraph.add([&]
+    {
+      readback.deliver(static_cast<uint32_t>(currentFrame));
+    });
+    TaskGraph::Node copyNode = frameGraph.add([&]
+    {
+      vk::ImageLayout layout = headless ? vk::ImageLayout::eTransferSrcOptimal : vk::ImageLayout::ePresentSrcKHR;
+      frame.readbackCommandBuffer.begin(vk::CommandBufferBeginInfo(vk::CommandBufferUsageFlagBits::eOneTimeSubmit));
+      readback.record(frame.readbackCommandBuffer, static_cast<uint32_t>(currentFrame), target.image, layout, frame.frameNumber);
+      frame.readbackCommandBuffer.end();
+    });
+    // The slot's staging buffer is reused once its previous capture is delivered
+    frameGraph.precede(deliverNode, copyNode);
+    // Both command buffers come from the slot's pool, which cannot be recorded into from two threads
+    frameGraph.precede(recordNode, copyNode);
+  }
+  // The consumer callback runs alongside command recording
+  jobSystem.run(frameGraph);
+
+  submitFrame(frame, target, commandBuffer);
+  if(headless)
+  {
+    currentFrame = (currentFrame + 1) % framesInFlight;
+    return;
   }
   
   vk::PresentInfoKHR presentInfo = {};
   presentInfo.waitSemaphoreCount = 1;
-  presentInfo.pWaitSemaphores = signalSemaphores;
+  presentInfo.pWaitSemaphores = &target.renderFinishedSemaphore;
   vk::SwapchainKHR swapChains[] = {swapchain};
   presentInfo.swapchainCount = 1;
   presentInfo.pSwapchains = swapChains;
   presentInfo.pImageIndices = &imageIndex;
 
-  presentQueue.presentKHR(presentInfo);
+  vk::Result presentResult = vk::Result::eSuccess;
+  try
+  {
+    presentResult = presentQueue.presentKHR(presentInfo);
+  }
+  catch(vk::OutOfDateKHRError& e)
+  {
+    presentResult = vk::Result::eErrorOutOfDateKHR;
+  }
+
+  currentFrame = (currentFrame + 1) % framesInFlight;
+
+  if(presentResult != vk::Result::eSuccess || framebufferResized)
+  {
+    recreateSwapchain();
+  }
 }
 
 Engine::~Engine()
@@ -294,21 +965,33 @@ Engine::~Engine()
     std::cout << "Engine being destroyed\n";
     instance.destroyDebugUtilsMessengerEXT(debugMessenger, nullptr, dispatchLoader);
   }
-  device.destroyFence(inFlightFence);
-  device.destroySemaphore(imageAvailableSemaphore);
-  device.destroySemaphore(renderFinishedSemaphore);
+  destroyFrameResources();
+  // Frames still in the ring are dropped, consumers stop capture first to get them
+  readback.destroy();
+  if(timelineSemaphores)
+  {
+    graphicsTimeline.destroy();
+  }
   device.destroyCommandPool(commandPool);
   device.destroyPipeline(pipeline);
-  device.destroyPipelineLayout(pipelineLayout);
-  device.destroyRenderPass(renderPass);
-  for(auto& frame : swapchainFrames)
+  if(!pipelineCachePath.empty())
   {
-    device.destroyImageView(frame.imageView);
-    device.destroyFramebuffer(frame.framebuffer);
+    savePipelineCache({physicalDevice, device, pipelineCachePath}, pipelineCache, debugMode);
+  }
+  device.destroyPipelineCache(pipelineCache);
+  layoutCache.destroy();
+  shaderArchive.close();
+  renderGraph.destroy();
+  destroySwapchainFrames(swapchainFrames);
+  if(!headless)
+  {
+    device.destroySwapchainKHR(swapchain);
   }
-  device.destroySwapchainKHR(swapchain);
   device.destroy();
-  instance.destroySurfaceKHR(surface);
+  if(!headless)
+  {
+    instance.destroySurfaceKHR(surface);
+  }
   instance.destroy();
   glfwTerminate();
 }
@@ -0,0 +1,226 @@
+#include "jobs.hpp"
+
+namespace
+{
+  // Which system's worker the current thread is, if any
+  thread_local const JobSystem* workerOf{nullptr};
+  thread_local int workerIndex{0};
+}
+
+TaskGraph::Node TaskGraph::add(const std::function<void()>& task)
+{
+  nodes.emplace_back();
+  nodes.back().task = task;
+  return nodes.size() - 1;
+}
+
+void TaskGraph::precede(Node before, Node after)
+{
+  nodes[before].successors.push_back(after);
+  nodes[after].dependencies++;
+}
+
+JobSystem::JobSystem()
+{
+  queues.push_back(std::make_unique<WorkQueue>());
+}
+
+void JobSystem::start(int threadCount)
+{
+  stop();
+  stopping = false;
+  while(static_cast<int>(queues.size()) < threadCount + 1)
+  {
+    queues.push_back(std::make_unique<WorkQueue>());
+  }
+  workerCount = threadCount;
+  for(int i = 1; i <= threadCount; i++)
+  {
+    threads.emplace_back(&JobSystem::workerLoop, this, i);
+  }
+}
+
+void JobSystem::stop()
+{
+  {
+    std::lock_guard<std::mutex> lock(sleepMutex);
+    stopping = true;
+  }
+  wake.notify_all();
+  for(auto& thread : threads)
+  {
+    thread.join();
+  }
+  threads.clear();
+  workerCount = 0;
+}
+
+int JobSystem::threadIndex() const
+{
+  return workerOf == this ? workerIndex : 0;
+}
+
+void JobSystem::spawn(const Task& task, JobCounter* counter)
+{
+  if(counter)
+  {
+    counter->value.fetch_add(1, std::memory_order_relaxed);
+  }
+
+  WorkQueue& queue = *queues[threadIndex()];
+  {
+    std::lock_guard<std::mutex> lock(queue.mutex);
+    queue.jobs.push_back({task, counter});
+  }
+
+  queuedJobs.fetch_add(1);
+  // Taking the lock orders this against a worker that is about to sleep
+  if(sleepingWorkers.load() > 0)
+  {
+    std::lock_guard<std::mutex> lock(sleepMutex);
+    wake.notify_one();
+  }
+}
+
+void JobSystem::wait(JobCounter& counter)
+{
+  int index = threadIndex();
+  while(counter.value.load(std::memory_order_acquire) > 0)
+  {
+    if(!tryRunOne(index))
+    {
+      std::this_thread::yield();
+    }
+  }
+}
+
+void JobSystem::parallelFor(size_t count, size_t grain, const RangeTask& task)
+{
+  grain = std::max<size_t>(grain, 1);
+  JobCounter counter;
+  for(size_t begin = grain; begin < count; begin += grain)
+  {
+    size_t end = std::min(begin + grain, count);
+    spawn([&task, begin, end]{ task(begin, end); }, &counter);
+  }
+  // The first chunk runs here instead of waiting for a thief
+  if(count > 0)
+  {
+    task(0, std::min(grain, count));
+  }
+  wait(counter);
+}
+
+void JobSystem::run(TaskGraph& graph)
+{
+  JobCounter counter;
+  for(auto& node : graph.nodes)
+  {
+    node.remaining.store(node.dependencies, std::memory_order_relaxed);
+  }
+  for(TaskGraph::Node node = 0; node < graph.nodes.size(); node++)
+  {
+    if(graph.nodes[node].dependencies == 0)
+    {
+      spawnNode(graph, node, &counter);
+    }
+  }
+  wait(counter);
+}
+
+void JobSystem::spawnNode(TaskGraph& graph, TaskGraph::Node node, JobCounter* counter)
+{
+  spawn([this, &graph, node, counter]
+  {
+    TaskGraph::Entry& entry = graph.nodes[node];
+    entry.task();
+    // Successors are spawned before this job retires, so the counter cannot reach zero early
+    for(TaskGraph::Node successor : entry.successors)
+    {
+      if(graph.nodes[successor].remaining.fetch_sub(1, std::memory_order_acq_rel) == 1)
+      {
+        spawnNode(graph, successor, counter);
+      }
+    }
+  }, counter);
+}
+
+void JobSystem::workerLoop(int index)
+{
+  workerOf = this;
+  workerIndex = index;
+  int spins{0};
+  while(!stopping.load(std::memory_order_relaxed))
+  {
+    if(tryRunOne(index))
+    {
+      spins = 0;
+      continue;
+    }
+    if(++spins < idleSpins)
+    {
+      std::this_thread::yield();
+      continue;
+    }
+
+    std::unique_lock<std::mutex> lock(sleepMutex);
+    sleepingWorkers.fetch_add(1);
+    wake.wait(lock, [this]{ return stopping.load() || queuedJobs.load() > 0; });
+    sleepingWorkers.fetch_sub(1);
+    spins = 0;
+  }
+}
+
+bool JobSystem::tryRunOne(int index)
+{
+  Job job;
+  if(pop(index, job) || steal(index, job))
+  {
+    execute(job);
+    return true;
+  }
+  return false;
+}
+
+bool JobSystem::pop(int index, Job& job)
+{
+  WorkQueue& queue = *queues[index];
+  std::lock_guard<std::mutex> lock(queue.mutex);
+  if(queue.jobs.empty())
+  {
+    return false;
+  }
+  // Newest first, its data is most likely still in cache
+  job = std::move(queue.jobs.back());
+  queue.jobs.pop_back();
+  queuedJobs.fetch_sub(1, std::memory_order_relaxed);
+  return true;
+}
+
+bool JobSystem::steal(int index, Job& job)
+{
+  int count = workerCount + 1;
+  for(int offset = 1; offset < count; offset++)
+  {
+    WorkQueue& queue = *queues[(index + offset) % count];
+    std::lock_guard<std::mutex> lock(queue.mutex);
+    if(!queue.jobs.empty())
+    {
+      // Oldest first, it is usually the largest piece of remaining work
+      job = std::move(queue.jobs.front());
+      queue.jobs.pop_front();
+      queuedJobs.fetch_sub(1, std::memory_order_relaxed);
+      return true;
+    }
+  }
+  return false;
+}
+
+void JobSystem::execute(Job& job)
+{
+  job.task();
+  if(job.counter)
+  {
+    job.counter->value.fetch_sub(1, std::memory_order_release);
+  }
+}
@@ -0,0 +1,115 @@
+#include "layoutcache.hpp"
+
+namespace
+{
+  void appendBindings(std::vector<uint32_t>& key, const std::vector<vk::DescriptorSetLayoutBinding>& bindings)
+  {
+    key.push_back(static_cast<uint32_t>(bindings.size()));
+    for(const auto& binding : bindings)
+    {
+      key.push_back(binding.binding);
+      key.push_back(static_cast<uint32_t>(binding.descriptorType));
+      key.push_back(binding.descriptorCount);
+      key.push_back(static_cast<uint32_t>(binding.stageFlags));
+    }
+  }
+}
+
+void LayoutCache::destroy()
+{
+  for(auto& layout : pipelineLayouts)
+  {
+    device.destroyPipelineLayout(layout.second);
+  }
+  for(auto& layout : setLayouts)
+  {
+    device.destroyDescriptorSetLayout(layout.second);
+  }
+  pipelineLayouts.clear();
+  setLayouts.clear();
+}
+
+vk::DescriptorSetLayout LayoutCache::getSetLayout(const std::vector<vk::DescriptorSetLayoutBinding>& bindings, const bool& debug)
+{
+  std::vector<uint32_t> key;
+  appendBindings(key, bindings);
+  auto found = setLayouts.find(key);
+  if(found != setLayouts.end())
+  {
+    return found->second;
+  }
+
+  vk::DescriptorSetLayoutCreateInfo layoutInfo = {};
+  layoutInfo.flags = vk::DescriptorSetLayoutCreateFlags();
+  layoutInfo.bindingCount = static_cast<uint32_t>(bindings.size());
+  layoutInfo.pBindings = bindings.data();
+
+  try
+  {
+    vk::DescriptorSetLayout layout = device.createDescriptorSetLayout(layoutInfo);
+    if(debug)
+    {
+      std::cout << "Descriptor set layout created with " << bindings.size() << " bindings\n";
+    }
+    setLayouts[key] = layout;
+    return layout;
+  }
+  catch(vk::SystemError& e)
+  {
+    std::cerr << e.what() << '\n';
+    throw std::runtime_error("Failed to create descriptor set layout\n");
+  }
+}
+
+vk::PipelineLayout LayoutCache::getPipelineLayout(const ShaderReflection& reflection, const bool& debug)
+{
+  std::vector<uint32_t> key;
+  uint32_t setCount = reflection.descriptorSets.empty() ? 0 : reflection.descriptorSets.rbegin()->first + 1;
+  key.push_back(setCount);
+  for(uint32_t set = 0; set < setCount; set++)
+  {
+    auto found = reflection.descriptorSets.find(set);
+    appendBindings(key, found != reflection.descriptorSets.end() ? found->second : std::vector<vk::DescriptorSetLayoutBinding>());
+  }
+  for(const auto& range : reflection.pushConstantRanges)
+  {
+    key.push_back(static_cast<uint32_t>(range.stageFlags));
+    key.push_back(range.offset);
+    key.push_back(range.size);
+  }
+  auto found = pipelineLayouts.find(key);
+  if(found != pipelineLayouts.end())
+  {
+    return found->second;
+  }
+
+  std::vector<vk::DescriptorSetLayout> sets;
+  for(uint32_t set = 0; set < setCount; set++)
+  {
+    auto bindings = reflection.descriptorSets.find(set);
+    sets.push_back(getSetLayout(bindings != reflection.descriptorSets.end() ? bindings->second : std::vector<vk::DescriptorSetLayoutBinding>(), debug));
+  }
+
+  vk::PipelineLayoutCreateInfo pipelineLayoutInfo = {};
+  pipelineLayoutInfo.flags = vk::PipelineLayoutCreateFlags();
+  pipelineLayoutInfo.setLayoutCount = static_cast<uint32_t>(sets.size());
+  pipelineLayoutInfo.pSetLayouts = sets.data();
+  pipelineLayoutInfo.pushConstantRangeCount = static_cast<uint32_t>(reflection.pushConstantRanges.size());
+  pipelineLayoutInfo.pPushConstantRanges = reflection.pushConstantRanges.data();
+
+  try
+  {
+    vk::PipelineLayout layout = device.createPipelineLayout(pipelineLayoutInfo);
+    if(debug)
+    {
+      std::cout << "Pipeline layout created with " << sets.size() << " descriptor sets and " << reflection.pushConstantRanges.size() << " push constant ranges\n";
+    }
+    pipelineLayouts[key] = layout;
+    return layout;
+  }
+  catch(vk::SystemError& e)
+  {
+    std::cerr << e.what() << '\n';
+    throw std::runtime_error("Failed to create pipeline layout\n");
+  }
+}
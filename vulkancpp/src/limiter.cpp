@@ -0,0 +1,34 @@
+#include "limiter.hpp"
+
+void FrameLimiter::setTargetFrameRate(double frameRate)
+{
+  targetFrameRate = frameRate > 0.0 ? frameRate : 0.0;
+  period = targetFrameRate > 0.0 ? std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(1.0 / targetFrameRate)) : Clock::duration(0);
+  deadline = Clock::now();
+}
+
+void FrameLimiter::wait()
+{
+  if(targetFrameRate <= 0.0)
+  {
+    return;
+  }
+
+  deadline += period;
+  Clock::time_point now = Clock::now();
+  if(deadline <= now)
+  {
+    // Running behind, start over from now instead of bursting to catch up
+    deadline = now;
+    return;
+  }
+
+  if(deadline - now > spinMargin)
+  {
+    std::this_thread::sleep_for(deadline - now - spinMargin);
+  }
+  while(Clock::now() < deadline)
+  {
+    std::this_thread::yield();
+  }
+}
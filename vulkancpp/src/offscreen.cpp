@@ -0,0 +1,67 @@
+#include "offscreen.hpp"
+
+SwapChain createOffscreenTargets(const OffscreenIn& in, const bool& debug)
+{
+  SwapChain targets;
+  targets.swapChain = nullptr;
+  targets.format = in.format;
+  targets.extent = in.extent;
+  targets.usage = vk::ImageUsageFlagBits::eColorAttachment | vk::ImageUsageFlagBits::eTransferSrc;
+  targets.frames.resize(in.imageCount);
+
+  for(uint32_t i = 0; i < in.imageCount; i++)
+  {
+    vk::ImageCreateInfo imageInfo = {};
+    imageInfo.flags = vk::ImageCreateFlags();
+    imageInfo.imageType = vk::ImageType::e2D;
+    imageInfo.format = in.format;
+    imageInfo.extent = vk::Extent3D(in.extent.width, in.extent.height, 1);
+    imageInfo.mipLevels = 1;
+    imageInfo.arrayLayers = 1;
+    imageInfo.samples = vk::SampleCountFlagBits::e1;
+    imageInfo.tiling = vk::ImageTiling::eOptimal;
+    imageInfo.usage = targets.usage;
+    imageInfo.sharingMode = vk::SharingMode::eExclusive;
+    imageInfo.initialLayout = vk::ImageLayout::eUndefined;
+
+    SwapChainFrame& frame = targets.frames[i];
+    try
+    {
+      frame.image = in.device.createImage(imageInfo);
+
+      vk::MemoryRequirements requirements = in.device.getImageMemoryRequirements(frame.image);
+      vk::MemoryAllocateInfo allocInfo = {};
+      allocInfo.allocationSize = requirements.size;
+      allocInfo.memoryTypeIndex = findMemoryType(in.physicalDevice, requirements.memoryTypeBits, vk::MemoryPropertyFlagBits::eDeviceLocal);
+      frame.imageMemory = in.device.allocateMemory(allocInfo);
+      in.device.bindImageMemory(frame.image, frame.imageMemory, 0);
+    }
+    catch(vk::SystemError& e)
+    {
+      std::cerr << e.what() << '\n';
+      throw std::runtime_error("Failed to create offscreen target " + std::to_string(i) + "\n");
+    }
+
+    vk::ImageViewCreateInfo viewInfo = {};
+    viewInfo.image = frame.image;
+    viewInfo.viewType = vk::ImageViewType::e2D;
+    viewInfo.format = in.format;
+    viewInfo.components.r = vk::ComponentSwizzle::eIdentity;
+    viewInfo.components.g = vk::ComponentSwizzle::eIdentity;
+    viewInfo.components.b = vk::ComponentSwizzle::eIdentity;
+    viewInfo.components.a = vk::ComponentSwizzle::eIdentity;
+    viewInfo.subresourceRange.aspectMask = vk::ImageAspectFlagBits::eColor;
+    viewInfo.subresourceRange.baseMipLevel = 0;
+    viewInfo.subresourceRange.levelCount = 1;
+    viewInfo.subresourceRange.baseArrayLayer = 0;
+    viewInfo.subresourceRange.layerCount = 1;
+    frame.imageView = in.device.createImageView(viewInfo);
+  }
+
+  if(debug)
+  {
+    std::cout << "Created " << in.imageCount << " offscreen targets of " << in.extent.width << "x" << in.extent.height << "\n";
+  }
+
+  return targets;
+}
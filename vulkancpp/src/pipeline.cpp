@@ -1,112 +1,59 @@
 #include "pipeline.hpp"
 
-vk::PipelineLayout createPipelineLayout(const vk::Device& device, const bool& debug)
-{
-  vk::PipelineLayoutCreateInfo pipelineLayoutInfo = {};
-  pipelineLayoutInfo.flags = vk::PipelineLayoutCreateFlags();
-  pipelineLayoutInfo.setLayoutCount = 0;
-  pipelineLayoutInfo.pushConstantRangeCount = 0;
-  
-  try
-  {
-    return device.createPipelineLayout(pipelineLayoutInfo);
-  }
-  catch(vk::SystemError& e)
-  {
-    std::cerr << e.what() << '\n';
-    throw std::runtime_error("Failed to create pipeline layout\n");
-  }
-}
-
-vk::RenderPass createRenderPass(const vk::Device& device, const vk::Format& swapChainImageFormat, const bool& debug)
-{
-  vk::AttachmentDescription colorAttachment = {};
-  colorAttachment.flags = vk::AttachmentDescriptionFlags();
-  colorAttachment.format = swapChainImageFormat;
-  colorAttachment.samples = vk::SampleCountFlagBits::e1;
-  colorAttachment.loadOp = vk::AttachmentLoadOp::eClear;
-  colorAttachment.storeOp = vk::AttachmentStoreOp::eStore;
-  colorAttachment.stencilLoadOp = vk::AttachmentLoadOp::eDontCare;
-  colorAttachment.stencilStoreOp = vk::AttachmentStoreOp::eDontCare;
-  colorAttachment.initialLayout = vk::ImageLayout::eUndefined;
-  colorAttachment.finalLayout = vk::ImageLayout::ePresentSrcKHR;
-
-  vk::AttachmentReference colorAttachmentRef = {};
-  colorAttachmentRef.attachment = 0;
-  colorAttachmentRef.layout = vk::ImageLayout::eColorAttachmentOptimal;
-
-  vk::SubpassDescription subpass = {};
-  subpass.flags = vk::SubpassDescriptionFlags();
-  subpass.pipelineBindPoint = vk::PipelineBindPoint::eGraphics;
-  subpass.colorAttachmentCount = 1;
-  subpass.pColorAttachments = &colorAttachmentRef;
-
-  vk::RenderPassCreateInfo renderPassInfo = {};
-  renderPassInfo.flags = vk::RenderPassCreateFlags();
-  renderPassInfo.attachmentCount = 1;
-  renderPassInfo.pAttachments = &colorAttachment;
-  renderPassInfo.subpassCount = 1;
-  renderPassInfo.pSubpasses = &subpass;
-
-  try
-  {
-    return device.createRenderPass(renderPassInfo);
-  }
-  catch(const std::exception& e)
-  {
-    std::cerr << e.what() << '\n';
-    throw std::runtime_error("Failed to create render pass\n");
-  }
-}
-
 GraphicsPipelineOut createGraphicsPipeline(const GraphicsPipelineIn& in, const bool& debug)
 {
   vk::GraphicsPipelineCreateInfo pipelineInfo = {};
   pipelineInfo.flags = vk::PipelineCreateFlags();
 
-  // Vertex input
+  // Layouts and vertex input as the shaders declare them
+  ShaderReflection reflection = reflectShader(in.vertexShader);
+  mergeReflection(reflection, reflectShader(in.fragmentShader));
+
+  // Vertex input, one interleaved binding
+  vk::VertexInputBindingDescription vertexBinding = {};
+  vertexBinding.binding = 0;
+  vertexBinding.stride = reflection.vertexStride;
+  vertexBinding.inputRate = vk::VertexInputRate::eVertex;
   vk::PipelineVertexInputStateCreateInfo vertexInputInfo = {};
   vertexInputInfo.flags = vk::PipelineVertexInputStateCreateFlags();
-  vertexInputInfo.vertexAttributeDescriptionCount = 0;
-  vertexInputInfo.vertexBindingDescriptionCount = 0;
+  vertexInputInfo.vertexAttributeDescriptionCount = static_cast<uint32_t>(reflection.vertexAttributes.size());
+  vertexInputInfo.pVertexAttributeDescriptions = reflection.vertexAttributes.data();
+  vertexInputInfo.vertexBindingDescriptionCount = reflection.vertexAttributes.empty() ? 0 : 1;
+  vertexInputInfo.pVertexBindingDescriptions = &vertexBinding;
   pipelineInfo.pVertexInputState = &vertexInputInfo;
   // Input assembly
   vk::PipelineInputAssemblyStateCreateInfo inputAssembly = {};
   inputAssembly.flags = vk::PipelineInputAssemblyStateCreateFlags();
-  inputAssembly.topology = vk::PrimitiveTopology::eTriangleList;
+  inputAssembly.topology = in.topology;
   pipelineInfo.pInputAssemblyState = &inputAssembly;
   
   std::vector<vk::PipelineShaderStageCreateInfo> shaderStages;
   // Vertex shader
-  vk::ShaderModule vertShaderModule = createShaderModule(in.vertexFilePath, in.device, debug);
+  vk::ShaderModule vertShaderModule = createShaderModule(in.vertexShader, in.device, debug);
   vk::PipelineShaderStageCreateInfo vertShaderStageInfo = {};
   vertShaderStageInfo.flags = vk::PipelineShaderStageCreateFlags();
   vertShaderStageInfo.stage = vk::ShaderStageFlagBits::eVertex;
   vertShaderStageInfo.module = vertShaderModule;
   vertShaderStageInfo.pName = "main";
+  vk::SpecializationInfo vertSpecializationInfo = in.vertexSpecialization.info();
+  vertShaderStageInfo.pSpecializationInfo = in.vertexSpecialization.empty() ? nullptr : &vertSpecializationInfo;
   shaderStages.push_back(vertShaderStageInfo);
 
-  // Viewport
-  vk::Viewport viewport = {};
-  viewport.x = 0.0f;
-  viewport.y = 0.0f;
-  viewport.width = static_cast<float>(in.extent.width);
-  viewport.height = static_cast<float>(in.extent.height);
-  viewport.minDepth = 0.0f;
-  viewport.maxDepth = 1.0f;
-  // Scissor
-  vk::Rect2D scissor = {};
-  scissor.offset = vk::Offset2D(0, 0);
-  scissor.extent = in.extent;
+  // Viewport and scissor are dynamic so extent changes never rebuild the pipeline
   vk::PipelineViewportStateCreateInfo viewportState = {};
   viewportState.flags = vk::PipelineViewportStateCreateFlags();
   viewportState.viewportCount = 1;
-  viewportState.pViewports = &viewport;
   viewportState.scissorCount = 1;
-  viewportState.pScissors = &scissor;
   viewportState.pNext = VK_NULL_HANDLE;
   pipelineInfo.pViewportState = &viewportState;
 
+  std::array<vk::DynamicState, 2> dynamicStates = {vk::DynamicState::eViewport, vk::DynamicState::eScissor};
+  vk::PipelineDynamicStateCreateInfo dynamicState = {};
+  dynamicState.flags = vk::PipelineDynamicStateCreateFlags();
+  dynamicState.dynamicStateCount = static_cast<uint32_t>(dynamicStates.size());
+  dynamicState.pDynamicStates = dynamicStates.data();
+  pipelineInfo.pDynamicState = &dynamicState;
+
   // Rasterizer
   vk::PipelineRasterizationStateCreateInfo rasterizer = {};
   rasterizer.flags = vk::PipelineRasterizationStateCreateFlags();
@@ -114,18 +61,20 @@ GraphicsPipelineOut createGraphicsPipeline(const GraphicsPipelineIn& in, const b
   rasterizer.rasterizerDiscardEnable = VK_FALSE;
   rasterizer.polygonMode = vk::PolygonMode::eFill;
   rasterizer.lineWidth = 1.0f;
-  rasterizer.cullMode = vk::CullModeFlagBits::eBack;
-  rasterizer.frontFace = vk::FrontFace::eClockwise;
+  rasterizer.cullMode = in.cullMode;
+  rasterizer.frontFace = in.frontFace;
   rasterizer.depthBiasEnable = VK_FALSE;
   pipelineInfo.pRasterizationState = &rasterizer;
 
   // Fragment shader
-  vk::ShaderModule fragmentShaderModule = createShaderModule(in.fragmentFilePath, in.device, debug);
+  vk::ShaderModule fragmentShaderModule = createShaderModule(in.fragmentShader, in.device, debug);
   vk::PipelineShaderStageCreateInfo fragmentShaderStageInfo = {};
   fragmentShaderStageInfo.flags = vk::PipelineShaderStageCreateFlags();
   fragmentShaderStageInfo.stage = vk::ShaderStageFlagBits::eFragment;
   fragmentShaderStageInfo.module = fragmentShaderModule;
   fragmentShaderStageInfo.pName = "main";
+  vk::SpecializationInfo fragmentSpecializationInfo = in.fragmentSpecialization.info();
+  fragmentShaderStageInfo.pSpecializationInfo = in.fragmentSpecialization.empty() ? nullptr : &fragmentSpecializationInfo;
   shaderStages.push_back(fragmentShaderStageInfo);
   pipelineInfo.stageCount = shaderStages.size();
   pipelineInfo.pStages = shaderStages.data();
@@ -140,7 +89,13 @@ GraphicsPipelineOut createGraphicsPipeline(const GraphicsPipelineIn& in, const b
   // Color blending
   vk::PipelineColorBlendAttachmentState colorBlendAttachment = {};
   colorBlendAttachment.colorWriteMask = vk::ColorComponentFlagBits::eR | vk::ColorComponentFlagBits::eG | vk::ColorComponentFlagBits::eB | vk::ColorComponentFlagBits::eA;
-  colorBlendAttachment.blendEnable = VK_FALSE;
+  colorBlendAttachment.blendEnable = in.blend ? VK_TRUE : VK_FALSE;
+  colorBlendAttachment.srcColorBlendFactor = vk::BlendFactor::eSrcAlpha;
+  colorBlendAttachment.dstColorBlendFactor = vk::BlendFactor::eOneMinusSrcAlpha;
+  colorBlendAttachment.colorBlendOp = vk::BlendOp::eAdd;
+  colorBlendAttachment.srcAlphaBlendFactor = vk::BlendFactor::eOne;
+  colorBlendAttachment.dstAlphaBlendFactor = vk::BlendFactor::eZero;
+  colorBlendAttachment.alphaBlendOp = vk::BlendOp::eAdd;
   vk::PipelineColorBlendStateCreateInfo colorBlending = {};
   colorBlending.flags = vk::PipelineColorBlendStateCreateFlags();
   colorBlending.logicOpEnable = VK_FALSE;
@@ -154,19 +109,18 @@ GraphicsPipelineOut createGraphicsPipeline(const GraphicsPipelineIn& in, const b
   pipelineInfo.pColorBlendState = &colorBlending;
 
   // Pipeline layout
-  vk::PipelineLayout pipelineLayout = createPipelineLayout(in.device, debug);
+  vk::PipelineLayout pipelineLayout = in.layoutCache->getPipelineLayout(reflection, debug);
   pipelineInfo.layout = pipelineLayout;
 
   // Render pass
-  vk::RenderPass renderPass = createRenderPass(in.device, in.swapchainImageFormat, debug);
-  pipelineInfo.renderPass = renderPass;
+  pipelineInfo.renderPass = in.renderPass;
 
   pipelineInfo.basePipelineHandle = VK_NULL_HANDLE;
 
   vk::Pipeline pipeline = VK_NULL_HANDLE;
   try
   {
-    pipeline = in.device.createGraphicsPipeline(VK_NULL_HANDLE, pipelineInfo).value;
+    pipeline = in.device.createGraphicsPipeline(in.pipelineCache, pipelineInfo).value;
     if(debug)
     {
       std::cout << "Graphics pipeline created\n";
@@ -181,10 +135,75 @@ GraphicsPipelineOut createGraphicsPipeline(const GraphicsPipelineIn& in, const b
   GraphicsPipelineOut out = {};
   out.pipeline = pipeline;
   out.pipelineLayout = pipelineLayout;
-  out.renderPass = renderPass;
 
   in.device.destroyShaderModule(vertShaderModule);
   in.device.destroyShaderModule(fragmentShaderModule);
 
   return out;
-}
\ No newline at end of file
+}
+
+ComputePipelineOut createComputePipeline(const ComputePipelineIn& in, const bool& debug)
+{
+  ShaderReflection reflection = reflectShader(in.computeShader);
+  if(!(reflection.stages & vk::ShaderStageFlagBits::eCompute))
+  {
+    throw std::runtime_error("Failed to create compute pipeline, shader is not a compute shader\n");
+  }
+
+  vk::ComputePipelineCreateInfo pipelineInfo = {};
+  pipelineInfo.flags = vk::PipelineCreateFlags();
+
+  // Compute shader
+  vk::ShaderModule computeShaderModule = createShaderModule(in.computeShader, in.device, debug);
+  pipelineInfo.stage.flags = vk::PipelineShaderStageCreateFlags();
+  pipelineInfo.stage.stage = vk::ShaderStageFlagBits::eCompute;
+  pipelineInfo.stage.module = computeShaderModule;
+  pipelineInfo.stage.pName = "main";
+  vk::SpecializationInfo specializationInfo = in.specialization.info();
+  pipelineInfo.stage.pSpecializationInfo = in.specialization.empty() ? nullptr : &specializationInfo;
+
+  // Pipeline layout
+  vk::PipelineLayout pipelineLayout = in.layoutCache->getPipelineLayout(reflection, debug);
+  pipelineInfo.layout = pipelineLayout;
+
+  pipelineInfo.basePipelineHandle = VK_NULL_HANDLE;
+
+  vk::Pipeline pipeline = VK_NULL_HANDLE;
+  try
+  {
+    pipeline = in.device.createComputePipeline(in.pipelineCache, pipelineInfo).value;
+    if(debug)
+    {
+      std::cout << "Compute pipeline created, " << reflection.localSize[0] << " invocations per workgroup\n";
+    }
+  }
+  catch(vk::SystemError& e)
+  {
+    std::cerr << e.what() << '\n';
+    in.device.destroyShaderModule(computeShaderModule);
+    throw std::runtime_error("Failed to create compute pipeline\n");
+  }
+
+  ComputePipelineOut out = {};
+  out.pipeline = pipeline;
+  out.pipelineLayout = pipelineLayout;
+  out.workgroupSize = reflection.localSize[0];
+
+  in.device.destroyShaderModule(computeShaderModule);
+
+  return out;
+}
+
+void dispatchCompute(vk::CommandBuffer commandBuffer, const ComputePipelineOut& pipeline, uint32_t elements, uint32_t maxGroupCount)
+{
+  uint32_t groups = elements / pipeline.workgroupSize + (elements % pipeline.workgroupSize != 0);
+  commandBuffer.dispatch(std::min(groups, maxGroupCount), 1, 1);
+}
+
+void recordComputeToGraphicsBarrier(vk::CommandBuffer commandBuffer, vk::AccessFlags dstAccess, vk::PipelineStageFlags dstStages)
+{
+  vk::MemoryBarrier barrier = {};
+  barrier.srcAccessMask = vk::AccessFlagBits::eShaderWrite;
+  barrier.dstAccessMask = dstAccess;
+  commandBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eComputeShader, dstStages, vk::DependencyFlags(), barrier, nullptr, nullptr);
+}
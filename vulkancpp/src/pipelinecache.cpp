@@ -0,0 +1,208 @@
+#include "pipelinecache.hpp"
+#include "hash.hpp"
+
+#include <fstream>
+#include <filesystem>
+#include <cstring>
+
+namespace
+{
+  // "VKPC", followed by the layout version of this wrapper
+  constexpr uint32_t fileMagic{0x43504B56};
+  constexpr uint32_t fileVersion{1};
+
+  struct FileHeader
+  {
+    uint32_t magic;
+    uint32_t version;
+    // Some drivers keep the cache UUID across updates that change the binary format
+    uint32_t driverVersion;
+    uint32_t reserved;
+    uint64_t dataSize;
+    uint64_t checksum;
+  };
+
+  // Layout of VkPipelineCacheHeaderVersionOne, which starts every driver's cache data
+  struct DriverHeader
+  {
+    uint32_t headerSize;
+    uint32_t headerVersion;
+    uint32_t vendorID;
+    uint32_t deviceID;
+    uint8_t pipelineCacheUUID[VK_UUID_SIZE];
+  };
+
+  // False with the reason when the file must not reach the driver
+  bool validate(const std::vector<char>& file, const vk::PhysicalDeviceProperties& properties, std::string& reason)
+  {
+    FileHeader header;
+    if(file.size() < sizeof(header))
+    {
+      reason = "truncated header";
+      return false;
+    }
+    std::memcpy(&header, file.data(), sizeof(header));
+    if(header.magic != fileMagic || header.version != fileVersion)
+    {
+      reason = "unknown format";
+      return false;
+    }
+    if(header.dataSize != file.size() - sizeof(header))
+    {
+      reason = "size mismatch";
+      return false;
+    }
+    if(header.checksum != hashBytes(file.data() + sizeof(header), header.dataSize))
+    {
+      reason = "checksum mismatch";
+      return false;
+    }
+    if(header.driverVersion != properties.driverVersion)
+    {
+      reason = "driver changed";
+      return false;
+    }
+
+    DriverHeader driver;
+    if(header.dataSize < sizeof(driver))
+    {
+      reason = "truncated driver header";
+      return false;
+    }
+    std::memcpy(&driver, file.data() + sizeof(header), sizeof(driver));
+    if(driver.headerSize < sizeof(driver) || driver.headerVersion != static_cast<uint32_t>(vk::PipelineCacheHeaderVersion::eOne))
+    {
+      reason = "unknown driver header";
+      return false;
+    }
+    if(driver.vendorID != properties.vendorID || driver.deviceID != properties.deviceID
+       || std::memcmp(driver.pipelineCacheUUID, properties.pipelineCacheUUID.data(), VK_UUID_SIZE) != 0)
+    {
+      reason = "written by another device";
+      return false;
+    }
+    return true;
+  }
+}
+
+vk::PipelineCache loadPipelineCache(const PipelineCacheIn& in, const bool& debug)
+{
+  std::vector<char> file;
+  std::ifstream stream(in.path, std::ios::binary | std::ios::ate);
+  if(stream.is_open())
+  {
+    file.resize(static_cast<size_t>(stream.tellg()));
+    stream.seekg(0);
+    stream.read(file.data(), file.size());
+    if(!stream)
+    {
+      file.clear();
+    }
+  }
+
+  vk::PipelineCacheCreateInfo cacheInfo = {};
+  cacheInfo.flags = vk::PipelineCacheCreateFlags();
+  std::string reason = "no cache file";
+  if(!file.empty() && validate(file, in.physicalDevice.getProperties(), reason))
+  {
+    cacheInfo.initialDataSize = file.size() - sizeof(FileHeader);
+    cacheInfo.pInitialData = file.data() + sizeof(FileHeader);
+  }
+
+  try
+  {
+    vk::PipelineCache cache = in.device.createPipelineCache(cacheInfo);
+    if(debug)
+    {
+      if(cacheInfo.initialDataSize > 0)
+      {
+        std::cout << "Pipeline cache loaded from " << in.path << ", " << cacheInfo.initialDataSize << " bytes\n";
+      }
+      else
+      {
+        std::cout << "Pipeline cache started empty: " << reason << "\n";
+      }
+    }
+    return cache;
+  }
+  catch(vk::SystemError& e)
+  {
+    if(cacheInfo.initialDataSize == 0)
+    {
+      std::cerr << e.what() << '\n';
+      throw std::runtime_error("Failed to create pipeline cache\n");
+    }
+  }
+
+  // The driver refused data that passed every check, start over rather than fail startup
+  if(debug)
+  {
+    std::cout << "Pipeline cache data rejected by the driver, starting empty\n";
+  }
+  cacheInfo.initialDataSize = 0;
+  cacheInfo.pInitialData = nullptr;
+  try
+  {
+    return in.device.createPipelineCache(cacheInfo);
+  }
+  catch(vk::SystemError& e)
+  {
+    std::cerr << e.what() << '\n';
+    throw std::runtime_error("Failed to create pipeline cache\n");
+  }
+}
+
+bool savePipelineCache(const PipelineCacheIn& in, vk::PipelineCache cache, const bool& debug)
+{
+  std::vector<uint8_t> data;
+  try
+  {
+    data = in.device.getPipelineCacheData(cache);
+  }
+  catch(vk::SystemError& e)
+  {
+    std::cerr << e.what() << '\n';
+    return false;
+  }
+  if(data.empty())
+  {
+    return false;
+  }
+
+  FileHeader header = {};
+  header.magic = fileMagic;
+  header.version = fileVersion;
+  header.driverVersion = in.physicalDevice.getProperties().driverVersion;
+  header.dataSize = data.size();
+  header.checksum = hashBytes(data.data(), data.size());
+
+  std::string temporaryPath = in.path + ".tmp";
+  {
+    std::ofstream stream(temporaryPath, std::ios::binary | std::ios::trunc);
+    stream.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    stream.write(reinterpret_cast<const char*>(data.data()), data.size());
+    stream.flush();
+    if(!stream)
+    {
+      std::cerr << "Failed to write pipeline cache to " << temporaryPath << "\n";
+      std::error_code ignored;
+      std::filesystem::remove(temporaryPath, ignored);
+      return false;
+    }
+  }
+  // Replaces the destination in one step, readers see either the old file or the new one
+  std::error_code error;
+  std::filesystem::rename(temporaryPath, in.path, error);
+  if(error)
+  {
+    std::cerr << "Failed to replace pipeline cache at " << in.path << ": " << error.message() << "\n";
+    std::filesystem::remove(temporaryPath, error);
+    return false;
+  }
+
+  if(debug)
+  {
+    std::cout << "Pipeline cache saved to " << in.path << ", " << data.size() << " bytes\n";
+  }
+  return true;
+}
@@ -12,18 +12,24 @@ QueueFamilyIndices findQueueFamilies(const vk::PhysicalDevice& device, const vk:
   int i{0};
   for(vk::QueueFamilyProperties queueFamily : queueFamilies)
   {
-    if(queueFamily.queueFlags & vk::QueueFlagBits::eGraphics)
+    // Compute feeding rendering is recorded on the graphics queue, so the family must do both
+    if((queueFamily.queueFlags & vk::QueueFlagBits::eGraphics) && (queueFamily.queueFlags & vk::QueueFlagBits::eCompute))
     {
       indices.graphicsFamily = i;
 
       if(debug)
       {
-        std::cout << "\tQueue family " << i << " supports graphics\n";
+        std::cout << "\tQueue family " << i << " supports graphics and compute\n";
         std::cout << queueFamily.queueCount << " queues\n";
       }
     }
 
-    if(device.getSurfaceSupportKHR(i, surface))
+    // Headless engines have no surface, the graphics queue stands in for presentation
+    if(!surface && indices.graphicsFamily.has_value())
+    {
+      indices.presentFamily = indices.graphicsFamily;
+    }
+    else if(surface && device.getSurfaceSupportKHR(i, surface))
     {
       indices.presentFamily = i;
       if(debug)
@@ -36,6 +42,7 @@ QueueFamilyIndices findQueueFamilies(const vk::PhysicalDevice& device, const vk:
     {
       break;
     }
+    i++;
   }
 
   return indices;
@@ -0,0 +1,176 @@
+#include "readback.hpp"
+
+void Readback::create(const ReadbackIn& in, const bool& debug)
+{
+  device = in.device;
+  extent = in.extent;
+  format = in.format;
+  size = static_cast<vk::DeviceSize>(extent.width) * extent.height * 4;
+  slots.resize(in.slotCount);
+
+  for(auto& slot : slots)
+  {
+    vk::BufferCreateInfo bufferInfo = {};
+    bufferInfo.size = size;
+    bufferInfo.usage = vk::BufferUsageFlagBits::eTransferDst;
+    bufferInfo.sharingMode = vk::SharingMode::eExclusive;
+
+    try
+    {
+      slot.buffer = device.createBuffer(bufferInfo);
+      vk::MemoryRequirements requirements = device.getBufferMemoryRequirements(slot.buffer);
+
+      // Cached memory makes CPU reads fast, but may need an explicit invalidate
+      uint32_t memoryType;
+      try
+      {
+        memoryType = findMemoryType(in.physicalDevice, requirements.memoryTypeBits, vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCached);
+        vk::PhysicalDeviceMemoryProperties properties = in.physicalDevice.getMemoryProperties();
+        coherent = static_cast<bool>(properties.memoryTypes[memoryType].propertyFlags & vk::MemoryPropertyFlagBits::eHostCoherent);
+      }
+      catch(std::runtime_error& e)
+      {
+        memoryType = findMemoryType(in.physicalDevice, requirements.memoryTypeBits, vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent);
+        coherent = true;
+      }
+
+      vk::MemoryAllocateInfo allocInfo = {};
+      allocInfo.allocationSize = requirements.size;
+      allocInfo.memoryTypeIndex = memoryType;
+      slot.memory = device.allocateMemory(allocInfo);
+      device.bindBufferMemory(slot.buffer, slot.memory, 0);
+      // Mapped for the lifetime of the slot
+      slot.mapped = device.mapMemory(slot.memory, 0, VK_WHOLE_SIZE);
+    }
+    catch(vk::SystemError& e)
+    {
+      std::cerr << e.what() << '\n';
+      throw std::runtime_error("Failed to create readback buffer\n");
+    }
+    slot.frameNumber = 0;
+  }
+
+  if(debug)
+  {
+    std::cout << "Created " << in.slotCount << " readback buffers of " << size << " bytes" << (coherent ? "" : ", non-coherent") << "\n";
+  }
+}
+
+void Readback::destroy()
+{
+  for(auto& slot : slots)
+  {
+    device.unmapMemory(slot.memory);
+    device.destroyBuffer(slot.buffer);
+    device.freeMemory(slot.memory);
+  }
+  slots.clear();
+}
+
+void Readback::record(vk::CommandBuffer commandBuffer, uint32_t slot, vk::Image image, vk::ImageLayout layout, uint64_t frameNumber)
+{
+  vk::ImageSubresourceRange range = {};
+  range.aspectMask = vk::ImageAspectFlagBits::eColor;
+  range.baseMipLevel = 0;
+  range.levelCount = 1;
+  range.baseArrayLayer = 0;
+  range.layerCount = 1;
+
+  // Wait for the render pass to finish writing the image
+  vk::ImageMemoryBarrier toTransfer = {};
+  toTransfer.srcAccessMask = vk::AccessFlagBits::eColorAttachmentWrite;
+  toTransfer.dstAccessMask = vk::AccessFlagBits::eTransferRead;
+  toTransfer.oldLayout = layout;
+  toTransfer.newLayout = vk::ImageLayout::eTransferSrcOptimal;
+  toTransfer.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  toTransfer.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  toTransfer.image = image;
+  toTransfer.subresourceRange = range;
+  commandBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eColorAttachmentOutput, vk::PipelineStageFlagBits::eTransfer,
+                                vk::DependencyFlags(), nullptr, nullptr, toTransfer);
+
+  vk::BufferImageCopy region = {};
+  region.bufferOffset = 0;
+  region.bufferRowLength = 0;
+  region.bufferImageHeight = 0;
+  region.imageSubresource.aspectMask = vk::ImageAspectFlagBits::eColor;
+  region.imageSubresource.mipLevel = 0;
+  region.imageSubresource.baseArrayLayer = 0;
+  region.imageSubresource.layerCount = 1;
+  region.imageOffset = vk::Offset3D(0, 0, 0);
+  region.imageExtent = vk::Extent3D(extent.width, extent.height, 1);
+  commandBuffer.copyImageToBuffer(image, vk::ImageLayout::eTransferSrcOptimal, slots[slot].buffer, region);
+
+  // Make the copy visible to the host once the frame's fence or timeline value is reached
+  vk::BufferMemoryBarrier toHost = {};
+  toHost.srcAccessMask = vk::AccessFlagBits::eTransferWrite;
+  toHost.dstAccessMask = vk::AccessFlagBits::eHostRead;
+  toHost.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  toHost.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  toHost.buffer = slots[slot].buffer;
+  toHost.offset = 0;
+  toHost.size = VK_WHOLE_SIZE;
+
+  // Put the image back for present, the copy only reads it
+  vk::ImageMemoryBarrier toPresent = toTransfer;
+  toPresent.srcAccessMask = vk::AccessFlagBits::eTransferRead;
+  toPresent.dstAccessMask = vk::AccessFlags();
+  toPresent.oldLayout = vk::ImageLayout::eTransferSrcOptimal;
+  toPresent.newLayout = layout;
+
+  uint32_t imageBarrierCount = layout == vk::ImageLayout::eTransferSrcOptimal ? 0 : 1;
+  commandBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eHost | vk::PipelineStageFlagBits::eBottomOfPipe,
+                                vk::DependencyFlags(), 0, nullptr, 1, &toHost, imageBarrierCount, &toPresent);
+
+  slots[slot].frameNumber = frameNumber;
+}
+
+void Readback::deliver(uint32_t slot)
+{
+  Slot& captured = slots[slot];
+  if(captured.frameNumber == 0)
+  {
+    return;
+  }
+
+  if(!coherent)
+  {
+    vk::MappedMemoryRange range = {};
+    range.memory = captured.memory;
+    range.offset = 0;
+    range.size = VK_WHOLE_SIZE;
+    if(device.invalidateMappedMemoryRanges(1, &range) != vk::Result::eSuccess)
+    {
+      std::cerr << "Failed to invalidate readback buffer\n";
+    }
+  }
+
+  if(callback)
+  {
+    ReadbackFrame frame = {};
+    frame.frameNumber = captured.frameNumber;
+    frame.extent = extent;
+    frame.format = format;
+    frame.data = captured.mapped;
+    frame.rowPitch = extent.width * 4;
+    callback(frame);
+  }
+  captured.frameNumber = 0;
+}
+
+void Readback::flush()
+{
+  std::vector<uint32_t> order;
+  for(uint32_t i = 0; i < slots.size(); i++)
+  {
+    if(slots[i].frameNumber != 0)
+    {
+      order.push_back(i);
+    }
+  }
+  std::sort(order.begin(), order.end(), [this](uint32_t a, uint32_t b) { return slots[a].frameNumber < slots[b].frameNumber; });
+  for(uint32_t i : order)
+  {
+    deliver(i);
+  }
+}
@@ -0,0 +1,476 @@
+#include "reflection.hpp"
+
+#include <algorithm>
+#include <iterator>
+#include <string>
+#include <unordered_map>
+
+namespace
+{
+  // Values from the SPIR-V specification, only the ones reflection looks at
+  constexpr uint32_t spirvMagic{0x07230203};
+  constexpr uint32_t spirvHeaderWords{5};
+
+  enum Op : uint32_t
+  {
+    opEntryPoint = 15,
+    opExecutionMode = 16,
+    opTypeBool = 20,
+    opTypeInt = 21,
+    opTypeFloat = 22,
+    opTypeVector = 23,
+    opTypeMatrix = 24,
+    opTypeImage = 25,
+    opTypeSampler = 26,
+    opTypeSampledImage = 27,
+    opTypeArray = 28,
+    opTypeRuntimeArray = 29,
+    opTypeStruct = 30,
+    opTypePointer = 32,
+    opConstant = 43,
+    opSpecConstant = 50,
+    opVariable = 59,
+    opDecorate = 71,
+    opMemberDecorate = 72
+  };
+
+  enum Decoration : uint32_t
+  {
+    decorationBufferBlock = 3,
+    decorationArrayStride = 6,
+    decorationMatrixStride = 7,
+    decorationBuiltIn = 11,
+    decorationLocation = 30,
+    decorationBinding = 33,
+    decorationDescriptorSet = 34,
+    decorationOffset = 35
+  };
+
+  enum StorageClass : uint32_t
+  {
+    storageClassUniformConstant = 0,
+    storageClassInput = 1,
+    storageClassUniform = 2,
+    storageClassPushConstant = 9,
+    storageClassStorageBuffer = 12
+  };
+
+  constexpr uint32_t executionModeLocalSize{17};
+
+  constexpr uint32_t dimBuffer{5};
+  constexpr uint32_t dimSubpassData{6};
+  // OpTypeImage's Sampled operand for images read and written without a sampler
+  constexpr uint32_t imageStorage{2};
+
+  struct Type
+  {
+    uint32_t opcode;
+    // Operands after the result id
+    std::vector<uint32_t> operands;
+  };
+
+  struct Variable
+  {
+    uint32_t id;
+    uint32_t pointerType;
+    uint32_t storageClass;
+  };
+
+  // The parts of a module reflection needs, indexed by result id
+  struct SpirvModule
+  {
+    vk::ShaderStageFlagBits stage{vk::ShaderStageFlagBits::eAll};
+    std::array<uint32_t, 3> localSize{1, 1, 1};
+    std::vector<Variable> variables;
+    std::unordered_map<uint32_t, Type> types;
+    std::unordered_map<uint32_t, uint32_t> constants;
+    std::unordered_map<uint32_t, std::unordered_map<uint32_t, uint32_t>> decorations;
+    std::unordered_map<uint64_t, std::unordered_map<uint32_t, uint32_t>> memberDecorations;
+
+    static uint64_t memberKey(uint32_t id, uint32_t member)
+    {
+      return uint64_t{id} << 32 | member;
+    }
+
+    const Type& type(uint32_t id) const
+    {
+      auto found = types.find(id);
+      if(found == types.end())
+      {
+        throw std::runtime_error("SPIR-V uses an unsupported type\n");
+      }
+      return found->second;
+    }
+
+    bool hasDecoration(uint32_t id, uint32_t decoration) const
+    {
+      auto found = decorations.find(id);
+      return found != decorations.end() && found->second.count(decoration) > 0;
+    }
+
+    uint32_t decoration(uint32_t id, uint32_t decoration) const
+    {
+      return hasDecoration(id, decoration) ? decorations.at(id).at(decoration) : 0;
+    }
+
+    bool hasMemberDecoration(uint32_t id, uint32_t member, uint32_t decoration) const
+    {
+      auto found = memberDecorations.find(memberKey(id, member));
+      return found != memberDecorations.end() && found->second.count(decoration) > 0;
+    }
+
+    uint32_t memberDecoration(uint32_t id, uint32_t member, uint32_t decoration) const
+    {
+      return hasMemberDecoration(id, member, decoration) ? memberDecorations.at(memberKey(id, member)).at(decoration) : 0;
+    }
+
+    // Specialization constants count with their default value
+    uint32_t arrayLength(const Type& array) const
+    {
+      auto found = constants.find(array.operands.at(1));
+      if(found == constants.end())
+      {
+        throw std::runtime_error("SPIR-V array length is not a constant\n");
+      }
+      return found->second;
+    }
+  };
+
+  SpirvModule parseModule(const ShaderCode& code)
+  {
+    size_t wordCount = code.size / sizeof(uint32_t);
+    if(wordCount < spirvHeaderWords || code.words[0] != spirvMagic)
+    {
+      throw std::runtime_error("Not a SPIR-V module\n");
+    }
+
+    SpirvModule module;
+    bool foundEntryPoint{false};
+    for(size_t i = spirvHeaderWords; i < wordCount;)
+    {
+      uint32_t instructionWords = code.words[i] >> 16;
+      uint32_t opcode = code.words[i] & 0xFFFF;
+      if(instructionWords == 0 || instructionWords > wordCount - i)
+      {
+        throw std::runtime_error("Truncated SPIR-V instruction\n");
+      }
+      const uint32_t* operands = code.words + i + 1;
+      uint32_t operandCount = instructionWords - 1;
+      auto require = [operandCount](uint32_t count)
+      {
+        if(operandCount < count)
+        {
+          throw std::runtime_error("Malformed SPIR-V instruction\n");
+        }
+      };
+
+      switch(opcode)
+      {
+        case opEntryPoint:
+        {
+          require(1);
+          // Modules here have one entry point, main
+          const vk::ShaderStageFlagBits stages[] = {vk::ShaderStageFlagBits::eVertex, vk::ShaderStageFlagBits::eTessellationControl,
+                                                    vk::ShaderStageFlagBits::eTessellationEvaluation, vk::ShaderStageFlagBits::eGeometry,
+                                                    vk::ShaderStageFlagBits::eFragment, vk::ShaderStageFlagBits::eCompute};
+          if(!foundEntryPoint)
+          {
+            if(operands[0] >= std::size(stages))
+            {
+              throw std::runtime_error("Unsupported shader stage\n");
+            }
+            module.stage = stages[operands[0]];
+            foundEntryPoint = true;
+          }
+          break;
+        }
+        case opExecutionMode:
+          require(2);
+          if(operands[1] == executionModeLocalSize)
+          {
+            require(5);
+            std::copy(operands + 2, operands + 5, module.localSize.begin());
+          }
+          break;
+        case opDecorate:
+          require(2);
+          module.decorations[operands[0]][operands[1]] = operandCount > 2 ? operands[2] : 0;
+          break;
+        case opMemberDecorate:
+          require(3);
+          module.memberDecorations[SpirvModule::memberKey(operands[0], operands[1])][operands[2]] = operandCount > 3 ? operands[3] : 0;
+          break;
+        case opTypeBool:
+        case opTypeInt:
+        case opTypeFloat:
+        case opTypeVector:
+        case opTypeMatrix:
+        case opTypeImage:
+        case opTypeSampler:
+        case opTypeSampledImage:
+        case opTypeArray:
+        case opTypeRuntimeArray:
+        case opTypeStruct:
+        case opTypePointer:
+          require(1);
+          module.types[operands[0]] = Type{opcode, {operands + 1, operands + operandCount}};
+          break;
+        case opConstant:
+        case opSpecConstant:
+          require(3);
+          module.constants[operands[1]] = operands[2];
+          break;
+        case opVariable:
+          require(3);
+          module.variables.push_back({operands[1], operands[0], operands[2]});
+          break;
+        default:
+          break;
+      }
+      i += instructionWords;
+    }
+
+    if(!foundEntryPoint)
+    {
+      throw std::runtime_error("SPIR-V module has no entry point\n");
+    }
+    return module;
+  }
+
+  vk::DescriptorType descriptorType(const SpirvModule& module, uint32_t typeId, uint32_t storageClass)
+  {
+    if(storageClass == storageClassStorageBuffer)
+    {
+      return vk::DescriptorType::eStorageBuffer;
+    }
+    if(storageClass == storageClassUniform)
+    {
+      // Older compilers mark storage buffers as Uniform with BufferBlock
+      return module.hasDecoration(typeId, decorationBufferBlock) ? vk::DescriptorType::eStorageBuffer : vk::DescriptorType::eUniformBuffer;
+    }
+
+    const Type& resource = module.type(typeId);
+    switch(resource.opcode)
+    {
+      case opTypeSampler:
+        return vk::DescriptorType::eSampler;
+      case opTypeSampledImage:
+        return vk::DescriptorType::eCombinedImageSampler;
+      case opTypeImage:
+      {
+        uint32_t dim = resource.operands.at(1);
+        bool storage = resource.operands.at(5) == imageStorage;
+        if(dim == dimBuffer)
+        {
+          return storage ? vk::DescriptorType::eStorageTexelBuffer : vk::DescriptorType::eUniformTexelBuffer;
+        }
+        if(dim == dimSubpassData)
+        {
+          return vk::DescriptorType::eInputAttachment;
+        }
+        return storage ? vk::DescriptorType::eStorageImage : vk::DescriptorType::eSampledImage;
+      }
+      default:
+        throw std::runtime_error("SPIR-V uses an unsupported descriptor type\n");
+    }
+  }
+
+  vk::Format vertexFormat(const SpirvModule& module, uint32_t typeId, uint32_t& size)
+  {
+    const Type* scalar = &module.type(typeId);
+    uint32_t components{1};
+    if(scalar->opcode == opTypeVector)
+    {
+      components = scalar->operands.at(1);
+      scalar = &module.type(scalar->operands.at(0));
+    }
+    if(components < 1 || components > 4 || scalar->operands.at(0) != 32)
+    {
+      throw std::runtime_error("Unsupported vertex input type\n");
+    }
+    size = components * sizeof(uint32_t);
+
+    const vk::Format floatFormats[] = {vk::Format::eR32Sfloat, vk::Format::eR32G32Sfloat, vk::Format::eR32G32B32Sfloat, vk::Format::eR32G32B32A32Sfloat};
+    const vk::Format intFormats[] = {vk::Format::eR32Sint, vk::Format::eR32G32Sint, vk::Format::eR32G32B32Sint, vk::Format::eR32G32B32A32Sint};
+    const vk::Format uintFormats[] = {vk::Format::eR32Uint, vk::Format::eR32G32Uint, vk::Format::eR32G32B32Uint, vk::Format::eR32G32B32A32Uint};
+    if(scalar->opcode == opTypeFloat)
+    {
+      return floatFormats[components - 1];
+    }
+    if(scalar->opcode == opTypeInt)
+    {
+      return scalar->operands.at(1) ? intFormats[components - 1] : uintFormats[components - 1];
+    }
+    throw std::runtime_error("Unsupported vertex input type\n");
+  }
+
+  // Bytes a value of the type occupies in an explicitly laid out block
+  uint32_t sizeOf(const SpirvModule& module, uint32_t typeId)
+  {
+    const Type& value = module.type(typeId);
+    switch(value.opcode)
+    {
+      case opTypeBool:
+        return sizeof(uint32_t);
+      case opTypeInt:
+      case opTypeFloat:
+        return value.operands.at(0) / 8;
+      case opTypeVector:
+      case opTypeMatrix:
+        // Matrix members carry a MatrixStride that the struct case prefers over this
+        return value.operands.at(1) * sizeOf(module, value.operands.at(0));
+      case opTypeArray:
+      {
+        uint32_t stride = module.hasDecoration(typeId, decorationArrayStride) ? module.decoration(typeId, decorationArrayStride) : sizeOf(module, value.operands.at(0));
+        return module.arrayLength(value) * stride;
+      }
+      case opTypeStruct:
+      {
+        uint32_t size{0};
+        for(uint32_t member = 0; member < value.operands.size(); member++)
+        {
+          uint32_t memberType = value.operands[member];
+          uint32_t memberSize = sizeOf(module, memberType);
+          if(module.type(memberType).opcode == opTypeMatrix && module.hasMemberDecoration(typeId, member, decorationMatrixStride))
+          {
+            memberSize = module.type(memberType).operands.at(1) * module.memberDecoration(typeId, member, decorationMatrixStride);
+          }
+          size = std::max(size, module.memberDecoration(typeId, member, decorationOffset) + memberSize);
+        }
+        return size;
+      }
+      default:
+        throw std::runtime_error("SPIR-V block member has no known size\n");
+    }
+  }
+}
+
+ShaderReflection reflectShader(const ShaderCode& code)
+{
+  SpirvModule module = parseModule(code);
+  ShaderReflection reflection = {};
+  reflection.stages = module.stage;
+  reflection.localSize = module.localSize;
+
+  for(const Variable& variable : module.variables)
+  {
+    uint32_t typeId = module.type(variable.pointerType).operands.at(1);
+    switch(variable.storageClass)
+    {
+      case storageClassUniformConstant:
+      case storageClassUniform:
+      case storageClassStorageBuffer:
+      {
+        vk::DescriptorSetLayoutBinding binding = {};
+        binding.binding = module.decoration(variable.id, decorationBinding);
+        binding.descriptorCount = 1;
+        binding.stageFlags = module.stage;
+        // Arrays of resources are one binding with a count, runtime sized ones count as one
+        while(module.type(typeId).opcode == opTypeArray || module.type(typeId).opcode == opTypeRuntimeArray)
+        {
+          const Type& array = module.type(typeId);
+          if(array.opcode == opTypeArray)
+          {
+            binding.descriptorCount *= module.arrayLength(array);
+          }
+          typeId = array.operands.at(0);
+        }
+        binding.descriptorType = descriptorType(module, typeId, variable.storageClass);
+        reflection.descriptorSets[module.decoration(variable.id, decorationDescriptorSet)].push_back(binding);
+        break;
+      }
+      case storageClassPushConstant:
+      {
+        const Type& block = module.type(typeId);
+        uint32_t offset{UINT32_MAX};
+        for(uint32_t member = 0; member < block.operands.size(); member++)
+        {
+          offset = std::min(offset, module.memberDecoration(typeId, member, decorationOffset));
+        }
+        uint32_t size = sizeOf(module, typeId);
+        if(offset < size)
+        {
+          reflection.pushConstantRanges.push_back(vk::PushConstantRange(module.stage, offset, size - offset));
+        }
+        break;
+      }
+      case storageClassInput:
+      {
+        // Built-ins like gl_VertexIndex have no location and take no vertex data
+        if(module.stage != vk::ShaderStageFlagBits::eVertex || module.hasDecoration(variable.id, decorationBuiltIn)
+           || !module.hasDecoration(variable.id, decorationLocation))
+        {
+          break;
+        }
+        vk::VertexInputAttributeDescription attribute = {};
+        attribute.location = module.decoration(variable.id, decorationLocation);
+        attribute.binding = 0;
+        attribute.format = vertexFormat(module, typeId, attribute.offset);
+        reflection.vertexAttributes.push_back(attribute);
+        break;
+      }
+      default:
+        break;
+    }
+  }
+
+  for(auto& set : reflection.descriptorSets)
+  {
+    std::sort(set.second.begin(), set.second.end(), [](const auto& a, const auto& b) { return a.binding < b.binding; });
+  }
+  // vertexFormat left each attribute's size in its offset, pack them in location order
+  std::sort(reflection.vertexAttributes.begin(), reflection.vertexAttributes.end(), [](const auto& a, const auto& b) { return a.location < b.location; });
+  for(auto& attribute : reflection.vertexAttributes)
+  {
+    uint32_t size = attribute.offset;
+    attribute.offset = reflection.vertexStride;
+    reflection.vertexStride += size;
+  }
+  return reflection;
+}
+
+void mergeReflection(ShaderReflection& into, const ShaderReflection& other)
+{
+  into.stages |= other.stages;
+
+  for(const auto& set : other.descriptorSets)
+  {
+    auto& merged = into.descriptorSets[set.first];
+    for(const auto& binding : set.second)
+    {
+      auto found = std::find_if(merged.begin(), merged.end(), [&binding](const auto& existing) { return existing.binding == binding.binding; });
+      if(found == merged.end())
+      {
+        merged.push_back(binding);
+        continue;
+      }
+      if(found->descriptorType != binding.descriptorType || found->descriptorCount != binding.descriptorCount)
+      {
+        throw std::runtime_error("Shader stages disagree on descriptor set " + std::to_string(set.first) + " binding " + std::to_string(binding.binding) + "\n");
+      }
+      found->stageFlags |= binding.stageFlags;
+    }
+    std::sort(merged.begin(), merged.end(), [](const auto& a, const auto& b) { return a.binding < b.binding; });
+  }
+
+  // One range over everything keeps pushConstants simple, the blocks are tiny anyway
+  for(const auto& range : other.pushConstantRanges)
+  {
+    if(into.pushConstantRanges.empty())
+    {
+      into.pushConstantRanges.push_back(range);
+      continue;
+    }
+    vk::PushConstantRange& merged = into.pushConstantRanges[0];
+    uint32_t end = std::max(merged.offset + merged.size, range.offset + range.size);
+    merged.offset = std::min(merged.offset, range.offset);
+    merged.size = end - merged.offset;
+    merged.stageFlags |= range.stageFlags;
+  }
+
+  if(other.stages & vk::ShaderStageFlagBits::eVertex)
+  {
+    into.vertexAttributes = other.vertexAttributes;
+    into.vertexStride = other.vertexStride;
+  }
+}
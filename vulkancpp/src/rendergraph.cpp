@@ -0,0 +1,753 @@
+#include "rendergraph.hpp"
+
+void RenderGraph::create(const vk::PhysicalDevice& physicalDevice, const vk::Device& device, const vk::Extent2D& extent, const bool& debug)
+{
+  this->physicalDevice = physicalDevice;
+  this->device = device;
+  this->extent = extent;
+  debugMode = debug;
+}
+
+void RenderGraph::destroy()
+{
+  destroyFramebuffers();
+  for(auto& pass : passes)
+  {
+    device.destroyRenderPass(pass.renderPass);
+  }
+  destroyTransients();
+  resources.clear();
+  passes.clear();
+  compiled = false;
+}
+
+RenderGraphResource RenderGraph::importImage(const std::string& name, vk::Format format, vk::ImageLayout initialLayout, vk::ImageLayout finalLayout)
+{
+  Resource resource = {};
+  resource.name = name;
+  resource.format = format;
+  resource.imported = true;
+  resource.initialLayout = initialLayout;
+  resource.finalLayout = finalLayout;
+  resources.push_back(resource);
+  return static_cast<RenderGraphResource>(resources.size() - 1);
+}
+
+RenderGraphResource RenderGraph::createImage(const std::string& name, vk::Format format)
+{
+  Resource resource = {};
+  resource.name = name;
+  resource.format = format;
+  resource.imported = false;
+  resources.push_back(resource);
+  return static_cast<RenderGraphResource>(resources.size() - 1);
+}
+
+void RenderGraph::markOutput(RenderGraphResource resource)
+{
+  resources[resource].output = true;
+}
+
+RenderGraphPass RenderGraph::addPass(const std::string& name, const RecordFunction& record)
+{
+  Pass pass = {};
+  pass.name = name;
+  pass.record = record;
+  passes.push_back(pass);
+  return static_cast<RenderGraphPass>(passes.size() - 1);
+}
+
+void RenderGraph::writeColor(RenderGraphPass pass, RenderGraphResource resource, bool clear, std::array<float, 4> clearColor)
+{
+  passes[pass].uses.push_back({resource, Access::eColor, clear, vk::ClearColorValue(clearColor)});
+}
+
+void RenderGraph::writeDepth(RenderGraphPass pass, RenderGraphResource resource, bool clear)
+{
+  passes[pass].uses.push_back({resource, Access::eDepth, clear, vk::ClearDepthStencilValue(1.0f, 0)});
+}
+
+void RenderGraph::read(RenderGraphPass pass, RenderGraphResource resource)
+{
+  passes[pass].uses.push_back({resource, Access::eRead, false, vk::ClearValue()});
+}
+
+void RenderGraph::setContents(RenderGraphPass pass, vk::SubpassContents contents)
+{
+  passes[pass].contents = contents;
+}
+
+bool RenderGraph::isDepthFormat(vk::Format format) const
+{
+  switch(format)
+  {
+    case vk::Format::eD16Unorm:
+    case vk::Format::eX8D24UnormPack32:
+    case vk::Format::eD32Sfloat:
+    case vk::Format::eD16UnormS8Uint:
+    case vk::Format::eD24UnormS8Uint:
+    case vk::Format::eD32SfloatS8Uint:
+      return true;
+    default:
+      return false;
+  }
+}
+
+vk::ImageAspectFlags RenderGraph::aspectMask(vk::Format format) const
+{
+  if(!isDepthFormat(format))
+  {
+    return vk::ImageAspectFlagBits::eColor;
+  }
+  if(format == vk::Format::eD16UnormS8Uint || format == vk::Format::eD24UnormS8Uint || format == vk::Format::eD32SfloatS8Uint)
+  {
+    return vk::ImageAspectFlagBits::eDepth | vk::ImageAspectFlagBits::eStencil;
+  }
+  return vk::ImageAspectFlagBits::eDepth;
+}
+
+void RenderGraph::compile()
+{
+  if(compiled)
+  {
+    destroyFramebuffers();
+    for(auto& pass : passes)
+    {
+      device.destroyRenderPass(pass.renderPass);
+      pass.renderPass = nullptr;
+    }
+    destroyTransients();
+  }
+
+  stats = {};
+  cullPasses();
+  createTransients();
+  buildRenderPasses();
+  compiled = true;
+
+  if(debugMode)
+  {
+    std::cout << "Render graph compiled: " << stats.passes << " passes, " << stats.culledPasses << " culled, "
+              << stats.barriers << " barriers (" << stats.unmergedBarriers << " unmerged), "
+              << stats.allocatedBytes << " of " << stats.transientBytes << " transient bytes allocated\n";
+  }
+}
+
+// Walks back from what leaves the graph, a pass survives only if something later needs what it writes
+void RenderGraph::cullPasses()
+{
+  std::vector<bool> needed(resources.size());
+  for(size_t i = 0; i < resources.size(); i++)
+  {
+    needed[i] = resources[i].imported || resources[i].output;
+  }
+
+  for(int i = static_cast<int>(passes.size()) - 1; i >= 0; i--)
+  {
+    Pass& pass = passes[i];
+    pass.alive = std::any_of(pass.uses.begin(), pass.uses.end(), [&](const Use& use)
+    {
+      return use.access != Access::eRead && needed[use.resource];
+    });
+    if(!pass.alive)
+    {
+      if(debugMode)
+      {
+        std::cout << "Render graph culled pass " << pass.name << "\n";
+      }
+      stats.culledPasses++;
+      continue;
+    }
+
+    // A cleared write makes earlier contents dead, a loading write still needs them
+    for(const auto& use : pass.uses)
+    {
+      if(use.access != Access::eRead)
+      {
+        needed[use.resource] = !use.clear;
+      }
+    }
+    for(const auto& use : pass.uses)
+    {
+      if(use.access == Access::eRead)
+      {
+        needed[use.resource] = true;
+      }
+    }
+  }
+  stats.passes = static_cast<uint32_t>(passes.size()) - stats.culledPasses;
+
+  for(auto& resource : resources)
+  {
+    resource.firstPass = -1;
+    resource.lastPass = -1;
+    resource.aliasOf = -1;
+    resource.lastOccupant = -1;
+    resource.usage = vk::ImageUsageFlags();
+  }
+  for(int i = 0; i < static_cast<int>(passes.size()); i++)
+  {
+    if(!passes[i].alive)
+    {
+      continue;
+    }
+    for(const auto& use : passes[i].uses)
+    {
+      Resource& resource = resources[use.resource];
+      resource.firstPass = resource.firstPass < 0 ? i : resource.firstPass;
+      resource.lastPass = i;
+      switch(use.access)
+      {
+        case Access::eColor: resource.usage |= vk::ImageUsageFlagBits::eColorAttachment; break;
+        case Access::eDepth: resource.usage |= vk::ImageUsageFlagBits::eDepthStencilAttachment; break;
+        case Access::eRead: resource.usage |= vk::ImageUsageFlagBits::eSampled; break;
+      }
+    }
+  }
+}
+
+void RenderGraph::createTransients()
+{
+  struct Slot
+  {
+    vk::DeviceSize size;
+    vk::DeviceSize alignment;
+    uint32_t memoryTypeBits;
+    int lastPass;
+    RenderGraphResource occupant;
+    std::vector<RenderGraphResource> members;
+  };
+  std::vector<Slot> slots;
+
+  std::vector<RenderGraphResource> order;
+  for(RenderGraphResource i = 0; i < resources.size(); i++)
+  {
+    if(!resources[i].imported && resources[i].firstPass >= 0)
+    {
+      order.push_back(i);
+    }
+  }
+  std::sort(order.begin(), order.end(), [this](RenderGraphResource a, RenderGraphResource b)
+  {
+    return resources[a].firstPass < resources[b].firstPass;
+  });
+
+  for(RenderGraphResource index : order)
+  {
+    Resource& resource = resources[index];
+    if(resource.output)
+    {
+      resource.usage |= vk::ImageUsageFlagBits::eSampled | vk::ImageUsageFlagBits::eTransferSrc;
+    }
+
+    vk::ImageCreateInfo imageInfo = {};
+    imageInfo.imageType = vk::ImageType::e2D;
+    imageInfo.format = resource.format;
+    imageInfo.extent = vk::Extent3D(extent.width, extent.height, 1);
+    imageInfo.mipLevels = 1;
+    imageInfo.arrayLayers = 1;
+    imageInfo.samples = vk::SampleCountFlagBits::e1;
+    imageInfo.tiling = vk::ImageTiling::eOptimal;
+    imageInfo.usage = resource.usage;
+    imageInfo.sharingMode = vk::SharingMode::eExclusive;
+    imageInfo.initialLayout = vk::ImageLayout::eUndefined;
+    try
+    {
+      resource.image = device.createImage(imageInfo);
+    }
+    catch(vk::SystemError& e)
+    {
+      std::cerr << e.what() << '\n';
+      throw std::runtime_error("Failed to create render graph image " + resource.name + "\n");
+    }
+
+    vk::MemoryRequirements requirements = device.getImageMemoryRequirements(resource.image);
+    resource.size = requirements.size;
+    stats.transientBytes += requirements.size;
+
+    // Best fit among slots whose occupant is dead before this image is first written
+    int best{-1};
+    for(int i = 0; i < static_cast<int>(slots.size()); i++)
+    {
+      Slot& slot = slots[i];
+      if(slot.lastPass >= resource.firstPass || !(slot.memoryTypeBits & requirements.memoryTypeBits))
+      {
+        continue;
+      }
+      bool fits = slot.size >= requirements.size;
+      bool bestFits = best >= 0 && slots[best].size >= requirements.size;
+      if(best < 0 || (fits && (!bestFits || slot.size < slots[best].size)) || (!fits && !bestFits && slot.size > slots[best].size))
+      {
+        best = i;
+      }
+    }
+
+    if(best < 0)
+    {
+      slots.push_back({requirements.size, requirements.alignment, requirements.memoryTypeBits, resource.lastPass, index, {index}});
+      continue;
+    }
+    Slot& slot = slots[best];
+    resource.aliasOf = static_cast<int>(slot.occupant);
+    slot.size = std::max(slot.size, requirements.size);
+    slot.alignment = std::max(slot.alignment, requirements.alignment);
+    slot.memoryTypeBits &= requirements.memoryTypeBits;
+    slot.lastPass = resource.lastPass;
+    slot.occupant = index;
+    slot.members.push_back(index);
+  }
+
+  for(auto& slot : slots)
+  {
+    resources[slot.members.front()].lastOccupant = static_cast<int>(slot.occupant);
+    vk::MemoryAllocateInfo allocInfo = {};
+    allocInfo.allocationSize = slot.size;
+    allocInfo.memoryTypeIndex = findMemoryType(physicalDevice, slot.memoryTypeBits, vk::MemoryPropertyFlagBits::eDeviceLocal);
+    vk::DeviceMemory memory;
+    try
+    {
+      memory = device.allocateMemory(allocInfo);
+    }
+    catch(vk::SystemError& e)
+    {
+      std::cerr << e.what() << '\n';
+      throw std::runtime_error("Failed to allocate render graph memory\n");
+    }
+    memoryBlocks.push_back(memory);
+    stats.allocatedBytes += slot.size;
+
+    for(RenderGraphResource index : slot.members)
+    {
+      Resource& resource = resources[index];
+      device.bindImageMemory(resource.image, memory, 0);
+
+      vk::ImageViewCreateInfo viewInfo = {};
+      viewInfo.image = resource.image;
+      viewInfo.viewType = vk::ImageViewType::e2D;
+      viewInfo.format = resource.format;
+      viewInfo.components.r = vk::ComponentSwizzle::eIdentity;
+      viewInfo.components.g = vk::ComponentSwizzle::eIdentity;
+      viewInfo.components.b = vk::ComponentSwizzle::eIdentity;
+      viewInfo.components.a = vk::ComponentSwizzle::eIdentity;
+      // Depth and stencil cannot be sampled through one view, depth is what passes read
+      viewInfo.subresourceRange.aspectMask = isDepthFormat(resource.format) ? vk::ImageAspectFlagBits::eDepth : vk::ImageAspectFlagBits::eColor;
+      viewInfo.subresourceRange.baseMipLevel = 0;
+      viewInfo.subresourceRange.levelCount = 1;
+      viewInfo.subresourceRange.baseArrayLayer = 0;
+      viewInfo.subresourceRange.layerCount = 1;
+      resource.view = device.createImageView(viewInfo);
+    }
+  }
+
+  if(debugMode)
+  {
+    std::cout << "Render graph placed " << order.size() << " transient images in " << slots.size() << " allocations\n";
+  }
+}
+
+void RenderGraph::destroyTransients()
+{
+  for(auto& resource : resources)
+  {
+    if(resource.imported)
+    {
+      continue;
+    }
+    device.destroyImageView(resource.view);
+    device.destroyImage(resource.image);
+    resource.view = nullptr;
+    resource.image = nullptr;
+  }
+  for(auto& memory : memoryBlocks)
+  {
+    device.freeMemory(memory);
+  }
+  memoryBlocks.clear();
+}
+
+void RenderGraph::buildRenderPasses()
+{
+  // Hazard tracking as the passes would execute
+  std::vector<vk::ImageLayout> layouts(resources.size());
+  std::vector<vk::PipelineStageFlags> writeStages(resources.size());
+  std::vector<vk::AccessFlags> writeAccess(resources.size());
+  std::vector<vk::PipelineStageFlags> readStages(resources.size());
+  std::vector<vk::PipelineStageFlags> lastStages(resources.size());
+  std::vector<bool> touched(resources.size(), false);
+  for(size_t i = 0; i < resources.size(); i++)
+  {
+    layouts[i] = resources[i].imported ? resources[i].initialLayout : vk::ImageLayout::eUndefined;
+  }
+
+  // How the previous frame left each resource, transients are reused by every frame in flight
+  std::vector<vk::PipelineStageFlags> frameLastStages(resources.size());
+  std::vector<vk::AccessFlags> frameWriteAccess(resources.size());
+  for(const auto& pass : passes)
+  {
+    if(!pass.alive)
+    {
+      continue;
+    }
+    for(const auto& use : pass.uses)
+    {
+      switch(use.access)
+      {
+        case Access::eColor:
+          frameLastStages[use.resource] = vk::PipelineStageFlagBits::eColorAttachmentOutput;
+          frameWriteAccess[use.resource] = vk::AccessFlagBits::eColorAttachmentWrite;
+          break;
+        case Access::eDepth:
+          frameLastStages[use.resource] = vk::PipelineStageFlagBits::eEarlyFragmentTests | vk::PipelineStageFlagBits::eLateFragmentTests;
+          frameWriteAccess[use.resource] = vk::AccessFlagBits::eDepthStencilAttachmentWrite;
+          break;
+        case Access::eRead:
+          frameLastStages[use.resource] = vk::PipelineStageFlagBits::eFragmentShader;
+          break;
+      }
+    }
+  }
+
+  for(int p = 0; p < static_cast<int>(passes.size()); p++)
+  {
+    Pass& pass = passes[p];
+    pass.attachments.clear();
+    pass.clearValues.clear();
+    pass.preBarriers.clear();
+    pass.preBarrierResources.clear();
+    pass.preSrcStages = vk::PipelineStageFlags();
+    if(!pass.alive)
+    {
+      continue;
+    }
+
+    vk::PipelineStageFlags srcStages;
+    vk::AccessFlags srcAccess;
+    vk::PipelineStageFlags dstStages;
+    vk::AccessFlags dstAccess;
+    uint32_t hazards{0};
+
+    std::vector<vk::AttachmentDescription> descriptions;
+    std::vector<vk::AttachmentReference> colorRefs;
+    vk::AttachmentReference depthRef = {};
+    bool hasDepth{false};
+
+    for(const auto& use : pass.uses)
+    {
+      RenderGraphResource r = use.resource;
+      Resource& resource = resources[r];
+
+      vk::PipelineStageFlags stage;
+      vk::AccessFlags access;
+      switch(use.access)
+      {
+        case Access::eColor:
+          stage = vk::PipelineStageFlagBits::eColorAttachmentOutput;
+          access = vk::AccessFlagBits::eColorAttachmentWrite | (use.clear ? vk::AccessFlags() : vk::AccessFlagBits::eColorAttachmentRead);
+          break;
+        case Access::eDepth:
+          stage = vk::PipelineStageFlagBits::eEarlyFragmentTests | vk::PipelineStageFlagBits::eLateFragmentTests;
+          access = vk::AccessFlagBits::eDepthStencilAttachmentWrite | vk::AccessFlagBits::eDepthStencilAttachmentRead;
+          break;
+        case Access::eRead:
+          stage = vk::PipelineStageFlagBits::eFragmentShader;
+          access = vk::AccessFlagBits::eShaderRead;
+          break;
+      }
+
+      // Read after write and write after write need the writer's results visible
+      if(writeStages[r])
+      {
+        srcStages |= writeStages[r];
+        srcAccess |= writeAccess[r];
+        hazards++;
+      }
+      // Write after read only has to wait for the readers
+      if(use.access != Access::eRead && readStages[r])
+      {
+        srcStages |= readStages[r];
+        hazards++;
+      }
+      // First use of aliased memory has to wait for the previous occupant
+      if(!touched[r] && resource.aliasOf >= 0)
+      {
+        srcStages |= lastStages[resource.aliasOf];
+        srcAccess |= writeAccess[resource.aliasOf];
+        hazards++;
+      }
+      // First use of unaliased memory has to wait for its last occupant in the previous frame
+      if(!touched[r] && resource.lastOccupant >= 0)
+      {
+        srcStages |= frameLastStages[resource.lastOccupant];
+        srcAccess |= frameWriteAccess[resource.lastOccupant];
+        hazards++;
+      }
+      // Imported images are produced outside the graph, swapchain images by the acquire semaphore wait
+      if(!touched[r] && resource.imported)
+      {
+        srcStages |= stage;
+        hazards++;
+      }
+      dstStages |= stage;
+      dstAccess |= access;
+
+      if(use.access == Access::eRead)
+      {
+        if(layouts[r] != vk::ImageLayout::eShaderReadOnlyOptimal)
+        {
+          vk::ImageMemoryBarrier barrier = {};
+          barrier.srcAccessMask = writeAccess[r];
+          barrier.dstAccessMask = vk::AccessFlagBits::eShaderRead;
+          barrier.oldLayout = layouts[r];
+          barrier.newLayout = vk::ImageLayout::eShaderReadOnlyOptimal;
+          barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+          barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+          barrier.subresourceRange = vk::ImageSubresourceRange(aspectMask(resource.format), 0, 1, 0, 1);
+          pass.preBarriers.push_back(barrier);
+          pass.preBarrierResources.push_back(r);
+          pass.preSrcStages |= writeStages[r] ? writeStages[r] : vk::PipelineStageFlags(vk::PipelineStageFlagBits::eTopOfPipe);
+          layouts[r] = vk::ImageLayout::eShaderReadOnlyOptimal;
+        }
+        continue;
+      }
+
+      // The next alive pass touching the resource decides what layout this pass leaves it in
+      vk::ImageLayout attachmentLayout = use.access == Access::eColor ? vk::ImageLayout::eColorAttachmentOptimal : vk::ImageLayout::eDepthStencilAttachmentOptimal;
+      vk::ImageLayout finalLayout = attachmentLayout;
+      bool usedLater{false};
+      for(int q = p + 1; q < static_cast<int>(passes.size()) && !usedLater; q++)
+      {
+        if(!passes[q].alive)
+        {
+          continue;
+        }
+        for(const auto& later : passes[q].uses)
+        {
+          if(later.resource != r)
+          {
+            continue;
+          }
+          usedLater = true;
+          if(later.access == Access::eRead)
+          {
+            finalLayout = vk::ImageLayout::eShaderReadOnlyOptimal;
+          }
+          else
+          {
+            finalLayout = later.access == Access::eColor ? vk::ImageLayout::eColorAttachmentOptimal : vk::ImageLayout::eDepthStencilAttachmentOptimal;
+          }
+          break;
+        }
+      }
+      if(!usedLater && resource.imported)
+      {
+        finalLayout = resource.finalLayout;
+      }
+      else if(!usedLater && resource.output)
+      {
+        finalLayout = vk::ImageLayout::eShaderReadOnlyOptimal;
+      }
+
+      vk::AttachmentDescription description = {};
+      description.format = resource.format;
+      description.samples = vk::SampleCountFlagBits::e1;
+      if(use.clear)
+      {
+        description.loadOp = vk::AttachmentLoadOp::eClear;
+      }
+      else
+      {
+        description.loadOp = layouts[r] == vk::ImageLayout::eUndefined ? vk::AttachmentLoadOp::eDontCare : vk::AttachmentLoadOp::eLoad;
+      }
+      // Nothing reads transient contents after their last pass, so they never have to reach memory
+      description.storeOp = usedLater || resource.imported || resource.output ? vk::AttachmentStoreOp::eStore : vk::AttachmentStoreOp::eDontCare;
+      description.stencilLoadOp = vk::AttachmentLoadOp::eDontCare;
+      description.stencilStoreOp = vk::AttachmentStoreOp::eDontCare;
+      description.initialLayout = layouts[r];
+      description.finalLayout = finalLayout;
+      layouts[r] = finalLayout;
+
+      uint32_t attachment = static_cast<uint32_t>(descriptions.size());
+      descriptions.push_back(description);
+      pass.attachments.push_back(r);
+      pass.clearValues.push_back(use.clearValue);
+      if(use.access == Access::eColor)
+      {
+        colorRefs.push_back(vk::AttachmentReference(attachment, attachmentLayout));
+      }
+      else
+      {
+        depthRef = vk::AttachmentReference(attachment, attachmentLayout);
+        hasDepth = true;
+      }
+    }
+
+    // All accesses of this pass are recorded only after every hazard check above
+    for(const auto& use : pass.uses)
+    {
+      RenderGraphResource r = use.resource;
+      vk::PipelineStageFlags stage = use.access == Access::eColor ? vk::PipelineStageFlags(vk::PipelineStageFlagBits::eColorAttachmentOutput)
+                                   : use.access == Access::eDepth ? vk::PipelineStageFlagBits::eEarlyFragmentTests | vk::PipelineStageFlagBits::eLateFragmentTests
+                                   : vk::PipelineStageFlags(vk::PipelineStageFlagBits::eFragmentShader);
+      if(use.access == Access::eRead)
+      {
+        readStages[r] |= stage;
+      }
+      else
+      {
+        writeStages[r] = stage;
+        writeAccess[r] = use.access == Access::eColor ? vk::AccessFlags(vk::AccessFlagBits::eColorAttachmentWrite) : vk::AccessFlagBits::eDepthStencilAttachmentWrite;
+        readStages[r] = vk::PipelineStageFlags();
+      }
+      lastStages[r] = stage;
+      touched[r] = true;
+    }
+
+    vk::SubpassDescription subpass = {};
+    subpass.pipelineBindPoint = vk::PipelineBindPoint::eGraphics;
+    subpass.colorAttachmentCount = static_cast<uint32_t>(colorRefs.size());
+    subpass.pColorAttachments = colorRefs.data();
+    subpass.pDepthStencilAttachment = hasDepth ? &depthRef : nullptr;
+
+    // One dependency covers every hazard of the pass, layout transitions happen inside it
+    vk::SubpassDependency dependency = {};
+    dependency.srcSubpass = VK_SUBPASS_EXTERNAL;
+    dependency.dstSubpass = 0;
+    dependency.srcStageMask = srcStages;
+    dependency.srcAccessMask = srcAccess;
+    dependency.dstStageMask = dstStages;
+    dependency.dstAccessMask = dstAccess;
+
+    vk::RenderPassCreateInfo renderPassInfo = {};
+    renderPassInfo.attachmentCount = static_cast<uint32_t>(descriptions.size());
+    renderPassInfo.pAttachments = descriptions.data();
+    renderPassInfo.subpassCount = 1;
+    renderPassInfo.pSubpasses = &subpass;
+    renderPassInfo.dependencyCount = srcStages ? 1 : 0;
+    renderPassInfo.pDependencies = &dependency;
+
+    try
+    {
+      pass.renderPass = device.createRenderPass(renderPassInfo);
+    }
+    catch(vk::SystemError& e)
+    {
+      std::cerr << e.what() << '\n';
+      throw std::runtime_error("Failed to create render pass for " + pass.name + "\n");
+    }
+
+    stats.barriers += (srcStages ? 1 : 0) + (pass.preBarriers.empty() ? 0 : 1);
+    stats.unmergedBarriers += hazards;
+  }
+}
+
+void RenderGraph::setExtent(const vk::Extent2D& newExtent)
+{
+  destroyFramebuffers();
+  if(newExtent == extent)
+  {
+    return;
+  }
+  extent = newExtent;
+  if(compiled)
+  {
+    destroyTransients();
+    vk::DeviceSize allocated = stats.allocatedBytes;
+    stats.transientBytes = 0;
+    stats.allocatedBytes = 0;
+    createTransients();
+    if(debugMode && allocated != stats.allocatedBytes)
+    {
+      std::cout << "Render graph transient memory resized to " << stats.allocatedBytes << " bytes\n";
+    }
+  }
+}
+
+void RenderGraph::bindImage(RenderGraphResource resource, vk::Image image, vk::ImageView view)
+{
+  resources[resource].image = image;
+  resources[resource].view = view;
+}
+
+vk::Framebuffer RenderGraph::getFramebuffer(RenderGraphPass pass)
+{
+  Pass& compiledPass = passes[pass];
+  std::vector<VkImageView> views;
+  for(RenderGraphResource r : compiledPass.attachments)
+  {
+    views.push_back(resources[r].view);
+  }
+  auto cached = compiledPass.framebuffers.find(views);
+  if(cached != compiledPass.framebuffers.end())
+  {
+    return cached->second;
+  }
+
+  std::vector<vk::ImageView> attachments(views.begin(), views.end());
+  vk::FramebufferCreateInfo framebufferInfo = {};
+  framebufferInfo.renderPass = compiledPass.renderPass;
+  framebufferInfo.attachmentCount = static_cast<uint32_t>(attachments.size());
+  framebufferInfo.pAttachments = attachments.data();
+  framebufferInfo.width = extent.width;
+  framebufferInfo.height = extent.height;
+  framebufferInfo.layers = 1;
+
+  try
+  {
+    vk::Framebuffer framebuffer = device.createFramebuffer(framebufferInfo);
+    compiledPass.framebuffers[views] = framebuffer;
+    return framebuffer;
+  }
+  catch(vk::SystemError& e)
+  {
+    std::cerr << e.what() << '\n';
+    throw std::runtime_error("Failed to create framebuffer for " + compiledPass.name + "\n");
+  }
+}
+
+void RenderGraph::destroyFramebuffers()
+{
+  for(auto& pass : passes)
+  {
+    for(auto& framebuffer : pass.framebuffers)
+    {
+      device.destroyFramebuffer(framebuffer.second);
+    }
+    pass.framebuffers.clear();
+  }
+}
+
+void RenderGraph::execute(vk::CommandBuffer commandBuffer)
+{
+  for(RenderGraphPass p = 0; p < passes.size(); p++)
+  {
+    Pass& pass = passes[p];
+    if(!pass.alive)
+    {
+      continue;
+    }
+
+    if(!pass.preBarriers.empty())
+    {
+      for(size_t i = 0; i < pass.preBarriers.size(); i++)
+      {
+        pass.preBarriers[i].image = resources[pass.preBarrierResources[i]].image;
+      }
+      commandBuffer.pipelineBarrier(pass.preSrcStages, vk::PipelineStageFlagBits::eFragmentShader, vk::DependencyFlags(), nullptr, nullptr, pass.preBarriers);
+    }
+
+    vk::RenderPassBeginInfo renderPassInfo = {};
+    renderPassInfo.renderPass = pass.renderPass;
+    renderPassInfo.framebuffer = getFramebuffer(p);
+    renderPassInfo.renderArea.offset = vk::Offset2D(0, 0);
+    renderPassInfo.renderArea.extent = extent;
+    renderPassInfo.clearValueCount = static_cast<uint32_t>(pass.clearValues.size());
+    renderPassInfo.pClearValues = pass.clearValues.data();
+
+    commandBuffer.beginRenderPass(renderPassInfo, pass.contents);
+    if(pass.record)
+    {
+      pass.record(commandBuffer);
+    }
+    commandBuffer.endRenderPass();
+  }
+}
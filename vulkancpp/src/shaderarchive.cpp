@@ -0,0 +1,216 @@
+#include "shaderarchive.hpp"
+#include "hash.hpp"
+
+#include <fstream>
+#include <filesystem>
+#include <cstring>
+#include <unordered_set>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace
+{
+  // "SPAK", followed by the layout version of the archive
+  constexpr uint32_t archiveMagic{0x4B415053};
+  constexpr uint32_t archiveVersion{1};
+  constexpr size_t nameSize{48};
+  // Keeps every shader word aligned, the mapping itself starts on a page
+  constexpr uint64_t codeAlignment{16};
+
+  struct ArchiveHeader
+  {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t entryCount;
+    uint32_t reserved;
+  };
+
+  struct ArchiveEntry
+  {
+    char name[nameSize];
+    uint64_t offset;
+    uint64_t size;
+    uint64_t hash;
+  };
+
+  uint64_t alignCode(uint64_t offset)
+  {
+    return (offset + codeAlignment - 1) & ~(codeAlignment - 1);
+  }
+}
+
+void ShaderArchive::open(const std::string& path, const bool& debug)
+{
+  int file = ::open(path.c_str(), O_RDONLY);
+  if(file < 0)
+  {
+    throw std::runtime_error("Failed to open shader archive " + path + "\n");
+  }
+  struct stat info;
+  if(fstat(file, &info) != 0 || info.st_size < static_cast<off_t>(sizeof(ArchiveHeader)))
+  {
+    ::close(file);
+    throw std::runtime_error("Shader archive " + path + " is truncated\n");
+  }
+  mappingSize = static_cast<size_t>(info.st_size);
+  mapping = mmap(nullptr, mappingSize, PROT_READ, MAP_PRIVATE, file, 0);
+  // The mapping keeps the file alive on its own
+  ::close(file);
+  if(mapping == MAP_FAILED)
+  {
+    mapping = nullptr;
+    throw std::runtime_error("Failed to map shader archive " + path + "\n");
+  }
+  // Most shaders become modules during startup, read them in ahead of the first fault
+  madvise(mapping, mappingSize, MADV_WILLNEED);
+
+  try
+  {
+    readIndex(debug);
+  }
+  catch(std::runtime_error& e)
+  {
+    close();
+    throw std::runtime_error("Shader archive " + path + ": " + e.what());
+  }
+
+  if(debug)
+  {
+    std::cout << "Shader archive mapped: " << path << ", " << index.size() << " shaders, " << mappingSize << " bytes\n";
+  }
+}
+
+void ShaderArchive::readIndex(const bool& debug)
+{
+  const char* base = static_cast<const char*>(mapping);
+  ArchiveHeader header;
+  std::memcpy(&header, base, sizeof(header));
+  if(header.magic != archiveMagic || header.version != archiveVersion)
+  {
+    throw std::runtime_error("unknown format\n");
+  }
+  uint64_t indexEnd = sizeof(ArchiveHeader) + uint64_t{header.entryCount} * sizeof(ArchiveEntry);
+  if(indexEnd > mappingSize)
+  {
+    throw std::runtime_error("truncated index\n");
+  }
+
+  for(uint32_t i = 0; i < header.entryCount; i++)
+  {
+    ArchiveEntry entry;
+    std::memcpy(&entry, base + sizeof(ArchiveHeader) + i * sizeof(ArchiveEntry), sizeof(entry));
+    std::string name(entry.name, strnlen(entry.name, nameSize));
+    if(entry.offset < indexEnd || entry.offset > mappingSize || entry.size > mappingSize - entry.offset
+       || entry.offset % sizeof(uint32_t) != 0 || entry.size % sizeof(uint32_t) != 0)
+    {
+      throw std::runtime_error("entry " + name + " out of bounds\n");
+    }
+    ShaderCode code = {};
+    code.words = reinterpret_cast<const uint32_t*>(base + entry.offset);
+    code.size = static_cast<size_t>(entry.size);
+    code.hash = entry.hash;
+    // Touches every page, which the release path leaves to the driver
+    if(debug && hashBytes(code.words, code.size) != code.hash)
+    {
+      throw std::runtime_error("entry " + name + " does not match its hash\n");
+    }
+    index[name] = code;
+  }
+}
+
+void ShaderArchive::close()
+{
+  if(mapping != nullptr)
+  {
+    munmap(mapping, mappingSize);
+  }
+  mapping = nullptr;
+  mappingSize = 0;
+  index.clear();
+}
+
+ShaderCode ShaderArchive::find(const std::string& name) const
+{
+  auto found = index.find(name);
+  if(found == index.end())
+  {
+    throw std::runtime_error("Shader " + name + " not found in archive\n");
+  }
+  return found->second;
+}
+
+void ShaderArchive::write(const std::string& path, const std::vector<std::string>& files)
+{
+  std::vector<ArchiveEntry> entries(files.size());
+  std::vector<std::vector<char>> codes(files.size());
+  std::unordered_set<std::string> names;
+  uint64_t offset = alignCode(sizeof(ArchiveHeader) + entries.size() * sizeof(ArchiveEntry));
+
+  for(size_t i = 0; i < files.size(); i++)
+  {
+    std::ifstream file(files[i], std::ios::ate | std::ios::binary);
+    if(!file.is_open())
+    {
+      throw std::runtime_error("Failed to open file " + files[i] + "\n");
+    }
+    codes[i].resize(static_cast<size_t>(file.tellg()));
+    file.seekg(0);
+    file.read(codes[i].data(), codes[i].size());
+    if(!file || codes[i].empty() || codes[i].size() % sizeof(uint32_t) != 0)
+    {
+      throw std::runtime_error("Not a SPIR-V module: " + files[i] + "\n");
+    }
+
+    std::string name = std::filesystem::path(files[i]).stem().string();
+    if(name.size() >= nameSize)
+    {
+      throw std::runtime_error("Shader name too long for the archive: " + name + "\n");
+    }
+    if(!names.insert(name).second)
+    {
+      throw std::runtime_error("Shader packed twice: " + name + "\n");
+    }
+
+    ArchiveEntry& entry = entries[i];
+    std::memset(&entry, 0, sizeof(entry));
+    std::memcpy(entry.name, name.data(), name.size());
+    entry.offset = offset;
+    entry.size = codes[i].size();
+    entry.hash = hashBytes(codes[i].data(), codes[i].size());
+    offset = alignCode(offset + entry.size);
+  }
+
+  ArchiveHeader header = {};
+  header.magic = archiveMagic;
+  header.version = archiveVersion;
+  header.entryCount = static_cast<uint32_t>(entries.size());
+
+  // Renamed over the destination once complete, a running program never maps half an archive
+  std::string temporaryPath = path + ".tmp";
+  {
+    std::ofstream file(temporaryPath, std::ios::binary | std::ios::trunc);
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    file.write(reinterpret_cast<const char*>(entries.data()), entries.size() * sizeof(ArchiveEntry));
+    const char padding[codeAlignment] = {};
+    for(size_t i = 0; i < entries.size(); i++)
+    {
+      file.write(padding, entries[i].offset - static_cast<uint64_t>(file.tellp()));
+      file.write(codes[i].data(), codes[i].size());
+    }
+    file.flush();
+    if(!file)
+    {
+      throw std::runtime_error("Failed to write shader archive " + temporaryPath + "\n");
+    }
+  }
+  std::error_code error;
+  std::filesystem::rename(temporaryPath, path, error);
+  if(error)
+  {
+    std::filesystem::remove(temporaryPath, error);
+    throw std::runtime_error("Failed to replace shader archive " + path + "\n");
+  }
+}
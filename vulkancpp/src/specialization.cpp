@@ -0,0 +1,60 @@
+#include "specialization.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+SpecializationConstants& SpecializationConstants::set(uint32_t constantId, bool value)
+{
+  // SPIR-V booleans are 32 bits wide
+  setWord(constantId, value ? VK_TRUE : VK_FALSE);
+  return *this;
+}
+
+SpecializationConstants& SpecializationConstants::set(uint32_t constantId, int32_t value)
+{
+  setWord(constantId, static_cast<uint32_t>(value));
+  return *this;
+}
+
+SpecializationConstants& SpecializationConstants::set(uint32_t constantId, uint32_t value)
+{
+  setWord(constantId, value);
+  return *this;
+}
+
+SpecializationConstants& SpecializationConstants::set(uint32_t constantId, float value)
+{
+  uint32_t word;
+  std::memcpy(&word, &value, sizeof(word));
+  setWord(constantId, word);
+  return *this;
+}
+
+void SpecializationConstants::setWord(uint32_t constantId, uint32_t word)
+{
+  auto position = std::lower_bound(entries.begin(), entries.end(), constantId,
+                                   [](const vk::SpecializationMapEntry& entry, uint32_t id) { return entry.constantID < id; });
+  size_t index = static_cast<size_t>(position - entries.begin());
+  if(position != entries.end() && position->constantID == constantId)
+  {
+    data[index] = word;
+    return;
+  }
+
+  entries.insert(position, vk::SpecializationMapEntry(constantId, 0, sizeof(uint32_t)));
+  data.insert(data.begin() + index, word);
+  for(size_t i = index; i < entries.size(); i++)
+  {
+    entries[i].offset = static_cast<uint32_t>(i * sizeof(uint32_t));
+  }
+}
+
+vk::SpecializationInfo SpecializationConstants::info() const
+{
+  vk::SpecializationInfo specializationInfo = {};
+  specializationInfo.mapEntryCount = static_cast<uint32_t>(entries.size());
+  specializationInfo.pMapEntries = entries.data();
+  specializationInfo.dataSize = data.size() * sizeof(uint32_t);
+  specializationInfo.pData = data.data();
+  return specializationInfo;
+}
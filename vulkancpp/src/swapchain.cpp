@@ -117,22 +117,63 @@ vk::SurfaceFormatKHR chooseSwapSurfaceFormat(const std::vector<vk::SurfaceFormat
   return availableFormats[0];
 }
 
-vk::PresentModeKHR chooseSwapPresentMode(const std::vector<vk::PresentModeKHR>& availablePresentModes)
+vk::PresentModeKHR chooseSwapPresentMode(const std::vector<vk::PresentModeKHR>& availablePresentModes, const PresentProfile& profile)
 {
-  vk::PresentModeKHR bestMode = vk::PresentModeKHR::eFifo;
-  for(auto mode : availablePresentModes)
+  // Preferred modes per profile, FIFO is always supported so it ends every list
+  std::vector<vk::PresentModeKHR> preferred;
+  switch(profile)
   {
-    if(mode == vk::PresentModeKHR::eMailbox)
+  case PresentProfile::eThroughput:
+    preferred = {vk::PresentModeKHR::eMailbox, vk::PresentModeKHR::eImmediate};
+    break;
+  case PresentProfile::eLatency:
+    preferred = {vk::PresentModeKHR::eImmediate, vk::PresentModeKHR::eMailbox, vk::PresentModeKHR::eFifoRelaxed};
+    break;
+  case PresentProfile::ePower:
+    break;
+  }
+
+  for(auto mode : preferred)
+  {
+    if(std::find(availablePresentModes.begin(), availablePresentModes.end(), mode) != availablePresentModes.end())
     {
       return mode;
     }
-    else if(mode == vk::PresentModeKHR::eImmediate)
-    {
-      bestMode = mode;
-    }
   }
 
-  return bestMode;
+  return vk::PresentModeKHR::eFifo;
+}
+
+uint32_t chooseSwapImageCount(const vk::SurfaceCapabilitiesKHR& capabilities, const PresentProfile& profile)
+{
+  // Throughput wants a spare image so the CPU never waits on presentation,
+  // latency and power keep the queue as short as the surface allows
+  uint32_t imageCount = capabilities.minImageCount;
+  if(profile == PresentProfile::eThroughput)
+  {
+    imageCount += 1;
+  }
+
+  // maxImageCount of 0 means there is no upper limit
+  if(capabilities.maxImageCount > 0)
+  {
+    imageCount = std::min(imageCount, capabilities.maxImageCount);
+  }
+  return imageCount;
+}
+
+std::string presentProfileName(const PresentProfile& profile)
+{
+  switch(profile)
+  {
+  case PresentProfile::eThroughput:
+    return "Throughput";
+  case PresentProfile::eLatency:
+    return "Latency";
+  case PresentProfile::ePower:
+    return "Power";
+  }
+  return "Unknown";
 }
 
 vk::Extent2D chooseSwapExtent(const vk::SurfaceCapabilitiesKHR& capabilities, int width, int height)
@@ -150,14 +191,18 @@ vk::Extent2D chooseSwapExtent(const vk::SurfaceCapabilitiesKHR& capabilities, in
   }
 }
 
-SwapChain crateSwapChain(const vk::PhysicalDevice& physicalDevice, const vk::Device& device, const vk::SurfaceKHR& surface, const int& width, const int& height, const bool& debug)
+SwapChain crateSwapChain(const vk::PhysicalDevice& physicalDevice, const vk::Device& device, const vk::SurfaceKHR& surface, const int& width, const int& height, const PresentProfile& profile, const vk::SwapchainKHR& oldSwapchain, const bool& debug)
 {
   SwapChainSupportDetails swapChainSupport = querySwapChainSupport(physicalDevice, surface, debug);
   vk::SurfaceFormatKHR surfaceFormat = chooseSwapSurfaceFormat(swapChainSupport.formats);
-  vk::PresentModeKHR presentMode = chooseSwapPresentMode(swapChainSupport.presentModes);
+  vk::PresentModeKHR presentMode = chooseSwapPresentMode(swapChainSupport.presentModes, profile);
   vk::Extent2D extent = chooseSwapExtent(swapChainSupport.capabilities, width, height);
 
-  uint32_t imageCount = std::min(swapChainSupport.capabilities.minImageCount + 1, swapChainSupport.capabilities.maxImageCount);
+  uint32_t imageCount = chooseSwapImageCount(swapChainSupport.capabilities, profile);
+  if(debug)
+  {
+    std::cout << presentProfileName(profile) << " profile: present mode " << vk::to_string(presentMode) << ", " << imageCount << " images\n";
+  }
   
   /*
     SwapchainCreateInfoKHR {
@@ -189,6 +234,11 @@ SwapChain crateSwapChain(const vk::PhysicalDevice& physicalDevice, const vk::Dev
     1,
     vk::ImageUsageFlagBits::eColorAttachment
   );
+  // Allows framebuffer readback, only when the surface supports copying out of its images
+  if(swapChainSupport.capabilities.supportedUsageFlags & vk::ImageUsageFlagBits::eTransferSrc)
+  {
+    createInfo.imageUsage |= vk::ImageUsageFlagBits::eTransferSrc;
+  }
 
   QueueFamilyIndices indices = findQueueFamilies(physicalDevice, surface, debug);
   uint32_t queueFamilyIndices[] = {indices.graphicsFamily.value(), indices.presentFamily.value()};
@@ -211,7 +261,8 @@ SwapChain crateSwapChain(const vk::PhysicalDevice& physicalDevice, const vk::Dev
   createInfo.compositeAlpha = vk::CompositeAlphaFlagBitsKHR::eOpaque;
   createInfo.presentMode = presentMode;
   createInfo.clipped = VK_TRUE;
-  createInfo.oldSwapchain = vk::SwapchainKHR(VK_NULL_HANDLE);
+  // Handing over the old swapchain lets the driver reuse its resources, it is retired by this call
+  createInfo.oldSwapchain = oldSwapchain;
 
   SwapChain swapChain;
   try
@@ -256,6 +307,7 @@ SwapChain crateSwapChain(const vk::PhysicalDevice& physicalDevice, const vk::Dev
     swapChain.frames[i].imageView = device.createImageView(viewInfo);
   }
   swapChain.format = surfaceFormat.format;
+  swapChain.usage = createInfo.imageUsage;
   swapChain.extent = extent;
 
   return swapChain;
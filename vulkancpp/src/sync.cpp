@@ -28,4 +28,83 @@ vk::Fence createFence(const vk::Device& device, const bool& debug)
     std::cerr << e.what() << '\n';
     throw std::runtime_error("Failed to create fence\n");
   }
-}
\ No newline at end of file
+}
+
+vk::Semaphore createTimelineSemaphore(const vk::Device& device, uint64_t initialValue, const bool& debug)
+{
+  vk::SemaphoreTypeCreateInfo typeInfo = {};
+  typeInfo.semaphoreType = vk::SemaphoreType::eTimeline;
+  typeInfo.initialValue = initialValue;
+  vk::SemaphoreCreateInfo semaphoreInfo = {};
+  semaphoreInfo.flags = vk::SemaphoreCreateFlags();
+  semaphoreInfo.pNext = &typeInfo;
+  try
+  {
+    vk::Semaphore semaphore = device.createSemaphore(semaphoreInfo);
+    if(debug)
+    {
+      std::cout << "Timeline semaphore created\n";
+    }
+    return semaphore;
+  }
+  catch(vk::SystemError& e)
+  {
+    std::cerr << e.what() << '\n';
+    throw std::runtime_error("Failed to create timeline semaphore\n");
+  }
+}
+
+void Timeline::create(const vk::Device& device, const bool& debug)
+{
+  this->device = device;
+  semaphore = createTimelineSemaphore(device, 0, debug);
+  submittedValue = 0;
+  completedValue = 0;
+}
+
+void Timeline::destroy()
+{
+  device.destroySemaphore(semaphore);
+  semaphore = VK_NULL_HANDLE;
+}
+
+void Timeline::retire(uint64_t value)
+{
+  uint64_t known = completedValue.load(std::memory_order_relaxed);
+  while(known < value && !completedValue.compare_exchange_weak(known, value, std::memory_order_release, std::memory_order_relaxed))
+  {
+  }
+}
+
+uint64_t Timeline::completed()
+{
+  retire(device.getSemaphoreCounterValue(semaphore));
+  return completedValue.load(std::memory_order_acquire);
+}
+
+bool Timeline::isComplete(uint64_t value)
+{
+  // Cheap path: no driver call when the cached value already covers it
+  if(completedValue.load(std::memory_order_acquire) >= value)
+  {
+    return true;
+  }
+  return completed() >= value;
+}
+
+void Timeline::wait(uint64_t value)
+{
+  if(isComplete(value))
+  {
+    return;
+  }
+
+  vk::SemaphoreWaitInfo waitInfo = {};
+  waitInfo.semaphoreCount = 1;
+  waitInfo.pSemaphores = &semaphore;
+  waitInfo.pValues = &value;
+  if(device.waitSemaphores(waitInfo, UINT64_MAX) == vk::Result::eSuccess)
+  {
+    retire(value);
+  }
+}
@@ -0,0 +1,25 @@
+#include "shaderarchive.hpp"
+
+#include <cstdlib>
+
+// Pack compiled shaders into the archive the engine maps at startup:
+//   packshaders <archive> <shader.spv>...
+int main(int argc, char** argv)
+{
+  if(argc < 3)
+  {
+    std::cerr << "Usage: " << argv[0] << " <archive> <shader.spv>...\n";
+    return EXIT_FAILURE;
+  }
+  try
+  {
+    ShaderArchive::write(argv[1], {argv + 2, argv + argc});
+  }
+  catch(std::runtime_error& e)
+  {
+    std::cerr << e.what();
+    return EXIT_FAILURE;
+  }
+  std::cout << "Packed " << argc - 2 << " shaders into " << argv[1] << "\n";
+  return EXIT_SUCCESS;
+}